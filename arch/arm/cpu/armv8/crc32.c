@@ -0,0 +1,40 @@
+/*
+ * CRC32 using the ARMv8 CRC32 instructions
+ *
+ * These are optional in ARMv8.0, so ID_AA64ISAR0_EL1 is checked first.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <u-boot/crc.h>
+
+int crc32_arch_probe(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	/* ID_AA64ISAR0_EL1.CRC32, bits [19:16] */
+	return (isar0 >> 16) & 0xf;
+}
+
+uint crc32_arch_no_comp(uint32_t *crcp, const unsigned char *buf, uint len)
+{
+	uint32_t crc = *crcp;
+	uint done = len;
+
+	if (!crc32_arch_probe())
+		return 0;
+
+	for (; len && ((ulong)buf & 7); len--, buf++)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf));
+	for (; len >= 8; len -= 8, buf += 8)
+		asm("crc32x %w0, %w0, %x1"
+		    : "+r" (crc) : "r" (*(const u64 *)buf));
+	for (; len; len--, buf++)
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (*buf));
+	*crcp = crc;
+
+	return done;
+}
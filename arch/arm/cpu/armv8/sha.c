@@ -0,0 +1,150 @@
+/*
+ * SHA-1 and SHA-256 using the ARMv8 Cryptographic Extension
+ *
+ * These are optional, so ID_AA64ISAR0_EL1 is checked first. Each group of
+ * four rounds takes one instruction (two for SHA-256), with the message
+ * schedule worked out four words at a time alongside.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <arm_neon.h>
+
+static u64 read_isar0(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return isar0;
+}
+
+int sha1_arch_probe(void)
+{
+	/* ID_AA64ISAR0_EL1.SHA1, bits [11:8] */
+	return (read_isar0() >> 8) & 0xf;
+}
+
+int sha256_arch_probe(void)
+{
+	/* ID_AA64ISAR0_EL1.SHA2, bits [15:12] */
+	return (read_isar0() >> 12) & 0xf;
+}
+
+/* Load four big-endian message words */
+static inline uint32x4_t load_be32x4(const uint8_t *data)
+{
+	return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data)));
+}
+
+unsigned int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+			       unsigned int blocks)
+{
+	static const uint32_t sha1_k[4] = {
+		0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6,
+	};
+	uint32x4_t abcd, abcd_save, wk, m[4];
+	uint32_t e, e_save, e_next;
+	unsigned int done = blocks;
+	int i;
+
+	if (!sha1_arch_probe())
+		return 0;
+
+	abcd = vld1q_u32(state);
+	e = state[4];
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e;
+
+		for (i = 0; i < 20; i++) {
+			if (i < 4) {
+				m[i] = load_be32x4(data + i * 16);
+			} else {
+				m[i & 3] = vsha1su1q_u32(
+					vsha1su0q_u32(m[i & 3],
+						      m[(i + 1) & 3],
+						      m[(i + 2) & 3]),
+					m[(i + 3) & 3]);
+			}
+			wk = vaddq_u32(m[i & 3], vdupq_n_u32(sha1_k[i / 5]));
+			e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+			if (i < 5)
+				abcd = vsha1cq_u32(abcd, e, wk);
+			else if (i >= 10 && i < 15)
+				abcd = vsha1mq_u32(abcd, e, wk);
+			else
+				abcd = vsha1pq_u32(abcd, e, wk);
+			e = e_next;
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		e += e_save;
+	}
+	vst1q_u32(state, abcd);
+	state[4] = e;
+
+	return done;
+}
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+unsigned int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks)
+{
+	uint32x4_t abcd, efgh, abcd_save, efgh_save, prev, wk, m[4];
+	unsigned int done = blocks;
+	int i;
+
+	if (!sha256_arch_probe())
+		return 0;
+
+	abcd = vld1q_u32(state);
+	efgh = vld1q_u32(state + 4);
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		efgh_save = efgh;
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				m[i] = load_be32x4(data + i * 16);
+			} else {
+				m[i & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(m[i & 3],
+							m[(i + 1) & 3]),
+					m[(i + 2) & 3], m[(i + 3) & 3]);
+			}
+			wk = vaddq_u32(m[i & 3], vld1q_u32(&sha256_k[i * 4]));
+			prev = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, wk);
+			efgh = vsha256h2q_u32(efgh, prev, wk);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+	vst1q_u32(state, abcd);
+	vst1q_u32(state + 4, efgh);
+
+	return done;
+}
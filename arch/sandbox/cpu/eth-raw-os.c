@@ -0,0 +1,118 @@
+/*
+ * Host side of the sandbox Ethernet driver's raw socket and TAP backends
+ *
+ * This is built in the system environment, like os.c.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/if_tun.h>
+
+#include <asm/eth-raw-os.h>
+
+int sandbox_eth_raw_os_init(const char *ifname,
+			    struct eth_sandbox_raw_priv *priv)
+{
+	struct sockaddr_ll sll;
+	int flags;
+	int ret;
+
+	priv->device = if_nametoindex(ifname);
+	if (!priv->device)
+		return -errno;
+
+	priv->sd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (priv->sd < 0)
+		return -errno;
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_ifindex = priv->device;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	if (bind(priv->sd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+		goto err;
+
+	flags = fcntl(priv->sd, F_GETFL, 0);
+	if (flags < 0 || fcntl(priv->sd, F_SETFL, flags | O_NONBLOCK) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	ret = -errno;
+	sandbox_eth_raw_os_halt(priv);
+	return ret;
+}
+
+int sandbox_eth_tap_os_init(const char *ifname,
+			    struct eth_sandbox_raw_priv *priv)
+{
+	struct ifreq ifr;
+	int ret;
+
+	priv->device = 0;
+	priv->sd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (priv->sd < 0)
+		return -errno;
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	if (ioctl(priv->sd, TUNSETIFF, &ifr) < 0) {
+		ret = -errno;
+		sandbox_eth_raw_os_halt(priv);
+		return ret;
+	}
+
+	return 0;
+}
+
+int sandbox_eth_raw_os_send(const void *packet, int length,
+			    const struct eth_sandbox_raw_priv *priv)
+{
+	ssize_t ret;
+
+	if (priv->sd < 0)
+		return -EBADF;
+
+	ret = write(priv->sd, packet, length);
+	if (ret < 0)
+		return -errno;
+	if (ret != length)
+		return -EIO;
+
+	return 0;
+}
+
+int sandbox_eth_raw_os_recv(void *packet, int length,
+			    const struct eth_sandbox_raw_priv *priv)
+{
+	ssize_t ret;
+
+	if (priv->sd < 0)
+		return -EBADF;
+
+	ret = read(priv->sd, packet, length);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+
+	return ret;
+}
+
+void sandbox_eth_raw_os_halt(struct eth_sandbox_raw_priv *priv)
+{
+	if (priv->sd >= 0)
+		close(priv->sd);
+	priv->sd = -1;
+}
@@ -0,0 +1,258 @@
+/*
+ * SHA-1 and SHA-256 using the host CPU's SHA extensions (SHA-NI)
+ *
+ * This is built in the system environment, like os.c. Each group of four
+ * rounds takes one instruction, with the message schedule worked out four
+ * words at a time alongside.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+
+static int sha_probe(void)
+{
+	static int has_sha = -1;
+	unsigned int eax, ebx, ecx, edx;
+
+	if (has_sha == -1) {
+		has_sha = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+			(ecx & bit_SSE4_1) && (ecx & bit_SSSE3) &&
+			__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+			(ebx & bit_SHA);
+	}
+
+	return has_sha;
+}
+
+int sha1_arch_probe(void)
+{
+	return sha_probe();
+}
+
+int sha256_arch_probe(void)
+{
+	return sha_probe();
+}
+
+/*
+ * Rounds 4 * i to 4 * i + 3 using message words @m. The round function is
+ * an immediate operand, so @i must be a constant.
+ */
+#define SHA1_ROUNDS(i, m) do {						\
+	e = (i) ? _mm_sha1nexte_epu32(e, m) : _mm_add_epi32(e, m);	\
+	prev = abcd;							\
+	abcd = _mm_sha1rnds4_epu32(abcd, e, (i) / 5);			\
+	e = prev;							\
+} while (0)
+
+/* Message words for the next four rounds, from the last sixteen */
+#define SHA1_SCHED(a, b, c, d)						\
+	a = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(a, b), c), d)
+
+static SHA_TARGET void sha1_ni(uint32_t state[5], const unsigned char *data,
+			       unsigned int blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+					     0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e, e_save, prev;
+	__m128i m0, m1, m2, m3;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+				 0x1b);
+	e = _mm_set_epi32(state[4], 0, 0, 0);
+
+	for (; blocks; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e;
+
+		m0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data), bswap);
+		m1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 1), bswap);
+		m2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 2), bswap);
+		m3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 3), bswap);
+		SHA1_ROUNDS(0, m0);
+		SHA1_ROUNDS(1, m1);
+		SHA1_ROUNDS(2, m2);
+		SHA1_ROUNDS(3, m3);
+		SHA1_SCHED(m0, m1, m2, m3);
+		SHA1_ROUNDS(4, m0);
+		SHA1_SCHED(m1, m2, m3, m0);
+		SHA1_ROUNDS(5, m1);
+		SHA1_SCHED(m2, m3, m0, m1);
+		SHA1_ROUNDS(6, m2);
+		SHA1_SCHED(m3, m0, m1, m2);
+		SHA1_ROUNDS(7, m3);
+		SHA1_SCHED(m0, m1, m2, m3);
+		SHA1_ROUNDS(8, m0);
+		SHA1_SCHED(m1, m2, m3, m0);
+		SHA1_ROUNDS(9, m1);
+		SHA1_SCHED(m2, m3, m0, m1);
+		SHA1_ROUNDS(10, m2);
+		SHA1_SCHED(m3, m0, m1, m2);
+		SHA1_ROUNDS(11, m3);
+		SHA1_SCHED(m0, m1, m2, m3);
+		SHA1_ROUNDS(12, m0);
+		SHA1_SCHED(m1, m2, m3, m0);
+		SHA1_ROUNDS(13, m1);
+		SHA1_SCHED(m2, m3, m0, m1);
+		SHA1_ROUNDS(14, m2);
+		SHA1_SCHED(m3, m0, m1, m2);
+		SHA1_ROUNDS(15, m3);
+		SHA1_SCHED(m0, m1, m2, m3);
+		SHA1_ROUNDS(16, m0);
+		SHA1_SCHED(m1, m2, m3, m0);
+		SHA1_ROUNDS(17, m1);
+		SHA1_SCHED(m2, m3, m0, m1);
+		SHA1_ROUNDS(18, m2);
+		SHA1_SCHED(m3, m0, m1, m2);
+		SHA1_ROUNDS(19, m3);
+
+		/* e holds A from before the last rounds, which gives E */
+		e = _mm_sha1nexte_epu32(e, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e, 3);
+}
+
+unsigned int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+			       unsigned int blocks)
+{
+	if (!sha_probe())
+		return 0;
+	sha1_ni(state, data, blocks);
+
+	return blocks;
+}
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* Rounds 4 * i to 4 * i + 3 using message words @m */
+#define SHA256_ROUNDS(i, m) do {					\
+	msg = _mm_add_epi32(m,						\
+		_mm_load_si128((const __m128i *)&sha256_k[4 * (i)]));	\
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);			\
+	abef = _mm_sha256rnds2_epu32(abef, cdgh,			\
+				     _mm_shuffle_epi32(msg, 0x0e));	\
+} while (0)
+
+/* Message words for the next four rounds, from the last sixteen */
+#define SHA256_SCHED(a, b, c, d)					\
+	a = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(a, b), \
+					       _mm_alignr_epi8(d, c, 4)), d)
+
+static SHA_TARGET void sha256_ni(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i abef, cdgh, abef_save, cdgh_save, msg, tmp;
+	__m128i m0, m1, m2, m3;
+	int i;
+
+	/* The instructions want the state as ABEF and CDGH */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+				0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state + 1),
+				 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; blocks; blocks--, data += 64) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+
+		m0 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data), bswap);
+		m1 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 1), bswap);
+		m2 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 2), bswap);
+		m3 = _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)data + 3), bswap);
+		SHA256_ROUNDS(0, m0);
+		SHA256_ROUNDS(1, m1);
+		SHA256_ROUNDS(2, m2);
+		SHA256_ROUNDS(3, m3);
+		for (i = 4; i < 16; i += 4) {
+			SHA256_SCHED(m0, m1, m2, m3);
+			SHA256_ROUNDS(i, m0);
+			SHA256_SCHED(m1, m2, m3, m0);
+			SHA256_ROUNDS(i + 1, m1);
+			SHA256_SCHED(m2, m3, m0, m1);
+			SHA256_ROUNDS(i + 2, m2);
+			SHA256_SCHED(m3, m0, m1, m2);
+			SHA256_ROUNDS(i + 3, m3);
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	/* Back to ABCD and EFGH */
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *)state, _mm_blend_epi16(tmp, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *)state + 1, _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+unsigned int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks)
+{
+	if (!sha_probe())
+		return 0;
+	sha256_ni(state, data, blocks);
+
+	return blocks;
+}
+#else
+int sha1_arch_probe(void)
+{
+	return 0;
+}
+
+int sha256_arch_probe(void)
+{
+	return 0;
+}
+
+unsigned int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+			       unsigned int blocks)
+{
+	return 0;
+}
+
+unsigned int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks)
+{
+	return 0;
+}
+#endif
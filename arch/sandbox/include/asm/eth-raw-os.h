@@ -0,0 +1,76 @@
+/*
+ * Host side of the sandbox Ethernet driver's raw socket and TAP backends
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __ETH_RAW_OS_H
+#define __ETH_RAW_OS_H
+
+/**
+ * struct eth_sandbox_raw_priv - host link used by the sandbox Ethernet driver
+ *
+ * sd: packet socket or TAP file descriptor, -1 if not open
+ * device: host interface index of a packet socket
+ */
+struct eth_sandbox_raw_priv {
+	int sd;
+	int device;
+};
+
+/**
+ * sandbox_eth_raw_os_init() - Open a packet socket on a host interface
+ *
+ * Every frame seen by the interface is received, so the caller has to
+ * filter on the destination address. This needs CAP_NET_RAW.
+ *
+ * @ifname:	Host interface name, e.g. "eth0"
+ * @priv:	Returns the open link
+ * @return 0 if OK, -errno on error
+ */
+int sandbox_eth_raw_os_init(const char *ifname,
+			    struct eth_sandbox_raw_priv *priv);
+
+/**
+ * sandbox_eth_tap_os_init() - Attach to a host TAP interface
+ *
+ * The interface is created if it does not exist yet, which needs
+ * CAP_NET_ADMIN; an existing persistent TAP owned by the user does not.
+ *
+ * @ifname:	TAP interface name, e.g. "tap0"
+ * @priv:	Returns the open link
+ * @return 0 if OK, -errno on error
+ */
+int sandbox_eth_tap_os_init(const char *ifname,
+			    struct eth_sandbox_raw_priv *priv);
+
+/**
+ * sandbox_eth_raw_os_send() - Send one Ethernet frame to the host
+ *
+ * @packet:	Frame, starting with the Ethernet header
+ * @length:	Length of the frame in bytes
+ * @priv:	Open link
+ * @return 0 if OK, -errno on error
+ */
+int sandbox_eth_raw_os_send(const void *packet, int length,
+			    const struct eth_sandbox_raw_priv *priv);
+
+/**
+ * sandbox_eth_raw_os_recv() - Receive one Ethernet frame without waiting
+ *
+ * @packet:	Buffer for the frame
+ * @length:	Size of the buffer in bytes
+ * @priv:	Open link
+ * @return length of the frame, 0 if none is waiting, -errno on error
+ */
+int sandbox_eth_raw_os_recv(void *packet, int length,
+			    const struct eth_sandbox_raw_priv *priv);
+
+/**
+ * sandbox_eth_raw_os_halt() - Close the link
+ *
+ * @priv:	Link to close, marked as not open afterwards
+ */
+void sandbox_eth_raw_os_halt(struct eth_sandbox_raw_priv *priv);
+
+#endif
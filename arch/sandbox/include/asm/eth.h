@@ -0,0 +1,25 @@
+/*
+ * Sandbox Ethernet driver
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __SANDBOX_ETH_H
+#define __SANDBOX_ETH_H
+
+/**
+ * sandbox_eth_show_stats() - Show the driver's latency statistics
+ *
+ * For received packets this is the time spent in NetReceive(), for sent
+ * packets the time taken by the peer to accept them and for replies the
+ * time from a packet being received to the stack sending something back
+ * in response.
+ */
+void sandbox_eth_show_stats(void);
+
+/**
+ * sandbox_eth_reset_stats() - Clear the driver's latency statistics
+ */
+void sandbox_eth_reset_stats(void);
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __SANDBOX_PROCESSOR_H__
+#define __SANDBOX_PROCESSOR_H__
+
+/* Sandbox has no processor registers to describe; common code includes this */
+
+#endif /* __SANDBOX_PROCESSOR_H__ */
@@ -28,8 +28,12 @@ struct sandbox_spi_emu_ops {
 	void (*cs_activate)(void *priv);
 	/* The CS has been "deactivated" -- we won't worry about low/high */
 	void (*cs_deactivate)(void *priv);
-	/* The client is rx-ing bytes from the bus, so it should tx some */
-	int (*xfer)(void *priv, const u8 *rx, u8 *tx, uint bytes);
+	/*
+	 * The client is rx-ing bytes from the bus, so it should tx some.
+	 * The SPI_XFER_DUAL/QUAD flags say how many lines the bytes are on.
+	 */
+	int (*xfer)(void *priv, const u8 *rx, u8 *tx, uint bytes,
+		    unsigned long flags);
 };
 
 /*
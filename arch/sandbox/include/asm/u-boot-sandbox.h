@@ -25,6 +25,9 @@ int sandbox_main_loop_init(void);
 
 int cleanup_before_linux(void);
 
+/* drivers/mtd/sandbox_mtdram.c */
+int sandbox_mtdram_init(void);
+
 /* drivers/video/sandbox_sdl.c */
 int sandbox_lcd_sdl_early_init(void);
 
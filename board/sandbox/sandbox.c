@@ -6,6 +6,7 @@
 #include <common.h>
 #include <cros_ec.h>
 #include <dm.h>
+#include <netdev.h>
 #include <os.h>
 #include <asm/u-boot-sandbox.h>
 
@@ -53,6 +54,13 @@ int board_early_init_f(void)
 }
 #endif
 
+#ifdef CONFIG_ETH_SANDBOX
+int board_eth_init(bd_t *bis)
+{
+	return sandbox_eth_initialize(bis);
+}
+#endif
+
 int arch_early_init_r(void)
 {
 #ifdef CONFIG_CROS_EC
@@ -61,6 +69,10 @@ int arch_early_init_r(void)
 		return 0;
 	}
 #endif
+#ifdef CONFIG_SANDBOX_MTDRAM
+	if (sandbox_mtdram_init())
+		printf("%s: Failed to init MTD device\n", __func__);
+#endif
 
 	return 0;
 }
@@ -100,7 +100,8 @@ static int bootm_find_os(cmd_tbl_t *cmdtp, int flag, int argc,
 		images.os.comp = image_get_comp(os_hdr);
 		images.os.os = image_get_os(os_hdr);
 
-		images.os.end = image_get_image_end(os_hdr);
+		images.os.end = map_to_sysmem(os_hdr) +
+				image_get_image_size(os_hdr);
 		images.os.load = image_get_load(os_hdr);
 		break;
 #endif
@@ -129,7 +130,8 @@ static int bootm_find_os(cmd_tbl_t *cmdtp, int flag, int argc,
 			return 1;
 		}
 
-		images.os.end = fit_get_end(images.fit_hdr_os);
+		images.os.end = map_to_sysmem(images.fit_hdr_os) +
+				fit_get_size(images.fit_hdr_os);
 
 		if (fit_image_get_load(images.fit_hdr_os, images.fit_noffset_os,
 				       &images.os.load)) {
@@ -180,7 +182,7 @@ static int bootm_find_os(cmd_tbl_t *cmdtp, int flag, int argc,
 		images.ep += images.os.load;
 	}
 
-	images.os.start = (ulong)os_hdr;
+	images.os.start = map_to_sysmem(os_hdr);
 
 	return 0;
 }
@@ -368,13 +370,26 @@ static int bootm_load_os(bootm_headers_t *images, unsigned long *load_end,
 	void *load_buf, *image_buf;
 	int err;
 
-	load_buf = map_sysmem(load, 0);
-	image_buf = map_sysmem(os.image_start, image_len);
-	err = decomp_image(os.comp, load, os.image_start, os.type, load_buf,
-			   image_buf, image_len, load_end);
-	if (err) {
-		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
-		return err;
+	if (images->legacy_hdr_valid &&
+	    !image_stream_check(blob_start, &images->legacy_hdr_os_copy,
+				load_end)) {
+		/* Decompressed and verified by the loader */
+		printf("   %s unpacked while loading\n",
+		       genimg_get_type_name(os.type));
+	} else if (images->os_load_end) {
+		/* Copied or decompressed while its hashes were checked */
+		*load_end = images->os_load_end;
+		printf("   %s loaded while verifying\n",
+		       genimg_get_type_name(os.type));
+	} else {
+		load_buf = map_sysmem(load, 0);
+		image_buf = map_sysmem(os.image_start, image_len);
+		err = decomp_image(os.comp, load, os.image_start, os.type,
+				   load_buf, image_buf, image_len, load_end);
+		if (err) {
+			bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
+			return err;
+		}
 	}
 	flush_cache(load, (*load_end - load) * sizeof(ulong));
 
@@ -666,7 +681,7 @@ err:
  */
 static image_header_t *image_get_kernel(ulong img_addr, int verify)
 {
-	image_header_t *hdr = (image_header_t *)img_addr;
+	image_header_t *hdr = map_sysmem(img_addr, 0);
 
 	if (!image_check_magic(hdr)) {
 		puts("Bad Magic Number\n");
@@ -686,7 +701,8 @@ static image_header_t *image_get_kernel(ulong img_addr, int verify)
 
 	if (verify) {
 		puts("   Verifying Checksum ... ");
-		if (!image_check_dcrc(hdr)) {
+		if (image_stream_check(img_addr, hdr, NULL) &&
+		    !image_check_dcrc(hdr)) {
 			printf("Bad Data CRC\n");
 			bootstage_error(BOOTSTAGE_ID_CHECK_CHECKSUM);
 			return NULL;
@@ -790,6 +806,7 @@ static const void *boot_get_kernel(cmd_tbl_t *cmdtp, int flag, int argc,
 			bootstage_error(BOOTSTAGE_ID_CHECK_IMAGETYPE);
 			return NULL;
 		}
+		*os_data = map_to_sysmem((void *)*os_data);
 
 		/*
 		 * copy image header to allow for image overwrites during
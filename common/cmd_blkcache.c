@@ -0,0 +1,97 @@
+/*
+ * Block cache control command
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <part.h>
+
+static int blkc_show(int argc, char * const argv[])
+{
+	struct block_cache_stats stats;
+	unsigned total;
+
+	if (argc != 0)
+		return CMD_RET_USAGE;
+
+	blkcache_stats(&stats);
+	total = stats.hits + stats.misses;
+	printf("    hits: %u\n"
+	       "    misses: %u\n"
+	       "    bypassed: %u\n"
+	       "    hit rate: %u%%\n"
+	       "    entries: %u\n"
+	       "    max blocks/entry: %u\n"
+	       "    max entries: %u\n",
+	       stats.hits, stats.misses, stats.bypass,
+	       total ? stats.hits * 100 / total : 0, stats.entries,
+	       stats.max_blocks_per_entry, stats.max_entries);
+
+	return 0;
+}
+
+static int blkc_configure(int argc, char * const argv[])
+{
+	unsigned blocks, entries;
+
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	blocks = simple_strtoul(argv[0], NULL, 0);
+	entries = simple_strtoul(argv[1], NULL, 0);
+	blkcache_configure(blocks, entries);
+
+	printf("changed to max of %u entries of %u blocks each\n",
+	       entries, blocks);
+
+	return 0;
+}
+
+static int blkc_invalidate(int argc, char * const argv[])
+{
+	block_dev_desc_t *dev_desc;
+	int dev;
+
+	if (argc != 2)
+		return CMD_RET_USAGE;
+
+	dev = simple_strtoul(argv[1], NULL, 16);
+	dev_desc = get_dev(argv[0], dev);
+	if (!dev_desc) {
+		printf("** Bad device %s %d **\n", argv[0], dev);
+		return CMD_RET_FAILURE;
+	}
+	blkcache_invalidate(dev_desc->if_type, dev_desc->dev);
+
+	return 0;
+}
+
+static int do_blkcache(cmd_tbl_t *cmdtp, int flag, int argc,
+		       char * const argv[])
+{
+	const char *cmd = argc < 2 ? NULL : argv[1];
+
+	if (!cmd)
+		return CMD_RET_USAGE;
+	switch (*cmd) {
+	case 's':
+		return blkc_show(argc - 2, argv + 2);
+	case 'c':
+		return blkc_configure(argc - 2, argv + 2);
+	case 'i':
+		return blkc_invalidate(argc - 2, argv + 2);
+	default:
+		return CMD_RET_USAGE;
+	}
+}
+
+U_BOOT_CMD(
+	blkcache,	4,	0,	do_blkcache,
+	"block cache diagnostics and control",
+	"show                        - show statistics\n"
+	"blkcache configure <blocks> <entries> - set max blocks per entry\n"
+	"                                        and max entries\n"
+	"blkcache invalidate <interface> <dev> - drop cached blocks of a device"
+);
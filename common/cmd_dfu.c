@@ -53,6 +53,9 @@ static int do_dfu(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			goto exit;
 
 		usb_gadget_handle_interrupts();
+
+		/* write received data while the host sends more */
+		dfu_write_pending();
 	}
 exit:
 	g_dnl_unregister();
@@ -20,7 +20,19 @@ static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	char *s;
 #ifdef CONFIG_HASH_VERIFY
 	int flags = HASH_FLAG_ENV;
+#else
+	const int flags = HASH_FLAG_ENV;
+#endif
 
+#ifdef CONFIG_CMD_HASH_BENCH
+	if (argc >= 2 && !strcmp(argv[1], "bench")) {
+		if (hash_bench(argc > 2 ? simple_strtoul(argv[2], NULL, 0) :
+			       1 << 20))
+			return CMD_RET_FAILURE;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
 	if (!strcmp(argv[1], "-v")) {
@@ -28,8 +40,6 @@ static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		argc--;
 		argv++;
 	}
-#else
-	const int flags = HASH_FLAG_ENV;
 #endif
 	/* Move forward to 'algorithm' parameter */
 	argc--;
@@ -39,6 +49,13 @@ static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	return hash_command(*argv, flags, cmdtp, flag, argc - 1, argv + 1);
 }
 
+#ifdef CONFIG_CMD_HASH_BENCH
+#define HASH_BENCH_HELP \
+	"\nhash bench [size]\n    - compare the speed of each hash algorithm"
+#else
+#define HASH_BENCH_HELP
+#endif
+
 #ifdef CONFIG_HASH_VERIFY
 U_BOOT_CMD(
 	hash,	6,	1,	do_hash,
@@ -47,6 +64,7 @@ U_BOOT_CMD(
 		"    - compute message digest [save to env var / *address]\n"
 	"hash -v algorithm address count [*]sum\n"
 		"    - verify hash of memory area with env var / *address"
+	HASH_BENCH_HELP
 );
 #else
 U_BOOT_CMD(
@@ -54,5 +72,6 @@ U_BOOT_CMD(
 	"compute message digest",
 	"algorithm address count [[*]sum_dest]\n"
 		"    - compute message digest [save to env var / *address]"
+	HASH_BENCH_HELP
 );
 #endif
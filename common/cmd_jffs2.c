@@ -78,6 +78,7 @@
 #include <linux/list.h>
 #include <linux/ctype.h>
 #include <cramfs/cramfs_fs.h>
+#include <asm/io.h>
 
 #if defined(CONFIG_CMD_NAND)
 #include <linux/mtd/nand.h>
@@ -476,6 +477,7 @@ int do_jffs2_fsload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	int size;
 	struct part_info *part;
 	ulong offset = load_addr;
+	char *buf;
 
 	/* pre-set Boot file name */
 	if ((filename = getenv("bootfile")) == NULL) {
@@ -501,12 +503,14 @@ int do_jffs2_fsload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		fsname = (cramfs_check(part) ? "CRAMFS" : "JFFS2");
 		printf("### %s loading '%s' to 0x%lx\n", fsname, filename, offset);
 
+		buf = map_sysmem(offset, 0);
 		if (cramfs_check(part)) {
-			size = cramfs_load ((char *) offset, part, filename);
+			size = cramfs_load(buf, part, filename);
 		} else {
 			/* if this is not cramfs assume jffs2 */
-			size = jffs2_1pass_load((char *)offset, part, filename);
+			size = jffs2_1pass_load(buf, part, filename);
 		}
+		unmap_sysmem(buf);
 
 		if (size > 0) {
 			printf("### %s load complete: %d bytes loaded to 0x%lx\n",
@@ -605,11 +609,20 @@ U_BOOT_CMD(
 	"    - load binary file from flash bank\n"
 	"      with offset 'off'"
 );
+/* The generic filesystem commands have their own 'ls' */
+#ifdef CONFIG_CMD_FS_GENERIC
+U_BOOT_CMD(
+	fsls,	2,	1,	do_jffs2_ls,
+	"list files in a directory (default /)",
+	"[ directory ]"
+);
+#else
 U_BOOT_CMD(
 	ls,	2,	1,	do_jffs2_ls,
 	"list files in a directory (default /)",
 	"[ directory ]"
 );
+#endif
 
 U_BOOT_CMD(
 	fsinfo,	1,	1,	do_jffs2_fsinfo,
@@ -22,6 +22,10 @@
 #include <watchdog.h>
 #include <asm/io.h>
 #include <linux/compiler.h>
+#ifdef CONFIG_CMD_CRC32_BENCH
+#include <malloc.h>
+#include <u-boot/crc.h>
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -1202,12 +1206,90 @@ mod_mem(cmd_tbl_t *cmdtp, int incrflag, int flag, int argc, char * const argv[])
 
 #ifdef CONFIG_CMD_CRC32
 
+#ifdef CONFIG_CMD_CRC32_BENCH
+/* Time each CRC32 algorithm over at least this long */
+#define CRC32_BENCH_US		100000
+
+/* Check that @algo agrees with the first algorithm at awkward alignments */
+static int crc32_bench_check(const struct crc32_algo *algo,
+			     const uchar *buf, uint size)
+{
+	uint32_t expect, crc;
+	uint ofs, len;
+
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len < 200 && ofs + len <= size; len += 13) {
+			expect = crc32_algos[0].no_comp(ofs, buf + ofs, len);
+			crc = algo->no_comp(ofs, buf + ofs, len);
+			if (crc != expect)
+				goto err;
+		}
+	}
+	expect = crc32_algos[0].no_comp(~0, buf, size);
+	crc = algo->no_comp(~0, buf, size);
+	if (crc == expect)
+		return 0;
+err:
+	printf("%s: mismatch at offset %u length %u: %08x, expected %08x\n",
+	       algo->name, ofs, len, crc, expect);
+	return -1;
+}
+
+static int crc32_bench(uint size)
+{
+	const struct crc32_algo *algo;
+	ulong start, us, bytes;
+	uchar *buf;
+	uint i;
+	int ret = 0;
+
+	buf = malloc(size);
+	if (!buf) {
+		printf("Cannot allocate %u bytes\n", size);
+		return CMD_RET_FAILURE;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = i * 0x9e3779b1 >> 24;
+
+	printf("Algorithm    MB/s\n");
+	for (algo = crc32_algos; algo->name; algo++) {
+		if (algo->probe && !algo->probe()) {
+			printf("%-8s  (not supported by this CPU)\n",
+			       algo->name);
+			continue;
+		}
+		if (crc32_bench_check(algo, buf, size)) {
+			ret = CMD_RET_FAILURE;
+			continue;
+		}
+
+		bytes = 0;
+		start = timer_get_us();
+		do {
+			algo->no_comp(~0, buf, size);
+			bytes += size;
+			us = timer_get_us() - start;
+			WATCHDOG_RESET();
+		} while (us < CRC32_BENCH_US);
+		printf("%-8s  %7lu\n", algo->name, bytes / us);
+	}
+	free(buf);
+
+	return ret;
+}
+#endif
+
 static int do_mem_crc(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	int flags = 0;
 	int ac;
 	char * const *av;
 
+#ifdef CONFIG_CMD_CRC32_BENCH
+	if (argc >= 2 && !strcmp(argv[1], "bench"))
+		return crc32_bench(argc > 2 ? simple_strtoul(argv[2], NULL, 0) :
+				   1 << 20);
+#endif
 	if (argc < 3)
 		return CMD_RET_USAGE;
 
@@ -1291,12 +1373,20 @@ U_BOOT_CMD(
 
 #ifdef CONFIG_CMD_CRC32
 
+#ifdef CONFIG_CMD_CRC32_BENCH
+#define CRC32_BENCH_HELP \
+	"\ncrc32 bench [size]\n    - compare the speed of each CRC32 algorithm"
+#else
+#define CRC32_BENCH_HELP
+#endif
+
 #ifndef CONFIG_CRC32_VERIFY
 
 U_BOOT_CMD(
 	crc32,	4,	1,	do_mem_crc,
 	"checksum calculation",
 	"address count [addr]\n    - compute CRC32 checksum [save at addr]"
+	CRC32_BENCH_HELP
 );
 
 #else	/* CONFIG_CRC32_VERIFY */
@@ -1306,6 +1396,7 @@ U_BOOT_CMD(
 	"checksum calculation",
 	"address count [addr]\n    - compute CRC32 checksum [save at addr]\n"
 	"-v address count crc\n    - verify crc of memory area"
+	CRC32_BENCH_HELP
 );
 
 #endif	/* CONFIG_CRC32_VERIFY */
@@ -7,6 +7,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <mmc.h>
 
 static int curr_device = -1;
@@ -91,6 +92,21 @@ static void print_mmcinfo(struct mmc *mmc)
 	print_size(mmc->capacity, "\n");
 
 	printf("Bus Width: %d-bit\n", mmc->bus_width);
+	puts("Erase Group Size: ");
+	print_size((u64)mmc->erase_grp_size * mmc->write_bl_len, "");
+	printf(", trim: %s, discard: %s, secure: %s\n",
+	       mmc->erase_types & (1 << BLK_ERASE_TRIM) ? "Yes" : "No",
+	       mmc->erase_types & (1 << BLK_ERASE_DISCARD) ? "Yes" : "No",
+	       mmc->erase_types & (1 << BLK_ERASE_SECURE) ? "Yes" : "No");
+
+	puts("Transfers:\n");
+	printf("  Read: %lu commands, %llu blocks, %llu ms\n",
+	       mmc->stats.rd_cmds, mmc->stats.rd_blks,
+	       lldiv(mmc->stats.rd_us, 1000));
+	printf("  Write: %lu commands, %llu blocks, %llu ms\n",
+	       mmc->stats.wr_cmds, mmc->stats.wr_blks,
+	       lldiv(mmc->stats.wr_us, 1000));
+	printf("  DMA restarts: %lu\n", mmc->stats.dma_restarts);
 }
 static struct mmc *init_mmc_device(int dev, bool force_init)
 {
@@ -333,7 +349,7 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
-	n = mmc->block_dev.block_write(curr_device, blk, cnt, addr);
+	n = blk_dwrite(&mmc->block_dev, blk, cnt, addr);
 	printf("%d blocks written: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
@@ -341,14 +357,27 @@ static int do_mmc_write(cmd_tbl_t *cmdtp, int flag,
 static int do_mmc_erase(cmd_tbl_t *cmdtp, int flag,
 			int argc, char * const argv[])
 {
+	static const char * const types[] = {
+		[BLK_ERASE_TRIM]	= "trim",
+		[BLK_ERASE_DISCARD]	= "discard",
+		[BLK_ERASE_SECURE]	= "secure",
+	};
 	struct mmc *mmc;
 	u32 blk, cnt, n;
+	int type = BLK_ERASE;
 
-	if (argc != 3)
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
 	blk = simple_strtoul(argv[1], NULL, 16);
 	cnt = simple_strtoul(argv[2], NULL, 16);
+	if (argc == 4) {
+		for (type = BLK_ERASE_TRIM; type < ARRAY_SIZE(types); type++)
+			if (!strcmp(argv[3], types[type]))
+				break;
+		if (type == ARRAY_SIZE(types))
+			return CMD_RET_USAGE;
+	}
 
 	mmc = init_mmc_device(curr_device, false);
 	if (!mmc)
@@ -361,7 +390,8 @@ static int do_mmc_erase(cmd_tbl_t *cmdtp, int flag,
 		printf("Error: card is write protected!\n");
 		return CMD_RET_FAILURE;
 	}
-	n = mmc->block_dev.block_erase(curr_device, blk, cnt);
+	n = mmc->block_dev.block_erase(curr_device, blk, cnt, type);
+	blkcache_invalidate(IF_TYPE_MMC, curr_device);
 	printf("%d blocks erased: %s\n", n, (n == cnt) ? "OK" : "ERROR");
 
 	return (n == cnt) ? CMD_RET_SUCCESS : CMD_RET_FAILURE;
@@ -595,7 +625,7 @@ static cmd_tbl_t cmd_mmc[] = {
 	U_BOOT_CMD_MKENT(info, 1, 0, do_mmcinfo, "", ""),
 	U_BOOT_CMD_MKENT(read, 4, 1, do_mmc_read, "", ""),
 	U_BOOT_CMD_MKENT(write, 4, 0, do_mmc_write, "", ""),
-	U_BOOT_CMD_MKENT(erase, 3, 0, do_mmc_erase, "", ""),
+	U_BOOT_CMD_MKENT(erase, 4, 0, do_mmc_erase, "", ""),
 	U_BOOT_CMD_MKENT(rescan, 1, 1, do_mmc_rescan, "", ""),
 	U_BOOT_CMD_MKENT(part, 1, 1, do_mmc_part, "", ""),
 	U_BOOT_CMD_MKENT(dev, 3, 0, do_mmc_dev, "", ""),
@@ -644,7 +674,10 @@ U_BOOT_CMD(
 	"info - display info of the current MMC device\n"
 	"mmc read addr blk# cnt\n"
 	"mmc write addr blk# cnt\n"
-	"mmc erase blk# cnt\n"
+	"mmc erase blk# cnt [trim|discard|secure]\n"
+	" - erase whole erase groups, or exactly the blocks given (trim),\n"
+	"   leaving their contents to the card (discard) or purging all\n"
+	"   copies of the data (secure)\n"
 	"mmc rescan\n"
 	"mmc part - lists available partition on current mmc device\n"
 	"mmc dev [dev] [part] - show or set current mmc device [partition]\n"
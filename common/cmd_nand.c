@@ -24,7 +24,9 @@
 #include <command.h>
 #include <watchdog.h>
 #include <malloc.h>
+#include <div64.h>
 #include <asm/byteorder.h>
+#include <asm/io.h>
 #include <jffs2/jffs2.h>
 #include <nand.h>
 
@@ -404,7 +406,7 @@ static void nand_print_and_set_info(int idx)
 	setenv_hex("nand_erasesize", nand->erasesize);
 }
 
-static int raw_access(nand_info_t *nand, ulong addr, loff_t off, ulong count,
+static int raw_access(nand_info_t *nand, u8 *buf, loff_t off, ulong count,
 			int read)
 {
 	int ret = 0;
@@ -412,8 +414,8 @@ static int raw_access(nand_info_t *nand, ulong addr, loff_t off, ulong count,
 	while (count--) {
 		/* Raw access */
 		mtd_oob_ops_t ops = {
-			.datbuf = (u8 *)addr,
-			.oobbuf = ((u8 *)addr) + nand->writesize,
+			.datbuf = buf,
+			.oobbuf = buf + nand->writesize,
 			.len = nand->writesize,
 			.ooblen = nand->oobsize,
 			.mode = MTD_OPS_RAW
@@ -430,7 +432,7 @@ static int raw_access(nand_info_t *nand, ulong addr, loff_t off, ulong count,
 			break;
 		}
 
-		addr += nand->writesize + nand->oobsize;
+		buf += nand->writesize + nand->oobsize;
 		off += nand->writesize;
 	}
 
@@ -462,10 +464,29 @@ static void adjust_size_for_badblocks(loff_t *size, loff_t offset, int dev)
 	}
 }
 
+/* Show how many pages a read took and how many came by read cache */
+static void nand_show_read_stats(struct nand_read_stats *stats)
+{
+	uint64_t rate = stats->bytes * 1000000;
+
+	if (!stats->pages)
+		return;
+
+	printf(" %lu pages (%lu by read cache) in %lu ms", stats->pages,
+	       stats->cache_pages, stats->us / 1000);
+	if (stats->us) {
+		do_div(rate, stats->us);
+		puts(", ");
+		print_size(rate, "/s");
+	}
+	putc('\n');
+}
+
 static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	int i, ret = 0;
 	ulong addr;
+	u_char *buf;
 	loff_t off, size, maxsize;
 	char *cmd, *s;
 	nand_info_t *nand;
@@ -636,6 +657,8 @@ static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	if (strncmp(cmd, "read", 4) == 0 || strncmp(cmd, "write", 5) == 0) {
 		size_t rwsize;
 		ulong pagecount = 1;
+		struct nand_read_stats rstats;
+		struct nand_chip *chip;
 		int read;
 		int raw = 0;
 
@@ -679,40 +702,45 @@ static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			rwsize = size;
 		}
 
+		buf = map_sysmem(addr, rwsize);
+		memset(&rstats, '\0', sizeof(rstats));
 		if (!s || !strcmp(s, ".jffs2") ||
 		    !strcmp(s, ".e") || !strcmp(s, ".i")) {
-			if (read)
+			chip = nand->priv;
+			if (read) {
+				chip->read_stats = &rstats;
 				ret = nand_read_skip_bad(nand, off, &rwsize,
-							 NULL, maxsize,
-							 (u_char *)addr);
-			else
+							 NULL, maxsize, buf);
+				chip->read_stats = NULL;
+			} else {
 				ret = nand_write_skip_bad(nand, off, &rwsize,
 							  NULL, maxsize,
-							  (u_char *)addr, 0);
+							  buf, 0);
+			}
 #ifdef CONFIG_CMD_NAND_TRIMFFS
 		} else if (!strcmp(s, ".trimffs")) {
 			if (read) {
 				printf("Unknown nand command suffix '%s'\n", s);
+				unmap_sysmem(buf);
 				return 1;
 			}
 			ret = nand_write_skip_bad(nand, off, &rwsize, NULL,
-						maxsize, (u_char *)addr,
-						WITH_DROP_FFS);
+						maxsize, buf, WITH_DROP_FFS);
 #endif
 #ifdef CONFIG_CMD_NAND_YAFFS
 		} else if (!strcmp(s, ".yaffs")) {
 			if (read) {
 				printf("Unknown nand command suffix '%s'.\n", s);
+				unmap_sysmem(buf);
 				return 1;
 			}
 			ret = nand_write_skip_bad(nand, off, &rwsize, NULL,
-						maxsize, (u_char *)addr,
-						WITH_YAFFS_OOB);
+						maxsize, buf, WITH_YAFFS_OOB);
 #endif
 		} else if (!strcmp(s, ".oob")) {
 			/* out-of-band data */
 			mtd_oob_ops_t ops = {
-				.oobbuf = (u8 *)addr,
+				.oobbuf = buf,
 				.ooblen = rwsize,
 				.mode = MTD_OPS_RAW
 			};
@@ -722,14 +750,17 @@ static int do_nand(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			else
 				ret = mtd_write_oob(nand, off, &ops);
 		} else if (raw) {
-			ret = raw_access(nand, addr, off, pagecount, read);
+			ret = raw_access(nand, buf, off, pagecount, read);
 		} else {
 			printf("Unknown nand command suffix '%s'.\n", s);
+			unmap_sysmem(buf);
 			return 1;
 		}
+		unmap_sysmem(buf);
 
 		printf(" %zu bytes %s: %s\n", rwsize,
 		       read ? "read" : "written", ret ? "ERROR" : "OK");
+		nand_show_read_stats(&rstats);
 
 		return ret == 0 ? 0 : 1;
 	}
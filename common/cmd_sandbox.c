@@ -9,6 +9,7 @@
 #include <part.h>
 #include <sandboxblockdev.h>
 #include <asm/errno.h>
+#include <asm/eth.h>
 
 static int do_sandbox_load(cmd_tbl_t *cmdtp, int flag, int argc,
 			   char * const argv[])
@@ -85,12 +86,30 @@ static int do_sandbox_info(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#ifdef CONFIG_ETH_SANDBOX
+static int do_sandbox_eth(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		sandbox_eth_reset_stats();
+		return 0;
+	}
+	if (argc != 1)
+		return CMD_RET_USAGE;
+	sandbox_eth_show_stats();
+	return 0;
+}
+#endif
+
 static cmd_tbl_t cmd_sandbox_sub[] = {
 	U_BOOT_CMD_MKENT(load, 7, 0, do_sandbox_load, "", ""),
 	U_BOOT_CMD_MKENT(ls, 3, 0, do_sandbox_ls, "", ""),
 	U_BOOT_CMD_MKENT(save, 6, 0, do_sandbox_save, "", ""),
 	U_BOOT_CMD_MKENT(bind, 3, 0, do_sandbox_bind, "", ""),
 	U_BOOT_CMD_MKENT(info, 3, 0, do_sandbox_info, "", ""),
+#ifdef CONFIG_ETH_SANDBOX
+	U_BOOT_CMD_MKENT(eth, 2, 0, do_sandbox_eth, "", ""),
+#endif
 };
 
 static int do_sandbox(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -121,6 +140,9 @@ U_BOOT_CMD(
 		"save a file to host\n"
 	"sb bind <dev> [<filename>] - bind \"host\" device to file\n"
 	"sb info [<dev>]            - show device binding & info\n"
+#ifdef CONFIG_ETH_SANDBOX
+	"sb eth [reset]             - show or clear Ethernet latency stats\n"
+#endif
 	"sb commands use the \"hostfs\" device. The \"host\" device is used\n"
 	"with standard IO commands such as fatls or ext2load"
 );
@@ -296,8 +296,44 @@ static int do_spi_flash_read_write(int argc, char * const argv[])
 	return ret == 0 ? 0 : 1;
 }
 
+static void sf_print_erase_kind(int kind)
+{
+	if (kind == SF_ERASE_CHIP)
+		puts("chip");
+	else
+		print_size(flash->erase_sizes[kind], "");
+}
+
+/* Show the erase cmds planned for a region, then the time each kind took */
+static void sf_show_erase(struct spi_flash_erase_stats *stats, int timed)
+{
+	const char *sep = "";
+	int kind;
+
+	if (!timed)
+		puts("SF: erase plan:");
+	for (kind = 0; kind < SF_ERASE_KINDS; kind++) {
+		if (!stats->count[kind])
+			continue;
+		if (timed) {
+			printf("SF: %u x ", stats->count[kind]);
+			sf_print_erase_kind(kind);
+			printf(" erase in %lu ms, %lu us each\n",
+			       stats->us[kind] / 1000,
+			       stats->us[kind] / stats->count[kind]);
+		} else {
+			printf("%s %u x ", sep, stats->count[kind]);
+			sf_print_erase_kind(kind);
+			sep = ",";
+		}
+	}
+	if (!timed)
+		putc('\n');
+}
+
 static int do_spi_flash_erase(int argc, char * const argv[])
 {
+	struct spi_flash_erase_stats stats;
 	unsigned long offset;
 	unsigned long len;
 	char *endp;
@@ -321,9 +357,17 @@ static int do_spi_flash_erase(int argc, char * const argv[])
 		return 1;
 	}
 
+	if (spi_flash_erase_plan(flash, offset, len, &stats) > 0)
+		sf_show_erase(&stats, 0);
+
+	memset(&stats, '\0', sizeof(stats));
+	flash->erase_stats = &stats;
 	ret = spi_flash_erase(flash, offset, len);
+	flash->erase_stats = NULL;
 	printf("SF: %zu bytes @ %#x Erased: %s\n", (size_t)len, (u32)offset,
 	       ret ? "ERROR" : "OK");
+	if (!ret)
+		sf_show_erase(&stats, 1);
 
 	return ret == 0 ? 0 : 1;
 }
@@ -21,6 +21,7 @@
 #include <linux/mtd/partitions.h>
 #include <ubi_uboot.h>
 #include <asm/errno.h>
+#include <asm/io.h>
 #include <jffs2/load_kernel.h>
 
 #undef ubi_msg
@@ -535,6 +536,22 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 	return 0;
 }
 
+static int ubi_detach(void)
+{
+#ifdef CONFIG_CMD_UBIFS
+	if (ubifs_is_mounted())
+		cmd_ubifs_umount();
+#endif
+
+	/* This is when a fastmap gets written, if it is enabled */
+	ubi_exit();
+	del_mtd_partitions(ubi_dev.mtd_info);
+	ubi_initialized = 0;
+	ubi_dev.selected = 0;
+
+	return 0;
+}
+
 static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	int64_t size = 0;
@@ -572,6 +589,9 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		return 1;
 	}
 
+	if (strcmp(argv[1], "detach") == 0)
+		return ubi_detach();
+
 	if (strcmp(argv[1], "info") == 0) {
 		int layout = 0;
 		if (argc > 2 && !strncmp(argv[2], "l", 1))
@@ -639,15 +659,17 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		    strncmp(argv[1] + 5, ".part", 5) == 0) {
 			if (argc < 6) {
 				ret = ubi_volume_continue_write(argv[3],
-						(void *)addr, size);
+						map_sysmem(addr, size), size);
 			} else {
 				size_t full_size;
 				full_size = simple_strtoul(argv[5], NULL, 16);
 				ret = ubi_volume_begin_write(argv[3],
-						(void *)addr, size, full_size);
+						map_sysmem(addr, size), size,
+						full_size);
 			}
 		} else {
-			ret = ubi_volume_write(argv[3], (void *)addr, size);
+			ret = ubi_volume_write(argv[3],
+					       map_sysmem(addr, size), size);
 		}
 		if (!ret) {
 			printf("%lld bytes written to volume %s\n", size,
@@ -676,7 +698,8 @@ static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			printf("Read %lld bytes from volume %s to %lx\n", size,
 			       argv[3], addr);
 
-			return ubi_volume_read(argv[3], (char *)addr, size);
+			return ubi_volume_read(argv[3],
+					       map_sysmem(addr, size), size);
 		}
 	}
 
@@ -690,6 +713,8 @@ U_BOOT_CMD(
 	"part [part] [offset]\n"
 		" - Show or set current partition (with optional VID"
 		" header offset)\n"
+	"ubi detach"
+		" - Detach the current partition\n"
 	"ubi info [l[ayout]]"
 		" - Display volume and ubi layout information\n"
 	"ubi check volumename"
@@ -0,0 +1,80 @@
+/*
+ * Flashing eMMC partitions from fastboot
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <fb_mmc.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <part.h>
+
+/* Pieces of an image smaller than this are collected before writing */
+#define FB_MMC_BUF_SIZE		(1 << 20)
+
+static struct sparse_writer fb_mmc_writer;
+static void *fb_mmc_buf;
+static disk_partition_t fb_mmc_info;
+
+const char *fb_mmc_flash_start(const char *name)
+{
+	disk_partition_t *info = &fb_mmc_info;
+	block_dev_desc_t *dev_desc;
+
+	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN)
+		return "invalid mmc device";
+
+	if (get_partition_info_efi_by_name(dev_desc, name, info))
+		return "no such partition";
+
+	if (!fb_mmc_buf) {
+		fb_mmc_buf = memalign(ARCH_DMA_MINALIGN, FB_MMC_BUF_SIZE);
+		if (!fb_mmc_buf)
+			return "out of memory";
+	}
+
+	sparse_writer_init(&fb_mmc_writer, dev_desc, info, fb_mmc_buf,
+			   FB_MMC_BUF_SIZE);
+	printf("Flashing %s: " LBAFU " blocks at " LBAFU "\n", info->name,
+	       info->size, info->start);
+
+	return NULL;
+}
+
+const char *fb_mmc_flash_data(const void *data, unsigned int len)
+{
+	if (sparse_writer_write(&fb_mmc_writer, data, len))
+		return fb_mmc_writer.err;
+
+	return NULL;
+}
+
+const char *fb_mmc_flash_finish(void)
+{
+	struct sparse_writer *sw = &fb_mmc_writer;
+
+	if (sparse_writer_finish(sw))
+		return sw->err;
+
+	printf("Flashed %s: " LBAFU " blocks written, " LBAFU " of them filled, "
+	       LBAFU " skipped\n", fb_mmc_info.name, sw->written, sw->filled,
+	       sw->skipped);
+
+	return NULL;
+}
+
+const char *fb_mmc_flash_write(const char *name, const void *data,
+			       unsigned int len)
+{
+	const char *err;
+
+	err = fb_mmc_flash_start(name);
+	if (!err)
+		err = fb_mmc_flash_data(data, len);
+	if (!err)
+		err = fb_mmc_flash_finish();
+
+	return err;
+}
@@ -106,6 +106,9 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
  * These are the hash algorithms we support. Chips which support accelerated
  * crypto could perhaps add named version of these algorithms here. Note that
  * algorithm names must be in lower case.
+ *
+ * With CONFIG_SHA_ARCH, "sha1" and "sha256" use the CPU's instructions
+ * where it has them, and the "-generic" versions never do.
  */
 static struct hash_algo hash_algo[] = {
 	/*
@@ -140,6 +143,14 @@ static struct hash_algo hash_algo[] = {
 		hash_update_sha1,
 		hash_finish_sha1,
 	},
+#ifdef CONFIG_SHA_ARCH
+	{
+		"sha1-generic",
+		SHA1_SUM_LEN,
+		sha1_csum_wd_generic,
+		CHUNKSZ_SHA1,
+	},
+#endif
 #define MULTI_HASH
 #endif
 #ifdef CONFIG_SHA256
@@ -152,6 +163,14 @@ static struct hash_algo hash_algo[] = {
 		hash_update_sha256,
 		hash_finish_sha256,
 	},
+#ifdef CONFIG_SHA_ARCH
+	{
+		"sha256-generic",
+		SHA256_SUM_LEN,
+		sha256_csum_wd_generic,
+		CHUNKSZ_SHA256,
+	},
+#endif
 #define MULTI_HASH
 #endif
 	{
@@ -342,6 +361,80 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
 	return 0;
 }
 
+#ifdef CONFIG_CMD_HASH_BENCH
+/* Time each algorithm over at least this long */
+#define HASH_BENCH_US		100000
+
+/* Check that a variant, e.g. "sha256-generic", agrees with the default */
+static int hash_bench_check(struct hash_algo *algo, const uint8_t *buf,
+			    unsigned int size)
+{
+	uint8_t output[HASH_MAX_DIGEST_SIZE], expect[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *base;
+	const char *dash;
+	char name[16];
+	int len;
+
+	dash = strchr(algo->name, '-');
+	len = dash ? dash - algo->name : 0;
+	if (!len || len >= sizeof(name))
+		return 0;
+	memcpy(name, algo->name, len);
+	name[len] = '\0';
+	if (hash_lookup_algo(name, &base))
+		return 0;
+
+	/* Unaligned, and not a whole number of blocks */
+	base->hash_func_ws(buf + 1, size - 1, expect, base->chunk_size);
+	algo->hash_func_ws(buf + 1, size - 1, output, algo->chunk_size);
+	if (memcmp(output, expect, algo->digest_size)) {
+		printf("%s: does not match %s\n", algo->name, base->name);
+		return -1;
+	}
+
+	return 0;
+}
+
+int hash_bench(unsigned int size)
+{
+	uint8_t output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start, us, bytes;
+	uint8_t *buf;
+	int i, ret = 0;
+
+	if (size < 2)
+		return -EINVAL;
+	buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < size; i++)
+		buf[i] = i * 0x9e3779b1 >> 24;
+
+	printf("Algorithm           MB/s\n");
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		algo = &hash_algo[i];
+		if (hash_bench_check(algo, buf, size)) {
+			ret = -EIO;
+			continue;
+		}
+
+		bytes = 0;
+		start = timer_get_us();
+		do {
+			algo->hash_func_ws(buf, size, output,
+					   algo->chunk_size);
+			bytes += size;
+			us = timer_get_us() - start;
+		} while (us < HASH_BENCH_US);
+		printf("%-16s %7lu\n", algo->name, bytes / us);
+	}
+	free(buf);
+
+	return ret;
+}
+#endif
+
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[])
 {
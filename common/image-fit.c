@@ -874,6 +874,10 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
+	/* Worked out already while the image was copied? */
+	if (!fit_image_get_digest(data, data_len, algo, value, value_len))
+		return 0;
+
 	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
 		*((uint32_t *)value) = crc32_wd(0, data, data_len,
 							CHUNKSZ_CRC32);
@@ -1502,6 +1506,74 @@ static const char *fit_get_image_type_property(int type)
 	return "unknown";
 }
 
+#if defined(CONFIG_FIT_VERIFY_COPY) && !defined(USE_HOSTCC)
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+/*
+ * Copy an image to its load address on the same pass as the hashes that
+ * fit_image_select() is about to check. A kernel is decompressed there
+ * too, rather than later by bootm. Returns 1 with the load address and
+ * length in *loadp and *lenp if done, 0 if the image is not to be loaded
+ * but all of its hashes were computed in one pass, -ve to leave the image
+ * to be checked and loaded as usual.
+ */
+static int fit_image_load_verify(ulong addr, const void *fit, int noffset,
+				 int image_type, enum fit_load_op load_op,
+				 ulong *loadp, ulong *lenp)
+{
+	const void *buf;
+	size_t size;
+	uint8_t comp;
+	ulong load, data, dst_max;
+	int ret;
+
+	if (getenv_yesno("fit_verify_copy") == 0)
+		return -ENOSYS;
+	if (image_type != IH_TYPE_KERNEL && load_op == FIT_LOAD_IGNORED)
+		return fit_image_verify_copy(fit, noffset, 0, 0, NULL);
+	if (fit_image_get_load(fit, noffset, &load) ||
+	    fit_image_get_data(fit, noffset, &buf, &size) ||
+	    fit_image_get_comp(fit, noffset, &comp))
+		return -ENOENT;
+
+	data = map_to_sysmem((void *)buf);
+
+	if (image_type == IH_TYPE_KERNEL) {
+		/* bootm leaves kernels which run in place where they are */
+		if (!fit_image_check_type(fit, noffset, IH_TYPE_KERNEL) ||
+		    (comp == IH_COMP_NONE && load == data))
+			return -ENOSYS;
+		dst_max = comp == IH_COMP_NONE ? size : CONFIG_SYS_BOOTM_LEN;
+	} else {
+		if (comp != IH_COMP_NONE)
+			return -ENOSYS;
+		dst_max = size;
+	}
+
+	/* Keep clear of the FIT, leaving overlaps to the usual checks */
+	if (load < addr)
+		dst_max = min(dst_max, addr - load);
+	else if (load < addr + fit_get_size(fit))
+		return -EXDEV;
+
+	*loadp = load;
+	ret = fit_image_verify_copy(fit, noffset, load, dst_max, lenp);
+
+	return ret ? ret : 1;
+}
+#else
+static inline int fit_image_load_verify(ulong addr, const void *fit,
+					int noffset, int image_type,
+					enum fit_load_op load_op, ulong *loadp,
+					ulong *lenp)
+{
+	return -ENOSYS;
+}
+#endif
+
 int fit_image_load(bootm_headers_t *images, ulong addr,
 		   const char **fit_unamep, const char **fit_uname_configp,
 		   int arch, int image_type, int bootstage_id,
@@ -1514,8 +1586,9 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	const void *buf;
 	size_t size;
 	int type_ok, os_ok;
-	ulong load, data, len;
+	ulong load, data, len, load_len;
 	const char *prop_name;
+	int copied;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -1584,11 +1657,19 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
+	copied = images->verify &&
+		fit_image_load_verify(addr, fit, noffset, image_type, load_op,
+				      &load, &load_len) == 1;
 	ret = fit_image_select(fit, noffset, images->verify);
+	fit_image_clear_digests();
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
 	}
+#ifndef USE_HOSTCC
+	if (copied && image_type == IH_TYPE_KERNEL)
+		images->os_load_end = load + load_len;
+#endif
 
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_CHECK_ARCH);
 #ifndef USE_HOSTCC
@@ -1678,8 +1759,11 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		printf("   Loading %s from 0x%08lx to 0x%08lx\n",
 		       prop_name, data, load);
 
-		dst = map_sysmem(load, len);
-		memmove(dst, buf, len);
+		/* Unless it was copied while its hashes were checked */
+		if (!copied) {
+			dst = map_sysmem(load, len);
+			memmove(dst, buf, len);
+		}
 		data = load;
 	}
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_LOAD);
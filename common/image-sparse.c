@@ -0,0 +1,376 @@
+/*
+ * Writing Android sparse images to a block device
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <image-sparse.h>
+#include <part.h>
+#include <sparse_format.h>
+
+enum {
+	SPARSE_MAGIC,		/* collecting the first four bytes */
+	SPARSE_FILE_HDR,	/* collecting the file header */
+	SPARSE_CHUNK_HDR,	/* collecting a chunk header */
+	SPARSE_RAW,		/* data of a raw chunk */
+	SPARSE_FILL,		/* collecting the value of a fill chunk */
+	SPARSE_SKIP,		/* bytes to pass over */
+	SPARSE_DONE,		/* after the last chunk */
+	SPARSE_NONE,		/* not a sparse image */
+};
+
+static int sparse_error(struct sparse_writer *sw, const char *err)
+{
+	sw->err = err;
+	return -EINVAL;
+}
+
+static int sparse_room(struct sparse_writer *sw, lbaint_t blocks)
+{
+	lbaint_t pos = sw->blk + sw->buf_len / sw->dev->blksz;
+
+	if (blocks > sw->size || pos > sw->size - blocks)
+		return sparse_error(sw, "image too large for partition");
+
+	return 0;
+}
+
+static int sparse_write_blocks(struct sparse_writer *sw, const void *data,
+			       lbaint_t blocks)
+{
+	if (blk_dwrite(sw->dev, sw->start + sw->blk, blocks, data) != blocks) {
+		sw->err = "write to the device failed";
+		return -EIO;
+	}
+	sw->blk += blocks;
+	sw->written += blocks;
+
+	return 0;
+}
+
+/* Write the staging buffer, which holds whole blocks */
+static int sparse_flush(struct sparse_writer *sw)
+{
+	lbaint_t blocks = sw->buf_len / sw->dev->blksz;
+
+	sw->buf_len = 0;
+	if (!blocks)
+		return 0;
+
+	return sparse_write_blocks(sw, sw->buf, blocks);
+}
+
+/* Write data at the current position, staging what is too small */
+static int sparse_put(struct sparse_writer *sw, const u8 *data, ulong len)
+{
+	ulong blksz = sw->dev->blksz;
+	lbaint_t blocks;
+	ulong n;
+	int ret;
+
+	while (len) {
+		/* chunk data may sit anywhere, but DMA needs aligned buffers */
+		if (!sw->buf_len && len >= sw->buf_size &&
+		    !((ulong)data & (ARCH_DMA_MINALIGN - 1))) {
+			blocks = len / blksz;
+			ret = sparse_write_blocks(sw, data, blocks);
+			if (ret)
+				return ret;
+			data += blocks * blksz;
+			len -= blocks * blksz;
+			continue;
+		}
+
+		n = min(len, sw->buf_size - sw->buf_len);
+		memcpy(sw->buf + sw->buf_len, data, n);
+		sw->buf_len += n;
+		data += n;
+		len -= n;
+
+		if (sw->buf_len == sw->buf_size) {
+			ret = sparse_flush(sw);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/* Write @blocks blocks holding the 32-bit value @fill */
+static int sparse_fill(struct sparse_writer *sw, u32 fill, lbaint_t blocks)
+{
+	lbaint_t buf_blocks = sw->buf_size / sw->dev->blksz;
+	u32 *p = (u32 *)sw->buf;
+	lbaint_t n;
+	ulong i;
+	int ret;
+
+	ret = sparse_flush(sw);
+	if (ret)
+		return ret;
+
+	n = min(blocks, buf_blocks);
+	for (i = 0; i < n * sw->dev->blksz / 4; i++)
+		p[i] = fill;
+
+	while (blocks) {
+		n = min(blocks, buf_blocks);
+		ret = sparse_write_blocks(sw, sw->buf, n);
+		if (ret)
+			return ret;
+		sw->filled += n;
+		blocks -= n;
+	}
+
+	return 0;
+}
+
+static void sparse_collect(struct sparse_writer *sw, int state,
+			   unsigned int want)
+{
+	sw->state = state;
+	sw->hdr_len = 0;
+	sw->hdr_want = want;
+}
+
+/* Move on to the next chunk, if there is one */
+static void sparse_next_chunk(struct sparse_writer *sw)
+{
+	if (sw->chunks_left)
+		sparse_collect(sw, SPARSE_CHUNK_HDR, sw->chunk_hdr_sz);
+	else
+		sw->state = SPARSE_DONE;
+}
+
+static int sparse_file_header(struct sparse_writer *sw)
+{
+	sparse_header_t *hdr = (sparse_header_t *)sw->hdr;
+	ulong blksz = sw->dev->blksz;
+	unsigned int file_hdr_sz = le16_to_cpu(hdr->file_hdr_sz);
+
+	sw->blk_sz = le32_to_cpu(hdr->blk_sz);
+	sw->chunk_hdr_sz = le16_to_cpu(hdr->chunk_hdr_sz);
+	sw->chunks_left = le32_to_cpu(hdr->total_chunks);
+
+	if (le16_to_cpu(hdr->major_version) != SPARSE_MAJOR_VERSION ||
+	    file_hdr_sz < sizeof(sparse_header_t) ||
+	    sw->chunk_hdr_sz < sizeof(chunk_header_t) ||
+	    sw->chunk_hdr_sz > sizeof(sw->hdr))
+		return sparse_error(sw, "unsupported sparse image");
+	if (!sw->blk_sz || sw->blk_sz % blksz)
+		return sparse_error(sw, "sparse block size not supported");
+	if (sparse_room(sw, (lbaint_t)le32_to_cpu(hdr->total_blks) *
+			(sw->blk_sz / blksz)))
+		return -EINVAL;
+
+	debug("%s: %u blocks of %u bytes in %u chunks\n", __func__,
+	      le32_to_cpu(hdr->total_blks), sw->blk_sz, sw->chunks_left);
+
+	sw->left = file_hdr_sz - sizeof(sparse_header_t);
+	if (sw->left)
+		sw->state = SPARSE_SKIP;
+	else
+		sparse_next_chunk(sw);
+
+	return 0;
+}
+
+static int sparse_chunk_header(struct sparse_writer *sw)
+{
+	chunk_header_t *chunk = (chunk_header_t *)sw->hdr;
+	u64 bytes = (u64)le32_to_cpu(chunk->chunk_sz) * sw->blk_sz;
+	u32 data_sz = le32_to_cpu(chunk->total_sz) - sw->chunk_hdr_sz;
+	lbaint_t blocks = (lbaint_t)le32_to_cpu(chunk->chunk_sz) *
+			  (sw->blk_sz / sw->dev->blksz);
+	int ret;
+
+	if (le32_to_cpu(chunk->total_sz) < sw->chunk_hdr_sz)
+		return sparse_error(sw, "bad chunk size");
+	sw->chunks_left--;
+
+	switch (le16_to_cpu(chunk->chunk_type)) {
+	case CHUNK_TYPE_RAW:
+		if (data_sz != bytes)
+			return sparse_error(sw, "bad chunk size");
+		ret = sparse_room(sw, blocks);
+		if (ret)
+			return ret;
+		sw->left = bytes;
+		sw->state = SPARSE_RAW;
+		break;
+	case CHUNK_TYPE_FILL:
+		if (data_sz != sizeof(u32))
+			return sparse_error(sw, "bad chunk size");
+		ret = sparse_room(sw, blocks);
+		if (ret)
+			return ret;
+		sw->left = blocks;
+		sparse_collect(sw, SPARSE_FILL, sizeof(u32));
+		return 0;
+	case CHUNK_TYPE_DONT_CARE:
+		if (data_sz)
+			return sparse_error(sw, "bad chunk size");
+		ret = sparse_room(sw, blocks);
+		if (!ret)
+			ret = sparse_flush(sw);
+		if (ret)
+			return ret;
+		sw->blk += blocks;
+		sw->skipped += blocks;
+		sw->left = 0;
+		break;
+	case CHUNK_TYPE_CRC32:
+		sw->left = data_sz;
+		sw->state = SPARSE_SKIP;
+		break;
+	default:
+		return sparse_error(sw, "unknown chunk type");
+	}
+
+	if (!sw->left)
+		sparse_next_chunk(sw);
+
+	return 0;
+}
+
+/* Write the image as it is, starting with the bytes taken for its magic */
+static int sparse_not_sparse(struct sparse_writer *sw)
+{
+	int ret;
+
+	sw->state = SPARSE_NONE;
+	ret = sparse_room(sw, 1);
+	if (ret)
+		return ret;
+
+	return sparse_put(sw, (u8 *)sw->hdr, sw->hdr_len);
+}
+
+/* A header, or the value of a fill chunk, has been collected */
+static int sparse_collected(struct sparse_writer *sw)
+{
+	int ret;
+
+	switch (sw->state) {
+	case SPARSE_MAGIC:
+		if (le32_to_cpu(sw->hdr[0]) == SPARSE_HEADER_MAGIC) {
+			sw->state = SPARSE_FILE_HDR;
+			sw->hdr_want = sizeof(sparse_header_t);
+			return 0;
+		}
+		return sparse_not_sparse(sw);
+	case SPARSE_FILE_HDR:
+		return sparse_file_header(sw);
+	case SPARSE_CHUNK_HDR:
+		return sparse_chunk_header(sw);
+	case SPARSE_FILL:
+		ret = sparse_fill(sw, sw->hdr[0], sw->left);
+		if (ret)
+			return ret;
+		sparse_next_chunk(sw);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+void sparse_writer_init(struct sparse_writer *sw, block_dev_desc_t *dev,
+			disk_partition_t *info, void *buf, ulong buf_size)
+{
+	memset(sw, '\0', sizeof(*sw));
+	sw->dev = dev;
+	sw->start = info->start;
+	sw->size = info->size;
+	sw->buf = buf;
+	sw->buf_size = buf_size - buf_size % dev->blksz;
+	sparse_collect(sw, SPARSE_MAGIC, sizeof(u32));
+}
+
+int sparse_writer_write(struct sparse_writer *sw, const void *data,
+			ulong len)
+{
+	ulong blksz = sw->dev->blksz;
+	const u8 *p = data;
+	lbaint_t blocks;
+	ulong n;
+	int ret;
+
+	while (len) {
+		switch (sw->state) {
+		case SPARSE_MAGIC:
+		case SPARSE_FILE_HDR:
+		case SPARSE_CHUNK_HDR:
+		case SPARSE_FILL:
+			n = min(len, (ulong)(sw->hdr_want - sw->hdr_len));
+			memcpy((u8 *)sw->hdr + sw->hdr_len, p, n);
+			sw->hdr_len += n;
+			ret = 0;
+			if (sw->hdr_len == sw->hdr_want)
+				ret = sparse_collected(sw);
+			break;
+		case SPARSE_RAW:
+			n = min((u64)len, sw->left);
+			ret = sparse_put(sw, p, n);
+			sw->left -= n;
+			if (!sw->left)
+				sparse_next_chunk(sw);
+			break;
+		case SPARSE_SKIP:
+			n = min((u64)len, sw->left);
+			sw->left -= n;
+			ret = 0;
+			if (!sw->left)
+				sparse_next_chunk(sw);
+			break;
+		case SPARSE_NONE:
+			n = len;
+			blocks = DIV_ROUND_UP(sw->buf_len % blksz + n, blksz);
+			ret = sparse_room(sw, blocks);
+			if (!ret)
+				ret = sparse_put(sw, p, n);
+			break;
+		default:
+			return sparse_error(sw, "data after the last chunk");
+		}
+		if (ret)
+			return ret;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int sparse_writer_finish(struct sparse_writer *sw)
+{
+	ulong blksz = sw->dev->blksz;
+	ulong pad;
+
+	int ret;
+
+	/* too short to be a sparse image */
+	if (sw->state == SPARSE_MAGIC) {
+		if (!sw->hdr_len)
+			return sparse_error(sw, "empty image");
+		ret = sparse_not_sparse(sw);
+		if (ret)
+			return ret;
+	}
+
+	switch (sw->state) {
+	case SPARSE_NONE:
+		pad = (blksz - sw->buf_len % blksz) % blksz;
+		memset(sw->buf + sw->buf_len, '\0', pad);
+		sw->buf_len += pad;
+		break;
+	case SPARSE_DONE:
+		break;
+	default:
+		return sparse_error(sw, "image is truncated");
+	}
+
+	return sparse_flush(sw);
+}
@@ -0,0 +1,208 @@
+/*
+ * Decompress a legacy kernel image while it is being loaded
+ *
+ * Loaders (TFTP, the generic filesystem load) tell us about each piece of
+ * the image as it lands in memory. Once the header is in, the data is
+ * inflated straight to the load address named in the header and its CRC
+ * is checked on the same pass, so that bootm finds the kernel ready and
+ * verified when the load completes.
+ *
+ * The compressed image is still stored at the load address given to the
+ * loader. Anything the stream cannot handle, or any error, simply leaves
+ * the image for bootm to check and decompress as usual.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <image.h>
+#include <asm/io.h>
+#include <u-boot/crc.h>
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
+enum stream_state {
+	STREAM_IDLE,		/* not streaming */
+	STREAM_HEADER,		/* waiting for the image header */
+	STREAM_DATA,		/* checking and decompressing the data */
+	STREAM_DONE,		/* image loaded, decompressed and verified */
+};
+
+static struct image_stream {
+	enum stream_state state;
+	ulong addr;		/* address the image is being loaded to */
+	ulong pos;		/* bytes of the image in memory so far */
+	ulong end;		/* end of the image data */
+	image_header_t hdr;	/* copy of the image header */
+	uint32_t dcrc;		/* CRC32 of the data so far */
+	struct image_unpack *unpack;	/* decompressor */
+	ulong fed;		/* bytes given to the decompressor so far */
+	ulong load;		/* decompressor output */
+	ulong out_len;		/* bytes of output so far */
+	ulong out_max;		/* room for the output */
+} stream;
+
+/* Free the decompressor and stop streaming */
+static void stream_stop(void)
+{
+	if (stream.unpack) {
+		image_unpack_finish(stream.unpack, NULL);
+		stream.unpack = NULL;
+	}
+	stream.state = STREAM_IDLE;
+}
+
+static void stream_fail(const char *msg)
+{
+	debug("Image stream: %s, leaving the image to bootm\n", msg);
+	stream_stop();
+}
+
+/* Check the image header and work out where the output can go */
+static int stream_check_header(void)
+{
+	const image_header_t *hdr = &stream.hdr;
+	ulong load = image_get_load(hdr);
+
+	if (!image_check_magic(hdr) || !image_check_hcrc(hdr))
+		return -1;
+	if (image_get_type(hdr) != IH_TYPE_KERNEL ||
+	    !image_check_target_arch(hdr))
+		return -1;
+
+	/* The output must not run into the image */
+	stream.out_max = CONFIG_SYS_BOOTM_LEN;
+	if (load < stream.addr)
+		stream.out_max = min(stream.out_max, stream.addr - load);
+	else if (load < stream.addr + image_get_image_size(hdr))
+		return -1;
+
+	stream.load = load;
+	stream.end = image_get_image_size(hdr);
+	stream.dcrc = 0;
+	stream.fed = image_get_header_size();
+	stream.out_len = 0;
+	stream.unpack = image_unpack_new(image_get_comp(hdr),
+					 map_sysmem(load, stream.out_max),
+					 stream.out_max);
+	if (!stream.unpack)
+		return -1;
+
+	return 0;
+}
+
+void image_stream_start(ulong addr)
+{
+	stream_stop();
+	if (getenv_yesno("bootm_stream") != 1)
+		return;
+
+	stream.addr = addr;
+	stream.pos = 0;
+	stream.state = STREAM_HEADER;
+}
+
+void image_stream_write(ulong offset, ulong len)
+{
+	ulong hdr_size = image_get_header_size();
+	ulong start, end;
+	long ret;
+
+	if (stream.state != STREAM_HEADER && stream.state != STREAM_DATA)
+		return;
+
+	/* A restarted load, e.g. after a TFTP timeout */
+	if (!offset && stream.pos) {
+		image_stream_start(stream.addr);
+		if (stream.state == STREAM_IDLE)
+			return;
+	}
+
+	if (offset > stream.pos) {
+		stream_fail("load out of order");
+		return;
+	}
+	if (offset + len <= stream.pos)
+		return;
+	start = stream.pos;
+	stream.pos = offset + len;
+
+	if (stream.state == STREAM_HEADER) {
+		if (stream.pos < hdr_size)
+			return;
+		memcpy(&stream.hdr, map_sysmem(stream.addr, hdr_size),
+		       hdr_size);
+		if (stream_check_header()) {
+			stream_fail("not a streamable image");
+			return;
+		}
+		stream.state = STREAM_DATA;
+	}
+
+	/* Check the new data against the image data CRC... */
+	start = max(start, hdr_size);
+	end = min(stream.pos, stream.end);
+	if (start >= end)
+		return;
+	stream.dcrc = crc32(stream.dcrc,
+			    map_sysmem(stream.addr + start, end - start),
+			    end - start);
+
+	/* ...and decompress whatever has not been yet */
+	if (stream.fed >= end)
+		return;
+	ret = image_unpack_feed(stream.unpack,
+				map_sysmem(stream.addr + stream.fed,
+					   end - stream.fed), end - stream.fed);
+	if (ret < 0) {
+		stream_fail("decompression error");
+		return;
+	}
+	/* The compression header may not all be in yet */
+	stream.fed += ret;
+}
+
+void image_stream_end(ulong size)
+{
+	int ret;
+
+	if (stream.state != STREAM_DATA) {
+		stream_stop();
+		return;
+	}
+	if (size < stream.end || stream.fed < stream.end) {
+		stream_fail("image incomplete");
+		return;
+	}
+	ret = image_unpack_finish(stream.unpack, &stream.out_len);
+	stream.unpack = NULL;
+	if (ret) {
+		stream_fail("image incomplete");
+		return;
+	}
+	if (stream.dcrc != image_get_dcrc(&stream.hdr)) {
+		stream_fail("bad data CRC");
+		return;
+	}
+
+	stream.state = STREAM_DONE;
+	flush_cache(stream.load, stream.out_len);
+	printf("Unpacked %lu bytes to 0x%08lx while loading\n",
+	       stream.out_len, stream.load);
+}
+
+int image_stream_check(ulong img_addr, const image_header_t *hdr,
+		       ulong *load_end)
+{
+	if (stream.state != STREAM_DONE || img_addr != stream.addr ||
+	    memcmp(hdr, &stream.hdr, sizeof(stream.hdr)))
+		return -1;
+	if (load_end)
+		*load_end = stream.load + stream.out_len;
+
+	return 0;
+}
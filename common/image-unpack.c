@@ -0,0 +1,284 @@
+/*
+ * Decompress an image a piece at a time
+ *
+ * Used where the compressed data is not all available at once, or where
+ * it is checked on the way through, so that decompression can follow
+ * along with the load or the hash rather than start after it.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <image.h>
+#include <malloc.h>
+#include <u-boot/zlib.h>
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+
+/* gzip header flags, as in gunzip() */
+#define HEAD_CRC		2
+#define EXTRA_FIELD		4
+#define ORIG_NAME		8
+#define COMMENT			0x10
+#define RESERVED		0xe0
+#define DEFLATED		8
+
+/* LZMA_Alone header: properties and a 64-bit uncompressed size */
+#define LZMA_HDR_SIZE		(LZMA_PROPS_SIZE + 8)
+
+struct image_unpack {
+	int comp;		/* IH_COMP_... */
+	bool started;		/* compression header has been read */
+	bool finished;		/* end of the compressed stream seen */
+	uchar *dst;		/* output buffer */
+	ulong dst_max;		/* size of the output buffer */
+	ulong out_len;		/* bytes of output so far */
+	z_stream zs;
+	CLzmaDec lzma;
+	SizeT lzma_len;		/* uncompressed size, or dst_max */
+};
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static ISzAlloc lzma_alloc = { sz_alloc, sz_free };
+
+static void *unpack_zalloc(void *x, unsigned items, unsigned size)
+{
+	return malloc(items * size);
+}
+
+static void unpack_zfree(void *x, void *addr, unsigned nb)
+{
+	free(addr);
+}
+
+#ifdef CONFIG_GZIP
+/*
+ * Skip the gzip header and set up a raw inflate, as gunzip() does; the
+ * image hash or CRC covers the data. Returns the header length, 0 if more
+ * data is needed.
+ */
+static long unpack_start_gzip(struct image_unpack *up, const uchar *buf,
+			      ulong len)
+{
+	ulong i = 10;
+	int flags;
+
+	if (len < i)
+		return 0;
+	flags = buf[3];
+	if (buf[2] != DEFLATED || (flags & RESERVED) != 0)
+		return -EINVAL;
+	if ((flags & EXTRA_FIELD) != 0) {
+		if (len < 12)
+			return 0;
+		i = 12 + buf[10] + (buf[11] << 8);
+	}
+	if ((flags & ORIG_NAME) != 0) {
+		do {
+			if (i >= len)
+				return 0;
+		} while (buf[i++] != 0);
+	}
+	if ((flags & COMMENT) != 0) {
+		do {
+			if (i >= len)
+				return 0;
+		} while (buf[i++] != 0);
+	}
+	if ((flags & HEAD_CRC) != 0)
+		i += 2;
+	if (i > len)
+		return 0;
+
+	up->zs.zalloc = unpack_zalloc;
+	up->zs.zfree = unpack_zfree;
+	if (inflateInit2(&up->zs, -MAX_WBITS) != Z_OK)
+		return -ENOMEM;
+	up->zs.next_out = up->dst;
+	up->zs.avail_out = up->dst_max;
+
+	return i;
+}
+#endif
+
+#ifdef CONFIG_LZMA
+static long unpack_start_lzma(struct image_unpack *up, const uchar *buf,
+			      ulong len)
+{
+	uint64_t size = 0;
+	int i;
+
+	if (len < LZMA_HDR_SIZE)
+		return 0;
+	for (i = 0; i < 8; i++)
+		size |= (uint64_t)buf[LZMA_PROPS_SIZE + i] << (i * 8);
+
+	/* All ones means the size is not known and an end mark follows */
+	up->lzma_len = up->dst_max;
+	if (size != (uint64_t)-1) {
+		if (size > up->dst_max)
+			return -E2BIG;
+		up->lzma_len = size;
+	}
+
+	LzmaDec_Construct(&up->lzma);
+	if (LzmaDec_AllocateProbs(&up->lzma, buf, LZMA_PROPS_SIZE,
+				  &lzma_alloc) != SZ_OK)
+		return -ENOMEM;
+	up->lzma.dic = up->dst;
+	up->lzma.dicBufSize = up->dst_max;
+	LzmaDec_Init(&up->lzma);
+
+	return LZMA_HDR_SIZE;
+}
+#endif
+
+struct image_unpack *image_unpack_new(int comp, void *dst, ulong dst_max)
+{
+	struct image_unpack *up;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+#endif
+		break;
+	default:
+		return NULL;
+	}
+
+	up = calloc(1, sizeof(*up));
+	if (!up)
+		return NULL;
+	up->comp = comp;
+	up->dst = dst;
+	up->dst_max = dst_max;
+
+	return up;
+}
+
+static long unpack_start(struct image_unpack *up, const uchar *buf,
+			 ulong len)
+{
+	switch (up->comp) {
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return unpack_start_gzip(up, buf, len);
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		return unpack_start_lzma(up, buf, len);
+#endif
+	}
+
+	return 0;
+}
+
+long image_unpack_feed(struct image_unpack *up, const void *data, ulong len)
+{
+	const uchar *buf = data;
+	long hdr_len = 0;
+
+	if (!up->started) {
+		hdr_len = unpack_start(up, buf, len);
+		if (hdr_len < 0)
+			return hdr_len;
+		if (!hdr_len && up->comp != IH_COMP_NONE)
+			return 0;
+		up->started = true;
+		buf += hdr_len;
+		len -= hdr_len;
+	}
+	/* Anything after the end of the stream is padding */
+	if (up->finished || !len)
+		return hdr_len + len;
+
+	switch (up->comp) {
+	case IH_COMP_NONE:
+		if (len > up->dst_max - up->out_len)
+			return -E2BIG;
+		memcpy(up->dst + up->out_len, buf, len);
+		up->out_len += len;
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP: {
+		int ret;
+
+		up->zs.next_in = (uchar *)buf;
+		up->zs.avail_in = len;
+		ret = inflate(&up->zs, Z_NO_FLUSH);
+		up->out_len = up->dst_max - up->zs.avail_out;
+		if (ret == Z_STREAM_END)
+			up->finished = true;
+		else if (ret != Z_OK)
+			return -EINVAL;
+		else if (up->zs.avail_in)
+			return -E2BIG;
+		break;
+	}
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA: {
+		ELzmaStatus status;
+		SizeT in_len = len;
+		int ret;
+
+		ret = LzmaDec_DecodeToDic(&up->lzma, up->lzma_len, buf,
+					  &in_len, LZMA_FINISH_ANY, &status);
+		up->out_len = up->lzma.dicPos;
+		if (ret != SZ_OK)
+			return -EINVAL;
+		if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+		    up->out_len == up->lzma_len)
+			up->finished = true;
+		else if (in_len != len)
+			return -E2BIG;
+		break;
+	}
+#endif
+	}
+
+	return hdr_len + len;
+}
+
+int image_unpack_finish(struct image_unpack *up, ulong *out_lenp)
+{
+	int ret = 0;
+
+	if (!up)
+		return -EINVAL;
+	if (up->comp != IH_COMP_NONE && !up->finished)
+		ret = -EIO;
+	if (up->started) {
+		switch (up->comp) {
+#ifdef CONFIG_GZIP
+		case IH_COMP_GZIP:
+			inflateEnd(&up->zs);
+			break;
+#endif
+#ifdef CONFIG_LZMA
+		case IH_COMP_LZMA:
+			LzmaDec_FreeProbs(&up->lzma, &lzma_alloc);
+			break;
+#endif
+		}
+	}
+	if (out_lenp)
+		*out_lenp = up->out_len;
+	free(up);
+
+	return ret;
+}
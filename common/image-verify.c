@@ -0,0 +1,252 @@
+/*
+ * Verify a FIT image on the way to its load address
+ *
+ * Checking a FIT image's hashes and signatures reads all of its data, then
+ * copying it to its load address, or decompressing it there, reads it all
+ * again. Here the data is taken a chunk at a time, small enough to stay in
+ * the cache, and every digest that the image's hash and signature nodes
+ * need is computed over each chunk as it is copied or decompressed.
+ *
+ * The digests are kept until the image has been checked, so that
+ * calculate_hash() and the signature checksum find them instead of reading
+ * the data once more. The image is still checked before it is used; a bad
+ * image is simply found after it has been written to its load address.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <errno.h>
+#include <image.h>
+#include <watchdog.h>
+#include <asm/io.h>
+#include <u-boot/crc.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+
+#ifndef CONFIG_FIT_VERIFY_CHUNK
+#define CONFIG_FIT_VERIFY_CHUNK	(32 << 10)
+#endif
+
+enum digest_type {
+	DIGEST_CRC32,
+	DIGEST_SHA1,
+	DIGEST_SHA256,
+
+	DIGEST_COUNT,
+};
+
+static const char *const digest_name[DIGEST_COUNT] = {
+	"crc32", "sha1", "sha256",
+};
+
+static const int digest_len[DIGEST_COUNT] = {
+	4, SHA1_SUM_LEN, SHA256_SUM_LEN,
+};
+
+/* Digests of the image most recently checked on its way through */
+static struct {
+	const void *data;	/* image data the digests cover */
+	ulong size;		/* size of the image data */
+	uint valid;		/* mask of DIGEST_... computed */
+	uint8_t value[DIGEST_COUNT][FIT_MAX_HASH_LEN];
+} digests;
+
+struct digest_ctx {
+	uint want;		/* mask of DIGEST_... to compute */
+	uint32_t crc;
+	sha1_context sha1;
+	sha256_context sha256;
+};
+
+static int digest_find(const char *algo, int len)
+{
+	int i;
+
+	for (i = 0; i < DIGEST_COUNT; i++) {
+		if (strlen(digest_name[i]) == len &&
+		    !strncmp(algo, digest_name[i], len))
+			return i;
+	}
+
+	return -1;
+}
+
+/* Work out which digests the hash and signature nodes will check */
+static uint digest_wanted(const void *fit, int image_noffset)
+{
+	uint want = 0;
+	int noffset;
+
+	for (noffset = fdt_first_subnode(fit, image_noffset);
+	     noffset >= 0;
+	     noffset = fdt_next_subnode(fit, noffset)) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+		const char *algo, *sep;
+		int type = -1;
+
+		algo = fdt_getprop(fit, noffset, FIT_ALGO_PROP, NULL);
+		if (!algo)
+			continue;
+		if (!strncmp(name, FIT_HASH_NODENAME,
+			     strlen(FIT_HASH_NODENAME))) {
+			type = digest_find(algo, strlen(algo));
+		} else if (IMAGE_ENABLE_VERIFY &&
+			   !strncmp(name, FIT_SIG_NODENAME,
+				    strlen(FIT_SIG_NODENAME))) {
+			/* e.g. "sha1,rsa2048" */
+			sep = strchr(algo, ',');
+			type = digest_find(algo,
+					   sep ? sep - algo : strlen(algo));
+		}
+		if (type >= 0)
+			want |= 1 << type;
+	}
+
+	return want;
+}
+
+static void digest_start(struct digest_ctx *ctx)
+{
+	if (IMAGE_ENABLE_CRC32 && (ctx->want & (1 << DIGEST_CRC32)))
+		ctx->crc = 0;
+	if (IMAGE_ENABLE_SHA1 && (ctx->want & (1 << DIGEST_SHA1)))
+		sha1_starts(&ctx->sha1);
+	if (IMAGE_ENABLE_SHA256 && (ctx->want & (1 << DIGEST_SHA256)))
+		sha256_starts(&ctx->sha256);
+}
+
+static void digest_update(struct digest_ctx *ctx, const void *buf, ulong len)
+{
+	bootstage_start(BOOTSTAGE_ID_ACCUM_HASH, "verify_hash");
+	if (IMAGE_ENABLE_CRC32 && (ctx->want & (1 << DIGEST_CRC32)))
+		ctx->crc = crc32(ctx->crc, buf, len);
+	if (IMAGE_ENABLE_SHA1 && (ctx->want & (1 << DIGEST_SHA1)))
+		sha1_update(&ctx->sha1, buf, len);
+	if (IMAGE_ENABLE_SHA256 && (ctx->want & (1 << DIGEST_SHA256)))
+		sha256_update(&ctx->sha256, buf, len);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_HASH);
+}
+
+/* Store the digests in the form calculate_hash() gives them */
+static void digest_finish(struct digest_ctx *ctx, const void *data,
+			  ulong size)
+{
+	digests.data = data;
+	digests.size = size;
+	digests.valid = 0;
+	if (IMAGE_ENABLE_CRC32 && (ctx->want & (1 << DIGEST_CRC32))) {
+		*((uint32_t *)digests.value[DIGEST_CRC32]) =
+			cpu_to_uimage(ctx->crc);
+		digests.valid |= 1 << DIGEST_CRC32;
+	}
+	if (IMAGE_ENABLE_SHA1 && (ctx->want & (1 << DIGEST_SHA1))) {
+		sha1_finish(&ctx->sha1, digests.value[DIGEST_SHA1]);
+		digests.valid |= 1 << DIGEST_SHA1;
+	}
+	if (IMAGE_ENABLE_SHA256 && (ctx->want & (1 << DIGEST_SHA256))) {
+		sha256_finish(&ctx->sha256, digests.value[DIGEST_SHA256]);
+		digests.valid |= 1 << DIGEST_SHA256;
+	}
+}
+
+int fit_image_verify_copy(const void *fit, int noffset, ulong dst,
+			  ulong dst_max, ulong *out_lenp)
+{
+	struct image_unpack *up;
+	struct digest_ctx ctx;
+	const uint8_t *buf;
+	const void *data;
+	size_t size;
+	ulong src, pos, len;
+	uint8_t comp;
+	long ret;
+
+	fit_image_clear_digests();
+	if (fit_image_get_data(fit, noffset, &data, &size) ||
+	    fit_image_get_comp(fit, noffset, &comp))
+		return -ENOENT;
+
+	/* The output must not run into the image */
+	buf = data;
+	src = map_to_sysmem((void *)buf);
+	if (dst < src + size && dst + dst_max > src)
+		return -EXDEV;
+
+	up = NULL;
+	if (dst_max) {
+		up = image_unpack_new(comp, map_sysmem(dst, dst_max), dst_max);
+		if (!up)
+			return -ENOSYS;
+	}
+
+	ctx.want = digest_wanted(fit, noffset);
+	digest_start(&ctx);
+
+	/*
+	 * Compressed data is hashed before it goes to the decompressor;
+	 * uncompressed data is hashed from the copy, while it is still in
+	 * the cache.
+	 */
+	for (pos = 0; pos < size; pos += ret) {
+		len = size - pos;
+		if (len > CONFIG_FIT_VERIFY_CHUNK)
+			len = CONFIG_FIT_VERIFY_CHUNK;
+
+		if (!up) {
+			digest_update(&ctx, buf + pos, len);
+			ret = len;
+		} else if (comp != IH_COMP_NONE) {
+			digest_update(&ctx, buf + pos, len);
+			bootstage_start(BOOTSTAGE_ID_ACCUM_DECOMP,
+					"verify_decomp");
+			ret = image_unpack_feed(up, buf + pos, len);
+			bootstage_accum(BOOTSTAGE_ID_ACCUM_DECOMP);
+		} else {
+			bootstage_start(BOOTSTAGE_ID_ACCUM_COPY, "verify_copy");
+			ret = image_unpack_feed(up, buf + pos, len);
+			bootstage_accum(BOOTSTAGE_ID_ACCUM_COPY);
+			digest_update(&ctx, map_sysmem(dst + pos, len), len);
+		}
+		/* Each chunk holds the whole compression header */
+		if (ret <= 0) {
+			image_unpack_finish(up, NULL);
+			return ret ? ret : -EINVAL;
+		}
+		WATCHDOG_RESET();
+	}
+
+	if (up) {
+		ret = image_unpack_finish(up, out_lenp);
+		if (ret)
+			return ret;
+		flush_cache(dst, *out_lenp);
+	}
+	digest_finish(&ctx, data, size);
+
+	return 0;
+}
+
+int fit_image_get_digest(const void *data, ulong size, const char *algo,
+			 uint8_t *value, int *value_len)
+{
+	int type;
+
+	if (!digests.valid || data != digests.data || size != digests.size)
+		return -ENOENT;
+	type = digest_find(algo, strlen(algo));
+	if (type < 0 || !(digests.valid & (1 << type)))
+		return -ENOENT;
+
+	memcpy(value, digests.value[type], digest_len[type]);
+	if (value_len)
+		*value_len = digest_len[type];
+
+	return 0;
+}
+
+void fit_image_clear_digests(void)
+{
+	digests.valid = 0;
+}
@@ -241,6 +241,16 @@ int usb_bulk_msg(struct usb_device *dev, unsigned int pipe,
 }
 
 
+/*
+ * Before controller drivers could tell, mass storage transfers were kept
+ * to 20 blocks of 512 bytes on all but EHCI, so that is what a controller
+ * which does not say is trusted with.
+ */
+__weak size_t usb_max_xfer_size(struct usb_device *dev)
+{
+	return 20 * 512;
+}
+
 /*-------------------------------------------------------------------
  * Max Packet stuff
  */
@@ -33,8 +33,10 @@
 
 #include <common.h>
 #include <command.h>
+#include <div64.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
+#include <asm/unaligned.h>
 
 #include <part.h>
 #include <usb.h>
@@ -49,7 +51,7 @@
 static const unsigned char us_direction[256/8] = {
 	0x28, 0x81, 0x14, 0x14, 0x20, 0x01, 0x90, 0x77,
 	0x0C, 0x20, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01,
+	0x00, 0x01, 0x00, 0x40, 0x00, 0x01, 0x00, 0x01,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 #define US_DIRECTION(x) ((us_direction[x>>3] >> (x & 7)) & 1)
@@ -129,21 +131,31 @@ struct us_data {
 	ccb		*srb;			/* current srb */
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
+	unsigned short	max_xfer_blk;		/* blocks per READ/WRITE */
 };
 
-#ifdef CONFIG_USB_EHCI
 /*
- * The U-Boot EHCI driver can handle any transfer length as long as there is
- * enough free heap space left, but the SCSI READ(10) and WRITE(10) commands are
- * limited to 65535 blocks.
+ * READ(10) and WRITE(10) count blocks in 16 bits and so does the code here
+ * for READ(16) and WRITE(16). The host controller may take fewer in one
+ * go, see usb_stor_set_max_xfer().
  */
 #define USB_MAX_XFER_BLK	65535
-#else
-#define USB_MAX_XFER_BLK	20
-#endif
+
+/* Beyond this block READ(16) and WRITE(16) are needed */
+#define USB_MAX_LBA10		0xffffffffULL
 
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
+/* What the READ and WRITE commands to each storage device have done */
+struct us_stats {
+	ulong		cmds;			/* commands which worked */
+	u64		blks_read;
+	u64		blks_written;
+	u64		us;			/* time spent in them */
+};
+
+static struct us_stats usb_stor_stats[USB_MAX_STOR_DEV];
+
 
 #define USB_STOR_TRANSPORT_GOOD	   0
 #define USB_STOR_TRANSPORT_FAILED -1
@@ -172,6 +184,44 @@ static void usb_show_progress(void)
 	debug(".");
 }
 
+/* Find the storage data behind a block device, NULL if it has gone */
+static struct us_data *usb_stor_find(int device)
+{
+	struct usb_device *dev;
+	int i;
+
+	for (i = 0; i < USB_MAX_DEVICE; i++) {
+		dev = usb_get_dev_index(i);
+		if (dev == NULL)
+			break;
+		if (dev->devnum == usb_dev_desc[device].target)
+			return (struct us_data *)dev->privptr;
+	}
+
+	return NULL;
+}
+
+static void usb_stor_print_stats(int device)
+{
+	struct us_stats *stats = &usb_stor_stats[device];
+	struct us_data *ss = usb_stor_find(device);
+	ulong blksz = usb_dev_desc[device].blksz;
+	u64 kib;
+
+	if (!ss || !blksz)
+		return;
+
+	kib = (stats->blks_read + stats->blks_written) * blksz / 1024;
+	printf("            Transfers of up to %u blocks, %lu commands\n",
+	       ss->max_xfer_blk, stats->cmds);
+	printf("            Read %llu KiB, wrote %llu KiB in %llu ms",
+	       stats->blks_read * blksz / 1024,
+	       stats->blks_written * blksz / 1024, lldiv(stats->us, 1000));
+	if (stats->us)
+		printf(", %llu KiB/s", lldiv(kib * 1000000, stats->us));
+	putc('\n');
+}
+
 /*******************************************************************************
  * show info on storage devices; 'usb start/init' must be invoked earlier
  * as we only retrieve structures populated during devices initialization
@@ -184,6 +234,7 @@ int usb_stor_info(void)
 		for (i = 0; i < usb_max_devs; i++) {
 			printf("  Device %d: ", i);
 			dev_print(&usb_dev_desc[i]);
+			usb_stor_print_stats(i);
 		}
 		return 0;
 	}
@@ -223,7 +274,9 @@ int usb_stor_scan(int mode)
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
 	for (i = 0; i < USB_MAX_STOR_DEV; i++) {
+		blkcache_invalidate(IF_TYPE_USB, i);
 		memset(&usb_dev_desc[i], 0, sizeof(block_dev_desc_t));
+		memset(&usb_stor_stats[i], 0, sizeof(struct us_stats));
 		usb_dev_desc[i].if_type = IF_TYPE_USB;
 		usb_dev_desc[i].dev = i;
 		usb_dev_desc[i].part_type = PART_TYPE_UNKNOWN;
@@ -979,6 +1032,21 @@ static int usb_read_capacity(ccb *srb, struct us_data *ss)
 	return -1;
 }
 
+/* For media of more than 2^32 blocks, the data is 32 bytes */
+static int usb_read_capacity_16(ccb *srb, struct us_data *ss)
+{
+	memset(&srb->cmd[0], 0, 16);
+	srb->cmd[0] = SCSI_RD_CAPAC16;
+	srb->cmd[1] = SCSI_SAI_RD_CAPAC16;
+	put_unaligned_be32(32, &srb->cmd[10]);
+	srb->datalen = 32;
+	srb->cmdlen = 16;
+	if (ss->transport(srb, ss) == USB_STOR_TRANSPORT_GOOD)
+		return 0;
+
+	return -1;
+}
+
 static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
 		       unsigned short blocks)
 {
@@ -1013,6 +1081,35 @@ static int usb_write_10(ccb *srb, struct us_data *ss, unsigned long start,
 	return ss->transport(srb, ss);
 }
 
+/*
+ * READ(16) or WRITE(16), as @opcode says. The LUN is only in the CBW here,
+ * byte 1 of these commands has other uses.
+ */
+static int usb_rw_16(ccb *srb, struct us_data *ss, unsigned char opcode,
+		     u64 start, unsigned short blocks)
+{
+	memset(&srb->cmd[0], 0, 16);
+	srb->cmd[0] = opcode;
+	put_unaligned_be64(start, &srb->cmd[2]);
+	put_unaligned_be32(blocks, &srb->cmd[10]);
+	srb->cmdlen = 16;
+	debug("rw16: %x start %llx blocks %x\n", opcode, start, blocks);
+	return ss->transport(srb, ss);
+}
+
+/* Read or write @blocks blocks at @start with the shortest command */
+static int usb_read_write(ccb *srb, struct us_data *ss, lbaint_t start,
+			  unsigned short blocks, int write)
+{
+	if ((u64)start + blocks - 1 > USB_MAX_LBA10)
+		return usb_rw_16(srb, ss, write ? SCSI_WRITE16 : SCSI_READ16,
+				 start, blocks);
+	if (write)
+		return usb_write_10(srb, ss, start, blocks);
+
+	return usb_read_10(srb, ss, start, blocks);
+}
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1043,9 +1140,10 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
 	unsigned short smallblks;
-	struct usb_device *dev;
+	struct us_stats *stats;
 	struct us_data *ss;
-	int retry, i;
+	ulong time;
+	int retry;
 	ccb *srb = &usb_ccb;
 
 	if (blkcnt == 0)
@@ -1054,15 +1152,11 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	device &= 0xff;
 	/* Setup  device */
 	debug("\nusb_read: dev %d \n", device);
-	dev = NULL;
-	for (i = 0; i < USB_MAX_DEVICE; i++) {
-		dev = usb_get_dev_index(i);
-		if (dev == NULL)
-			return 0;
-		if (dev->devnum == usb_dev_desc[device].target)
-			break;
-	}
-	ss = (struct us_data *)dev->privptr;
+	ss = usb_stor_find(device);
+	if (ss == NULL)
+		return 0;
+	stats = &usb_stor_stats[device];
+	time = timer_get_us();
 
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 	srb->lun = usb_dev_desc[device].lun;
@@ -1077,16 +1171,16 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > ss->max_xfer_blk)
+			smallblks = ss->max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == ss->max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_read_10(srb, ss, start, smallblks)) {
+		if (usb_read_write(srb, ss, start, smallblks, 0)) {
 			debug("Read ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1094,18 +1188,23 @@ retry_it:
 			blkcnt -= blks;
 			break;
 		}
+		/* The device is awake, the next command needs no settling */
+		ss->flags |= USB_READY;
+		stats->cmds++;
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
 	} while (blks != 0);
 	ss->flags &= ~USB_READY;
+	stats->blks_read += blkcnt;
+	stats->us += timer_get_us() - time;
 
 	debug("usb_read: end startblk " LBAF
 	      ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= ss->max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 }
@@ -1116,9 +1215,10 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
 	unsigned short smallblks;
-	struct usb_device *dev;
+	struct us_stats *stats;
 	struct us_data *ss;
-	int retry, i;
+	ulong time;
+	int retry;
 	ccb *srb = &usb_ccb;
 
 	if (blkcnt == 0)
@@ -1127,15 +1227,11 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	device &= 0xff;
 	/* Setup  device */
 	debug("\nusb_write: dev %d \n", device);
-	dev = NULL;
-	for (i = 0; i < USB_MAX_DEVICE; i++) {
-		dev = usb_get_dev_index(i);
-		if (dev == NULL)
-			return 0;
-		if (dev->devnum == usb_dev_desc[device].target)
-			break;
-	}
-	ss = (struct us_data *)dev->privptr;
+	ss = usb_stor_find(device);
+	if (ss == NULL)
+		return 0;
+	stats = &usb_stor_stats[device];
+	time = timer_get_us();
 
 	usb_disable_asynch(1); /* asynch transfer not allowed */
 
@@ -1153,16 +1249,16 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		 */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > ss->max_xfer_blk)
+			smallblks = ss->max_xfer_blk;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == ss->max_xfer_blk)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (usb_write_10(srb, ss, start, smallblks)) {
+		if (usb_read_write(srb, ss, start, smallblks, 1)) {
 			debug("Write ERROR\n");
 			usb_request_sense(srb, ss);
 			if (retry--)
@@ -1170,17 +1266,22 @@ retry_it:
 			blkcnt -= blks;
 			break;
 		}
+		/* The device is awake, the next command needs no settling */
+		ss->flags |= USB_READY;
+		stats->cmds++;
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
 	} while (blks != 0);
 	ss->flags &= ~USB_READY;
+	stats->blks_written += blkcnt;
+	stats->us += timer_get_us() - time;
 
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= ss->max_xfer_blk)
 		debug("\n");
 	return blkcnt;
 
@@ -1326,16 +1427,37 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 		dev->irq_handle = usb_stor_irq;
 	}
 	dev->privptr = (void *)ss;
+	/* until the block size is known, see usb_stor_get_info() */
+	ss->max_xfer_blk = 1;
 	return 1;
 }
 
+/*
+ * Take as many blocks per READ or WRITE as the host controller moves in
+ * one bulk transfer and one command counts, but no more than the medium
+ * holds
+ */
+static void usb_stor_set_max_xfer(struct us_data *ss,
+				  block_dev_desc_t *dev_desc)
+{
+	size_t blks = usb_max_xfer_size(ss->pusb_dev) / dev_desc->blksz;
+
+	if (blks > USB_MAX_XFER_BLK)
+		blks = USB_MAX_XFER_BLK;
+	if (blks > dev_desc->lba)
+		blks = dev_desc->lba;
+	ss->max_xfer_blk = blks ? blks : 1;
+	debug("max transfer %u blocks\n", ss->max_xfer_blk);
+}
+
 int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 		      block_dev_desc_t *dev_desc)
 {
 	unsigned char perq, modi;
-	ALLOC_CACHE_ALIGN_BUFFER(unsigned long, cap, 2);
+	ALLOC_CACHE_ALIGN_BUFFER(u32, cap, 8);
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, usb_stor_buf, 36);
-	unsigned long *capacity, *blksz;
+	unsigned long blksz;
+	u64 capacity;
 	ccb *pccb = &usb_ccb;
 
 	pccb->pdata = usb_stor_buf;
@@ -1385,26 +1507,27 @@ int usb_stor_get_info(struct usb_device *dev, struct us_data *ss,
 	memset(pccb->pdata, 0, 8);
 	if (usb_read_capacity(pccb, ss) != 0) {
 		printf("READ_CAP ERROR\n");
-		cap[0] = 2880;
-		cap[1] = 0x200;
+		capacity = 2880;
+		blksz = 0x200;
+	} else {
+		capacity = (u64)be32_to_cpu(cap[0]) + 1;
+		blksz = be32_to_cpu(cap[1]);
+	}
+	/* the last block does not fit in READ CAPACITY(10) */
+	if (capacity > USB_MAX_LBA10 && !usb_read_capacity_16(pccb, ss)) {
+		capacity = ((u64)be32_to_cpu(cap[0]) << 32 |
+			    be32_to_cpu(cap[1])) + 1;
+		blksz = be32_to_cpu(cap[2]);
 	}
 	ss->flags &= ~USB_READY;
-	debug("Read Capacity returns: 0x%lx, 0x%lx\n", cap[0], cap[1]);
-#if 0
-	if (cap[0] > (0x200000 * 10)) /* greater than 10 GByte */
-		cap[0] >>= 16;
-#endif
-	cap[0] = cpu_to_be32(cap[0]);
-	cap[1] = cpu_to_be32(cap[1]);
-
-	/* this assumes bigendian! */
-	cap[0] += 1;
-	capacity = &cap[0];
-	blksz = &cap[1];
-	debug("Capacity = 0x%lx, blocksz = 0x%lx\n", *capacity, *blksz);
-	dev_desc->lba = *capacity;
-	dev_desc->blksz = *blksz;
+	debug("Capacity = 0x%llx, blocksz = 0x%lx\n", capacity, blksz);
+	/* lbaint_t may be too small for all of a large medium */
+	if (capacity > (lbaint_t)-1)
+		capacity = (lbaint_t)-1;
+	dev_desc->lba = capacity;
+	dev_desc->blksz = blksz;
 	dev_desc->log2blksz = LOG2(dev_desc->blksz);
+	usb_stor_set_max_xfer(ss, dev_desc);
 	dev_desc->type = perq;
 	debug(" address %d\n", dev_desc->target);
 	debug("partype: %d\n", dev_desc->part_type);
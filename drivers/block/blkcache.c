@@ -0,0 +1,204 @@
+/*
+ * Generic LRU block cache
+ *
+ * Sits between filesystem code and the block_read/block_write callbacks of
+ * a block_dev_desc_t. Small reads (typically filesystem metadata such as
+ * FAT tables, ext4 group descriptors or inode tables) are kept in a list of
+ * entries ordered by last use, so repeated lookups do not go to the device.
+ * Writes always go to the device and refresh any cached copy.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <linux/list.h>
+
+#ifndef CONFIG_BLOCK_CACHE_BLOCKS
+#define CONFIG_BLOCK_CACHE_BLOCKS	8
+#endif
+
+#ifndef CONFIG_BLOCK_CACHE_ENTRIES
+#define CONFIG_BLOCK_CACHE_ENTRIES	32
+#endif
+
+struct block_cache_node {
+	struct list_head lh;
+	int if_type;
+	int dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	unsigned long blksz;
+	char *cache;
+};
+
+static LIST_HEAD(block_cache);
+
+static struct block_cache_stats _stats = {
+	.max_blocks_per_entry = CONFIG_BLOCK_CACHE_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_ENTRIES,
+};
+
+static void blkcache_free_node(struct block_cache_node *node)
+{
+	list_del(&node->lh);
+	free(node->cache);
+	free(node);
+	_stats.entries--;
+}
+
+/* Find an entry holding all of [start, start + blkcnt) */
+static struct block_cache_node *cache_find(int if_type, int dev,
+					   lbaint_t start, lbaint_t blkcnt,
+					   unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->if_type == if_type && node->dev == dev &&
+		    node->blksz == blksz && node->start <= start &&
+		    node->start + node->blkcnt >= start + blkcnt) {
+			/* Move to the front of the LRU list */
+			if (node != list_first_entry(&block_cache,
+						     struct block_cache_node,
+						     lh))
+				list_move(&node->lh, &block_cache);
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+static void cache_fill(int if_type, int dev, lbaint_t start, lbaint_t blkcnt,
+		       unsigned long blksz, const void *buffer)
+{
+	struct block_cache_node *node;
+	lbaint_t bytes = blkcnt * blksz;
+
+	/* Recycle the least recently used entry if the cache is full */
+	if (_stats.entries >= _stats.max_entries) {
+		node = list_entry(block_cache.prev, struct block_cache_node,
+				  lh);
+		list_del(&node->lh);
+		_stats.entries--;
+		if (node->blkcnt * node->blksz < bytes) {
+			free(node->cache);
+			node->cache = malloc(bytes);
+			if (!node->cache) {
+				free(node);
+				return;
+			}
+		}
+	} else {
+		node = malloc(sizeof(*node));
+		if (!node)
+			return;
+		node->cache = malloc(bytes);
+		if (!node->cache) {
+			free(node);
+			return;
+		}
+	}
+
+	debug("%s: fill %d/%d " LBAFU "+" LBAFU "\n", __func__, if_type, dev,
+	      start, blkcnt);
+	node->if_type = if_type;
+	node->dev = dev;
+	node->start = start;
+	node->blkcnt = blkcnt;
+	node->blksz = blksz;
+	memcpy(node->cache, buffer, bytes);
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+}
+
+unsigned long blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+			lbaint_t blkcnt, void *buffer)
+{
+	struct block_cache_node *node;
+	unsigned long blksz = dev_desc->blksz;
+	unsigned long n;
+
+	if (blkcnt > _stats.max_blocks_per_entry || !_stats.max_entries) {
+		_stats.bypass++;
+		return dev_desc->block_read(dev_desc->dev, start, blkcnt,
+					    buffer);
+	}
+
+	node = cache_find(dev_desc->if_type, dev_desc->dev, start, blkcnt,
+			  blksz);
+	if (node) {
+		memcpy(buffer, node->cache + (start - node->start) * blksz,
+		       blkcnt * blksz);
+		_stats.hits++;
+		return blkcnt;
+	}
+
+	_stats.misses++;
+	n = dev_desc->block_read(dev_desc->dev, start, blkcnt, buffer);
+	if (n == blkcnt)
+		cache_fill(dev_desc->if_type, dev_desc->dev, start, blkcnt,
+			   blksz, buffer);
+
+	return n;
+}
+
+unsigned long blk_dwrite(block_dev_desc_t *dev_desc, lbaint_t start,
+			 lbaint_t blkcnt, const void *buffer)
+{
+	struct block_cache_node *node, *tmp;
+	unsigned long blksz = dev_desc->blksz;
+	lbaint_t first, last;
+	unsigned long n;
+
+	n = dev_desc->block_write(dev_desc->dev, start, blkcnt, buffer);
+
+	/* Refresh or drop every entry overlapping the written range */
+	list_for_each_entry_safe(node, tmp, &block_cache, lh) {
+		if (node->if_type != dev_desc->if_type ||
+		    node->dev != dev_desc->dev)
+			continue;
+		first = max(node->start, start);
+		last = min(node->start + node->blkcnt, start + blkcnt);
+		if (first >= last)
+			continue;
+		if (n != blkcnt || node->blksz != blksz) {
+			blkcache_free_node(node);
+			continue;
+		}
+		memcpy(node->cache + (first - node->start) * blksz,
+		       (const char *)buffer + (first - start) * blksz,
+		       (last - first) * blksz);
+	}
+
+	return n;
+}
+
+void blkcache_invalidate(int if_type, int dev)
+{
+	struct block_cache_node *node, *tmp;
+
+	list_for_each_entry_safe(node, tmp, &block_cache, lh) {
+		if (node->if_type == if_type && node->dev == dev)
+			blkcache_free_node(node);
+	}
+}
+
+void blkcache_configure(unsigned blocks, unsigned entries)
+{
+	struct block_cache_node *node, *tmp;
+
+	list_for_each_entry_safe(node, tmp, &block_cache, lh)
+		blkcache_free_node(node);
+
+	memset(&_stats, '\0', sizeof(_stats));
+	_stats.max_blocks_per_entry = blocks;
+	_stats.max_entries = entries;
+}
+
+void blkcache_stats(struct block_cache_stats *stats)
+{
+	memcpy(stats, &_stats, sizeof(*stats));
+}
@@ -65,6 +65,7 @@ int host_dev_bind(int dev, char *filename)
 
 	if (!host_dev)
 		return -1;
+	blkcache_invalidate(IF_TYPE_HOST, dev);
 	if (host_dev->blk_dev.priv) {
 		os_close(host_dev->fd);
 		host_dev->blk_dev.priv = NULL;
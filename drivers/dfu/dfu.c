@@ -16,6 +16,7 @@
 #include <hash.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
+#include <div64.h>
 
 static bool dfu_reset_request;
 static LIST_HEAD(dfu_list);
@@ -118,50 +119,208 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+/*
+ * For a download the buffer is split into a ring of
+ * CONFIG_SYS_DFU_BUF_COUNT parts. Data from the host fills one part while
+ * the full ones wait to be written to the medium, which dfu_write_pending()
+ * does one part at a time between USB requests. The host only has to wait
+ * for the medium when all the parts are full.
+ */
+/* Parts hold whole USB transfers of up to this size */
+#define DFU_PART_ALIGN		4096
+
+struct dfu_part {
+	u8 *start;
+	long len;		/* bytes waiting to be written */
+};
+
+static struct dfu_part dfu_parts[CONFIG_SYS_DFU_BUF_COUNT];
+static unsigned long dfu_part_size;
+static int dfu_fill_part;		/* the part being filled */
+static int dfu_nr_queued;		/* full parts before it */
+static struct dfu_entity *dfu_queued_entity;
+static int dfu_write_err;
+
+/* Time spent in each phase of a download, in ms */
+static struct {
+	ulong start;
+	ulong write;		/* writing to the medium */
+	ulong stall;		/* of which the host had to wait */
+	ulong hash;
+	ulong flush;
+	u64 bytes;
+} dfu_stats;
+
+unsigned long dfu_get_buf_part_size(void)
 {
-	long w_size;
-	int ret;
+	return dfu_part_size ? dfu_part_size : dfu_buf_size;
+}
 
-	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
-		return 0;
+static void dfu_init_parts(struct dfu_entity *dfu)
+{
+	int i;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+	/* the parts take whole USB transfers */
+	dfu_part_size = dfu_buf_size / CONFIG_SYS_DFU_BUF_COUNT;
+	if (dfu_part_size > DFU_PART_ALIGN)
+		dfu_part_size &= ~(DFU_PART_ALIGN - 1);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
+	for (i = 0; i < CONFIG_SYS_DFU_BUF_COUNT; i++) {
+		dfu_parts[i].start = dfu_buf + i * dfu_part_size;
+		dfu_parts[i].len = 0;
+	}
+	dfu_fill_part = 0;
+	dfu_nr_queued = 0;
+	dfu_queued_entity = dfu;
+	dfu_write_err = 0;
 
-	/* point back */
+	dfu->i_buf_start = dfu_parts[0].start;
+	dfu->i_buf_end = dfu->i_buf_start + dfu_part_size;
 	dfu->i_buf = dfu->i_buf_start;
+}
+
+static int dfu_write_medium(struct dfu_entity *dfu, void *buf, long len)
+{
+	ulong start = get_timer(0);
+	long w_size = len;
+	int ret;
+
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
+	if (ret)
+		debug("%s: Write error!\n", __func__);
 
 	/* update offset */
 	dfu->offset += w_size;
+	dfu_stats.write += get_timer(start);
 
 	puts("#");
 
 	return ret;
 }
 
+/* Write the oldest full part to the medium */
+static int dfu_write_queued(struct dfu_entity *dfu)
+{
+	struct dfu_part *part;
+	int ret;
+
+	part = &dfu_parts[(dfu_fill_part + CONFIG_SYS_DFU_BUF_COUNT -
+			   dfu_nr_queued) % CONFIG_SYS_DFU_BUF_COUNT];
+	ret = dfu_write_medium(dfu, part->start, part->len);
+	part->len = 0;
+	dfu_nr_queued--;
+
+	if (ret && !dfu_write_err)
+		dfu_write_err = ret;
+
+	return ret;
+}
+
+/* Queue the part being filled for writing and move on to the next one */
+static int dfu_queue_part(struct dfu_entity *dfu)
+{
+	struct dfu_part *part = &dfu_parts[dfu_fill_part];
+	ulong start;
+	int ret = 0;
+
+	part->len = dfu->i_buf - dfu->i_buf_start;
+	if (part->len == 0)
+		return 0;
+
+	dfu_nr_queued++;
+	dfu_fill_part = (dfu_fill_part + 1) % CONFIG_SYS_DFU_BUF_COUNT;
+
+	/* the next part is still full, so the host has to wait for it */
+	if (dfu_nr_queued == CONFIG_SYS_DFU_BUF_COUNT) {
+		start = get_timer(0);
+		ret = dfu_write_queued(dfu);
+		dfu_stats.stall += get_timer(start);
+	}
+
+	part = &dfu_parts[dfu_fill_part];
+	dfu->i_buf_start = part->start;
+	dfu->i_buf_end = part->start + dfu_part_size;
+	dfu->i_buf = dfu->i_buf_start;
+
+	return ret;
+}
+
+/* Write everything received so far to the medium */
+static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+{
+	dfu_queue_part(dfu);
+	while (dfu_nr_queued)
+		dfu_write_queued(dfu);
+
+	return dfu_write_err;
+}
+
+/* Forget the parts, so that only dfu_init_parts() can queue any again */
+static void dfu_clear_parts(void)
+{
+	dfu_part_size = 0;
+	dfu_fill_part = 0;
+	dfu_nr_queued = 0;
+	dfu_queued_entity = NULL;
+}
+
+/* Drop a download that did not finish, without writing what is queued */
+void dfu_abort(void)
+{
+	if (dfu_queued_entity)
+		dfu_queued_entity->inited = 0;
+	dfu_clear_parts();
+}
+
+int dfu_write_pending(void)
+{
+	if (!dfu_nr_queued || !dfu_queued_entity)
+		return 0;
+
+	dfu_write_queued(dfu_queued_entity);
+
+	return 1;
+}
+
+static ulong dfu_kib_per_sec(u64 bytes, ulong ms)
+{
+	return ms ? (ulong)lldiv(bytes * 1000, ms * 1024) : 0;
+}
+
+static void dfu_show_stats(void)
+{
+	ulong total = get_timer(dfu_stats.start);
+
+	printf("\nDFU: %llu bytes in %lu ms (%lu KiB/s), written in %lu ms "
+	       "(%lu KiB/s)\n", dfu_stats.bytes, total,
+	       dfu_kib_per_sec(dfu_stats.bytes, total), dfu_stats.write,
+	       dfu_kib_per_sec(dfu_stats.bytes, dfu_stats.write));
+	printf("DFU: host waited %lu ms for writes, hash %lu ms, flush %lu ms\n",
+	       dfu_stats.stall, dfu_stats.hash, dfu_stats.flush);
+}
+
 int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	ulong start;
 	int ret = 0;
 
 	ret = dfu_write_buffer_drain(dfu);
 	if (ret)
 		return ret;
 
-	if (dfu->flush_medium)
+	if (dfu->flush_medium) {
+		start = get_timer(0);
 		ret = dfu->flush_medium(dfu);
+		dfu_stats.flush = get_timer(start);
+	}
 
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
 
+	if (dfu_stats.bytes)
+		dfu_show_stats();
+
 	/* clear everything */
 	dfu_free_buf();
 	dfu->crc = 0;
@@ -171,12 +330,14 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	dfu->i_buf_end = dfu_buf;
 	dfu->i_buf = dfu->i_buf_start;
 	dfu->inited = 0;
+	dfu_clear_parts();
 
 	return ret;
 }
 
 int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
+	ulong start;
 	int ret = 0;
 	int tret;
 
@@ -190,11 +351,11 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		dfu->offset = 0;
 		dfu->bad_skip = 0;
 		dfu->i_blk_seq_num = 0;
-		dfu->i_buf_start = dfu_get_buf();
-		if (dfu->i_buf_start == NULL)
+		if (dfu_get_buf() == NULL)
 			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf() + dfu_buf_size;
-		dfu->i_buf = dfu->i_buf_start;
+		dfu_init_parts(dfu);
+		memset(&dfu_stats, 0, sizeof(dfu_stats));
+		dfu_stats.start = get_timer(0);
 
 		dfu->inited = 1;
 	}
@@ -221,31 +382,40 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
-	/* flush buffer if overflow */
-	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		tret = dfu_write_buffer_drain(dfu);
-		if (ret == 0)
-			ret = tret;
+	/* hash the data as it arrives */
+	if (dfu_hash_algo && size) {
+		start = get_timer(0);
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc, buf,
+					   size, 0);
+		dfu_stats.hash += get_timer(start);
 	}
+	dfu_stats.bytes += size;
 
-	/* we should be in buffer now (if not then size too large) */
+	/* a block larger than a part (thor) is written straight from buf */
+	if (size > dfu_part_size) {
+		ret = dfu_write_buffer_drain(dfu);
+		tret = dfu_write_medium(dfu, buf, size);
+		return ret ? ret : tret;
+	}
+
+	/* queue the part if this would overflow it */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		error("Buffer overflow! (0x%p + 0x%x > 0x%p)\n", dfu->i_buf,
-		      size, dfu->i_buf_end);
-		return -1;
+		tret = dfu_queue_part(dfu);
+		if (ret == 0)
+			ret = tret;
 	}
 
 	memcpy(dfu->i_buf, buf, size);
 	dfu->i_buf += size;
 
-	/* if end or if buffer full flush */
+	/* if end or if the part is full queue it */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		tret = dfu_write_buffer_drain(dfu);
+		tret = dfu_queue_part(dfu);
 		if (ret == 0)
 			ret = tret;
 	}
 
-	return ret;
+	return ret ? ret : dfu_write_err;
 }
 
 static int dfu_read_buffer_fill(struct dfu_entity *dfu, void *buf, int size)
@@ -405,6 +575,8 @@ void dfu_free_entities(void)
 {
 	struct dfu_entity *dfu, *p, *t = NULL;
 
+	dfu_abort();
+	dfu_free_buf();
 	list_for_each_entry_safe_reverse(dfu, p, &dfu_list, list) {
 		list_del(&dfu->list);
 		t = dfu;
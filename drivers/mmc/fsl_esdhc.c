@@ -592,7 +592,11 @@ int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg)
 		return -1;
 	}
 
-	cfg->cfg.host_caps = MMC_MODE_4BIT | MMC_MODE_8BIT | MMC_MODE_HC;
+	cfg->cfg.host_caps = MMC_MODE_4BIT | MMC_MODE_8BIT | MMC_MODE_HC |
+			     MMC_MODE_BUSY_WAIT;
+#ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
+	cfg->cfg.host_caps |= MMC_MODE_AUTO_CMD12;
+#endif
 
 	if (cfg->max_bus_width > 0) {
 		if (cfg->max_bus_width < 8)
@@ -107,6 +107,20 @@ int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	return ret;
 }
 
+int mmc_set_blockcount(struct mmc *mmc, unsigned int blockcount,
+		       bool is_rel_write)
+{
+	struct mmc_cmd cmd = {0};
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = blockcount & 0x0000FFFF;
+	if (is_rel_write)
+		cmd.cmdarg |= 1 << 31;
+	cmd.resp_type = MMC_RSP_R1;
+
+	return mmc_send_cmd(mmc, &cmd, NULL);
+}
+
 int mmc_send_status(struct mmc *mmc, int timeout)
 {
 	struct mmc_cmd cmd;
@@ -195,6 +209,10 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
+	int closed = mmc->set_block_count && blkcnt > 1 && blkcnt <= 0xffff;
+
+	if (closed && mmc_set_blockcount(mmc, blkcnt, false))
+		return 0;
 
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -216,7 +234,7 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
 
-	if (blkcnt > 1) {
+	if (blkcnt > 1 && !closed) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -228,12 +246,16 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 		}
 	}
 
+	mmc->stats.rd_cmds++;
+	mmc->stats.rd_blks += blkcnt;
+
 	return blkcnt;
 }
 
 static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
+	ulong start_us;
 
 	if (blkcnt == 0)
 		return 0;
@@ -253,6 +275,7 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len))
 		return 0;
 
+	start_us = timer_get_us();
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
@@ -262,6 +285,7 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 		start += cur;
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
+	mmc->stats.rd_us += timer_get_us() - start_us;
 
 	return blkcnt;
 }
@@ -599,6 +623,9 @@ int mmc_switch_part(int dev_num, unsigned int part_num)
 	if (ret)
 		return ret;
 
+	/* The same device number now addresses different blocks */
+	blkcache_invalidate(IF_TYPE_MMC, dev_num);
+
 	return mmc_set_capacity(mmc, part_num);
 }
 
@@ -963,7 +990,25 @@ static int mmc_startup(struct mmc *mmc)
 	 * For SD, its erase group is always one sector
 	 */
 	mmc->erase_grp_size = 1;
+	mmc->write_grp_size = 1;
 	mmc->part_config = MMCPART_NOAVAILABLE;
+
+	/*
+	 * SD cards erase write blocks, so trim and discard are plain erases.
+	 * They are given 250ms per block, MMC cards a second per group
+	 * unless EXT_CSD says otherwise.
+	 */
+	mmc->erase_types = 1 << BLK_ERASE;
+	mmc->sec_erase_mult = 1;
+	if (IS_SD(mmc)) {
+		mmc->erase_types |= 1 << BLK_ERASE_TRIM |
+				    1 << BLK_ERASE_DISCARD;
+		mmc->erase_timeout = 250;
+	} else {
+		mmc->erase_timeout = 1000;
+	}
+	mmc->trim_timeout = mmc->erase_timeout;
+
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
 		err = mmc_send_ext_csd(mmc, ext_csd);
@@ -1013,10 +1058,12 @@ static int mmc_startup(struct mmc *mmc)
 			if (err)
 				return err;
 
-			/* Read out group size from ext_csd */
+			/* Read out group size from ext_csd, in 512KiB units */
 			mmc->erase_grp_size =
-				ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] *
-					MMC_MAX_BLOCK_LEN * 1024;
+				ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] * 1024;
+			if (ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT])
+				mmc->erase_timeout = 300 *
+					ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT];
 		} else {
 			/* Calculate the group size from the csd value. */
 			int erase_gsz, erase_gmul;
@@ -1026,6 +1073,33 @@ static int mmc_startup(struct mmc *mmc)
 				* (erase_gmul + 1);
 		}
 
+		/*
+		 * Writes of whole high-capacity erase groups spare the card
+		 * merging partly written ones, whatever ERASE_GROUP_DEF says
+		 */
+		if (ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE])
+			mmc->write_grp_size =
+				ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] * 1024;
+		else
+			mmc->write_grp_size = mmc->erase_grp_size;
+
+		if (ext_csd[EXT_CSD_REV] >= 4) {
+			u8 sec = ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT];
+
+			if (sec & EXT_CSD_SEC_GB_CL_EN)
+				mmc->erase_types |= 1 << BLK_ERASE_TRIM;
+			if (ext_csd[EXT_CSD_TRIM_MULT])
+				mmc->trim_timeout = 300 *
+					ext_csd[EXT_CSD_TRIM_MULT];
+			if (sec & EXT_CSD_SEC_ER_EN)
+				mmc->erase_types |= 1 << BLK_ERASE_SECURE;
+			if (ext_csd[EXT_CSD_SEC_ERASE_MULT])
+				mmc->sec_erase_mult =
+					ext_csd[EXT_CSD_SEC_ERASE_MULT];
+		}
+		if (ext_csd[EXT_CSD_REV] >= 6)
+			mmc->erase_types |= 1 << BLK_ERASE_DISCARD;
+
 		/* store the partition info of emmc */
 		if ((ext_csd[EXT_CSD_PARTITIONING_SUPPORT] & PART_SUPPORT) ||
 		    ext_csd[EXT_CSD_BOOT_MULT])
@@ -1060,6 +1134,17 @@ static int mmc_startup(struct mmc *mmc)
 	/* Restrict card's capabilities by what the host can do */
 	mmc->card_caps &= mmc->cfg->host_caps;
 
+	/*
+	 * Announce the length of multi-block transfers with CMD23, so that
+	 * they end without CMD12, unless the host sends CMD12 by itself
+	 */
+	if (IS_SD(mmc))
+		mmc->set_block_count = !!(mmc->scr[0] & SD_SCR_CMD23_SUPPORT);
+	else
+		mmc->set_block_count = mmc->version >= MMC_VERSION_3;
+	if (mmc_host_is_spi(mmc) || (mmc->cfg->host_caps & MMC_MODE_AUTO_CMD12))
+		mmc->set_block_count = 0;
+
 	if (IS_SD(mmc)) {
 		if (mmc->card_caps & MMC_MODE_4BIT) {
 			cmd.cmdidx = MMC_CMD_APP_CMD;
@@ -1361,6 +1446,7 @@ int mmc_init(struct mmc *mmc)
 
 	if (!err || err == IN_PROGRESS)
 		err = mmc_complete_init(mmc);
+	blkcache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
 	debug("%s: %d, time %lu\n", __func__, err, get_timer(start));
 	return err;
 }
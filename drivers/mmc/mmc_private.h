@@ -16,10 +16,13 @@ extern int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 			struct mmc_data *data);
 extern int mmc_send_status(struct mmc *mmc, int timeout);
 extern int mmc_set_blocklen(struct mmc *mmc, int len);
+extern int mmc_set_blockcount(struct mmc *mmc, unsigned int blockcount,
+			      bool is_rel_write);
 
 #ifndef CONFIG_SPL_BUILD
 
-extern unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt);
+extern unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt,
+				int type);
 
 extern ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
 		const void *src);
@@ -29,7 +32,7 @@ extern ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
 /* SPL will never write or erase, declare dummies to reduce code size. */
 
 static inline unsigned long mmc_berase(int dev_num, lbaint_t start,
-		lbaint_t blkcnt)
+		lbaint_t blkcnt, int type)
 {
 	return 0;
 }
@@ -12,7 +12,8 @@
 #include <part.h>
 #include "mmc_private.h"
 
-static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
+static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt,
+			 u32 arg)
 {
 	struct mmc_cmd cmd;
 	ulong end;
@@ -48,9 +49,14 @@ static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
 	if (err)
 		goto err_out;
 
+	/*
+	 * Erasing may keep the card busy far longer than hosts wait for
+	 * the end of busy, so the caller polls the status instead. The
+	 * card keeps the bus busy in SPI mode.
+	 */
 	cmd.cmdidx = MMC_CMD_ERASE;
-	cmd.cmdarg = SECURE_ERASE;
-	cmd.resp_type = MMC_RSP_R1b;
+	cmd.cmdarg = arg;
+	cmd.resp_type = mmc_host_is_spi(mmc) ? MMC_RSP_R1b : MMC_RSP_R1;
 
 	err = mmc_send_cmd(mmc, &cmd, NULL);
 	if (err)
@@ -63,47 +69,121 @@ err_out:
 	return err;
 }
 
-unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt)
+/* Longest the card may take to erase the blocks with @arg, in ms */
+static int mmc_erase_timeout(struct mmc *mmc, lbaint_t start,
+			     lbaint_t blkcnt, u32 arg)
+{
+	lbaint_t groups = (start + blkcnt - 1) / mmc->erase_grp_size -
+			  start / mmc->erase_grp_size + 1;
+	u64 timeout;
+
+	if (arg & MMC_TRIM_ARG)
+		timeout = (u64)groups * mmc->trim_timeout;
+	else
+		timeout = (u64)groups * mmc->erase_timeout;
+	if (arg & SECURE_ERASE)
+		timeout *= mmc->sec_erase_mult;
+
+	return timeout > 0x7fffffff ? 0x7fffffff : (int)timeout;
+}
+
+/* Erase a range of blocks with one erase command */
+static int mmc_erase_range(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			   u32 arg)
+{
+	int err;
+
+	if (!blkcnt)
+		return 0;
+
+	err = mmc_erase_t(mmc, start, blkcnt, arg);
+	if (err)
+		return err;
+
+	/* Waiting for the ready status */
+	return mmc_send_status(mmc, mmc_erase_timeout(mmc, start, blkcnt,
+							arg));
+}
+
+unsigned long mmc_berase(int dev_num, lbaint_t start, lbaint_t blkcnt,
+			 int type)
 {
-	int err = 0;
 	struct mmc *mmc = find_mmc_device(dev_num);
-	lbaint_t blk = 0, blk_r = 0;
-	int timeout = 1000;
+	lbaint_t grp, head, tail;
+	u32 arg;
 
 	if (!mmc)
 		return -1;
 
-	if ((start % mmc->erase_grp_size) || (blkcnt % mmc->erase_grp_size))
-		printf("\n\nCaution! Your devices Erase group is 0x%x\n"
-		       "The erase range would be change to "
-		       "0x" LBAF "~0x" LBAF "\n\n",
-		       mmc->erase_grp_size, start & ~(mmc->erase_grp_size - 1),
-		       ((start + blkcnt + mmc->erase_grp_size)
-		       & ~(mmc->erase_grp_size - 1)) - 1);
-
-	while (blk < blkcnt) {
-		blk_r = ((blkcnt - blk) > mmc->erase_grp_size) ?
-			mmc->erase_grp_size : (blkcnt - blk);
-		err = mmc_erase_t(mmc, start + blk, blk_r);
-		if (err)
-			break;
-
-		blk += blk_r;
-
-		/* Waiting for the ready status */
-		if (mmc_send_status(mmc, timeout))
+	if (!(mmc->erase_types & (1 << type))) {
+		printf("MMC: erase type %d is not supported by the card\n",
+		       type);
+		return 0;
+	}
+
+	/* SD cards only have the plain erase, which is per write block */
+	if (IS_SD(mmc))
+		type = BLK_ERASE;
+
+	switch (type) {
+	case BLK_ERASE_TRIM:
+		arg = MMC_TRIM_ARG;
+		break;
+	case BLK_ERASE_DISCARD:
+		arg = MMC_DISCARD_ARG;
+		break;
+	case BLK_ERASE_SECURE:
+		arg = SECURE_ERASE;
+		break;
+	default:
+		arg = MMC_ERASE_ARG;
+		break;
+	}
+
+	if (!blkcnt)
+		return 0;
+
+	/*
+	 * Erase the whole range with one command. A plain erase covers the
+	 * erase groups the range touches, so blocks in partly covered
+	 * groups are trimmed instead if the card can.
+	 */
+	grp = mmc->erase_grp_size;
+	head = (grp - start % grp) % grp;
+	tail = (start + blkcnt) % grp;
+	if (arg & MMC_TRIM_ARG || !(head || tail))
+		return mmc_erase_range(mmc, start, blkcnt, arg) ? 0 : blkcnt;
+
+	if (arg == MMC_ERASE_ARG &&
+	    (mmc->erase_types & (1 << BLK_ERASE_TRIM))) {
+		if (head >= blkcnt)
+			return mmc_erase_range(mmc, start, blkcnt,
+					       MMC_TRIM_ARG) ? 0 : blkcnt;
+		if (mmc_erase_range(mmc, start, head, MMC_TRIM_ARG) ||
+		    mmc_erase_range(mmc, start + head, blkcnt - head - tail,
+				    arg) ||
+		    mmc_erase_range(mmc, start + blkcnt - tail, tail,
+				    MMC_TRIM_ARG))
 			return 0;
+		return blkcnt;
 	}
 
-	return blk;
+	printf("\n\nCaution! Your devices Erase group is 0x%x\n"
+	       "The erase range would be change to "
+	       "0x" LBAF "~0x" LBAF "\n\n",
+	       mmc->erase_grp_size, start - start % grp,
+	       start + blkcnt + (tail ? grp - tail : 0) - 1);
+
+	return mmc_erase_range(mmc, start, blkcnt, arg) ? 0 : blkcnt;
 }
 
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
-		lbaint_t blkcnt, const void *src)
+		lbaint_t blkcnt, const void *src, int wait)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int timeout = 1000;
+	int closed = mmc->set_block_count && blkcnt > 1 && blkcnt <= 0xffff;
 
 	if ((start + blkcnt) > mmc->block_dev.lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
@@ -130,6 +210,11 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	data.blocksize = mmc->write_bl_len;
 	data.flags = MMC_DATA_WRITE;
 
+	if (closed && mmc_set_blockcount(mmc, blkcnt, false)) {
+		printf("mmc fail to set block count\n");
+		return 0;
+	}
+
 	if (mmc_send_cmd(mmc, &cmd, &data)) {
 		printf("mmc write failed\n");
 		return 0;
@@ -138,7 +223,7 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	/* SPI multiblock writes terminate using a special
 	 * token, not a STOP_TRANSMISSION request.
 	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
+	if (!mmc_host_is_spi(mmc) && blkcnt > 1 && !closed) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -149,15 +234,41 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	}
 
 	/* Waiting for the ready status */
-	if (mmc_send_status(mmc, timeout))
+	if (wait && mmc_send_status(mmc, timeout))
 		return 0;
 
+	mmc->stats.wr_cmds++;
+	mmc->stats.wr_blks += blkcnt;
+
 	return blkcnt;
 }
 
+/*
+ * Blocks to write with the next command: as many as the host takes, but
+ * ending on a write group boundary unless it is the last command, so that
+ * the card is written in whole groups
+ */
+static lbaint_t mmc_write_chunk(struct mmc *mmc, lbaint_t start,
+				lbaint_t blkcnt)
+{
+	lbaint_t cur = min(blkcnt, (lbaint_t)mmc->cfg->b_max);
+	lbaint_t over;
+
+	if (cur == blkcnt || mmc->write_grp_size <= 1)
+		return cur;
+
+	over = (start + cur) % mmc->write_grp_size;
+	if (over < cur)
+		cur -= over;
+
+	return cur;
+}
+
 ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
+	ulong start_us;
+	int wait;
 
 	struct mmc *mmc = find_mmc_device(dev_num);
 	if (!mmc)
@@ -166,15 +277,22 @@ ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt, const void *src)
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
+	start_us = timer_get_us();
 	do {
-		cur = (blocks_todo > mmc->cfg->b_max) ?
-			mmc->cfg->b_max : blocks_todo;
-		if (mmc_write_blocks(mmc, start, cur, src) != cur)
+		cur = mmc_write_chunk(mmc, start, blocks_todo);
+		/*
+		 * A host that waits for the card to finish programming
+		 * before the next command needs no status poll in between
+		 */
+		wait = cur == blocks_todo ||
+		       !(mmc->cfg->host_caps & MMC_MODE_BUSY_WAIT);
+		if (mmc_write_blocks(mmc, start, cur, src, wait) != cur)
 			return 0;
 		blocks_todo -= cur;
 		start += cur;
 		src += cur * mmc->write_bl_len;
 	} while (blocks_todo > 0);
+	mmc->stats.wr_us += timer_get_us() - start_us;
 
 	return blkcnt;
 }
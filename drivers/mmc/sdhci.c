@@ -63,6 +63,93 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	}
 }
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+/*
+ * Describe the whole data buffer in the ADMA2 descriptor table, so that
+ * the transfer runs without the restart SDMA needs at every boundary.
+ * A buffer the descriptors can't address is transferred by PIO.
+ */
+static int sdhci_adma_prepare(struct sdhci_host *host, struct mmc_data *data,
+			      unsigned int trans_bytes)
+{
+	int adma64 = host->adma_desc_size == SDHCI_ADMA64_DESC_SIZE;
+	struct sdhci_adma_desc *desc;
+	u8 *p = host->adma_table;
+	unsigned int len;
+	ulong addr;
+	u8 ctrl;
+
+	if (data->flags == MMC_DATA_READ)
+		addr = (ulong)data->dest;
+	else
+		addr = (ulong)data->src;
+
+	if ((addr & (adma64 ? 7 : 3)) ||
+	    trans_bytes > host->adma_descs * SDHCI_ADMA_MAX_LEN)
+		return -1;
+
+	/* 32-bit descriptors reach neither buffer nor table above 4GiB */
+	if (!adma64 && ((u64)addr + trans_bytes > 0x100000000ULL ||
+			(u64)(ulong)host->adma_table >= 0x100000000ULL))
+		return -1;
+
+	flush_cache(addr, trans_bytes);
+	while (trans_bytes) {
+		len = min(trans_bytes, (unsigned int)SDHCI_ADMA_MAX_LEN);
+		trans_bytes -= len;
+
+		desc = (struct sdhci_adma_desc *)p;
+		desc->attr = cpu_to_le16(SDHCI_ADMA_VALID | SDHCI_ADMA_TRAN |
+					 (trans_bytes ? 0 : SDHCI_ADMA_END));
+		desc->len = cpu_to_le16(len & 0xffff);
+		desc->addr_lo = cpu_to_le32((u32)addr);
+		if (adma64)
+			desc->addr_hi = cpu_to_le32((u64)addr >> 32);
+
+		addr += len;
+		p += host->adma_desc_size;
+	}
+	flush_cache((ulong)host->adma_table,
+		    roundup(p - (u8 *)host->adma_table, ARCH_DMA_MINALIGN));
+
+	addr = (ulong)host->adma_table;
+	sdhci_writel(host, (u32)addr, SDHCI_ADMA_ADDRESS);
+	if (adma64)
+		sdhci_writel(host, (u64)addr >> 32, SDHCI_ADMA_ADDRESS_HI);
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= adma64 ? SDHCI_CTRL_ADMA64 : SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	return 0;
+}
+
+/* The table holds descriptors for the largest transfer, b_max blocks */
+static int sdhci_adma_init(struct sdhci_host *host, unsigned int caps)
+{
+	ulong size;
+
+	/* Buffers may be above 4GiB only if pointers are 64 bits wide */
+	if ((caps & SDHCI_CAN_64BIT) && sizeof(ulong) > 4)
+		host->adma_desc_size = SDHCI_ADMA64_DESC_SIZE;
+	else
+		host->adma_desc_size = SDHCI_ADMA32_DESC_SIZE;
+
+	host->adma_descs = DIV_ROUND_UP(host->cfg.b_max * MMC_MAX_BLOCK_LEN,
+					SDHCI_ADMA_MAX_LEN);
+	size = roundup(host->adma_descs * host->adma_desc_size,
+		       ARCH_DMA_MINALIGN);
+	host->adma_table = memalign(ARCH_DMA_MINALIGN, size);
+	if (!host->adma_table) {
+		printf("%s: ADMA table alloc failed!!!\n", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
 static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 				unsigned int start_addr)
 {
@@ -82,6 +169,12 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 		if (stat & SDHCI_INT_ERROR) {
 			printf("%s: Error detected in status(0x%X)!\n",
 			       __func__, stat);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+			if (stat & SDHCI_INT_ADMA_ERROR)
+				printf("%s: ADMA error status(0x%X)\n",
+				       __func__,
+				       sdhci_readb(host, SDHCI_ADMA_ERROR));
+#endif
 			return -1;
 		}
 		if (stat & rdy) {
@@ -99,6 +192,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 			start_addr &= ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1);
 			start_addr += SDHCI_DEFAULT_BOUNDARY_SIZE;
 			sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
+			host->mmc->stats.dma_restarts++;
 		}
 #endif
 		if (timeout-- > 0)
@@ -207,6 +301,10 @@ int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 
 		sdhci_writel(host, start_addr, SDHCI_DMA_ADDRESS);
 		mode |= SDHCI_TRNS_DMA;
+#endif
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (!sdhci_adma_prepare(host, data, trans_bytes))
+			mode |= SDHCI_TRNS_DMA;
 #endif
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
 				data->blocksize),
@@ -452,6 +550,13 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 		return -1;
 	}
 #endif
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
+		printf("%s: Your controller doesn't support ADMA2!!\n",
+		       __func__);
+		return -1;
+	}
+#endif
 
 	if (max_clk)
 		host->cfg.f_max = max_clk;
@@ -492,6 +597,8 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 		host->cfg.voltages |= host->voltages;
 
 	host->cfg.host_caps = MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	/* Commands wait for SDHCI_DATA_INHIBIT, which covers write busy */
+	host->cfg.host_caps |= MMC_MODE_BUSY_WAIT;
 	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
 		if (caps & SDHCI_CAN_DO_8BIT)
 			host->cfg.host_caps |= MMC_MODE_8BIT;
@@ -500,6 +607,10 @@ int add_sdhci(struct sdhci_host *host, u32 max_clk, u32 min_clk)
 		host->cfg.host_caps |= host->host_caps;
 
 	host->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (sdhci_adma_init(host, caps))
+		return -1;
+#endif
 
 	sdhci_reset(host, SDHCI_RESET_ALL);
 
@@ -488,6 +488,8 @@ int sunxi_mmc_init(int sdc_no)
 	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
 	cfg->host_caps = MMC_MODE_4BIT;
 	cfg->host_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
+	/* multi-block transfers end with SUNXI_MMC_CMD_AUTO_STOP */
+	cfg->host_caps |= MMC_MODE_AUTO_CMD12;
 	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
 	cfg->f_min = 400000;
@@ -1231,7 +1231,10 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 			    struct mtd_oob_ops *ops)
 {
 	int chipnr, page, realpage, col, bytes, aligned, oob_required;
+	int cache_seq = 0, cache_next;
 	struct nand_chip *chip = mtd->priv;
+	struct nand_read_stats *rstats = chip->read_stats;
+	ulong start = rstats ? timer_get_us() : 0;
 	struct mtd_ecc_stats stats;
 	int ret = 0;
 	uint32_t readlen = ops->len;
@@ -1266,7 +1269,33 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		if (realpage != chip->pagebuf || oob) {
 			bufpoi = aligned ? buf : chip->buffers->databuf;
 
-			chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+			/*
+			 * With read cache the chip reads the next page from
+			 * its array while this one is read out, if the next
+			 * one is wanted whole and is on this chip
+			 */
+			cache_next = NAND_HAS_CACHERD(chip) && aligned &&
+				ops->mode != MTD_OPS_RAW &&
+				readlen - bytes >= mtd->writesize &&
+				((page + 1) & chip->pagemask) &&
+				realpage + 1 != chip->pagebuf;
+			if (cache_seq) {
+				chip->cmdfunc(mtd, cache_next ?
+					      NAND_CMD_READCACHESEQ :
+					      NAND_CMD_READCACHEEND, -1, -1);
+			} else {
+				chip->cmdfunc(mtd, NAND_CMD_READ0, 0x00, page);
+				if (cache_next)
+					chip->cmdfunc(mtd,
+						      NAND_CMD_READCACHESEQ,
+						      -1, -1);
+			}
+			if (rstats) {
+				rstats->pages++;
+				if (cache_seq)
+					rstats->cache_pages++;
+			}
+			cache_seq = cache_next;
 
 			/*
 			 * Now read the page into the buffer.  Absent an error,
@@ -1343,10 +1372,19 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		}
 	}
 
+	/* Leave read cache mode if a read failed part way */
+	if (cache_seq)
+		chip->cmdfunc(mtd, NAND_CMD_READCACHEEND, -1, -1);
+
 	ops->retlen = ops->len - (size_t) readlen;
 	if (oob)
 		ops->oobretlen = ops->ooblen - oobreadlen;
 
+	if (rstats) {
+		rstats->bytes += ops->retlen;
+		rstats->us += timer_get_us() - start;
+	}
+
 	if (ret)
 		return ret;
 
@@ -2639,6 +2677,8 @@ static int nand_flash_detect_onfi(struct mtd_info *mtd, struct nand_chip *chip,
 	*busw = 0;
 	if (le16_to_cpu(p->features) & 1)
 		*busw = NAND_BUSWIDTH_16;
+	if (le16_to_cpu(p->opt_cmd) & ONFI_OPT_CMD_READ_CACHE)
+		chip->options |= NAND_CACHERD;
 
 	pr_info("ONFI flash detected\n");
 	return 1;
@@ -3358,6 +3398,15 @@ int nand_scan_tail(struct mtd_info *mtd)
 	if ((chip->ecc.mode == NAND_ECC_SOFT) && (chip->page_shift > 9))
 		chip->options |= NAND_SUBPAGE_READ;
 
+	/*
+	 * Read cache needs a cmdfunc that sends its commands, and pages read
+	 * out of the cache register in order without any other command
+	 */
+	if ((chip->cmdfunc != nand_command_lp &&
+	     !(chip->options & NAND_CMDFUNC_CACHERD)) ||
+	    chip->ecc.mode == NAND_ECC_HW_OOB_FIRST)
+		chip->options &= ~NAND_CACHERD;
+
 	/* Fill in remaining MTD driver data */
 	mtd->type = MTD_NANDFLASH;
 	mtd->flags = (chip->options & NAND_ROM) ? MTD_CAP_ROM :
@@ -0,0 +1,863 @@
+/*
+ * Simulate a NAND flash chip in a host file, for sandbox
+ *
+ * Set up with --nand <size>:<pagesize>:<oobsize>:<erasesize>:<file>, with K
+ * or M suffixes on the sizes. The file holds each page followed by its OOB
+ * area, and a file shorter than the chip is padded with erased pages.
+ *
+ * The chip is driven through cmdfunc() and the data bus functions, so that
+ * everything above them in nand_base.c and nand_bbt.c runs as it would on a
+ * board, with software ECC. Programming only clears bits. The chip has an
+ * ONFI parameter page and, if its pages are larger than 512 bytes, the read
+ * cache commands: while one page is read out the next one is read from the
+ * array. Optionally:
+ *
+ * --nand_badblocks <block>,...	Blocks which are marked bad in the file
+ *				and fail erase and program
+ * --nand_bitflips <n>[:<bits>]	Every nth page read has that many bits
+ *				(default 1) flipped in its data
+ * --nand_timing <tR>:<tPROG>:<tBERS>[:<ns>]
+ *				Each page read, page program and block
+ *				erase keeps the chip busy that many us, and
+ *				each byte on the bus takes that many ns
+ * --nand_no_cache_read		The chip has no read cache commands
+ *
+ * The 'nandsim' command shows the number of each operation and the time
+ * the chip spent on them, and can make a block go bad or flip a bit in the
+ * file while running.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <exports.h>
+#include <malloc.h>
+#include <nand.h>
+#include <os.h>
+#include <asm/errno.h>
+#include <asm/getopt.h>
+#include <asm/state.h>
+#include <linux/sizes.h>
+
+/* ID bytes of the chip: Toshiba, then a device ID only used here */
+#define NANDSIM_MFR_ID		NAND_MFR_TOSHIBA
+#define NANDSIM_DEV_ID		0x01
+
+/* Smallest wait worth sleeping for, in ns */
+#define NANDSIM_MIN_SLEEP	1000000
+
+enum nandsim_out {
+	NANDSIM_OUT_NONE,
+	NANDSIM_OUT_ID,
+	NANDSIM_OUT_PARAM,
+	NANDSIM_OUT_STATUS,
+	NANDSIM_OUT_DATA,
+};
+
+enum nandsim_cache {
+	NANDSIM_CACHE_OFF,	/* no page is in the page register */
+	NANDSIM_CACHE_READY,	/* a page was read and the next may follow */
+	NANDSIM_CACHE_ON,	/* the next page is being read from the array */
+};
+
+struct nandsim_stats {
+	ulong reads;		/* pages read from the array */
+	ulong cache_reads;	/* of which while the last was read out */
+	ulong programs;		/* pages programmed */
+	ulong erases;		/* blocks erased */
+	ulong bitflips;		/* bits flipped on the way out */
+	uint64_t bytes_out;	/* bytes read over the bus */
+	uint64_t bytes_in;	/* bytes written over the bus */
+	uint64_t read_ns;	/* time spent waiting for each of those */
+	uint64_t prog_ns;
+	uint64_t erase_ns;
+	uint64_t xfer_ns;
+};
+
+static struct nandsim {
+	struct nand_chip chip;
+	struct nand_flash_dev ids[2];
+	struct nand_ecclayout layout;
+	struct nand_onfi_params onfi;
+	int fd;
+
+	/* Geometry */
+	ulong page_size;
+	ulong oob_size;
+	ulong pages_per_block;
+	ulong blocks;
+
+	/* State of the chip */
+	uint8_t *reg;		/* page register, data then OOB */
+	int col;		/* next byte of the register on the bus */
+	int page;		/* page being read or programmed */
+	enum nandsim_cache cache;
+	uint8_t *array_reg;	/* page being read from the array */
+	int array_page;
+	uint64_t array_ready;	/* when array_reg is ready, in ns */
+	int erase_page;		/* first page of the block to erase */
+	uint8_t status;
+	enum nandsim_out out;
+	uint8_t *bad;		/* per block, non-zero if it fails */
+
+	/* Fault injection and timing */
+	ulong flip_every;
+	ulong flip_bits;
+	ulong flip_count;
+	uint32_t seed;
+	ulong t_read_us;
+	ulong t_prog_us;
+	ulong t_erase_us;
+	ulong t_byte_ns;
+	uint64_t busy_until;
+
+	struct nandsim_stats stats;
+} nandsim;
+
+static const char *nandsim_spec;
+static const char *nandsim_badblocks;
+static int nandsim_no_cache_read;
+
+static const uint8_t nandsim_id[] = { NANDSIM_MFR_ID, NANDSIM_DEV_ID };
+
+/* Keep the chip busy for @ns, adding it to @stat */
+static void nandsim_busy(uint64_t ns, uint64_t *stat)
+{
+	uint64_t now;
+
+	*stat += ns;
+	if (!ns)
+		return;
+
+	now = os_get_nsec();
+	if (nandsim.busy_until < now)
+		nandsim.busy_until = now;
+	nandsim.busy_until += ns;
+
+	/* Sleeping has overhead, so let short waits add up first */
+	if (nandsim.busy_until > now + NANDSIM_MIN_SLEEP)
+		os_usleep((nandsim.busy_until - now) / 1000);
+}
+
+static loff_t nandsim_offset(int page)
+{
+	return (loff_t)page * (nandsim.page_size + nandsim.oob_size);
+}
+
+static int nandsim_pread(void *buf, int page)
+{
+	loff_t offs = nandsim_offset(page);
+	ssize_t len = nandsim.page_size + nandsim.oob_size;
+
+	if (os_lseek(nandsim.fd, offs, OS_SEEK_SET) != offs ||
+	    os_read(nandsim.fd, buf, len) != len)
+		return -EIO;
+
+	return 0;
+}
+
+static int nandsim_pwrite(const void *buf, int page)
+{
+	loff_t offs = nandsim_offset(page);
+	ssize_t len = nandsim.page_size + nandsim.oob_size;
+
+	if (os_lseek(nandsim.fd, offs, OS_SEEK_SET) != offs ||
+	    os_write(nandsim.fd, buf, len) != len)
+		return -EIO;
+
+	return 0;
+}
+
+static uint32_t nandsim_random(void)
+{
+	nandsim.seed = nandsim.seed * 1103515245 + 12345;
+
+	return nandsim.seed >> 8;
+}
+
+static int nandsim_page(int page_addr)
+{
+	if (page_addr < 0 ||
+	    page_addr >= nandsim.blocks * nandsim.pages_per_block)
+		return -1;
+
+	return page_addr;
+}
+
+/* Read @page from the array into @buf, flipping bits if asked to */
+static int nandsim_fetch(uint8_t *buf, int page)
+{
+	ulong i, bit;
+
+	if (page < 0 || nandsim_pread(buf, page)) {
+		memset(buf, 0xff, nandsim.page_size + nandsim.oob_size);
+		return -EIO;
+	}
+	nandsim.stats.reads++;
+
+	if (!nandsim.flip_every || ++nandsim.flip_count < nandsim.flip_every)
+		return 0;
+	nandsim.flip_count = 0;
+	for (i = 0; i < nandsim.flip_bits; i++) {
+		bit = nandsim_random() % (nandsim.page_size * 8);
+		buf[bit / 8] ^= 1 << (bit % 8);
+		nandsim.stats.bitflips++;
+	}
+
+	return 0;
+}
+
+/* Load @page into the page register, as the chip does on a read command */
+static void nandsim_load(int page)
+{
+	nandsim.page = page;
+	if (!nandsim_fetch(nandsim.reg, page))
+		nandsim_busy(nandsim.t_read_us * 1000ULL,
+			     &nandsim.stats.read_ns);
+}
+
+/* The time on the chip's clock, which may be ahead of the host's */
+static uint64_t nandsim_now(void)
+{
+	return max(os_get_nsec(), nandsim.busy_until);
+}
+
+/*
+ * Start reading the page after the one in the page register from the
+ * array, which takes tR while the host reads out the page register
+ */
+static void nandsim_cache_start(void)
+{
+	nandsim.array_page = nandsim_page(nandsim.page + 1);
+	if (!nandsim_fetch(nandsim.array_reg, nandsim.array_page))
+		nandsim.stats.cache_reads++;
+	nandsim.array_ready = nandsim_now() + nandsim.t_read_us * 1000ULL;
+}
+
+/* Wait for the array and move its page into the page register */
+static void nandsim_cache_next(void)
+{
+	uint64_t now = nandsim_now();
+	uint8_t *reg = nandsim.reg;
+
+	if (nandsim.array_ready > now)
+		nandsim_busy(nandsim.array_ready - now,
+			     &nandsim.stats.read_ns);
+	nandsim.reg = nandsim.array_reg;
+	nandsim.array_reg = reg;
+	nandsim.page = nandsim.array_page;
+}
+
+static int nandsim_is_erased(const uint8_t *buf, ulong len)
+{
+	while (len--)
+		if (*buf++ != 0xff)
+			return 0;
+
+	return 1;
+}
+
+/* Program the page register into the page given with SEQIN */
+static int nandsim_program(void)
+{
+	ulong len = nandsim.page_size + nandsim.oob_size;
+	int block = nandsim.page / nandsim.pages_per_block;
+	uint8_t *old;
+	ulong i;
+	int ret;
+
+	nandsim.stats.programs++;
+	nandsim_busy(nandsim.t_prog_us * 1000ULL, &nandsim.stats.prog_ns);
+
+	/* A bad block can still take a marker in its OOB area */
+	if (nandsim.page < 0 || (nandsim.bad[block] &&
+	    !nandsim_is_erased(nandsim.reg, nandsim.page_size)))
+		return -EIO;
+
+	old = malloc(len);
+	if (!old)
+		return -ENOMEM;
+	ret = nandsim_pread(old, nandsim.page);
+	for (i = 0; i < len && !ret; i++)
+		old[i] &= nandsim.reg[i];
+	if (!ret)
+		ret = nandsim_pwrite(old, nandsim.page);
+	free(old);
+
+	return ret;
+}
+
+static int nandsim_erase(void)
+{
+	int block = nandsim.erase_page / nandsim.pages_per_block;
+	ulong i;
+	int ret = 0;
+
+	nandsim.stats.erases++;
+	nandsim_busy(nandsim.t_erase_us * 1000ULL, &nandsim.stats.erase_ns);
+
+	if (nandsim.erase_page < 0 || nandsim.bad[block])
+		return -EIO;
+
+	memset(nandsim.reg, 0xff, nandsim.page_size + nandsim.oob_size);
+	for (i = 0; i < nandsim.pages_per_block && !ret; i++)
+		ret = nandsim_pwrite(nandsim.reg, nandsim.erase_page + i);
+
+	return ret;
+}
+
+static void nandsim_cmdfunc(struct mtd_info *mtd, unsigned command,
+			    int column, int page_addr)
+{
+	/* Read cache mode lasts until any other command but these */
+	if (command != NAND_CMD_STATUS && command != NAND_CMD_RNDOUT &&
+	    command != NAND_CMD_READCACHESEQ &&
+	    command != NAND_CMD_READCACHEEND)
+		nandsim.cache = NANDSIM_CACHE_OFF;
+
+	switch (command) {
+	case NAND_CMD_RESET:
+		nandsim.status = NAND_STATUS_READY | NAND_STATUS_WP;
+		nandsim.out = NANDSIM_OUT_NONE;
+		break;
+	case NAND_CMD_READID:
+		/* The ONFI signature is at 0x20 */
+		nandsim.col = column;
+		nandsim.out = NANDSIM_OUT_ID;
+		break;
+	case NAND_CMD_PARAM:
+		nandsim.col = 0;
+		nandsim.out = NANDSIM_OUT_PARAM;
+		break;
+	case NAND_CMD_STATUS:
+		nandsim.out = NANDSIM_OUT_STATUS;
+		break;
+	case NAND_CMD_READ0:
+	case NAND_CMD_READ1:
+	case NAND_CMD_READOOB:
+		nandsim_load(nandsim_page(page_addr));
+		nandsim.col = column;
+		if (command == NAND_CMD_READ1)
+			nandsim.col += 256;
+		else if (command == NAND_CMD_READOOB)
+			nandsim.col += nandsim.page_size;
+		nandsim.out = NANDSIM_OUT_DATA;
+		if (nandsim.page >= 0)
+			nandsim.cache = NANDSIM_CACHE_READY;
+		break;
+	case NAND_CMD_READCACHESEQ:
+	case NAND_CMD_READCACHEEND:
+		if (!nandsim.array_reg || nandsim.cache == NANDSIM_CACHE_OFF ||
+		    (nandsim.cache == NANDSIM_CACHE_READY &&
+		     command == NAND_CMD_READCACHEEND)) {
+			debug("%s: read cache command %#x out of sequence\n",
+			      __func__, command);
+			nandsim.out = NANDSIM_OUT_NONE;
+			break;
+		}
+		if (nandsim.cache == NANDSIM_CACHE_ON)
+			nandsim_cache_next();
+		if (command == NAND_CMD_READCACHESEQ) {
+			nandsim_cache_start();
+			nandsim.cache = NANDSIM_CACHE_ON;
+		} else {
+			nandsim.cache = NANDSIM_CACHE_OFF;
+		}
+		nandsim.col = 0;
+		nandsim.out = NANDSIM_OUT_DATA;
+		break;
+	case NAND_CMD_RNDOUT:
+		nandsim.col = column;
+		nandsim.out = NANDSIM_OUT_DATA;
+		break;
+	case NAND_CMD_SEQIN:
+		memset(nandsim.reg, 0xff, nandsim.page_size + nandsim.oob_size);
+		nandsim.page = nandsim_page(page_addr);
+		nandsim.col = column;
+		break;
+	case NAND_CMD_RNDIN:
+		nandsim.col = column;
+		break;
+	case NAND_CMD_PAGEPROG:
+	case NAND_CMD_CACHEDPROG:
+		nandsim.status = NAND_STATUS_READY | NAND_STATUS_WP;
+		if (nandsim_program())
+			nandsim.status |= NAND_STATUS_FAIL;
+		break;
+	case NAND_CMD_ERASE1:
+		nandsim.erase_page = nandsim_page(page_addr);
+		break;
+	case NAND_CMD_ERASE2:
+		nandsim.status = NAND_STATUS_READY | NAND_STATUS_WP;
+		if (nandsim_erase())
+			nandsim.status |= NAND_STATUS_FAIL;
+		break;
+	default:
+		debug("%s: unsupported command %#x\n", __func__, command);
+		nandsim.out = NANDSIM_OUT_NONE;
+		break;
+	}
+}
+
+static void nandsim_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
+{
+	int avail = nandsim.page_size + nandsim.oob_size - nandsim.col;
+	int n = min(len, max(avail, 0));
+
+	memcpy(buf, nandsim.reg + nandsim.col, n);
+	memset(buf + n, 0xff, len - n);
+	nandsim.col += len;
+	nandsim.stats.bytes_out += len;
+	nandsim_busy((uint64_t)len * nandsim.t_byte_ns, &nandsim.stats.xfer_ns);
+}
+
+static uint8_t nandsim_read_byte(struct mtd_info *mtd)
+{
+	uint8_t val;
+
+	switch (nandsim.out) {
+	case NANDSIM_OUT_ID:
+		if (nandsim.col >= 0x20 && nandsim.col < 0x24)
+			return "ONFI"[nandsim.col++ - 0x20];
+		if (nandsim.col >= ARRAY_SIZE(nandsim_id))
+			return 0;
+		return nandsim_id[nandsim.col++];
+	case NANDSIM_OUT_PARAM:
+		/* The parameter page is repeated */
+		return ((uint8_t *)&nandsim.onfi)[nandsim.col++ %
+						  sizeof(nandsim.onfi)];
+	case NANDSIM_OUT_STATUS:
+		return nandsim.status;
+	case NANDSIM_OUT_DATA:
+		nandsim_read_buf(mtd, &val, 1);
+		return val;
+	default:
+		return 0xff;
+	}
+}
+
+static void nandsim_write_buf(struct mtd_info *mtd, const uint8_t *buf,
+			      int len)
+{
+	int avail = nandsim.page_size + nandsim.oob_size - nandsim.col;
+
+	memcpy(nandsim.reg + nandsim.col, buf, min(len, max(avail, 0)));
+	nandsim.col += len;
+	nandsim.stats.bytes_in += len;
+	nandsim_busy((uint64_t)len * nandsim.t_byte_ns, &nandsim.stats.xfer_ns);
+}
+
+static int nandsim_verify_buf(struct mtd_info *mtd, const uint8_t *buf,
+			      int len)
+{
+	uint8_t *tmp = malloc(len);
+	int ret;
+
+	if (!tmp)
+		return -ENOMEM;
+	nandsim_read_buf(mtd, tmp, len);
+	ret = memcmp(tmp, buf, len) ? -EFAULT : 0;
+	free(tmp);
+
+	return ret;
+}
+
+static void nandsim_select_chip(struct mtd_info *mtd, int chip)
+{
+}
+
+static int nandsim_dev_ready(struct mtd_info *mtd)
+{
+	/* Operations finish as they are issued */
+	return 1;
+}
+
+static int nandsim_init_size(struct mtd_info *mtd, struct nand_chip *chip,
+			     u8 *id_data)
+{
+	mtd->writesize = nandsim.page_size;
+	mtd->oobsize = nandsim.oob_size;
+	mtd->erasesize = nandsim.page_size * nandsim.pages_per_block;
+
+	return 0;
+}
+
+static u16 nandsim_onfi_crc16(const uint8_t *p, size_t len)
+{
+	u16 crc = ONFI_CRC_BASE;
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0);
+	}
+
+	return crc;
+}
+
+/* Fill in an ONFI 1.0 parameter page describing the chip */
+static void nandsim_setup_onfi(void)
+{
+	struct nand_onfi_params *p = &nandsim.onfi;
+
+	memcpy(p->sig, "ONFI", sizeof(p->sig));
+	p->revision = cpu_to_le16(1 << 1);
+	/* Small page chips have no read cache */
+	if (!nandsim_no_cache_read && nandsim.page_size > 512)
+		p->opt_cmd = cpu_to_le16(ONFI_OPT_CMD_READ_CACHE);
+	memcpy(p->manufacturer, "TOSHIBA     ", sizeof(p->manufacturer));
+	memcpy(p->model, "SANDBOX NAND        ", sizeof(p->model));
+	p->byte_per_page = cpu_to_le32(nandsim.page_size);
+	p->spare_bytes_per_page = cpu_to_le16(nandsim.oob_size);
+	p->pages_per_block = cpu_to_le32(nandsim.pages_per_block);
+	p->blocks_per_lun = cpu_to_le32(nandsim.blocks);
+	p->lun_count = 1;
+	p->bits_per_cell = 1;
+	p->programs_per_page = 1;
+	p->t_prog = cpu_to_le16(nandsim.t_prog_us);
+	p->t_bers = cpu_to_le16(nandsim.t_erase_us);
+	p->t_r = cpu_to_le16(nandsim.t_read_us);
+	p->crc = cpu_to_le16(nandsim_onfi_crc16((uint8_t *)p,
+				offsetof(struct nand_onfi_params, crc)));
+}
+
+/*
+ * Put the ECC bytes at the end of the OOB area, after the space that is
+ * free, if nand_base.c has no layout for this OOB size
+ */
+static int nandsim_setup_layout(struct nand_chip *chip)
+{
+	struct nand_ecclayout *layout = &nandsim.layout;
+	int eccbytes = nandsim.page_size / 256 * 3;
+	int i;
+
+	if (nandsim.oob_size == 16 || nandsim.oob_size == 64 ||
+	    nandsim.oob_size == 128)
+		return 0;
+	if (eccbytes + 2 > nandsim.oob_size ||
+	    eccbytes > ARRAY_SIZE(layout->eccpos))
+		return -EINVAL;
+
+	layout->eccbytes = eccbytes;
+	for (i = 0; i < eccbytes; i++)
+		layout->eccpos[i] = nandsim.oob_size - eccbytes + i;
+	layout->oobfree[0].offset = 2;
+	layout->oobfree[0].length = nandsim.oob_size - eccbytes - 2;
+	chip->ecc.layout = layout;
+
+	return 0;
+}
+
+/* Mark the blocks given with --nand_badblocks as bad in the file */
+static int nandsim_mark_bad(void)
+{
+	const char *p = nandsim_badblocks;
+	ulong block, page;
+	char *end;
+	int i;
+
+	while (p && *p) {
+		block = simple_strtoul(p, &end, 0);
+		if (end == p || block >= nandsim.blocks) {
+			printf("nandsim: bad block list '%s'\n",
+			       nandsim_badblocks);
+			return -EINVAL;
+		}
+		nandsim.bad[block] = 1;
+
+		/* The marker is in the first two pages, for any layout */
+		for (i = 0; i < 2; i++) {
+			page = block * nandsim.pages_per_block + i;
+			if (nandsim_pread(nandsim.reg, page))
+				return -EIO;
+			nandsim.reg[nandsim.page_size] = 0;
+			nandsim.reg[nandsim.page_size + 5] = 0;
+			if (nandsim_pwrite(nandsim.reg, page))
+				return -EIO;
+		}
+		p = *end == ',' ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+/* A size such as "2K" or "128KiB" */
+static ulong nandsim_parse_size(const char *str, char **end)
+{
+	ulong size = ustrtoul(str, end, 0);
+
+	/* ustrtoul() only steps over "Ki", "KiB" and so on */
+	if (**end && strchr("KkMG", **end))
+		(*end)++;
+
+	return size;
+}
+
+static int nandsim_pow2(ulong n)
+{
+	return n && !(n & (n - 1));
+}
+
+static int nandsim_parse_spec(const char *spec, ulong *size, char **file)
+{
+	ulong erasesize;
+	char *end;
+
+	*size = nandsim_parse_size(spec, &end);
+	if (*end++ != ':')
+		return -EINVAL;
+	nandsim.page_size = nandsim_parse_size(end, &end);
+	if (*end++ != ':')
+		return -EINVAL;
+	nandsim.oob_size = nandsim_parse_size(end, &end);
+	if (*end++ != ':')
+		return -EINVAL;
+	erasesize = nandsim_parse_size(end, &end);
+	if (*end++ != ':' || !*end)
+		return -EINVAL;
+	*file = end;
+
+	/* nand_base.c needs powers of two and a chip of at least 1MiB */
+	if (!nandsim_pow2(*size) || *size < SZ_1M ||
+	    !nandsim_pow2(nandsim.page_size) || nandsim.page_size < 512 ||
+	    nandsim.page_size > NAND_MAX_PAGESIZE ||
+	    nandsim.oob_size > NAND_MAX_OOBSIZE ||
+	    !nandsim_pow2(erasesize) || erasesize < nandsim.page_size ||
+	    erasesize > *size)
+		return -EINVAL;
+	nandsim.pages_per_block = erasesize / nandsim.page_size;
+	nandsim.blocks = *size / erasesize;
+
+	return 0;
+}
+
+static int nandsim_init(void)
+{
+	struct nand_chip *chip = &nandsim.chip;
+	struct mtd_info *mtd = &nand_info[0];
+	ulong size, page_len, pages;
+	off_t len;
+	char *file;
+	int ret;
+
+	if (nandsim_parse_spec(nandsim_spec, &size, &file)) {
+		printf("nandsim: bad spec '%s', want "
+		       "<size>:<pagesize>:<oobsize>:<erasesize>:<file>\n",
+		       nandsim_spec);
+		return -EINVAL;
+	}
+
+	nandsim.fd = os_open(file, OS_O_RDWR | OS_O_CREAT);
+	if (nandsim.fd < 0) {
+		printf("nandsim: cannot open '%s'\n", file);
+		return -EIO;
+	}
+	page_len = nandsim.page_size + nandsim.oob_size;
+	nandsim.reg = malloc(page_len);
+	nandsim.array_reg = malloc(page_len);
+	nandsim.bad = calloc(nandsim.blocks, 1);
+	if (!nandsim.reg || !nandsim.array_reg || !nandsim.bad) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* Pad the file out to the chip with erased pages */
+	pages = nandsim.blocks * nandsim.pages_per_block;
+	len = os_lseek(nandsim.fd, 0, OS_SEEK_END);
+	memset(nandsim.reg, 0xff, page_len);
+	for (; len >= 0 && len < (loff_t)pages * page_len; len += page_len) {
+		if (len % page_len ||
+		    os_write(nandsim.fd, nandsim.reg, page_len) != page_len) {
+			printf("nandsim: '%s' is not whole pages\n", file);
+			ret = -EIO;
+			goto err;
+		}
+	}
+
+	ret = nandsim_mark_bad();
+	if (ret)
+		goto err;
+
+	nandsim.ids[0].name = "sandbox NAND";
+	nandsim.ids[0].id = NANDSIM_DEV_ID;
+	nandsim.ids[0].chipsize = size >> 20;
+	nandsim_setup_onfi();
+
+	chip->cmdfunc = nandsim_cmdfunc;
+	chip->read_byte = nandsim_read_byte;
+	chip->read_buf = nandsim_read_buf;
+	chip->write_buf = nandsim_write_buf;
+	chip->verify_buf = nandsim_verify_buf;
+	chip->select_chip = nandsim_select_chip;
+	chip->dev_ready = nandsim_dev_ready;
+	chip->init_size = nandsim_init_size;
+	chip->ecc.mode = NAND_ECC_SOFT;
+	/* nandsim_cmdfunc() handles the read cache commands */
+	chip->options |= NAND_CMDFUNC_CACHERD;
+	mtd->priv = chip;
+
+	ret = nand_scan_ident(mtd, 1, nandsim.ids);
+	if (ret)
+		goto err;
+	if (nandsim_setup_layout(chip)) {
+		printf("nandsim: %lu byte OOB is too small for ECC\n",
+		       nandsim.oob_size);
+		ret = -EINVAL;
+		goto err;
+	}
+	ret = nand_scan_tail(mtd);
+	if (!ret)
+		ret = nand_register(0);
+	if (!ret)
+		return 0;
+
+err:
+	os_close(nandsim.fd);
+	nandsim.fd = -1;
+	free(nandsim.reg);
+	free(nandsim.array_reg);
+	free(nandsim.bad);
+	nandsim.reg = NULL;
+	nandsim.array_reg = NULL;
+	nandsim.bad = NULL;
+	return ret;
+}
+
+void board_nand_init(void)
+{
+	if (!nandsim_spec || !nandsim_init())
+		return;
+
+	/* Leave no half set up device behind */
+	puts("Sandbox NAND init failed\n");
+	memset(&nand_info[0], '\0', sizeof(nand_info[0]));
+}
+
+static int sandbox_cmdline_cb_nand(struct sandbox_state *state,
+				   const char *arg)
+{
+	/* The chip is set up by board_nand_init() */
+	nandsim_spec = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(nand, 1,
+		    "NAND chip in a file: <size>:<page>:<oob>:<block>:<file>");
+
+static int sandbox_cmdline_cb_nand_badblocks(struct sandbox_state *state,
+					     const char *arg)
+{
+	nandsim_badblocks = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(nand_badblocks, 1,
+		    "NAND blocks which are bad: <block>[,<block>...]");
+
+static int sandbox_cmdline_cb_nand_bitflips(struct sandbox_state *state,
+					    const char *arg)
+{
+	char *end;
+
+	nandsim.flip_every = simple_strtoul(arg, &end, 10);
+	nandsim.flip_bits = *end == ':' ? simple_strtoul(end + 1, NULL, 10) : 1;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(nand_bitflips, 1,
+		    "Flip bits in every nth NAND page read: <n>[:<bits>]");
+
+static int sandbox_cmdline_cb_nand_timing(struct sandbox_state *state,
+					  const char *arg)
+{
+	char *end;
+
+	nandsim.t_read_us = simple_strtoul(arg, &end, 10);
+	if (*end == ':')
+		nandsim.t_prog_us = simple_strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		nandsim.t_erase_us = simple_strtoul(end + 1, &end, 10);
+	if (*end == ':')
+		nandsim.t_byte_ns = simple_strtoul(end + 1, &end, 10);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(nand_timing, 1,
+		    "NAND busy times in us: <tR>:<tPROG>:<tBERS>[:<ns/byte>]");
+
+static int sandbox_cmdline_cb_nand_no_cache_read(struct sandbox_state *state,
+						 const char *arg)
+{
+	nandsim_no_cache_read = 1;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(nand_no_cache_read, 0,
+		    "NAND chip has no read cache commands");
+
+static void nandsim_print_op(const char *name, ulong count, uint64_t ns)
+{
+	printf("%-16s%lu in %llu ms", name, count, ns / 1000000);
+	if (count)
+		printf(", %llu us each", ns / 1000 / count);
+	putc('\n');
+}
+
+static int do_nandsim(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	struct nandsim_stats *stats = &nandsim.stats;
+	ulong block, page, byte, bit;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+	if (!nandsim.reg) {
+		puts("No sandbox NAND chip (use --nand)\n");
+		return CMD_RET_FAILURE;
+	}
+
+	if (!strcmp(argv[1], "stats")) {
+		nandsim_print_op("page reads:", stats->reads, stats->read_ns);
+		printf("%-16s%lu\n", "cache reads:", stats->cache_reads);
+		nandsim_print_op("page programs:", stats->programs,
+				 stats->prog_ns);
+		nandsim_print_op("block erases:", stats->erases,
+				 stats->erase_ns);
+		printf("%-16s", "bus transfers:");
+		print_size(stats->bytes_out, " out, ");
+		print_size(stats->bytes_in, " in, ");
+		printf("%llu ms\n", stats->xfer_ns / 1000000);
+		printf("%-16s%lu\n", "bit flips:", stats->bitflips);
+		if (argc > 2 && !strcmp(argv[2], "reset"))
+			memset(stats, '\0', sizeof(*stats));
+	} else if (!strcmp(argv[1], "bad") && argc == 3) {
+		/* The block wears out: erases and programs fail from now */
+		block = simple_strtoul(argv[2], NULL, 0);
+		if (block >= nandsim.blocks)
+			return CMD_RET_USAGE;
+		nandsim.bad[block] = 1;
+	} else if (!strcmp(argv[1], "flip") && argc == 5) {
+		/* The bit stays flipped until the block is erased */
+		page = simple_strtoul(argv[2], NULL, 0);
+		byte = simple_strtoul(argv[3], NULL, 0);
+		bit = simple_strtoul(argv[4], NULL, 0);
+		if (page >= nandsim.blocks * nandsim.pages_per_block ||
+		    byte >= nandsim.page_size + nandsim.oob_size || bit > 7)
+			return CMD_RET_USAGE;
+		if (nandsim_pread(nandsim.reg, page))
+			return CMD_RET_FAILURE;
+		nandsim.reg[byte] ^= 1 << bit;
+		if (nandsim_pwrite(nandsim.reg, page))
+			return CMD_RET_FAILURE;
+		nandsim.chip.pagebuf = -1;
+	} else {
+		return CMD_RET_USAGE;
+	}
+
+	return CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	nandsim, 5, 1, do_nandsim,
+	"sandbox NAND simulator",
+	"stats [reset] - show (and clear) the operation counts and times\n"
+	"nandsim bad <block> - make erases and programs in a block fail\n"
+	"nandsim flip <page> <byte> <bit> - flip a bit stored in a page"
+);
@@ -0,0 +1,222 @@
+/*
+ * Simulate a NOR-like MTD device in a host file
+ *
+ * Set up with --mtdram <size>:<erasesize>:<file>, with K or M suffixes on
+ * the sizes, and registered as "nor0" so that mtdparts and UBI can find it.
+ * A file shorter than the device is padded with erased (0xff) bytes.
+ * Programming only clears bits, as on real flash.
+ *
+ * Reading from flash is far slower than from a host file. With
+ * --mtdram_read_us each read takes that long per 2 KiB page it touches, so
+ * that the time spent attaching UBI or mounting a filesystem is closer to
+ * what a board would see.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <exports.h>
+#include <malloc.h>
+#include <os.h>
+#include <asm/errno.h>
+#include <asm/getopt.h>
+#include <asm/state.h>
+#include <asm/u-boot-sandbox.h>
+#include <linux/mtd/mtd.h>
+
+/* Unit the read time is charged in, like a NAND page */
+#define MTDRAM_READ_PAGE	2048
+
+static const char *mtdram_spec;
+static unsigned long mtdram_read_us;
+
+static struct mtdram {
+	struct mtd_info mtd;
+	int fd;
+	uint64_t busy_until;	/* when the last read finishes, in ns */
+	u_char *buf;		/* an eraseblock, for programming */
+} mtdram;
+
+/* Wait until reading @len bytes at @from would have finished */
+static void mtdram_read_time(loff_t from, size_t len)
+{
+	uint64_t now = os_get_nsec();
+	ulong pages;
+
+	if (!mtdram_read_us || !len)
+		return;
+
+	pages = (from + len - 1) / MTDRAM_READ_PAGE -
+		from / MTDRAM_READ_PAGE + 1;
+	if (mtdram.busy_until < now)
+		mtdram.busy_until = now;
+	mtdram.busy_until += (uint64_t)pages * mtdram_read_us * 1000;
+
+	/* Sleeping has overhead, so let short reads add up first */
+	if (mtdram.busy_until > now + 1000000)
+		os_usleep((mtdram.busy_until - now) / 1000);
+}
+
+static int mtdram_pread(void *buf, loff_t offs, size_t len)
+{
+	if (os_lseek(mtdram.fd, offs, OS_SEEK_SET) != offs ||
+	    os_read(mtdram.fd, buf, len) != len)
+		return -EIO;
+
+	return 0;
+}
+
+static int mtdram_pwrite(const void *buf, loff_t offs, size_t len)
+{
+	if (os_lseek(mtdram.fd, offs, OS_SEEK_SET) != offs ||
+	    os_write(mtdram.fd, buf, len) != len)
+		return -EIO;
+
+	return 0;
+}
+
+static int mtdram_erase(struct mtd_info *mtd, struct erase_info *instr)
+{
+	loff_t offs;
+	int ret = 0;
+
+	memset(mtdram.buf, 0xff, mtd->erasesize);
+	for (offs = instr->addr; offs < instr->addr + instr->len && !ret;
+	     offs += mtd->erasesize)
+		ret = mtdram_pwrite(mtdram.buf, offs, mtd->erasesize);
+
+	if (ret) {
+		instr->state = MTD_ERASE_FAILED;
+		return ret;
+	}
+
+	instr->state = MTD_ERASE_DONE;
+	mtd_erase_callback(instr);
+	return 0;
+}
+
+static int mtdram_read(struct mtd_info *mtd, loff_t from, size_t len,
+		       size_t *retlen, u_char *buf)
+{
+	int ret;
+
+	mtdram_read_time(from, len);
+	ret = mtdram_pread(buf, from, len);
+	if (!ret)
+		*retlen = len;
+
+	return ret;
+}
+
+static int mtdram_write(struct mtd_info *mtd, loff_t to, size_t len,
+			size_t *retlen, const u_char *buf)
+{
+	size_t done, chunk, i;
+	int ret;
+
+	for (done = 0; done < len; done += chunk) {
+		chunk = min(len - done, (size_t)mtd->erasesize);
+		ret = mtdram_pread(mtdram.buf, to + done, chunk);
+		if (ret)
+			return ret;
+		for (i = 0; i < chunk; i++)
+			mtdram.buf[i] &= buf[done + i];
+		ret = mtdram_pwrite(mtdram.buf, to + done, chunk);
+		if (ret)
+			return ret;
+	}
+	*retlen = len;
+
+	return 0;
+}
+
+static void mtdram_sync(struct mtd_info *mtd)
+{
+}
+
+/* A size such as "64M" or "128KiB" */
+static ulong mtdram_parse_size(const char *str, char **end)
+{
+	ulong size = ustrtoul(str, end, 0);
+
+	/* ustrtoul() only steps over "Ki", "KiB" and so on */
+	if (**end && strchr("KkMG", **end))
+		(*end)++;
+
+	return size;
+}
+
+int sandbox_mtdram_init(void)
+{
+	struct mtd_info *mtd = &mtdram.mtd;
+	ulong size, erasesize;
+	off_t len;
+	char *end;
+
+	if (!mtdram_spec)
+		return 0;
+
+	size = mtdram_parse_size(mtdram_spec, &end);
+	if (*end++ != ':')
+		goto err_spec;
+	erasesize = mtdram_parse_size(end, &end);
+	if (*end++ != ':' || !*end || !erasesize || size % erasesize)
+		goto err_spec;
+
+	mtdram.fd = os_open(end, OS_O_RDWR | OS_O_CREAT);
+	if (mtdram.fd < 0) {
+		printf("mtdram: cannot open '%s'\n", end);
+		return -EIO;
+	}
+	mtdram.buf = malloc(erasesize);
+	if (!mtdram.buf)
+		return -ENOMEM;
+
+	/* Pad the file out to the device with erased flash */
+	len = os_lseek(mtdram.fd, 0, OS_SEEK_END);
+	memset(mtdram.buf, 0xff, erasesize);
+	while (len >= 0 && len < size) {
+		ulong chunk = min(size - len, erasesize - len % erasesize);
+
+		if (os_write(mtdram.fd, mtdram.buf, chunk) != chunk)
+			return -EIO;
+		len += chunk;
+	}
+
+	mtd->name = "nor0";
+	mtd->type = MTD_NORFLASH;
+	mtd->flags = MTD_CAP_NORFLASH;
+	mtd->size = size;
+	mtd->erasesize = erasesize;
+	mtd->writesize = 1;
+	mtd->_erase = mtdram_erase;
+	mtd->_read = mtdram_read;
+	mtd->_write = mtdram_write;
+	mtd->_sync = mtdram_sync;
+
+	return add_mtd_device(mtd);
+
+err_spec:
+	printf("mtdram: bad spec '%s', want <size>:<erasesize>:<file>\n",
+	       mtdram_spec);
+	return -EINVAL;
+}
+
+static int sandbox_cmdline_cb_mtdram(struct sandbox_state *state,
+				     const char *arg)
+{
+	/* The device is set up by sandbox_mtdram_init() */
+	mtdram_spec = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(mtdram, 1,
+		    "MTD device in a host file: <size>:<erasesize>:<file>");
+
+static int sandbox_cmdline_cb_mtdram_read_us(struct sandbox_state *state,
+					     const char *arg)
+{
+	mtdram_read_us = simple_strtoul(arg, NULL, 10);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(mtdram_read_us, 1,
+		    "MTD device read time per 2 KiB page, in us (default 0)");
@@ -34,12 +34,14 @@ enum sandbox_sf_state {
 	SF_ERASE, /* erase the flash */
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
+	SF_WRITE_STATUS, /* write the flash's status register */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
+		"READ_STATUS1", "WRITE_STATUS",
 	};
 	return states[state];
 }
@@ -47,6 +49,7 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 /* Bits for the status register */
 #define STAT_WIP	(1 << 0)
 #define STAT_WEL	(1 << 1)
+#define STAT_QE		(1 << 9)	/* quad enable, as on Winbond */
 
 /* Assume all SPI flashes have 3 byte addresses since they do atm */
 #define SF_ADDR_LEN	3
@@ -54,15 +57,31 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 struct sandbox_spi_flash_erase_commands {
 	u8 cmd;
 	u32 size;
+	u32 time_ms;	/* typical time from the datasheet */
 };
 #define IDCODE_LEN 5
-#define MAX_ERASE_CMDS 3
+#define MAX_ERASE_CMDS 4
 struct sandbox_spi_flash_data {
 	const char *name;
 	u8 idcode[IDCODE_LEN];
 	u32 size;
 	const struct sandbox_spi_flash_erase_commands
 						erase_cmds[MAX_ERASE_CMDS];
+	int multi_io;	/* has the dual and quad read/program commands */
+};
+
+/* The dual and quad commands: the lines they use, and their dummy bytes */
+static const struct sandbox_sf_multi_io_cmd {
+	u8 cmd;
+	u8 addr_lines;	/* for the address and dummy bytes */
+	u8 data_lines;
+	u8 dummy;
+} sandbox_sf_multi_io_cmds[] = {
+	{ CMD_READ_DUAL_OUTPUT_FAST,	1, 2, 1, },
+	{ CMD_READ_DUAL_IO_FAST,	2, 2, 1, },	/* mode byte */
+	{ CMD_READ_QUAD_OUTPUT_FAST,	1, 4, 1, },
+	{ CMD_READ_QUAD_IO_FAST,	4, 4, 3, },	/* mode, 4 cycles */
+	{ CMD_QUAD_PAGE_PROGRAM,	1, 4, 0, },
 };
 
 /* Structure describing all the flashes we know how to emulate */
@@ -70,31 +89,38 @@ static const struct sandbox_spi_flash_data sandbox_sf_flashes[] = {
 	{
 		"M25P16", { 0x20, 0x20, 0x15 }, (2 << 20),
 		{	/* erase commands */
-			{ 0xd8, (64 << 10), }, /* sector */
-			{ 0xc7, (2 << 20), }, /* bulk */
+			{ 0xd8, (64 << 10), 600, }, /* sector */
+			{ 0xc7, (2 << 20), 13000, }, /* bulk */
 		},
 	},
 	{
 		"W25Q32", { 0xef, 0x40, 0x16 }, (4 << 20),
 		{	/* erase commands */
-			{ 0x20, (4 << 10), }, /* 4KB */
-			{ 0xd8, (64 << 10), }, /* sector */
-			{ 0xc7, (4 << 20), }, /* bulk */
+			{ 0x20, (4 << 10), 45, }, /* 4KB */
+			{ 0x52, (32 << 10), 120, }, /* 32KB */
+			{ 0xd8, (64 << 10), 150, }, /* sector */
+			{ 0xc7, (4 << 20), 10000, }, /* bulk */
 		},
+		1,
 	},
 	{
 		"W25Q128", { 0xef, 0x40, 0x18 }, (16 << 20),
 		{	/* erase commands */
-			{ 0x20, (4 << 10), }, /* 4KB */
-			{ 0xd8, (64 << 10), }, /* sector */
-			{ 0xc7, (16 << 20), }, /* bulk */
+			{ 0x20, (4 << 10), 45, }, /* 4KB */
+			{ 0x52, (32 << 10), 120, }, /* 32KB */
+			{ 0xd8, (64 << 10), 150, }, /* sector */
+			{ 0xc7, (16 << 20), 40000, }, /* bulk */
 		},
+		1,
 	},
 };
 
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
 
+/* How long erases take, as a percentage of the typical time */
+static uint sandbox_sf_erase_time;
+
 /* Internal state data for each SPI flash */
 struct sandbox_spi_flash {
 	/*
@@ -114,8 +140,12 @@ struct sandbox_spi_flash {
 	uint off;
 	/* How many address bytes we've consumed */
 	uint addr_bytes, pad_addr_bytes;
+	/* Lines the address and the data of the current command go on */
+	uint addr_lines, data_lines;
 	/* The current flash status (see STAT_XXX defines above) */
 	u16 status;
+	/* When the erase in progress finishes, in ns, for STAT_WIP */
+	uint64_t busy_until;
 	/* Data describing the flash we're emulating */
 	const struct sandbox_spi_flash_data *data;
 	/* The file on disk to serv up data from */
@@ -195,6 +225,8 @@ static void sandbox_sf_cs_activate(void *priv)
 	sbsf->off = 0;
 	sbsf->addr_bytes = 0;
 	sbsf->pad_addr_bytes = 0;
+	sbsf->addr_lines = 1;
+	sbsf->data_lines = 1;
 	sbsf->state = SF_CMD;
 	sbsf->cmd = SF_CMD;
 }
@@ -204,6 +236,59 @@ static void sandbox_sf_cs_deactivate(void *priv)
 	debug("sandbox_sf: CS deactivated; cmd done processing!\n");
 }
 
+int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
+{
+	int todo;
+	int ret;
+
+	while (size > 0) {
+		todo = min(size, sizeof(sandbox_sf_0xff));
+		ret = os_write(sbsf->fd, sandbox_sf_0xff, todo);
+		if (ret != todo)
+			return ret;
+		size -= todo;
+	}
+
+	return 0;
+}
+
+/* Erase at the current offset, and stay busy for as long as a flash would */
+static int sandbox_sf_erase(struct sandbox_spi_flash *sbsf)
+{
+	const struct sandbox_spi_flash_erase_commands *erase_cmd =
+							sbsf->cmd_data;
+	int ret;
+
+	if (!(sbsf->status & STAT_WEL)) {
+		puts("sandbox_sf: write enable not set before erase\n");
+		return 1;
+	}
+
+	/* verify address is aligned */
+	if (sbsf->off & (erase_cmd->size - 1)) {
+		debug(" sector erase: cmd:%#x needs align:%#x, but we got %#x\n",
+		      erase_cmd->cmd, erase_cmd->size, sbsf->off);
+		sbsf->status &= ~STAT_WEL;
+		return 1;
+	}
+
+	debug(" sector erase addr: %u\n", sbsf->off);
+
+	ret = sandbox_erase_part(sbsf, erase_cmd->size);
+	sbsf->status &= ~STAT_WEL;
+	if (ret) {
+		debug("sandbox_sf: Erase failed\n");
+		return 1;
+	}
+	if (sandbox_sf_erase_time) {
+		sbsf->busy_until = os_get_nsec() + (uint64_t)erase_cmd->time_ms *
+			sandbox_sf_erase_time * 10000;
+		sbsf->status |= STAT_WIP;
+	}
+
+	return 0;
+}
+
 /* Figure out what command this stream is telling us to do */
 static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				  u8 *tx)
@@ -240,9 +325,37 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		debug(" write enabled\n");
 		sbsf->status |= STAT_WEL;
 		break;
+	case CMD_WRITE_STATUS:
+		if (!(sbsf->status & STAT_WEL)) {
+			puts("sandbox_sf: write enable not set before wrsr\n");
+			return 1;
+		}
+		sbsf->status &= ~STAT_WEL;
+		sbsf->state = SF_WRITE_STATUS;
+		break;
 	default: {
 		size_t i;
 
+		for (i = 0; sbsf->data->multi_io &&
+			    i < ARRAY_SIZE(sandbox_sf_multi_io_cmds); ++i) {
+			const struct sandbox_sf_multi_io_cmd *mio =
+				&sandbox_sf_multi_io_cmds[i];
+
+			if (sbsf->cmd != mio->cmd)
+				continue;
+
+			if ((mio->data_lines == 4) &&
+			    !(sbsf->status & STAT_QE)) {
+				printf("sandbox_sf: cmd %#x needs QE set\n",
+				       sbsf->cmd);
+				return 1;
+			}
+			sbsf->addr_lines = mio->addr_lines;
+			sbsf->data_lines = mio->data_lines;
+			sbsf->pad_addr_bytes = mio->dummy;
+			goto state_addr;
+		}
+
 		/* handle erase commands first */
 		for (i = 0; i < MAX_ERASE_CMDS; ++i) {
 			const struct sandbox_spi_flash_erase_commands *
@@ -254,6 +367,16 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				continue;
 
 			sbsf->cmd_data = erase_cmd;
+			/* A bulk erase has no address */
+			if (erase_cmd->size == sbsf->data->size) {
+				if (os_lseek(sbsf->fd, 0, OS_SEEK_SET) < 0) {
+					puts("sandbox_sf: os_lseek() failed");
+					return 1;
+				}
+				sbsf->off = 0;
+				sandbox_sf_erase(sbsf);
+				break;
+			}
 			goto state_addr;
 		}
 
@@ -269,24 +392,36 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	return 0;
 }
 
-int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size)
+/* Check that the bus put this part of the command on the right lines */
+static int sandbox_sf_check_lines(struct sandbox_spi_flash *sbsf,
+				  unsigned long flags)
 {
-	int todo;
-	int ret;
+	uint lines, want;
 
-	while (size > 0) {
-		todo = min(size, sizeof(sandbox_sf_0xff));
-		ret = os_write(sbsf->fd, sandbox_sf_0xff, todo);
-		if (ret != todo)
-			return ret;
-		size -= todo;
+	lines = flags & SPI_XFER_QUAD ? 4 : flags & SPI_XFER_DUAL ? 2 : 1;
+	switch (sbsf->state) {
+	case SF_ADDR:
+		want = sbsf->addr_lines;
+		break;
+	case SF_READ:
+	case SF_WRITE:
+		want = sbsf->data_lines;
+		break;
+	default:
+		want = 1;
+	}
+	if (lines != want) {
+		printf("sandbox_sf: cmd %#x: %s on %u lines, expected %u\n",
+		       sbsf->cmd, sandbox_sf_state_name(sbsf->state), lines,
+		       want);
+		return 1;
 	}
 
 	return 0;
 }
 
 static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
-		uint bytes)
+		uint bytes, unsigned long flags)
 {
 	struct sandbox_spi_flash *sbsf = priv;
 	uint cnt, pos = 0;
@@ -297,13 +432,17 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 
 	if (sbsf->state == SF_CMD) {
 		/* Figure out the initial state */
-		if (sandbox_sf_process_cmd(sbsf, rx, tx))
+		if (sandbox_sf_check_lines(sbsf, flags) ||
+		    sandbox_sf_process_cmd(sbsf, rx, tx))
 			return 1;
 		++pos;
 	}
 
 	/* Process the remaining data */
 	while (pos < bytes) {
+		if (sandbox_sf_check_lines(sbsf, flags))
+			return 1;
+
 		switch (sbsf->state) {
 		case SF_ID: {
 			u8 id;
@@ -341,9 +480,14 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_DUAL_OUTPUT_FAST:
+			case CMD_READ_DUAL_IO_FAST:
+			case CMD_READ_QUAD_OUTPUT_FAST:
+			case CMD_READ_QUAD_IO_FAST:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
+			case CMD_QUAD_PAGE_PROGRAM:
 				sbsf->state = SF_WRITE;
 				break;
 			default:
@@ -370,6 +514,9 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			pos += ret;
 			break;
 		case SF_READ_STATUS:
+			if ((sbsf->status & STAT_WIP) &&
+			    os_get_nsec() >= sbsf->busy_until)
+				sbsf->status &= ~STAT_WIP;
 			debug(" read status: %#x\n", sbsf->status);
 			cnt = bytes - pos;
 			memset(tx + pos, sbsf->status, cnt);
@@ -381,6 +528,18 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			memset(tx + pos, sbsf->status >> 8, cnt);
 			pos += cnt;
 			break;
+		case SF_WRITE_STATUS:
+			/* The low byte, then on some parts the high byte */
+			if (sbsf->off == 0)
+				sbsf->status = (sbsf->status & 0xff03) |
+					(rx[pos] & 0xfc);
+			else if (sbsf->off == 1)
+				sbsf->status = (sbsf->status & 0xff) |
+					rx[pos] << 8;
+			debug(" write status: %#x\n", sbsf->status);
+			sandbox_spi_tristate(&tx[pos++], 1);
+			++sbsf->off;
+			break;
 		case SF_WRITE:
 			/*
 			 * XXX: need to handle exotic behavior:
@@ -405,42 +564,14 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			sbsf->status &= ~STAT_WEL;
 			break;
 		case SF_ERASE:
- case_sf_erase: {
-			const struct sandbox_spi_flash_erase_commands *
-						erase_cmd = sbsf->cmd_data;
-
-			if (!(sbsf->status & STAT_WEL)) {
-				puts("sandbox_sf: write enable not set before erase\n");
+ case_sf_erase:
+			if (sandbox_sf_erase(sbsf))
 				goto done;
-			}
-
-			/* verify address is aligned */
-			if (sbsf->off & (erase_cmd->size - 1)) {
-				debug(" sector erase: cmd:%#x needs align:%#x, but we got %#x\n",
-				      erase_cmd->cmd, erase_cmd->size,
-				      sbsf->off);
-				sbsf->status &= ~STAT_WEL;
-				goto done;
-			}
-
-			debug(" sector erase addr: %u\n", sbsf->off);
 
 			cnt = bytes - pos;
 			sandbox_spi_tristate(&tx[pos], cnt);
 			pos += cnt;
-
-			/*
-			 * TODO(vapier@gentoo.org): latch WIP in status, and
-			 * delay before clearing it ?
-			 */
-			ret = sandbox_erase_part(sbsf, erase_cmd->size);
-			sbsf->status &= ~STAT_WEL;
-			if (ret) {
-				debug("sandbox_sf: Erase failed\n");
-				goto done;
-			}
 			goto done;
-		}
 		default:
 			debug(" ??? no idea what to do ???\n");
 			goto done;
@@ -481,3 +612,12 @@ static int sandbox_cmdline_cb_spi_sf(struct sandbox_state *state,
 	return 0;
 }
 SANDBOX_CMDLINE_OPT(spi_sf, 1, "connect a SPI flash: <bus>:<cs>:<id>:<file>");
+
+static int sandbox_cmdline_cb_spi_sf_erase_time(struct sandbox_state *state,
+						const char *arg)
+{
+	sandbox_sf_erase_time = simple_strtoul(arg, NULL, 10);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(spi_sf_erase_time, 1,
+		    "SPI flash erase time, in percent of typical (default 0)");
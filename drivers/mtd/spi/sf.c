@@ -9,6 +9,37 @@
 
 #include <common.h>
 #include <spi.h>
+#include <spi_flash.h>
+
+#include "sf_internal.h"
+
+/*
+ * Work out the lines that the address (with any dummy bytes) and the data
+ * of a command go on, as spi_xfer() flags. The command byte itself always
+ * goes on one line.
+ */
+static void spi_flash_cmd_lines(u8 cmd, unsigned long *addr_lines,
+				unsigned long *data_lines)
+{
+	*addr_lines = 0;
+	*data_lines = 0;
+
+	switch (cmd) {
+	case CMD_READ_DUAL_IO_FAST:
+		*addr_lines = SPI_XFER_DUAL;
+		/* fall through */
+	case CMD_READ_DUAL_OUTPUT_FAST:
+		*data_lines = SPI_XFER_DUAL;
+		break;
+	case CMD_READ_QUAD_IO_FAST:
+		*addr_lines = SPI_XFER_QUAD;
+		/* fall through */
+	case CMD_READ_QUAD_OUTPUT_FAST:
+	case CMD_QUAD_PAGE_PROGRAM:
+		*data_lines = SPI_XFER_QUAD;
+		break;
+	}
+}
 
 static int spi_flash_read_write(struct spi_slave *spi,
 				const u8 *cmd, size_t cmd_len,
@@ -16,12 +47,26 @@ static int spi_flash_read_write(struct spi_slave *spi,
 				size_t data_len)
 {
 	unsigned long flags = SPI_XFER_BEGIN;
+	unsigned long addr_lines, data_lines;
 	int ret;
 
 #ifdef CONFIG_SF_DUAL_FLASH
 	if (spi->flags & SPI_XFER_U_PAGE)
 		flags |= SPI_XFER_U_PAGE;
 #endif
+	spi_flash_cmd_lines(cmd[0], &addr_lines, &data_lines);
+
+	/* The address of an I/O cmd goes on more lines than the cmd */
+	if (addr_lines && cmd_len > 1) {
+		ret = spi_xfer(spi, 8, cmd, NULL, flags);
+		if (ret) {
+			debug("SF: Failed to send command: %d\n", ret);
+			return ret;
+		}
+		flags = addr_lines;
+		cmd++;
+		cmd_len--;
+	}
 	if (data_len == 0)
 		flags |= SPI_XFER_END;
 
@@ -31,7 +76,7 @@ static int spi_flash_read_write(struct spi_slave *spi,
 		      cmd_len, ret);
 	} else if (data_len != 0) {
 		ret = spi_xfer(spi, data_len * 8, data_out, data_in,
-					SPI_XFER_END);
+					SPI_XFER_END | data_lines);
 		if (ret)
 			debug("SF: Failed to transfer %zu bytes of data: %d\n",
 			      data_len, ret);
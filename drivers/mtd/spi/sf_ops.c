@@ -55,7 +55,8 @@ int spi_flash_cmd_write_status(struct spi_flash *flash, u8 ws)
 	return 0;
 }
 
-#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND) || \
+	defined(CONFIG_SPI_FLASH_GIGADEVICE)
 int spi_flash_cmd_read_config(struct spi_flash *flash, u8 *rc)
 {
 	int ret;
@@ -204,16 +205,13 @@ int spi_flash_cmd_wait_ready(struct spi_flash *flash, unsigned long timeout)
 	return -1;
 }
 
-int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
-		size_t cmd_len, const void *buf, size_t buf_len)
+static int spi_flash_write_timeout(struct spi_flash *flash, const u8 *cmd,
+		size_t cmd_len, const void *buf, size_t buf_len,
+		unsigned long timeout)
 {
 	struct spi_slave *spi = flash->spi;
-	unsigned long timeout = SPI_FLASH_PROG_TIMEOUT;
 	int ret;
 
-	if (buf == NULL)
-		timeout = SPI_FLASH_PAGE_ERASE_TIMEOUT;
-
 	ret = spi_claim_bus(flash->spi);
 	if (ret) {
 		debug("SF: unable to claim SPI bus\n");
@@ -234,9 +232,7 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 
 	ret = spi_flash_cmd_wait_ready(flash, timeout);
 	if (ret < 0) {
-		debug("SF: write %s timed out\n",
-		      timeout == SPI_FLASH_PROG_TIMEOUT ?
-			"program" : "page erase");
+		debug("SF: write %s timed out\n", buf ? "program" : "erase");
 		return ret;
 	}
 
@@ -245,11 +241,67 @@ int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+int spi_flash_write_common(struct spi_flash *flash, const u8 *cmd,
+		size_t cmd_len, const void *buf, size_t buf_len)
+{
+	unsigned long timeout = SPI_FLASH_PROG_TIMEOUT;
+
+	if (buf == NULL)
+		timeout = SPI_FLASH_PAGE_ERASE_TIMEOUT;
+
+	return spi_flash_write_timeout(flash, cmd, cmd_len, buf, buf_len,
+				       timeout);
+}
+
+/* Pick the largest erase cmd that is aligned at @offset and fits in @len */
+static int spi_flash_erase_kind(struct spi_flash *flash, u32 offset,
+		size_t len)
+{
+	u32 size;
+	int kind;
+
+	if (flash->erase_cmds[SF_ERASE_CHIP] && !offset && len == flash->size)
+		return SF_ERASE_CHIP;
+
+	for (kind = SF_ERASE_SECTOR; kind >= 0; kind--) {
+		size = flash->erase_sizes[kind];
+		if (flash->erase_cmds[kind] && !(offset % size) && len >= size)
+			return kind;
+	}
+
+	return -EINVAL;
+}
+
+int spi_flash_erase_plan(struct spi_flash *flash, u32 offset, size_t len,
+			 struct spi_flash_erase_stats *plan)
+{
+	int kind, count = 0;
+
+	memset(plan, '\0', sizeof(*plan));
+	if (offset % flash->erase_size || len % flash->erase_size ||
+	    offset > flash->size || len > flash->size - offset)
+		return -EINVAL;
+
+	while (len) {
+		kind = spi_flash_erase_kind(flash, offset, len);
+		if (kind < 0)
+			return kind;
+		plan->count[kind]++;
+		count++;
+		offset += flash->erase_sizes[kind];
+		len -= flash->erase_sizes[kind];
+	}
+
+	return count;
+}
+
 int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 {
+	struct spi_flash_erase_stats *stats = flash->erase_stats;
 	u32 erase_size, erase_addr;
 	u8 cmd[SPI_FLASH_CMD_LEN];
-	int ret = -1;
+	ulong start = 0;
+	int kind, ret = -1;
 
 	erase_size = flash->erase_size;
 	if (offset % erase_size || len % erase_size) {
@@ -257,32 +309,51 @@ int spi_flash_cmd_erase_ops(struct spi_flash *flash, u32 offset, size_t len)
 		return -1;
 	}
 
-	cmd[0] = flash->erase_cmd;
 	while (len) {
-		erase_addr = offset;
+		kind = spi_flash_erase_kind(flash, offset, len);
+		if (kind < 0) {
+			debug("SF: no erase cmd fits at %x\n", offset);
+			return -1;
+		}
+		cmd[0] = flash->erase_cmds[kind];
+		if (stats)
+			start = timer_get_us();
+
+		if (kind == SF_ERASE_CHIP) {
+			debug("SF: erase %2x (chip)\n", cmd[0]);
+			ret = spi_flash_write_timeout(flash, cmd, 1, NULL, 0,
+					SPI_FLASH_CHIP_ERASE_TIMEOUT);
+		} else {
+			erase_addr = offset;
 
 #ifdef CONFIG_SF_DUAL_FLASH
-		if (flash->dual_flash > SF_SINGLE_FLASH)
-			spi_flash_dual_flash(flash, &erase_addr);
+			if (flash->dual_flash > SF_SINGLE_FLASH)
+				spi_flash_dual_flash(flash, &erase_addr);
 #endif
 #ifdef CONFIG_SPI_FLASH_BAR
-		ret = spi_flash_bank(flash, erase_addr);
-		if (ret < 0)
-			return ret;
+			ret = spi_flash_bank(flash, erase_addr);
+			if (ret < 0)
+				return ret;
 #endif
-		spi_flash_addr(erase_addr, cmd);
+			spi_flash_addr(erase_addr, cmd);
 
-		debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0], cmd[1],
-		      cmd[2], cmd[3], erase_addr);
+			debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0],
+			      cmd[1], cmd[2], cmd[3], erase_addr);
 
-		ret = spi_flash_write_common(flash, cmd, sizeof(cmd), NULL, 0);
+			ret = spi_flash_write_common(flash, cmd, sizeof(cmd),
+						     NULL, 0);
+		}
 		if (ret < 0) {
 			debug("SF: erase failed\n");
 			break;
 		}
 
-		offset += erase_size;
-		len -= erase_size;
+		if (stats) {
+			stats->count[kind]++;
+			stats->us[kind] += timer_get_us() - start;
+		}
+		offset += flash->erase_sizes[kind];
+		len -= flash->erase_sizes[kind];
 	}
 
 	return ret;
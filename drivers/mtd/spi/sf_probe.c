@@ -50,7 +50,8 @@ static int spi_flash_set_qeb_mxic(struct spi_flash *flash)
 }
 #endif
 
-#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND) || \
+	defined(CONFIG_SPI_FLASH_GIGADEVICE)
 static int spi_flash_set_qeb_winspan(struct spi_flash *flash)
 {
 	u8 qeb_status;
@@ -79,9 +80,11 @@ static int spi_flash_set_qeb(struct spi_flash *flash, u8 idcode0)
 	case SPI_FLASH_CFI_MFR_MACRONIX:
 		return spi_flash_set_qeb_mxic(flash);
 #endif
-#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND)
+#if defined(CONFIG_SPI_FLASH_SPANSION) || defined(CONFIG_SPI_FLASH_WINBOND) || \
+	defined(CONFIG_SPI_FLASH_GIGADEVICE)
 	case SPI_FLASH_CFI_MFR_SPANSION:
 	case SPI_FLASH_CFI_MFR_WINBOND:
+	case SPI_FLASH_CFI_MFR_GIGADEVICE:
 		return spi_flash_set_qeb_winspan(flash);
 #endif
 #ifdef CONFIG_SPI_FLASH_STMICRO
@@ -95,12 +98,68 @@ static int spi_flash_set_qeb(struct spi_flash *flash, u8 idcode0)
 	}
 }
 
+/*
+ * Pick the fastest read and write cmds that both the flash and the SPI bus
+ * support. Quad cmds need the flash's quad enable bit set, and if that
+ * cannot be done the fastest of the others is used instead.
+ */
+static void spi_flash_select_cmds(struct spi_flash *flash,
+		const struct spi_flash_params *params, u8 idcode0)
+{
+	u8 rd_modes = params->e_rd_cmd & flash->spi->op_mode_rx;
+	int quad_pp = (params->flags & WR_QPP) &&
+		(flash->spi->op_mode_tx & SPI_OPM_TX_QPP);
+	int cmd;
+
+	if (((rd_modes & (QUAD_OUTPUT_FAST | QUAD_IO_FAST)) || quad_pp) &&
+	    spi_flash_set_qeb(flash, idcode0)) {
+		debug("SF: Fail to set QEB for %02x, using 1/2 lines\n",
+		      idcode0);
+		rd_modes &= ~(QUAD_OUTPUT_FAST | QUAD_IO_FAST);
+		quad_pp = 0;
+	}
+
+	cmd = fls(rd_modes);
+	if (cmd)
+		flash->read_cmd = spi_read_cmds_array[cmd - 1];
+	else
+		/* Go for default supported read cmd */
+		flash->read_cmd = CMD_READ_ARRAY_FAST;
+
+	if (quad_pp)
+		flash->write_cmd = CMD_QUAD_PAGE_PROGRAM;
+	else
+		/* Go for default supported write cmd */
+		flash->write_cmd = CMD_PAGE_PROGRAM;
+
+	/*
+	 * Read dummy_byte: dummy byte is determined based on the
+	 * dummy cycles of a particular command.
+	 * Fast commands - dummy_byte = dummy_cycles/8
+	 * I/O commands- dummy_byte = (dummy_cycles * no.of lines)/8
+	 * For I/O commands except cmd[0] everything goes on no.of lines
+	 * based on particular command but incase of fast commands except
+	 * data all go on single line irrespective of command. The I/O
+	 * commands start with 8 mode bits (sent as 0), which count here:
+	 * dual I/O has no other dummy cycles and quad I/O has 4.
+	 */
+	switch (flash->read_cmd) {
+	case CMD_READ_QUAD_IO_FAST:
+		flash->dummy_byte = 3;
+		break;
+	case CMD_READ_ARRAY_SLOW:
+		flash->dummy_byte = 0;
+		break;
+	default:
+		flash->dummy_byte = 1;
+	}
+}
+
 static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		u8 *idcode)
 {
 	const struct spi_flash_params *params;
 	struct spi_flash *flash;
-	u8 cmd;
 	u16 jedec = idcode[1] << 8 | idcode[2];
 	u16 ext_jedec = idcode[3] << 8 | idcode[4];
 
@@ -180,40 +239,21 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		flash->erase_size = flash->sector_size;
 	}
 
-	/* Look for the fastest read cmd */
-	cmd = fls(params->e_rd_cmd & flash->spi->op_mode_rx);
-	if (cmd) {
-		cmd = spi_read_cmds_array[cmd - 1];
-		flash->read_cmd = cmd;
-	} else {
-		/* Go for default supported read cmd */
-		flash->read_cmd = CMD_READ_ARRAY_FAST;
+	/* All the erase cmds the flash supports, for erasing large regions */
+	if (params->flags & SECT_4K) {
+		flash->erase_cmds[SF_ERASE_4K] = CMD_ERASE_4K;
+		flash->erase_sizes[SF_ERASE_4K] = 4096 << flash->shift;
 	}
-
-	/* Not require to look for fastest only two write cmds yet */
-	if (params->flags & WR_QPP && flash->spi->op_mode_tx & SPI_OPM_TX_QPP)
-		flash->write_cmd = CMD_QUAD_PAGE_PROGRAM;
-	else
-		/* Go for default supported write cmd */
-		flash->write_cmd = CMD_PAGE_PROGRAM;
-
-	/* Read dummy_byte: dummy byte is determined based on the
-	 * dummy cycles of a particular command.
-	 * Fast commands - dummy_byte = dummy_cycles/8
-	 * I/O commands- dummy_byte = (dummy_cycles * no.of lines)/8
-	 * For I/O commands except cmd[0] everything goes on no.of lines
-	 * based on particular command but incase of fast commands except
-	 * data all go on single line irrespective of command.
-	 */
-	switch (flash->read_cmd) {
-	case CMD_READ_QUAD_IO_FAST:
-		flash->dummy_byte = 2;
-		break;
-	case CMD_READ_ARRAY_SLOW:
-		flash->dummy_byte = 0;
-		break;
-	default:
-		flash->dummy_byte = 1;
+	if (params->flags & SECT_32K) {
+		flash->erase_cmds[SF_ERASE_32K] = CMD_ERASE_32K;
+		flash->erase_sizes[SF_ERASE_32K] = 32768 << flash->shift;
+	}
+	flash->erase_cmds[SF_ERASE_SECTOR] = CMD_ERASE_64K;
+	flash->erase_sizes[SF_ERASE_SECTOR] = flash->sector_size;
+	/* Multi-die parts (E_FSR) and dual flashes have no single chip erase */
+	if (flash->dual_flash == SF_SINGLE_FLASH && !(params->flags & E_FSR)) {
+		flash->erase_cmds[SF_ERASE_CHIP] = CMD_ERASE_CHIP;
+		flash->erase_sizes[SF_ERASE_CHIP] = flash->size;
 	}
 
 	/* Poll cmd selection */
@@ -250,6 +290,8 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		spi_flash_cmd_write_status(flash, 0);
 #endif
 
+	spi_flash_select_cmds(flash, params, idcode[0]);
+
 	return flash;
 }
 
@@ -312,25 +354,19 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	print_buffer(0, idcode, 1, sizeof(idcode), 0);
 #endif
 
+	/* Register accesses from here on claim the bus themselves */
+	spi_release_bus(spi);
+
 	/* Validate params from spi_flash_params table */
 	flash = spi_flash_validate_params(spi, idcode);
 	if (!flash)
-		goto err_read_id;
-
-	/* Set the quad enable bit - only for quad commands */
-	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
-	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
-		if (spi_flash_set_qeb(flash, idcode[0])) {
-			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
-			return NULL;
-		}
-	}
+		goto err_claim_bus;
 
 #ifdef CONFIG_OF_CONTROL
 	if (spi_flash_decode_fdt(gd->fdt_blob, flash)) {
 		debug("SF: FDT decode error\n");
-		goto err_read_id;
+		free(flash);
+		goto err_claim_bus;
 	}
 #endif
 #ifndef CONFIG_SPL_BUILD
@@ -352,9 +388,6 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	}
 #endif
 
-	/* Release spi bus */
-	spi_release_bus(spi);
-
 	return flash;
 
 err_read_id:
@@ -16,9 +16,8 @@
  * specified, UBI does not attach any MTD device, but it is possible to do
  * later using the "UBI control device".
  *
- * At the moment we only attach UBI devices by scanning, which will become a
- * bottleneck when flashes reach certain large size. Then one may improve UBI
- * and add other methods, although it does not seem to be easy to do.
+ * UBI devices are attached by scanning, which becomes a bottleneck on large
+ * flashes, or from a fastmap if one was written (see fastmap.c).
  */
 
 #ifdef UBI_LINUX
@@ -441,26 +440,41 @@ static void uif_close(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * If there is a valid fastmap, the scanning information is taken from it
+ * instead of reading every PEB. Scanning is still the fall-back if there is
+ * none, or if it does not agree with the volume table.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
+	unsigned long long sqnum;
 	struct ubi_scan_info *si;
 
-	si = ubi_scan(ubi);
+	si = ubi->fm_disabled ? NULL : ubi_scan_fastmap(ubi);
+	if (!si)
+		si = ubi_scan(ubi);
 	if (IS_ERR(si))
 		return PTR_ERR(si);
 
+retry:
 	ubi->bad_peb_count = si->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
 	ubi->max_ec = si->max_ec;
 	ubi->mean_ec = si->mean_ec;
 
+	sqnum = si->max_sqnum;
 	err = ubi_read_volume_table(ubi, si);
+	if (err && ubi->fm && err != -ENOMEM) {
+		/* The fastmap does not agree with the volume table */
+		ubi_warn("bad fastmap, attaching by scanning");
+		ubi_scan_destroy_si(si);
+		ubi_free_fastmap(ubi);
+		ubi->vol_count = ubi->rsvd_pebs = 0;
+		si = ubi_scan(ubi);
+		if (IS_ERR(si))
+			return PTR_ERR(si);
+		goto retry;
+	}
 	if (err)
 		goto out_si;
 
@@ -472,15 +486,26 @@ static int attach_by_scanning(struct ubi_device *ubi)
 	if (err)
 		goto out_eba;
 
+	/* A volume table copy written while attaching is not in the fastmap */
+	if (si->max_sqnum != sqnum) {
+		err = ubi_invalidate_fastmap(ubi);
+		if (err)
+			goto out_wl;
+	}
+
 	ubi_scan_destroy_si(si);
 	return 0;
 
+out_wl:
+	ubi_wl_close(ubi);
+
 out_eba:
 	ubi_eba_close(ubi);
 out_vtbl:
 	vfree(ubi->vtbl);
 out_si:
 	ubi_scan_destroy_si(si);
+	ubi_free_fastmap(ubi);
 	return err;
 }
 
@@ -776,6 +801,16 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	if (err)
 		goto out_free;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	ubi->fm_size = ubi_calc_fm_size(ubi);
+	if (ubi->fm_size > UBI_FM_MAX_BLOCKS * ubi->leb_size) {
+		ubi_warn("device too large for a fastmap");
+		ubi->fm_disabled = 1;
+	}
+#else
+	ubi->fm_disabled = 1;
+#endif
+
 	err = -ENOMEM;
 	ubi->peb_buf1 = vmalloc(ubi->peb_size);
 	if (!ubi->peb_buf1)
@@ -906,6 +941,9 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	if (ubi->bgt_thread)
 		kthread_stop(ubi->bgt_thread);
 
+	/* Leave a fastmap behind so that the next attach is quick */
+	ubi_update_fastmap(ubi);
+
 	uif_close(ubi);
 	ubi_eba_close(ubi);
 	ubi_wl_close(ubi);
@@ -0,0 +1,863 @@
+/*
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+/*
+ * UBI fastmap unit.
+ *
+ * Attaching by scanning reads the EC and VID headers of every physical
+ * eraseblock, which takes a while on a large flash. A fastmap is a snapshot
+ * of what scanning finds - the erase counter of each PEB, which PEBs are
+ * free, used, to be scrubbed or to be erased, and the EBA table of every
+ * volume - stored in a few PEBs. The first of them, the anchor, is one of
+ * the first %UBI_FM_MAX_START PEBs, so attaching only has to look for it
+ * there and then read the fastmap. The on-flash format is the one Linux
+ * uses, see &struct ubi_fm_sb.
+ *
+ * A fastmap describes the flash only as long as nothing is written to it.
+ * Linux keeps pools of PEBs that may be written after the fastmap and reads
+ * their headers when attaching; here the fastmap is simply invalidated -
+ * its PEBs are erased - before the first PEB is taken, returned or moved,
+ * and a new one is written when the device is detached. So the pools of a
+ * fastmap written here are always empty, but the PEBs in the pools of a
+ * fastmap written by Linux are scanned like any other PEB.
+ *
+ * If there is no fastmap, or anything in it does not check out, the device
+ * is attached by scanning.
+ */
+
+#include <ubi_uboot.h>
+#include "ubi.h"
+
+/* Why a device has to be attached by scanning */
+enum {
+	UBI_NO_FASTMAP = 1,
+	UBI_BAD_FASTMAP,
+};
+
+/* What the fastmap says about a PEB */
+enum {
+	FM_PEB_UNSEEN,	/* nothing yet */
+	FM_PEB_LISTED,	/* free, to be erased, or part of the fastmap */
+	FM_PEB_USED,	/* used, waiting for its EBA table entry */
+	FM_PEB_MAPPED,	/* used and in an EBA table */
+};
+
+/**
+ * struct fm_peb - state of a PEB while attaching by fastmap.
+ * @state: %FM_PEB_UNSEEN, %FM_PEB_LISTED, %FM_PEB_USED or %FM_PEB_MAPPED
+ * @scrub: if the PEB is in the scrub list
+ * @ec: erase counter of a used PEB
+ */
+struct fm_peb {
+	unsigned char state;
+	unsigned char scrub;
+	int ec;
+};
+
+/**
+ * ubi_calc_fm_size - calculate the size of a fastmap.
+ * @ubi: UBI device description object
+ *
+ * The fastmap is big enough for every PEB and the largest number of volumes,
+ * rounded up to a whole number of LEBs. It has to be the same as Linux
+ * calculates, as a fastmap of any other size is not accepted.
+ */
+size_t ubi_calc_fm_size(struct ubi_device *ubi)
+{
+	size_t size;
+
+	size = sizeof(struct ubi_fm_sb) +
+		sizeof(struct ubi_fm_hdr) +
+		sizeof(struct ubi_fm_scan_pool) +
+		sizeof(struct ubi_fm_scan_pool) +
+		(ubi->peb_count * sizeof(struct ubi_fm_ec)) +
+		(sizeof(struct ubi_fm_eba) +
+		(ubi->peb_count * sizeof(__be32))) +
+		sizeof(struct ubi_fm_volhdr) * UBI_MAX_VOLUMES;
+
+	return roundup(size, ubi->leb_size);
+}
+
+/**
+ * fm_add_to_list - add a physical eraseblock to a scanning information list.
+ * @list: the list to add to
+ * @pnum: physical eraseblock number
+ * @ec: erase counter
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int fm_add_to_list(struct list_head *list, int pnum, int ec)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/* Account for an erase counter as the scanning unit does */
+static void fm_count_ec(struct ubi_scan_info *si, int ec)
+{
+	si->ec_sum += ec;
+	si->ec_count += 1;
+	if (ec > si->max_ec)
+		si->max_ec = ec;
+	if (ec < si->min_ec)
+		si->min_ec = ec;
+}
+
+/**
+ * fm_find_anchor - find the fastmap super block.
+ * @ubi: UBI device description object
+ * @vh: buffer for a VID header
+ *
+ * Returns the PEB holding the newest fastmap super block, %-ENOENT if there is
+ * none, or a negative error code.
+ */
+static int fm_find_anchor(struct ubi_device *ubi, struct ubi_vid_hdr *vh)
+{
+	unsigned long long sqnum = 0;
+	int pnum, err, anchor = -ENOENT;
+
+	for (pnum = 0; pnum < UBI_FM_MAX_START && pnum < ubi->peb_count;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			return err;
+		if (err)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+		if (be32_to_cpu(vh->vol_id) != UBI_FM_SB_VOLUME_ID)
+			continue;
+
+		if (anchor < 0 || be64_to_cpu(vh->sqnum) > sqnum) {
+			anchor = pnum;
+			sqnum = be64_to_cpu(vh->sqnum);
+		}
+	}
+
+	return anchor;
+}
+
+/**
+ * fm_read - read and check the fastmap.
+ * @ubi: UBI device description object
+ * @fm: the fastmap layout to fill in
+ * @fm_raw: buffer of @ubi->fm_size bytes for the fastmap
+ * @anchor: PEB holding the fastmap super block
+ * @ech: buffer for an EC header
+ * @vh: buffer for a VID header
+ * @sqnum: returns the highest sequence number of the fastmap blocks
+ *
+ * Returns zero in case of success, %UBI_BAD_FASTMAP if the fastmap is not
+ * valid, or a negative error code.
+ */
+static int fm_read(struct ubi_device *ubi, struct ubi_fastmap_layout *fm,
+		   void *fm_raw, int anchor, struct ubi_ec_hdr *ech,
+		   struct ubi_vid_hdr *vh, unsigned long long *sqnum)
+{
+	struct ubi_fm_sb *fmsb = fm_raw;
+	uint32_t crc;
+	int used_blocks, i, pnum, err;
+
+	err = ubi_io_read_data(ubi, fmsb, anchor, 0, sizeof(*fmsb));
+	if (err && err != UBI_IO_BITFLIPS)
+		return err < 0 ? err : UBI_BAD_FASTMAP;
+
+	if (be32_to_cpu(fmsb->magic) != UBI_FM_SB_MAGIC) {
+		ubi_err("bad fastmap super block magic %#08x",
+			be32_to_cpu(fmsb->magic));
+		return UBI_BAD_FASTMAP;
+	}
+	if (fmsb->version != UBI_FM_FMT_VERSION) {
+		ubi_err("unsupported fastmap version %d", fmsb->version);
+		return UBI_BAD_FASTMAP;
+	}
+
+	used_blocks = be32_to_cpu(fmsb->used_blocks);
+	if (used_blocks < 1 || used_blocks > UBI_FM_MAX_BLOCKS ||
+	    used_blocks * ubi->leb_size != ubi->fm_size) {
+		ubi_err("bad fastmap size: %d blocks", used_blocks);
+		return UBI_BAD_FASTMAP;
+	}
+	if (be32_to_cpu(fmsb->block_loc[0]) != anchor) {
+		ubi_err("fastmap does not start at PEB %d", anchor);
+		return UBI_BAD_FASTMAP;
+	}
+
+	*sqnum = 0;
+	for (i = 0; i < used_blocks; i++) {
+		pnum = be32_to_cpu(fmsb->block_loc[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count) {
+			ubi_err("bad fastmap block location %d", pnum);
+			return UBI_BAD_FASTMAP;
+		}
+
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err)
+			return err < 0 ? err : UBI_BAD_FASTMAP;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+		if (err && err != UBI_IO_BITFLIPS) {
+			ubi_err("bad EC header in fastmap PEB %d", pnum);
+			return err < 0 ? err : UBI_BAD_FASTMAP;
+		}
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS) {
+			ubi_err("bad VID header in fastmap PEB %d", pnum);
+			return err < 0 ? err : UBI_BAD_FASTMAP;
+		}
+		if (be32_to_cpu(vh->vol_id) != (i ? UBI_FM_DATA_VOLUME_ID :
+						UBI_FM_SB_VOLUME_ID)) {
+			ubi_err("PEB %d is not fastmap block %d", pnum, i);
+			return UBI_BAD_FASTMAP;
+		}
+		if (be64_to_cpu(vh->sqnum) > *sqnum)
+			*sqnum = be64_to_cpu(vh->sqnum);
+
+		/* The super block is read again so that the CRC covers it */
+		err = ubi_io_read_data(ubi, fm_raw + i * ubi->leb_size, pnum,
+				       0, ubi->leb_size);
+		if (err && err != UBI_IO_BITFLIPS)
+			return err < 0 ? err : UBI_BAD_FASTMAP;
+	}
+
+	crc = be32_to_cpu(fmsb->data_crc);
+	fmsb->data_crc = 0;
+	if (crc32(UBI_CRC32_INIT, fm_raw, ubi->fm_size) != crc) {
+		ubi_err("fastmap data CRC is invalid");
+		return UBI_BAD_FASTMAP;
+	}
+
+	fm->used_blocks = used_blocks;
+	for (i = 0; i < used_blocks; i++) {
+		fm->e[i] = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!fm->e[i])
+			return -ENOMEM;
+		fm->e[i]->pnum = be32_to_cpu(fmsb->block_loc[i]);
+		fm->e[i]->ec = be32_to_cpu(fmsb->block_ec[i]);
+	}
+
+	return 0;
+}
+
+/**
+ * fm_scan_pool - scan the PEBs in a fastmap pool.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @peb: state of each PEB
+ * @fmpl: the pool
+ * @ech: buffer for an EC header
+ * @vh: buffer for a VID header
+ *
+ * The PEBs in a pool may have been written after the fastmap, so they are
+ * added to the scanning information from their headers. Returns zero in case
+ * of success, %UBI_BAD_FASTMAP if the fastmap is not valid, or a negative
+ * error code.
+ */
+static int fm_scan_pool(struct ubi_device *ubi, struct ubi_scan_info *si,
+			struct fm_peb *peb, struct ubi_fm_scan_pool *fmpl,
+			struct ubi_ec_hdr *ech, struct ubi_vid_hdr *vh)
+{
+	int i, pnum, ec, vol_id, err;
+
+	for (i = 0; i < be16_to_cpu(fmpl->size); i++) {
+		pnum = be32_to_cpu(fmpl->pebs[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count ||
+		    peb[pnum].state != FM_PEB_UNSEEN) {
+			ubi_err("bad PEB %d in fastmap pool", pnum);
+			return UBI_BAD_FASTMAP;
+		}
+		peb[pnum].state = FM_PEB_LISTED;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+		if (err && err != UBI_IO_BITFLIPS) {
+			ubi_err("bad EC header in pool PEB %d", pnum);
+			return err < 0 ? err : UBI_BAD_FASTMAP;
+		}
+		ec = be64_to_cpu(ech->ec);
+		fm_count_ec(si, ec);
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err == UBI_IO_PEB_FREE) {
+			err = fm_add_to_list(&si->free, pnum, ec);
+		} else if (!err || err == UBI_IO_BITFLIPS) {
+			vol_id = be32_to_cpu(vh->vol_id);
+			if (vol_id >= UBI_MAX_VOLUMES &&
+			    vol_id != UBI_LAYOUT_VOLUME_ID)
+				err = fm_add_to_list(&si->erase, pnum, ec);
+			else
+				err = ubi_scan_add_used(ubi, si, pnum, ec, vh,
+							err == UBI_IO_BITFLIPS);
+		} else {
+			ubi_err("bad VID header in pool PEB %d", pnum);
+			err = err < 0 ? err : UBI_BAD_FASTMAP;
+		}
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * fm_add_lists - add the PEBs of the fastmap lists to the scanning information.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @peb: state of each PEB
+ * @fec: the fastmap's erase counter entries
+ * @count: number of entries in each list, in %UBI_FM_FREE, %UBI_FM_USED,
+ *         %UBI_FM_SCRUB order, followed by the erase list
+ *
+ * Free and to be erased PEBs go to the lists straight away; used PEBs wait
+ * in @peb for their EBA table entries. Returns zero in case of success,
+ * %UBI_BAD_FASTMAP if the fastmap is not valid, or a negative error code.
+ */
+static int fm_add_lists(struct ubi_device *ubi, struct ubi_scan_info *si,
+			struct fm_peb *peb, struct ubi_fm_ec *fec,
+			const int *count)
+{
+	int list, i, pnum, ec, err;
+
+	for (list = 0; list < 4; list++) {
+		for (i = 0; i < count[list]; i++, fec++) {
+			pnum = be32_to_cpu(fec->pnum);
+			ec = be32_to_cpu(fec->ec);
+			if (pnum < 0 || pnum >= ubi->peb_count ||
+			    peb[pnum].state != FM_PEB_UNSEEN ||
+			    ec < 0 || ec > UBI_MAX_ERASECOUNTER) {
+				ubi_err("bad fastmap entry: PEB %d, EC %d",
+					pnum, ec);
+				return UBI_BAD_FASTMAP;
+			}
+			fm_count_ec(si, ec);
+
+			if (list == UBI_FM_USED || list == UBI_FM_SCRUB) {
+				peb[pnum].state = FM_PEB_USED;
+				peb[pnum].scrub = list == UBI_FM_SCRUB;
+				peb[pnum].ec = ec;
+				continue;
+			}
+
+			peb[pnum].state = FM_PEB_LISTED;
+			err = fm_add_to_list(list == UBI_FM_FREE ? &si->free :
+					     &si->erase, pnum, ec);
+			if (err)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * fm_add_volume - add the LEBs of a volume to the scanning information.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @peb: state of each PEB
+ * @fvh: the fastmap's volume header
+ * @feba: the fastmap's EBA table of the volume
+ * @vh: buffer for a VID header
+ *
+ * Each mapped LEB is added as if its VID header had been read. Returns zero in
+ * case of success, %UBI_BAD_FASTMAP if the fastmap is not valid, or a negative
+ * error code.
+ */
+static int fm_add_volume(struct ubi_device *ubi, struct ubi_scan_info *si,
+			 struct fm_peb *peb, struct ubi_fm_volhdr *fvh,
+			 struct ubi_fm_eba *feba, struct ubi_vid_hdr *vh)
+{
+	int vol_id, lnum, pnum, err;
+
+	vol_id = be32_to_cpu(fvh->vol_id);
+	if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+	    vol_id != UBI_LAYOUT_VOLUME_ID) {
+		ubi_err("bad volume ID %d in fastmap", vol_id);
+		return UBI_BAD_FASTMAP;
+	}
+
+	memset(vh, 0, sizeof(struct ubi_vid_hdr));
+	vh->vol_type = fvh->vol_type == UBI_STATIC_VOLUME ? UBI_VID_STATIC :
+							    UBI_VID_DYNAMIC;
+	if (vol_id == UBI_LAYOUT_VOLUME_ID)
+		vh->compat = UBI_LAYOUT_VOLUME_COMPAT;
+	vh->vol_id = fvh->vol_id;
+	vh->used_ebs = fvh->used_ebs;
+	vh->data_pad = fvh->data_pad;
+	vh->data_size = fvh->last_eb_bytes;
+
+	for (lnum = 0; lnum < be32_to_cpu(feba->reserved_pebs); lnum++) {
+		pnum = be32_to_cpu(feba->pnum[lnum]);
+		if (pnum == UBI_LEB_UNMAPPED)
+			continue;
+		if (pnum < 0 || pnum >= ubi->peb_count ||
+		    peb[pnum].state != FM_PEB_USED) {
+			ubi_err("LEB %d:%d is in PEB %d, which is not used",
+				vol_id, lnum, pnum);
+			return UBI_BAD_FASTMAP;
+		}
+		peb[pnum].state = FM_PEB_MAPPED;
+
+		vh->lnum = cpu_to_be32(lnum);
+		err = ubi_scan_add_used(ubi, si, pnum, peb[pnum].ec, vh,
+					peb[pnum].scrub);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * fm_attach - build the scanning information from the fastmap.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @fm: the fastmap layout
+ * @fm_raw: the fastmap
+ * @ech: buffer for an EC header
+ * @vh: buffer for a VID header
+ *
+ * Returns zero in case of success, %UBI_BAD_FASTMAP if the fastmap is not
+ * valid, or a negative error code.
+ */
+static int fm_attach(struct ubi_device *ubi, struct ubi_scan_info *si,
+		     struct ubi_fastmap_layout *fm, void *fm_raw,
+		     struct ubi_ec_hdr *ech, struct ubi_vid_hdr *vh)
+{
+	struct ubi_fm_hdr *fmh;
+	struct ubi_fm_scan_pool *fmpl[2];
+	struct ubi_fm_volhdr *fvh;
+	struct ubi_fm_eba *feba;
+	struct ubi_scan_volume *sv;
+	struct ubi_scan_leb *seb;
+	struct fm_peb *peb;
+	struct rb_node *rb;
+	size_t fm_pos;
+	int count[4], vol_count, i, pnum, found, err;
+
+	fm_pos = sizeof(struct ubi_fm_sb);
+	fmh = fm_raw + fm_pos;
+	fm_pos += sizeof(*fmh);
+	if (be32_to_cpu(fmh->magic) != UBI_FM_HDR_MAGIC) {
+		ubi_err("bad fastmap header magic %#08x",
+			be32_to_cpu(fmh->magic));
+		return UBI_BAD_FASTMAP;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fmpl[i] = fm_raw + fm_pos;
+		fm_pos += sizeof(struct ubi_fm_scan_pool);
+		if (be32_to_cpu(fmpl[i]->magic) != UBI_FM_POOL_MAGIC ||
+		    be16_to_cpu(fmpl[i]->size) > UBI_FM_MAX_POOL_SIZE) {
+			ubi_err("bad fastmap pool");
+			return UBI_BAD_FASTMAP;
+		}
+	}
+
+	count[UBI_FM_FREE] = be32_to_cpu(fmh->free_peb_count);
+	count[UBI_FM_USED] = be32_to_cpu(fmh->used_peb_count);
+	count[UBI_FM_SCRUB] = be32_to_cpu(fmh->scrub_peb_count);
+	count[3] = be32_to_cpu(fmh->erase_peb_count);
+	vol_count = be32_to_cpu(fmh->vol_count);
+	found = 0;
+	for (i = 0; i < 4; i++) {
+		if (count[i] < 0 || count[i] > ubi->peb_count) {
+			ubi_err("bad PEB count in fastmap");
+			return UBI_BAD_FASTMAP;
+		}
+		found += count[i];
+	}
+	if (fm_pos + found * sizeof(struct ubi_fm_ec) > ubi->fm_size ||
+	    vol_count < 0 || vol_count > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT) {
+		ubi_err("bad fastmap header");
+		return UBI_BAD_FASTMAP;
+	}
+
+	si->bad_peb_count = be32_to_cpu(fmh->bad_peb_count);
+	if (si->bad_peb_count < 0 || si->bad_peb_count > ubi->peb_count) {
+		ubi_err("bad count of bad PEBs in fastmap");
+		return UBI_BAD_FASTMAP;
+	}
+
+	peb = vmalloc(ubi->peb_count * sizeof(struct fm_peb));
+	if (!peb)
+		return -ENOMEM;
+	memset(peb, 0, ubi->peb_count * sizeof(struct fm_peb));
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		pnum = fm->e[i]->pnum;
+		if (peb[pnum].state != FM_PEB_UNSEEN) {
+			ubi_err("PEB %d is in the fastmap twice", pnum);
+			err = UBI_BAD_FASTMAP;
+			goto out;
+		}
+		peb[pnum].state = FM_PEB_LISTED;
+	}
+
+	err = fm_add_lists(ubi, si, peb, fm_raw + fm_pos, count);
+	if (err)
+		goto out;
+	fm_pos += found * sizeof(struct ubi_fm_ec);
+
+	for (i = 0; i < vol_count; i++) {
+		fvh = fm_raw + fm_pos;
+		feba = fm_raw + fm_pos + sizeof(*fvh);
+		if (fm_pos + sizeof(*fvh) + sizeof(*feba) > ubi->fm_size ||
+		    be32_to_cpu(fvh->magic) != UBI_FM_VHDR_MAGIC ||
+		    be32_to_cpu(feba->magic) != UBI_FM_EBA_MAGIC ||
+		    be32_to_cpu(feba->reserved_pebs) > ubi->peb_count) {
+			ubi_err("bad fastmap volume %d", i);
+			err = UBI_BAD_FASTMAP;
+			goto out;
+		}
+		fm_pos += sizeof(*fvh) + sizeof(*feba) +
+			  be32_to_cpu(feba->reserved_pebs) * sizeof(__be32);
+		if (fm_pos > ubi->fm_size) {
+			ubi_err("bad fastmap volume %d", i);
+			err = UBI_BAD_FASTMAP;
+			goto out;
+		}
+
+		err = fm_add_volume(ubi, si, peb, fvh, feba, vh);
+		if (err)
+			goto out;
+	}
+
+	/* Used PEBs which no LEB maps to were on their way to be erased */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (peb[pnum].state != FM_PEB_USED)
+			continue;
+		err = fm_add_to_list(&si->erase, pnum, peb[pnum].ec);
+		if (err)
+			goto out;
+	}
+
+	for (i = 0; i < 2; i++) {
+		err = fm_scan_pool(ubi, si, peb, fmpl[i], ech, vh);
+		if (err)
+			goto out;
+	}
+
+	/* Every good PEB but the fastmap's own must be accounted for */
+	found = 0;
+	list_for_each_entry(seb, &si->free, u.list)
+		found += 1;
+	list_for_each_entry(seb, &si->erase, u.list)
+		found += 1;
+	ubi_rb_for_each_entry(rb, sv, &si->volumes, rb)
+		found += sv->leb_count;
+	if (found != ubi->peb_count - si->bad_peb_count - fm->used_blocks) {
+		ubi_err("fastmap has %d PEBs, expected %d", found,
+			ubi->peb_count - si->bad_peb_count - fm->used_blocks);
+		err = UBI_BAD_FASTMAP;
+	}
+
+out:
+	vfree(peb);
+	return err;
+}
+
+/**
+ * ubi_scan_fastmap - build the scanning information from a fastmap.
+ * @ubi: UBI device description object
+ *
+ * This function looks for a fastmap and, if there is a valid one, returns
+ * the scanning information it holds and sets @ubi->fm. It returns %NULL if
+ * the device has to be attached by scanning and an error pointer in case of
+ * failure.
+ */
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_scan_info *si = NULL;
+	struct ubi_fastmap_layout *fm;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vh;
+	unsigned long long sqnum;
+	void *fm_raw;
+	int anchor, err;
+
+	fm = kzalloc(sizeof(struct ubi_fastmap_layout), GFP_KERNEL);
+	fm_raw = vmalloc(ubi->fm_size);
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!fm || !fm_raw || !ech || !vh) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	anchor = fm_find_anchor(ubi, vh);
+	if (anchor < 0) {
+		err = anchor == -ENOENT ? UBI_NO_FASTMAP : anchor;
+		goto out_free;
+	}
+
+	err = fm_read(ubi, fm, fm_raw, anchor, ech, vh, &sqnum);
+	if (err)
+		goto out_free;
+
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	si->min_ec = UBI_MAX_ERASECOUNTER;
+
+	err = fm_attach(ubi, si, fm, fm_raw, ech, vh);
+	if (err)
+		goto out_free;
+
+	if (si->ec_count) {
+		do_div(si->ec_sum, si->ec_count);
+		si->mean_ec = si->ec_sum;
+	}
+	if (si->max_sqnum < sqnum)
+		si->max_sqnum = sqnum;
+
+	ubi_msg("attaching by fastmap at PEB %d", anchor);
+	ubi->fm = fm;
+	ubi_free_vid_hdr(ubi, vh);
+	kfree(ech);
+	vfree(fm_raw);
+	return si;
+
+out_free:
+	if (si)
+		ubi_scan_destroy_si(si);
+	if (fm) {
+		ubi->fm = fm;
+		ubi_free_fastmap(ubi);
+	}
+	ubi_free_vid_hdr(ubi, vh);
+	kfree(ech);
+	vfree(fm_raw);
+
+	if (err == UBI_NO_FASTMAP) {
+		ubi_msg("no fastmap found");
+		return NULL;
+	}
+	if (err == UBI_BAD_FASTMAP) {
+		ubi_warn("bad fastmap, attaching by scanning");
+		return NULL;
+	}
+	return ERR_PTR(err);
+}
+
+/**
+ * ubi_update_fastmap - write a fastmap of the device as it is now.
+ * @ubi: UBI device description object
+ *
+ * This function does nothing if the fastmap the device was attached with is
+ * still valid or if fastmaps are disabled for the device. Returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+int ubi_update_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm;
+	struct ubi_vid_hdr *vh;
+	struct ubi_fm_sb *fmsb;
+	struct ubi_fm_hdr *fmh;
+	struct ubi_fm_scan_pool *fmpl;
+	struct ubi_fm_volhdr *fvh;
+	struct ubi_fm_eba *feba;
+	struct ubi_volume *vol;
+	void *fm_raw;
+	size_t fm_pos;
+	int i, j, n, pool_size, vol_count, err;
+
+	if (ubi->fm || ubi->fm_disabled || ubi->ro_mode)
+		return 0;
+
+	fm = kzalloc(sizeof(struct ubi_fastmap_layout), GFP_KERNEL);
+	fm_raw = vmalloc(ubi->fm_size);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!fm || !fm_raw || !vh) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	memset(fm_raw, 0, ubi->fm_size);
+
+	/* Taken before the free PEBs are listed, so they are not among them */
+	fm->used_blocks = ubi->fm_size / ubi->leb_size;
+	for (i = 0; i < fm->used_blocks; i++) {
+		fm->e[i] = ubi_wl_get_fm_peb(ubi, i == 0);
+		if (!fm->e[i]) {
+			ubi_err("no free PEB for the fastmap%s",
+				i ? "" : " super block");
+			err = -ENOSPC;
+			goto out_put;
+		}
+	}
+
+	fm_pos = sizeof(struct ubi_fm_sb);
+	fmh = fm_raw + fm_pos;
+	fm_pos += sizeof(*fmh);
+	fmh->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+	fmh->bad_peb_count = cpu_to_be32(ubi->bad_peb_count);
+
+	/* The pools are empty; the sizes are the ones Linux would use */
+	pool_size = ubi->peb_count / 100 * 5;
+	if (pool_size > UBI_FM_MAX_POOL_SIZE)
+		pool_size = UBI_FM_MAX_POOL_SIZE;
+	if (pool_size < UBI_FM_MIN_POOL_SIZE)
+		pool_size = UBI_FM_MIN_POOL_SIZE;
+	for (i = 0; i < 2; i++) {
+		fmpl = fm_raw + fm_pos;
+		fm_pos += sizeof(*fmpl);
+		fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+		fmpl->max_size = cpu_to_be16(i ? pool_size / 2 : pool_size);
+	}
+
+	n = ubi_wl_fm_pebs(ubi, UBI_FM_FREE, fm_raw + fm_pos);
+	fmh->free_peb_count = cpu_to_be32(n);
+	fm_pos += n * sizeof(struct ubi_fm_ec);
+	n = ubi_wl_fm_pebs(ubi, UBI_FM_USED, fm_raw + fm_pos);
+	fmh->used_peb_count = cpu_to_be32(n);
+	fm_pos += n * sizeof(struct ubi_fm_ec);
+	n = ubi_wl_fm_pebs(ubi, UBI_FM_SCRUB, fm_raw + fm_pos);
+	fmh->scrub_peb_count = cpu_to_be32(n);
+	fm_pos += n * sizeof(struct ubi_fm_ec);
+
+	vol_count = 0;
+	for (i = 0; i < UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		if (fm_pos + sizeof(*fvh) + sizeof(*feba) +
+		    vol->reserved_pebs * sizeof(__be32) > ubi->fm_size) {
+			ubi_err("fastmap is too small for volume %d",
+				vol->vol_id);
+			err = -ENOSPC;
+			goto out_put;
+		}
+
+		fvh = fm_raw + fm_pos;
+		fm_pos += sizeof(*fvh);
+		fvh->magic = cpu_to_be32(UBI_FM_VHDR_MAGIC);
+		fvh->vol_id = cpu_to_be32(vol->vol_id);
+		fvh->vol_type = vol->vol_type;
+		fvh->used_ebs = cpu_to_be32(vol->used_ebs);
+		fvh->data_pad = cpu_to_be32(vol->data_pad);
+		fvh->last_eb_bytes = cpu_to_be32(vol->last_eb_bytes);
+
+		feba = fm_raw + fm_pos;
+		fm_pos += sizeof(*feba) + vol->reserved_pebs * sizeof(__be32);
+		feba->magic = cpu_to_be32(UBI_FM_EBA_MAGIC);
+		feba->reserved_pebs = cpu_to_be32(vol->reserved_pebs);
+		for (j = 0; j < vol->reserved_pebs; j++)
+			feba->pnum[j] = cpu_to_be32(vol->eba_tbl[j]);
+		vol_count++;
+	}
+	fmh->vol_count = cpu_to_be32(vol_count);
+
+	fmsb = fm_raw;
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->used_blocks = cpu_to_be32(fm->used_blocks);
+	for (i = 0; i < fm->used_blocks; i++) {
+		fmsb->block_loc[i] = cpu_to_be32(fm->e[i]->pnum);
+		fmsb->block_ec[i] = cpu_to_be32(fm->e[i]->ec);
+	}
+	fmsb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, fm_raw,
+					   ubi->fm_size));
+
+	vh->vol_type = UBI_VID_DYNAMIC;
+	vh->compat = UBI_COMPAT_DELETE;
+	for (i = 0; i < fm->used_blocks; i++) {
+		vh->vol_id = cpu_to_be32(i ? UBI_FM_DATA_VOLUME_ID :
+					 UBI_FM_SB_VOLUME_ID);
+		vh->lnum = cpu_to_be32(i);
+		vh->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+		err = ubi_io_write_vid_hdr(ubi, fm->e[i]->pnum, vh);
+		if (err)
+			goto out_put;
+	}
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		err = ubi_io_write_data(ubi, fm_raw + i * ubi->leb_size,
+					fm->e[i]->pnum, 0, ubi->leb_size);
+		if (err)
+			goto out_put;
+	}
+
+	ubi_msg("fastmap written to PEB %d, %d PEBs", fm->e[0]->pnum,
+		fm->used_blocks);
+	ubi->fm = fm;
+	ubi_free_vid_hdr(ubi, vh);
+	vfree(fm_raw);
+	return 0;
+
+out_put:
+	for (i = 0; i < fm->used_blocks && fm->e[i]; i++)
+		ubi_wl_put_fm_peb(ubi, fm->e[i]);
+out_free:
+	kfree(fm);
+	ubi_free_vid_hdr(ubi, vh);
+	vfree(fm_raw);
+	ubi_err("cannot write fastmap, error %d", err);
+	return err;
+}
+
+/**
+ * ubi_invalidate_fastmap - invalidate the fastmap before the flash changes.
+ * @ubi: UBI device description object
+ *
+ * The fastmap PEBs are erased, the super block first, and returned to the
+ * free PEBs. Returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+int ubi_invalidate_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm = ubi->fm;
+	int i, err, ret = 0;
+
+	if (!fm)
+		return 0;
+
+	/* Cleared first, as erasing the PEBs comes back here */
+	ubi->fm = NULL;
+	dbg_bld("invalidate fastmap at PEB %d", fm->e[0]->pnum);
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		err = ubi_wl_put_fm_peb(ubi, fm->e[i]);
+		if (err && !ret)
+			ret = err;
+	}
+	kfree(fm);
+
+	return ret;
+}
+
+/**
+ * ubi_free_fastmap - free the fastmap layout.
+ * @ubi: UBI device description object
+ */
+void ubi_free_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm = ubi->fm;
+	int i;
+
+	if (!fm)
+		return;
+
+	for (i = 0; i < fm->used_blocks; i++)
+		if (fm->e[i])
+			kmem_cache_free(ubi_wl_entry_slab, fm->e[i]);
+	kfree(fm);
+	ubi->fm = NULL;
+}
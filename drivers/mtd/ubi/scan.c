@@ -836,12 +836,15 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si, int pnum
 		/* Unsupported internal volume */
 		switch (vidh->compat) {
 		case UBI_COMPAT_DELETE:
-			ubi_msg("\"delete\" compatible internal volume %d:%d"
-				" found, remove it", vol_id, lnum);
-			err = add_to_list(si, pnum, ec, &si->corr);
+			/* Scanning means any fastmap is out of date */
+			if (vol_id != UBI_FM_SB_VOLUME_ID &&
+			    vol_id != UBI_FM_DATA_VOLUME_ID)
+				ubi_msg("\"delete\" compatible internal volume"
+					" %d:%d found, remove it", vol_id, lnum);
+			err = add_to_list(si, pnum, ec, &si->erase);
 			if (err)
 				return err;
-			break;
+			goto adjust_mean_ec;
 
 		case UBI_COMPAT_RO:
 			ubi_msg("read-only compatible internal volume %d:%d"
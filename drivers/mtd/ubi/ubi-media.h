@@ -294,6 +294,13 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The fastmap super block and data volumes. They are not in the volume
+ * table; see &struct ubi_fm_sb.
+ */
+#define UBI_FM_SB_VOLUME_ID	(UBI_LAYOUT_VOLUME_ID + 1)
+#define UBI_FM_DATA_VOLUME_ID	(UBI_LAYOUT_VOLUME_ID + 2)
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -357,4 +364,142 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* Fastmap on-flash format version */
+#define UBI_FM_FMT_VERSION	2
+
+/* Fastmap magic numbers */
+#define UBI_FM_SB_MAGIC		0x7B11D69F
+#define UBI_FM_HDR_MAGIC	0xD4B82EF7
+#define UBI_FM_VHDR_MAGIC	0xFA370ED1
+#define UBI_FM_POOL_MAGIC	0x67AF4D08
+#define UBI_FM_EBA_MAGIC	0xf0c040a8
+
+/* The fastmap super block must be in one of the first PEBs */
+#define UBI_FM_MAX_START	64
+
+/* A fastmap takes at most this many PEBs, including the super block */
+#define UBI_FM_MAX_BLOCKS	32
+
+/* Limits of the fastmap pool sizes */
+#define UBI_FM_MIN_POOL_SIZE	8
+#define UBI_FM_MAX_POOL_SIZE	256
+
+/**
+ * struct ubi_fm_sb - fastmap super block.
+ * @magic: fastmap super block magic number (%UBI_FM_SB_MAGIC)
+ * @version: format version of this fastmap
+ * @padding1: reserved, zeroes
+ * @data_crc: CRC32 checksum of the whole fastmap, taken with @data_crc zero
+ * @used_blocks: number of PEBs used by this fastmap
+ * @block_loc: PEB numbers of the fastmap blocks
+ * @block_ec: erase counters of the fastmap blocks
+ * @sqnum: highest sequence number of the fastmap blocks
+ * @padding2: reserved, zeroes
+ *
+ * A fastmap lets UBI attach without reading the headers of every PEB. It is
+ * made of the fastmap super block, which is at the start of the fastmap,
+ * followed by a &struct ubi_fm_hdr, two &struct ubi_fm_scan_pool, the
+ * &struct ubi_fm_ec entries of the free, used, scrub and erase PEBs, and a
+ * &struct ubi_fm_volhdr and &struct ubi_fm_eba for each volume. It fills
+ * @used_blocks LEBs, each written at offset zero of a PEB. The first of them,
+ * the anchor, belongs to volume %UBI_FM_SB_VOLUME_ID and is one of the first
+ * %UBI_FM_MAX_START PEBs; the others belong to %UBI_FM_DATA_VOLUME_ID.
+ */
+struct ubi_fm_sb {
+	__be32 magic;
+	__u8 version;
+	__u8 padding1[3];
+	__be32 data_crc;
+	__be32 used_blocks;
+	__be32 block_loc[UBI_FM_MAX_BLOCKS];
+	__be32 block_ec[UBI_FM_MAX_BLOCKS];
+	__be64 sqnum;
+	__u8 padding2[32];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_hdr - header of the fastmap data.
+ * @magic: fastmap header magic number (%UBI_FM_HDR_MAGIC)
+ * @free_peb_count: number of free PEBs known by this fastmap
+ * @used_peb_count: number of used PEBs known by this fastmap
+ * @scrub_peb_count: number of to be scrubbed PEBs known by this fastmap
+ * @bad_peb_count: number of bad PEBs known by this fastmap
+ * @erase_peb_count: number of PEBs which have to be erased
+ * @vol_count: number of UBI volumes known by this fastmap
+ * @padding: reserved, zeroes
+ */
+struct ubi_fm_hdr {
+	__be32 magic;
+	__be32 free_peb_count;
+	__be32 used_peb_count;
+	__be32 scrub_peb_count;
+	__be32 bad_peb_count;
+	__be32 erase_peb_count;
+	__be32 vol_count;
+	__u8 padding[4];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_scan_pool - fastmap pool of PEBs to be scanned.
+ * @magic: pool magic number (%UBI_FM_POOL_MAGIC)
+ * @size: current pool size
+ * @max_size: maximal pool size
+ * @pebs: PEBs in this pool
+ * @padding: reserved, zeroes
+ *
+ * The PEBs in a pool may have been written after the fastmap, so their
+ * headers are read when attaching.
+ */
+struct ubi_fm_scan_pool {
+	__be32 magic;
+	__be16 size;
+	__be16 max_size;
+	__be32 pebs[UBI_FM_MAX_POOL_SIZE];
+	__be32 padding[4];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_ec - stores the erase counter of a PEB.
+ * @pnum: PEB number
+ * @ec: erase counter
+ */
+struct ubi_fm_ec {
+	__be32 pnum;
+	__be32 ec;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_volhdr - fastmap volume header.
+ * @magic: fastmap volume header magic number (%UBI_FM_VHDR_MAGIC)
+ * @vol_id: volume ID
+ * @vol_type: type of the volume (%UBI_DYNAMIC_VOLUME or %UBI_STATIC_VOLUME)
+ * @padding1: reserved, zeroes
+ * @data_pad: data_pad value of the volume
+ * @used_ebs: number of used LEBs within this volume
+ * @last_eb_bytes: number of bytes used in the last LEB
+ * @padding2: reserved, zeroes
+ */
+struct ubi_fm_volhdr {
+	__be32 magic;
+	__be32 vol_id;
+	__u8 vol_type;
+	__u8 padding1[3];
+	__be32 data_pad;
+	__be32 used_ebs;
+	__be32 last_eb_bytes;
+	__u8 padding2[8];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_fm_eba - denotes an association between a PEB and LEB.
+ * @magic: EBA table magic number (%UBI_FM_EBA_MAGIC)
+ * @reserved_pebs: number of reserved PEBs in this volume
+ * @pnum: PEB of each LEB, or -1 if the LEB is not mapped
+ */
+struct ubi_fm_eba {
+	__be32 magic;
+	__be32 reserved_pebs;
+	__be32 pnum[0];
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
@@ -94,6 +94,13 @@ enum {
 	UBI_IO_BITFLIPS
 };
 
+/* Lists of PEBs in a fastmap, see ubi_wl_fm_pebs() */
+enum {
+	UBI_FM_FREE,
+	UBI_FM_USED,
+	UBI_FM_SCRUB
+};
+
 /**
  * struct ubi_wl_entry - wear-leveling entry.
  * @rb: link in the corresponding RB-tree
@@ -248,6 +255,20 @@ struct ubi_volume_desc {
 
 struct ubi_wl_entry;
 
+/**
+ * struct ubi_fastmap_layout - PEBs holding a fastmap.
+ * @e: wear-leveling entries of the fastmap PEBs, the anchor first
+ * @used_blocks: number of PEBs used by the fastmap
+ *
+ * The fastmap PEBs are in the WL unit's lookup table but in none of its
+ * trees, so that they are neither handed out nor moved while the fastmap
+ * is valid.
+ */
+struct ubi_fastmap_layout {
+	struct ubi_wl_entry *e[UBI_FM_MAX_BLOCKS];
+	int used_blocks;
+};
+
 /**
  * struct ubi_device - UBI device description structure
  * @dev: UBI device object to use the the Linux device model
@@ -284,6 +305,10 @@ struct ubi_wl_entry;
  * @ltree: the lock tree
  * @alc_mutex: serializes "atomic LEB change" operations
  *
+ * @fm: the fastmap this device was attached with, if it is still valid
+ * @fm_size: size of a fastmap in bytes, a whole number of LEBs
+ * @fm_disabled: if no fastmap is to be written for this device
+ *
  * @used: RB-tree of used physical eraseblocks
  * @free: RB-tree of free physical eraseblocks
  * @scrub: RB-tree of physical eraseblocks which need scrubbing
@@ -366,6 +391,11 @@ struct ubi_device {
 	struct rb_root ltree;
 	struct mutex alc_mutex;
 
+	/* Fastmap stuff */
+	struct ubi_fastmap_layout *fm;
+	size_t fm_size;
+	int fm_disabled;
+
 	/* Wear-leveling unit's stuff */
 	struct rb_root used;
 	struct rb_root free;
@@ -484,6 +514,7 @@ int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_eba_close(const struct ubi_device *ubi);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -493,6 +524,23 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor);
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e);
+int ubi_wl_fm_pebs(struct ubi_device *ubi, int list, struct ubi_fm_ec *fec);
+
+/* fastmap.c */
+#ifdef CONFIG_MTD_UBI_FASTMAP
+size_t ubi_calc_fm_size(struct ubi_device *ubi);
+struct ubi_scan_info *ubi_scan_fastmap(struct ubi_device *ubi);
+int ubi_update_fastmap(struct ubi_device *ubi);
+int ubi_invalidate_fastmap(struct ubi_device *ubi);
+void ubi_free_fastmap(struct ubi_device *ubi);
+#else
+#define ubi_scan_fastmap(ubi) NULL
+#define ubi_update_fastmap(ubi) 0
+#define ubi_invalidate_fastmap(ubi) 0
+#define ubi_free_fastmap(ubi)
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -440,6 +440,10 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 	ubi_assert(dtype == UBI_LONGTERM || dtype == UBI_SHORTTERM ||
 		   dtype == UBI_UNKNOWN);
 
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		return err;
+
 	pe = kmalloc(sizeof(struct ubi_wl_prot_entry), GFP_NOFS);
 	if (!pe)
 		return -ENOMEM;
@@ -996,6 +1000,11 @@ static int ensure_wear_leveling(struct ubi_device *ubi)
 	ubi->wl_scheduled = 1;
 	spin_unlock(&ubi->wl_lock);
 
+	/* Moving a LEB changes the EBA table the fastmap holds */
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		goto out_cancel;
+
 	wrk = kmalloc(sizeof(struct ubi_work), GFP_NOFS);
 	if (!wrk) {
 		err = -ENOMEM;
@@ -1110,6 +1119,12 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 	}
 
 	spin_unlock(&ubi->volumes_lock);
+
+	/* The fastmap still has this PEB as a good one */
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		goto out_ro;
+
 	ubi_msg("mark PEB %d as bad", pnum);
 
 	err = ubi_io_mark_bad(ubi, pnum);
@@ -1152,6 +1167,10 @@ int ubi_wl_put_peb(struct ubi_device *ubi, int pnum, int torture)
 	ubi_assert(pnum >= 0);
 	ubi_assert(pnum < ubi->peb_count);
 
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		return err;
+
 retry:
 	spin_lock(&ubi->wl_lock);
 	e = ubi->lookuptbl[pnum];
@@ -1432,7 +1451,7 @@ static void cancel_pending(struct ubi_device *ubi)
  */
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 {
-	int err;
+	int err, i, fm_pebs;
 	struct rb_node *rb1, *rb2;
 	struct ubi_scan_volume *sv;
 	struct ubi_scan_leb *seb, *tmp;
@@ -1523,6 +1542,14 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 		}
 	}
 
+	/* The fastmap PEBs stay out of the trees until it is invalidated */
+	if (ubi->fm) {
+		for (i = 0; i < ubi->fm->used_blocks; i++) {
+			e = ubi->fm->e[i];
+			ubi->lookuptbl[e->pnum] = e;
+		}
+	}
+
 	if (ubi->avail_pebs < WL_RESERVED_PEBS) {
 		ubi_err("no enough physical eraseblocks (%d, need %d)",
 			ubi->avail_pebs, WL_RESERVED_PEBS);
@@ -1532,6 +1559,19 @@ int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si)
 	ubi->avail_pebs -= WL_RESERVED_PEBS;
 	ubi->rsvd_pebs += WL_RESERVED_PEBS;
 
+	/* Room for the fastmap and for the one written after it */
+	if (!ubi->fm_disabled) {
+		fm_pebs = 2 * (ubi->fm_size / ubi->leb_size);
+		if (ubi->avail_pebs < fm_pebs) {
+			ubi_warn("no room for a fastmap (%d PEBs, need %d)",
+				 ubi->avail_pebs, fm_pebs);
+			ubi->fm_disabled = 1;
+		} else {
+			ubi->avail_pebs -= fm_pebs;
+			ubi->rsvd_pebs += fm_pebs;
+		}
+	}
+
 	/* Schedule wear-leveling if needed */
 	err = ensure_wear_leveling(ubi);
 	if (err)
@@ -1594,8 +1634,102 @@ void ubi_wl_close(struct ubi_device *ubi)
 	tree_destroy(&ubi->free);
 	tree_destroy(&ubi->scrub);
 	kfree(ubi->lookuptbl);
+	ubi_free_fastmap(ubi);
+}
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+
+/**
+ * ubi_wl_get_fm_peb - get a free physical eraseblock for a fastmap.
+ * @ubi: UBI device description object
+ * @anchor: if the PEB is for the fastmap super block
+ *
+ * The super block has to be in one of the first %UBI_FM_MAX_START PEBs, so
+ * for it the least worn free PEB among those is taken. The PEB is removed from
+ * the free tree but stays in the lookup table. Returns %NULL if there is no
+ * suitable free PEB.
+ */
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int anchor)
+{
+	struct ubi_wl_entry *e = NULL, *e1;
+	struct rb_node *rb;
+
+	spin_lock(&ubi->wl_lock);
+	if (!ubi->free.rb_node)
+		goto out_unlock;
+
+	if (anchor) {
+		ubi_rb_for_each_entry(rb, e1, &ubi->free, rb) {
+			if (e1->pnum < UBI_FM_MAX_START &&
+			    (!e || e1->ec < e->ec))
+				e = e1;
+		}
+	} else
+		e = find_wl_entry(&ubi->free, WL_FREE_MAX_DIFF);
+
+	if (e) {
+		paranoid_check_in_wl_tree(e, &ubi->free);
+		rb_erase(&e->rb, &ubi->free);
+		dbg_wl("PEB %d EC %d for the fastmap", e->pnum, e->ec);
+	}
+
+out_unlock:
+	spin_unlock(&ubi->wl_lock);
+	return e;
+}
+
+/**
+ * ubi_wl_put_fm_peb - return a fastmap physical eraseblock.
+ * @ubi: UBI device description object
+ * @e: the WL entry of the PEB
+ *
+ * The PEB is erased and goes back to the free tree. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	dbg_wl("PEB %d", e->pnum);
+	return schedule_erase(ubi, e, 0);
 }
 
+/**
+ * ubi_wl_fm_pebs - list physical eraseblocks for a fastmap.
+ * @ubi: UBI device description object
+ * @list: which PEBs to list (%UBI_FM_FREE, %UBI_FM_USED or %UBI_FM_SCRUB)
+ * @fec: where to store the PEB numbers and erase counters
+ *
+ * The used PEBs include the protected ones. Returns the number of PEBs
+ * stored.
+ */
+int ubi_wl_fm_pebs(struct ubi_device *ubi, int list, struct ubi_fm_ec *fec)
+{
+	struct rb_root *root;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+	struct ubi_wl_prot_entry *pe;
+	int n = 0;
+
+	spin_lock(&ubi->wl_lock);
+	root = list == UBI_FM_FREE ? &ubi->free :
+	       list == UBI_FM_USED ? &ubi->used : &ubi->scrub;
+	ubi_rb_for_each_entry(rb, e, root, rb) {
+		fec[n].pnum = cpu_to_be32(e->pnum);
+		fec[n++].ec = cpu_to_be32(e->ec);
+	}
+
+	if (list == UBI_FM_USED) {
+		ubi_rb_for_each_entry(rb, pe, &ubi->prot.pnum, rb_pnum) {
+			fec[n].pnum = cpu_to_be32(pe->e->pnum);
+			fec[n++].ec = cpu_to_be32(pe->e->ec);
+		}
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	return n;
+}
+
+#endif /* CONFIG_MTD_UBI_FASTMAP */
+
 #ifdef CONFIG_MTD_UBI_DEBUG_PARANOID
 
 /**
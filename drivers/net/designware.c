@@ -336,22 +336,28 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static int dw_eth_recv(struct eth_device *dev)
+/* Hand up the frames in every descriptor the DMA has given back to us */
+static int dw_eth_recv_batch(struct eth_device *dev, struct eth_rx_desc *desc,
+			     int count)
 {
 	struct dw_eth_dev *priv = dev->priv;
 	u32 status, desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	int length = 0;
+	struct dmamacdescr *desc_p;
+	int length, n;
+
+	for (n = 0; n < min(count, CONFIG_RX_DESCR_NUM); n++) {
+		desc_p = &priv->rx_mac_descrtable[desc_num];
 
-	/* Invalidate entire buffer descriptor */
-	invalidate_dcache_range((unsigned long)desc_p,
-				(unsigned long)desc_p +
-				sizeof(struct dmamacdescr));
+		/* Invalidate entire buffer descriptor */
+		invalidate_dcache_range((unsigned long)desc_p,
+					(unsigned long)desc_p +
+					sizeof(struct dmamacdescr));
 
-	status = desc_p->txrx_status;
+		status = desc_p->txrx_status;
 
-	/* Check  if the owner is the CPU */
-	if (!(status & DESC_RXSTS_OWNBYDMA)) {
+		/* Check  if the owner is the CPU */
+		if (status & DESC_RXSTS_OWNBYDMA)
+			break;
 
 		length = (status & DESC_RXSTS_FRMLENMSK) >> \
 			 DESC_RXSTS_FRMLENSHFT;
@@ -361,18 +367,9 @@ static int dw_eth_recv(struct eth_device *dev)
 					(unsigned long)desc_p->dmamac_addr +
 					roundup(length, ARCH_DMA_MINALIGN));
 
-		NetReceive(desc_p->dmamac_addr, length);
-
-		/*
-		 * Make the current descriptor valid again and go to
-		 * the next one
-		 */
-		desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
-
-		/* Flush only status field - others weren't changed */
-		flush_dcache_range((unsigned long)&desc_p->txrx_status,
-				   (unsigned long)&desc_p->txrx_status +
-				   sizeof(desc_p->txrx_status));
+		desc[n].packet = desc_p->dmamac_addr;
+		desc[n].length = length;
+		desc[n].priv = desc_p;
 
 		/* Test the wrap-around condition. */
 		if (++desc_num >= CONFIG_RX_DESCR_NUM)
@@ -381,7 +378,20 @@ static int dw_eth_recv(struct eth_device *dev)
 
 	priv->rx_currdescnum = desc_num;
 
-	return length;
+	return n;
+}
+
+static void dw_eth_free_pkt(struct eth_device *dev, struct eth_rx_desc *desc)
+{
+	struct dmamacdescr *desc_p = desc->priv;
+
+	/* Make the descriptor valid again */
+	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+
+	/* Flush only status field - others weren't changed */
+	flush_dcache_range((unsigned long)&desc_p->txrx_status,
+			   (unsigned long)&desc_p->txrx_status +
+			   sizeof(desc_p->txrx_status));
 }
 
 static int dw_phy_init(struct eth_device *dev)
@@ -443,7 +453,8 @@ int designware_initialize(ulong base_addr, u32 interface)
 
 	dev->init = dw_eth_init;
 	dev->send = dw_eth_send;
-	dev->recv = dw_eth_recv;
+	dev->recv_batch = dw_eth_recv_batch;
+	dev->free_pkt = dw_eth_free_pkt;
 	dev->halt = dw_eth_halt;
 	dev->write_hwaddr = dw_write_hwaddr;
 
@@ -8,8 +8,12 @@
 #ifndef _DW_ETH_H
 #define _DW_ETH_H
 
+#ifndef CONFIG_TX_DESCR_NUM
 #define CONFIG_TX_DESCR_NUM	16
+#endif
+#ifndef CONFIG_RX_DESCR_NUM
 #define CONFIG_RX_DESCR_NUM	16
+#endif
 #define CONFIG_ETH_BUFSIZE	2048
 #define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
 #define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
@@ -0,0 +1,1009 @@
+/*
+ * Sandbox Ethernet driver
+ *
+ * The device can be connected to one of several peers:
+ *
+ * loop - an emulated host on the other end of the wire which answers ARP
+ *	requests and serves files from a directory on the host over TFTP.
+ *	The round trip time of the link and a packet loss rate can be set,
+ *	so that the network stack and the TFTP client can be exercised and
+ *	timed without any hardware.
+ * raw, tap - a real network, through a packet socket bound to a host
+ *	interface or through a host TAP interface.
+ * pcap - a recorded session, replayed from a pcap file in lockstep with
+ *	the packets U-Boot sends.
+ *
+ * Any session can also be recorded to a pcap file. The time U-Boot spends
+ * on each received packet and the time it takes to answer one are kept
+ * and shown by 'sb eth'.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <net.h>
+#include <netdev.h>
+#include <os.h>
+#include <asm/eth.h>
+#include <asm/getopt.h>
+#include <asm/state.h>
+#include <asm/unaligned.h>
+#ifdef CONFIG_ETH_SANDBOX_RAW
+#include <asm/eth-raw-os.h>
+#endif
+
+/* Number of ARP / OACK / ERROR replies which can be waiting */
+#define SB_ETH_QUEUE_LEN	8
+
+/* TFTP opcodes and the port our emulated server sends data from */
+#define TFTP_RRQ		1
+#define TFTP_DATA		3
+#define TFTP_ACK		4
+#define TFTP_ERROR		5
+#define TFTP_OACK		6
+#define TFTPD_PORT		69
+#define TFTPD_TID		1069
+/* Largest block which fits in an Ethernet frame without fragmentation */
+#define TFTPD_MAX_BLKSIZE	1468
+
+/* Offsets in a BOOTP message of the transaction ID and client address */
+#define BOOTP_XID		4
+#define BOOTP_CHADDR		28
+#define BOOTP_SERVER_PORT	67
+
+/* pcap file format, with microsecond timestamps and Ethernet frames */
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET	1
+
+struct pcap_hdr {
+	u32 magic;
+	u16 version_major;
+	u16 version_minor;
+	s32 thiszone;
+	u32 sigfigs;
+	u32 snaplen;
+	u32 network;
+};
+
+struct pcap_rec_hdr {
+	u32 ts_sec;
+	u32 ts_usec;
+	u32 incl_len;
+	u32 orig_len;
+};
+
+/* Number of port and BOOTP transaction ID translations kept by replay */
+#define SB_ETH_MAP_LEN		8
+
+/* MAC address of the U-Boot side and of the emulated host */
+static const uchar sb_eth_addr[6] = { 0x02, 0x00, 0x11, 0x22, 0x33, 0x44 };
+static const uchar sb_peer_addr[6] = { 0x02, 0x00, 0x11, 0x22, 0x33, 0x55 };
+
+enum sb_eth_backend {
+	SB_ETH_LOOP,
+	SB_ETH_RAW,
+	SB_ETH_TAP,
+	SB_ETH_PCAP,
+};
+
+static const char * const sb_eth_backend_name[] = {
+	"loop", "raw", "tap", "pcap",
+};
+
+struct sb_eth_pkt {
+	int len;
+	uint64_t ready;			/* Time (ns) at which it arrives */
+	uchar data[PKTSIZE_ALIGN];
+};
+
+/* Latency of one kind of event, in nanoseconds */
+struct sb_eth_stat {
+	ulong count;
+	uint64_t bytes;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+};
+
+/* A value seen in the recording and the one U-Boot uses instead */
+struct sb_eth_map {
+	u32 from;
+	u32 to;
+};
+
+/* State of the pcap file being replayed */
+struct sb_pcap {
+	int fd;				/* -1 if not open yet */
+	int swap;			/* File has the other byte order */
+	uchar mac[6];			/* Address of the recorded U-Boot */
+	struct sb_eth_pkt next;		/* Next record, len 0 at the end */
+	struct sb_eth_map port[SB_ETH_MAP_LEN];
+	struct sb_eth_map xid[SB_ETH_MAP_LEN];
+	ulong unmatched;		/* Packets sent out of step */
+};
+
+/* State of the one TFTP read transfer the emulated host can serve */
+struct sb_tftpd {
+	int fd;				/* File being served, -1 if idle */
+	ulong size;			/* Its size in bytes */
+	IPaddr_t client_ip;
+	IPaddr_t server_ip;
+	uchar client_mac[6];
+	int client_port;
+	unsigned blksize;
+	unsigned windowsize;
+	ulong next;			/* Next block to send */
+	ulong last;			/* Final block (shorter than blksize) */
+	unsigned left;			/* Blocks left in the current window */
+	uint64_t ready;			/* Time (ns) the window can be sent */
+};
+
+static struct sb_eth {
+	struct eth_device *dev;
+	enum sb_eth_backend backend;
+	char name[256];			/* Directory, interface or pcap file */
+	unsigned delay_us;		/* Round trip time of the link */
+	unsigned drop;			/* Drop every n-th DATA packet */
+	unsigned rate;			/* Link rate in Mbit/s, 0 for no limit */
+	unsigned data_count;		/* DATA packets sent so far */
+	struct sb_eth_pkt queue[SB_ETH_QUEUE_LEN];
+	int head, tail;
+	struct sb_tftpd tftpd;
+#ifdef CONFIG_ETH_SANDBOX_RAW
+	struct eth_sandbox_raw_priv raw;
+#endif
+	struct sb_pcap replay;
+	char record_name[256];		/* pcap file to record to, if any */
+	int record_fd;
+	int rx_pending;			/* Packets handed up, not yet freed */
+	uint64_t rx_start;		/* NetReceive() entry time, or 0 */
+	struct sb_eth_stat rx;		/* Time spent in NetReceive() */
+	struct sb_eth_stat tx;		/* Time taken to send a packet */
+	struct sb_eth_stat reply;	/* From a packet to the answer */
+} sb_eth = {
+	.name = ".",
+	.tftpd.fd = -1,
+#ifdef CONFIG_ETH_SANDBOX_RAW
+	.raw.sd = -1,
+#endif
+	.replay.fd = -1,
+	.record_fd = -1,
+};
+
+static uint64_t sb_eth_arrival(void)
+{
+	return os_get_nsec() + sb_eth.delay_us * 1000ULL;
+}
+
+/* Return the next free slot in the reply queue, or NULL if it is full */
+static struct sb_eth_pkt *sb_eth_queue_get(void)
+{
+	int next = (sb_eth.tail + 1) % SB_ETH_QUEUE_LEN;
+
+	if (next == sb_eth.head) {
+		debug("%s: reply queue full\n", __func__);
+		return NULL;
+	}
+
+	return &sb_eth.queue[sb_eth.tail];
+}
+
+static void sb_eth_queue_put(struct sb_eth_pkt *pkt, int len)
+{
+	pkt->len = len;
+	pkt->ready = sb_eth_arrival();
+	sb_eth.tail = (sb_eth.tail + 1) % SB_ETH_QUEUE_LEN;
+}
+
+/*
+ * Fill in the Ethernet, IP and UDP headers of a packet sent by the
+ * emulated host to the client of the current TFTP transfer.
+ * Return a pointer to the UDP payload.
+ */
+static uchar *sb_eth_udp_hdr(uchar *pkt, int src_port, int payload_len)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	struct ethernet_hdr *eth = (struct ethernet_hdr *)pkt;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	static ushort ip_id;
+
+	memcpy(eth->et_dest, tftpd->client_mac, 6);
+	memcpy(eth->et_src, sb_peer_addr, 6);
+	eth->et_protlen = htons(PROT_IP);
+
+	ip->ip_hl_v = 0x45;
+	ip->ip_tos = 0;
+	ip->ip_len = htons(IP_UDP_HDR_SIZE + payload_len);
+	ip->ip_id = htons(ip_id++);
+	ip->ip_off = htons(IP_FLAGS_DFRAG);
+	ip->ip_ttl = 255;
+	ip->ip_p = IPPROTO_UDP;
+	ip->ip_sum = 0;
+	NetCopyIP((void *)&ip->ip_src, &tftpd->server_ip);
+	NetCopyIP((void *)&ip->ip_dst, &tftpd->client_ip);
+	ip->ip_sum = ~NetCksum((uchar *)ip, IP_HDR_SIZE >> 1);
+	ip->udp_src = htons(src_port);
+	ip->udp_dst = htons(tftpd->client_port);
+	ip->udp_len = htons(UDP_HDR_SIZE + payload_len);
+	ip->udp_xsum = 0;
+
+	return pkt + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+}
+
+static void sb_tftpd_error(int src_port, int code, const char *msg)
+{
+	struct sb_eth_pkt *pkt = sb_eth_queue_get();
+	int len = 4 + strlen(msg) + 1;
+	uchar *p;
+
+	if (!pkt)
+		return;
+	p = sb_eth_udp_hdr(pkt->data, src_port, len);
+	put_unaligned_be16(TFTP_ERROR, p);
+	put_unaligned_be16(code, p + 2);
+	strcpy((char *)p + 4, msg);
+	sb_eth_queue_put(pkt, p + len - pkt->data);
+}
+
+static void sb_tftpd_close(void)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+
+	if (tftpd->fd >= 0)
+		os_close(tftpd->fd);
+	tftpd->fd = -1;
+	tftpd->left = 0;
+}
+
+/* Start sending a new window of blocks, beginning with 'block' */
+static void sb_tftpd_window(ulong block)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+
+	tftpd->next = block;
+	tftpd->left = tftpd->windowsize;
+	tftpd->ready = sb_eth_arrival();
+}
+
+/* Handle a read request, answering with an OACK, the first block or ERROR */
+static void sb_tftpd_rrq(uchar *pkt, int len)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	char *end = (char *)pkt + len;
+	char *filename, *opt, *val;
+	char path[512];
+	char oack[128];
+	int oack_len = 0;
+	off_t size;
+
+	sb_tftpd_close();
+	tftpd->blksize = 512;
+	tftpd->windowsize = 1;
+
+	filename = (char *)pkt + 2;
+	if (strnlen(filename, end - filename) == end - filename)
+		return;
+	/* Skip the transfer mode; only octet is supported */
+	opt = filename + strlen(filename) + 1;
+	if (opt < end)
+		opt += strnlen(opt, end - opt) + 1;
+
+	/* Options come as name/value string pairs */
+	while (opt < end && (val = opt + strnlen(opt, end - opt) + 1) < end) {
+		ulong v = simple_strtoul(val, NULL, 10);
+
+		if (!strcmp(opt, "blksize") && v >= 8) {
+			tftpd->blksize = min(v, (ulong)TFTPD_MAX_BLKSIZE);
+			oack_len += sprintf(oack + oack_len, "blksize%c%u%c",
+					    0, tftpd->blksize, 0);
+		} else if (!strcmp(opt, "windowsize") && v >= 1) {
+			tftpd->windowsize = min(v, 65535UL);
+			oack_len += sprintf(oack + oack_len, "windowsize%c%u%c",
+					    0, tftpd->windowsize, 0);
+		}
+		opt = val + strnlen(val, end - val) + 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", sb_eth.name, filename);
+	tftpd->fd = os_open(path, OS_O_RDONLY);
+	if (tftpd->fd < 0) {
+		sb_tftpd_error(TFTPD_TID, 1, "File not found");
+		return;
+	}
+	size = os_lseek(tftpd->fd, 0, OS_SEEK_END);
+	if (size < 0) {
+		sb_tftpd_close();
+		sb_tftpd_error(TFTPD_TID, 0, "Cannot read file");
+		return;
+	}
+	tftpd->size = size;
+	tftpd->last = tftpd->size / tftpd->blksize + 1;
+	debug("%s: '%s', %lu bytes, blksize %u, windowsize %u\n", __func__,
+	      path, tftpd->size, tftpd->blksize, tftpd->windowsize);
+
+	if (oack_len) {
+		struct sb_eth_pkt *reply = sb_eth_queue_get();
+		uchar *p;
+
+		if (!reply) {
+			sb_tftpd_close();
+			return;
+		}
+		p = sb_eth_udp_hdr(reply->data, TFTPD_TID, 2 + oack_len);
+		put_unaligned_be16(TFTP_OACK, p);
+		memcpy(p + 2, oack, oack_len);
+		sb_eth_queue_put(reply, p + 2 + oack_len - reply->data);
+		/* Wait for ACK 0 before sending data */
+		tftpd->next = 1;
+	} else {
+		sb_tftpd_window(1);
+	}
+}
+
+/* Handle an ACK: the client wants everything after the acked block */
+static void sb_tftpd_ack(uchar *pkt, int len)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	ulong block;
+
+	if (tftpd->fd < 0 || len < 4)
+		return;
+
+	/* Expand the 16-bit block number to the one we last sent */
+	block = tftpd->next - 1;
+	block -= (block - get_unaligned_be16(pkt + 2)) & 0xffff;
+
+	if (block >= tftpd->last)
+		sb_tftpd_close();
+	else
+		sb_tftpd_window(block + 1);
+}
+
+static void sb_eth_rx_udp(uchar *pkt, int len)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	uchar *data = pkt + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	int data_len = len - ETHER_HDR_SIZE - IP_UDP_HDR_SIZE;
+	int port = ntohs(ip->udp_dst);
+	int opcode;
+
+	if (data_len < 2 || (port != TFTPD_PORT && port != TFTPD_TID))
+		return;
+
+	opcode = get_unaligned_be16(data);
+	if (port == TFTPD_PORT && opcode == TFTP_RRQ) {
+		memcpy(tftpd->client_mac, pkt + 6, 6);
+		tftpd->client_ip = NetReadIP(&ip->ip_src);
+		tftpd->server_ip = NetReadIP(&ip->ip_dst);
+		tftpd->client_port = ntohs(ip->udp_src);
+		sb_tftpd_rrq(data, data_len);
+	} else if (port == TFTPD_TID && opcode == TFTP_ACK) {
+		sb_tftpd_ack(data, data_len);
+	} else if (port == TFTPD_TID && opcode == TFTP_ERROR) {
+		sb_tftpd_close();
+	}
+}
+
+/* Answer ARP requests for any address other than the sender's own */
+static void sb_eth_rx_arp(uchar *pkt, int len)
+{
+	struct arp_hdr *arp = (struct arp_hdr *)(pkt + ETHER_HDR_SIZE);
+	struct sb_eth_pkt *reply;
+	struct ethernet_hdr *eth;
+	struct arp_hdr *rarp;
+
+	if (len < ETHER_HDR_SIZE + ARP_HDR_SIZE ||
+	    ntohs(arp->ar_op) != ARPOP_REQUEST ||
+	    NetReadIP(&arp->ar_tpa) == NetReadIP(&arp->ar_spa))
+		return;
+
+	reply = sb_eth_queue_get();
+	if (!reply)
+		return;
+	eth = (struct ethernet_hdr *)reply->data;
+	memcpy(eth->et_dest, &arp->ar_sha, 6);
+	memcpy(eth->et_src, sb_peer_addr, 6);
+	eth->et_protlen = htons(PROT_ARP);
+	rarp = (struct arp_hdr *)(reply->data + ETHER_HDR_SIZE);
+	memcpy(rarp, arp, ARP_HDR_SIZE);
+	rarp->ar_op = htons(ARPOP_REPLY);
+	memcpy(&rarp->ar_tha, &arp->ar_sha, ARP_HLEN);
+	NetCopyIP(&rarp->ar_tpa, &arp->ar_spa);
+	memcpy(&rarp->ar_sha, sb_peer_addr, ARP_HLEN);
+	NetCopyIP(&rarp->ar_spa, &arp->ar_tpa);
+	sb_eth_queue_put(reply, ETHER_HDR_SIZE + ARP_HDR_SIZE);
+}
+
+/* Build the next DATA block of the current window into the rx buffer */
+static int sb_tftpd_data(uchar *buf)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	ulong offset = (tftpd->next - 1) * tftpd->blksize;
+	int len = min(tftpd->size - offset, (ulong)tftpd->blksize);
+	uchar *p;
+
+	p = sb_eth_udp_hdr(buf, TFTPD_TID, 4 + len);
+	put_unaligned_be16(TFTP_DATA, p);
+	put_unaligned_be16(tftpd->next & 0xffff, p + 2);
+	if (os_lseek(tftpd->fd, offset, OS_SEEK_SET) != offset ||
+	    os_read(tftpd->fd, p + 4, len) != len) {
+		sb_tftpd_close();
+		return 0;
+	}
+
+	if (++tftpd->next > tftpd->last)
+		tftpd->left = 0;
+	else
+		tftpd->left--;
+
+	return p + 4 + len - buf;
+}
+
+
+static void sb_eth_stat_add(struct sb_eth_stat *stat, int len, uint64_t ns)
+{
+	if (!stat->count || ns < stat->min)
+		stat->min = ns;
+	if (ns > stat->max)
+		stat->max = ns;
+	stat->count++;
+	stat->bytes += len;
+	stat->total += ns;
+}
+
+static int sb_eth_record_open(void)
+{
+	struct pcap_hdr hdr = {
+		.magic = PCAP_MAGIC,
+		.version_major = 2,
+		.version_minor = 4,
+		.snaplen = PKTSIZE_ALIGN,
+		.network = PCAP_LINKTYPE_ETHERNET,
+	};
+
+	sb_eth.record_fd = os_open(sb_eth.record_name,
+				   OS_O_WRONLY | OS_O_CREAT | OS_O_TRUNC);
+	if (sb_eth.record_fd < 0 ||
+	    os_write(sb_eth.record_fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		printf("sb_eth: cannot create '%s'\n", sb_eth.record_name);
+		if (sb_eth.record_fd >= 0)
+			os_close(sb_eth.record_fd);
+		sb_eth.record_fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Append a packet to the recording, if there is one */
+static void sb_eth_record(const void *packet, int len)
+{
+	struct pcap_rec_hdr rec;
+	uint64_t now;
+
+	if (sb_eth.record_fd < 0)
+		return;
+
+	now = os_get_nsec();
+	rec.ts_sec = now / 1000000000;
+	rec.ts_usec = now % 1000000000 / 1000;
+	rec.incl_len = len;
+	rec.orig_len = len;
+	if (os_write(sb_eth.record_fd, &rec, sizeof(rec)) != sizeof(rec) ||
+	    os_write(sb_eth.record_fd, packet, len) != len) {
+		printf("sb_eth: cannot write to '%s'\n", sb_eth.record_name);
+		os_close(sb_eth.record_fd);
+		sb_eth.record_fd = -1;
+		sb_eth.record_name[0] = '\0';
+	}
+}
+
+static int sb_eth_is_udp(const uchar *pkt, int len)
+{
+	const struct ethernet_hdr *eth = (const struct ethernet_hdr *)pkt;
+	const struct ip_udp_hdr *ip;
+
+	ip = (const struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+
+	return len >= ETHER_HDR_SIZE + IP_UDP_HDR_SIZE &&
+		ntohs(eth->et_protlen) == PROT_IP &&
+		ip->ip_hl_v == 0x45 && ip->ip_p == IPPROTO_UDP;
+}
+
+static void sb_loop_send(void *packet, int length)
+{
+	struct ethernet_hdr *eth = packet;
+
+	if (length < ETHER_HDR_SIZE)
+		return;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		sb_eth_rx_arp(packet, length);
+	else if (sb_eth_is_udp(packet, length))
+		sb_eth_rx_udp(packet, length);
+}
+
+/* Fetch a packet which has made it across the link, returning its length */
+static int sb_loop_recv(uchar *buf)
+{
+	struct sb_tftpd *tftpd = &sb_eth.tftpd;
+	uint64_t now = os_get_nsec();
+	struct sb_eth_pkt *pkt;
+	int len;
+
+	if (sb_eth.head != sb_eth.tail) {
+		pkt = &sb_eth.queue[sb_eth.head];
+		if (pkt->ready > now)
+			return 0;
+		memcpy(buf, pkt->data, pkt->len);
+		sb_eth.head = (sb_eth.head + 1) % SB_ETH_QUEUE_LEN;
+		return pkt->len;
+	}
+
+	if (tftpd->fd < 0 || !tftpd->left || tftpd->ready > now)
+		return 0;
+
+	len = sb_tftpd_data(buf);
+	if (!len)
+		return 0;
+	/* The rest of the window follows at the link rate */
+	if (sb_eth.rate)
+		tftpd->ready += len * 8000ULL / sb_eth.rate;
+	if (sb_eth.drop && ++sb_eth.data_count % sb_eth.drop == 0) {
+		debug("%s: dropping block %lu\n", __func__, tftpd->next - 1);
+		return 0;
+	}
+
+	return len;
+}
+
+#ifdef CONFIG_ETH_SANDBOX_RAW
+static int sb_raw_recv(uchar *buf)
+{
+	struct ethernet_hdr *eth = (struct ethernet_hdr *)buf;
+	uchar *enetaddr = sb_eth.dev->enetaddr;
+	int len;
+
+	/* A packet socket sees all traffic on the interface, even our own */
+	do {
+		len = sandbox_eth_raw_os_recv(buf, PKTSIZE_ALIGN, &sb_eth.raw);
+		if (len < 0 || len < ETHER_HDR_SIZE)
+			return 0;
+	} while (!memcmp(eth->et_src, enetaddr, 6) ||
+		 (memcmp(eth->et_dest, enetaddr, 6) &&
+		  !is_multicast_ether_addr(eth->et_dest)));
+
+	return len;
+}
+#endif
+
+static u32 sb_pcap_u32(u32 val)
+{
+	return sb_eth.replay.swap ? __swab32(val) : val;
+}
+
+/* Read the next record of the replay, leaving len 0 at the end */
+static void sb_pcap_next(void)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+	struct pcap_rec_hdr rec;
+	u32 len;
+
+	replay->next.len = 0;
+	while (os_read(replay->fd, &rec, sizeof(rec)) == sizeof(rec)) {
+		len = sb_pcap_u32(rec.incl_len);
+		if (len >= ETHER_HDR_SIZE && len <= PKTSIZE_ALIGN) {
+			if (os_read(replay->fd, replay->next.data, len) == len)
+				replay->next.len = len;
+			return;
+		}
+		/* Skip frames which cannot have come from this driver */
+		if (os_lseek(replay->fd, len, OS_SEEK_CUR) < 0)
+			return;
+	}
+}
+
+/* Was the next record sent by the recorded U-Boot? */
+static int sb_pcap_outgoing(void)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+
+	return !memcmp(replay->next.data + 6, replay->mac, 6);
+}
+
+static int sb_pcap_open(void)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+	struct pcap_hdr hdr;
+
+	replay->fd = os_open(sb_eth.name, OS_O_RDONLY);
+	if (replay->fd < 0) {
+		printf("sb_eth: cannot open '%s'\n", sb_eth.name);
+		return -1;
+	}
+
+	if (os_read(replay->fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+		hdr.magic = 0;
+	replay->swap = hdr.magic == __swab32(PCAP_MAGIC) ||
+		       hdr.magic == __swab32(PCAP_MAGIC_NSEC);
+	if ((hdr.magic != PCAP_MAGIC && hdr.magic != PCAP_MAGIC_NSEC &&
+	     !replay->swap) ||
+	    sb_pcap_u32(hdr.network) != PCAP_LINKTYPE_ETHERNET) {
+		printf("sb_eth: '%s' is not an Ethernet pcap file\n",
+		       sb_eth.name);
+		os_close(replay->fd);
+		replay->fd = -1;
+		return -1;
+	}
+
+	/* The recording starts with a packet sent by U-Boot */
+	sb_pcap_next();
+	memcpy(replay->mac, replay->next.data + 6, 6);
+
+	return 0;
+}
+
+/* Remember 'from' as being replaced by 'to', most recent first */
+static void sb_pcap_map_set(struct sb_eth_map *map, u32 from, u32 to)
+{
+	int i;
+
+	for (i = 0; i < SB_ETH_MAP_LEN - 1; i++) {
+		if (map[i].from == from)
+			break;
+	}
+	memmove(map + 1, map, i * sizeof(*map));
+	map[0].from = from;
+	map[0].to = to;
+}
+
+static u32 sb_pcap_map_get(struct sb_eth_map *map, u32 from)
+{
+	int i;
+
+	for (i = 0; i < SB_ETH_MAP_LEN; i++) {
+		if (map[i].from == from)
+			return map[i].to;
+	}
+
+	return from;
+}
+
+/*
+ * U-Boot picks a new UDP source port and BOOTP transaction ID each time, so
+ * learn how they differ from the recording by comparing what it sends with
+ * the recorded packet.
+ */
+static void sb_pcap_learn(const uchar *rec, int rec_len,
+			  const uchar *pkt, int len)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+	const struct ip_udp_hdr *rip, *ip;
+	const int hdr_len = ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+
+	if (!sb_eth_is_udp(rec, rec_len) || !sb_eth_is_udp(pkt, len))
+		return;
+
+	rip = (const struct ip_udp_hdr *)(rec + ETHER_HDR_SIZE);
+	ip = (const struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	sb_pcap_map_set(replay->port, ntohs(rip->udp_src), ntohs(ip->udp_src));
+	if (ntohs(ip->udp_dst) == BOOTP_SERVER_PORT &&
+	    rec_len >= hdr_len + BOOTP_XID + 4 &&
+	    len >= hdr_len + BOOTP_XID + 4)
+		sb_pcap_map_set(replay->xid,
+				get_unaligned_be32(rec + hdr_len + BOOTP_XID),
+				get_unaligned_be32(pkt + hdr_len + BOOTP_XID));
+}
+
+/* Make a recorded packet look as if it was sent to this U-Boot */
+static void sb_pcap_rewrite(uchar *pkt, int len)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+	struct ethernet_hdr *eth = (struct ethernet_hdr *)pkt;
+	struct arp_hdr *arp = (struct arp_hdr *)(pkt + ETHER_HDR_SIZE);
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)(pkt + ETHER_HDR_SIZE);
+	uchar *bootp = pkt + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	uchar *enetaddr = sb_eth.dev->enetaddr;
+
+	if (!memcmp(eth->et_dest, replay->mac, 6))
+		memcpy(eth->et_dest, enetaddr, 6);
+
+	if (ntohs(eth->et_protlen) == PROT_ARP &&
+	    len >= ETHER_HDR_SIZE + ARP_HDR_SIZE) {
+		if (!memcmp(&arp->ar_tha, replay->mac, 6))
+			memcpy(&arp->ar_tha, enetaddr, 6);
+	} else if (sb_eth_is_udp(pkt, len)) {
+		ip->udp_dst = htons(sb_pcap_map_get(replay->port,
+						    ntohs(ip->udp_dst)));
+		if (ntohs(ip->udp_src) == BOOTP_SERVER_PORT &&
+		    len >= bootp + BOOTP_CHADDR + 6 - pkt) {
+			put_unaligned_be32(sb_pcap_map_get(replay->xid,
+					get_unaligned_be32(bootp + BOOTP_XID)),
+					bootp + BOOTP_XID);
+			if (!memcmp(bootp + BOOTP_CHADDR, replay->mac, 6))
+				memcpy(bootp + BOOTP_CHADDR, enetaddr, 6);
+		}
+		/* Zero means no checksum for UDP over IPv4 */
+		ip->udp_xsum = 0;
+	}
+}
+
+/* A packet from U-Boot stands for the next recorded outgoing one */
+static void sb_pcap_send(void *packet, int length)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+
+	if (!replay->next.len || !sb_pcap_outgoing()) {
+		replay->unmatched++;
+		return;
+	}
+
+	sb_pcap_learn(replay->next.data, replay->next.len, packet, length);
+	sb_pcap_next();
+}
+
+/* Deliver the next record straight away, unless U-Boot has to send first */
+static int sb_pcap_recv(uchar *buf)
+{
+	struct sb_pcap *replay = &sb_eth.replay;
+	int len = replay->next.len;
+
+	if (!len || sb_pcap_outgoing())
+		return 0;
+
+	memcpy(buf, replay->next.data, len);
+	sb_pcap_rewrite(buf, len);
+	/* Read ahead, as the stack may reply before NetReceive() returns */
+	sb_pcap_next();
+
+	return len;
+}
+
+static int sb_eth_init(struct eth_device *dev, bd_t *bis)
+{
+	int ret;
+
+	sb_eth.head = sb_eth.tail = 0;
+
+	/* The recording and the replay carry on across commands */
+	if (sb_eth.record_name[0] && sb_eth.record_fd < 0 &&
+	    sb_eth_record_open())
+		return -1;
+
+	switch (sb_eth.backend) {
+#ifdef CONFIG_ETH_SANDBOX_RAW
+	case SB_ETH_RAW:
+	case SB_ETH_TAP:
+		if (sb_eth.raw.sd >= 0)
+			break;
+		if (sb_eth.backend == SB_ETH_RAW)
+			ret = sandbox_eth_raw_os_init(sb_eth.name, &sb_eth.raw);
+		else
+			ret = sandbox_eth_tap_os_init(sb_eth.name, &sb_eth.raw);
+		if (ret) {
+			printf("%s: cannot open %s interface '%s' (err=%d)\n",
+			       dev->name, sb_eth_backend_name[sb_eth.backend],
+			       sb_eth.name, ret);
+			return -1;
+		}
+		break;
+#endif
+	case SB_ETH_PCAP:
+		if (sb_eth.replay.fd < 0) {
+			ret = sb_pcap_open();
+			if (ret)
+				return ret;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int sb_eth_send(struct eth_device *dev, void *packet, int length)
+{
+	uint64_t start = os_get_nsec();
+	int ret = 0;
+
+	if (sb_eth.rx_start)
+		sb_eth_stat_add(&sb_eth.reply, length, start - sb_eth.rx_start);
+	sb_eth_record(packet, length);
+
+	switch (sb_eth.backend) {
+	case SB_ETH_LOOP:
+		sb_loop_send(packet, length);
+		break;
+#ifdef CONFIG_ETH_SANDBOX_RAW
+	case SB_ETH_RAW:
+	case SB_ETH_TAP:
+		ret = sandbox_eth_raw_os_send(packet, length, &sb_eth.raw);
+		break;
+#endif
+	case SB_ETH_PCAP:
+		sb_pcap_send(packet, length);
+		break;
+	default:
+		break;
+	}
+	sb_eth_stat_add(&sb_eth.tx, length, os_get_nsec() - start);
+
+	return ret;
+}
+
+static int sb_eth_recv_one(uchar *buf)
+{
+	switch (sb_eth.backend) {
+	case SB_ETH_LOOP:
+		return sb_loop_recv(buf);
+#ifdef CONFIG_ETH_SANDBOX_RAW
+	case SB_ETH_RAW:
+	case SB_ETH_TAP:
+		return sb_raw_recv(buf);
+#endif
+	case SB_ETH_PCAP:
+		return sb_pcap_recv(buf);
+	default:
+		return 0;
+	}
+}
+
+/* Hand up every packet which is ready, using NetRxPackets[] as the ring */
+static int sb_eth_recv_batch(struct eth_device *dev, struct eth_rx_desc *desc,
+			     int count)
+{
+	int len, n;
+
+	for (n = 0; n < min(count, PKTBUFSRX); n++) {
+		len = sb_eth_recv_one(NetRxPackets[n]);
+		if (!len)
+			break;
+		sb_eth_record(NetRxPackets[n], len);
+		desc[n].packet = NetRxPackets[n];
+		desc[n].length = len;
+	}
+
+	sb_eth.rx_pending = n;
+	if (n)
+		sb_eth.rx_start = os_get_nsec();
+
+	return n;
+}
+
+/* NetReceive() is done with a packet: time it and start on the next one */
+static void sb_eth_free_pkt(struct eth_device *dev, struct eth_rx_desc *desc)
+{
+	uint64_t now = os_get_nsec();
+
+	sb_eth_stat_add(&sb_eth.rx, desc->length, now - sb_eth.rx_start);
+	sb_eth.rx_start = --sb_eth.rx_pending ? now : 0;
+}
+
+static void sb_eth_halt(struct eth_device *dev)
+{
+	sb_eth.head = sb_eth.tail = 0;
+	sb_tftpd_close();
+}
+
+static void sb_eth_show_stat(const char *name, struct sb_eth_stat *stat)
+{
+	printf("%-6s %8lu %11llu", name, stat->count, stat->bytes);
+	if (stat->count)
+		printf(" %8llu %8llu %8llu", stat->min,
+		       stat->total / stat->count, stat->max);
+	puts("\n");
+}
+
+void sandbox_eth_show_stats(void)
+{
+	printf("%s: %s '%s'", sb_eth.dev->name,
+	       sb_eth_backend_name[sb_eth.backend], sb_eth.name);
+	if (sb_eth.record_name[0])
+		printf(", recording to '%s'", sb_eth.record_name);
+	puts("\n");
+	printf("%-6s %8s %11s %8s %8s %8s\n", "", "packets", "bytes",
+	       "min ns", "avg ns", "max ns");
+	sb_eth_show_stat("rx", &sb_eth.rx);
+	sb_eth_show_stat("tx", &sb_eth.tx);
+	sb_eth_show_stat("reply", &sb_eth.reply);
+	if (sb_eth.backend == SB_ETH_PCAP && sb_eth.replay.fd >= 0)
+		printf("replay %s, %lu packets sent out of step\n",
+		       sb_eth.replay.next.len ? "in progress" : "complete",
+		       sb_eth.replay.unmatched);
+}
+
+void sandbox_eth_reset_stats(void)
+{
+	memset(&sb_eth.rx, 0, sizeof(sb_eth.rx));
+	memset(&sb_eth.tx, 0, sizeof(sb_eth.tx));
+	memset(&sb_eth.reply, 0, sizeof(sb_eth.reply));
+}
+
+int sandbox_eth_initialize(bd_t *bis)
+{
+	static struct eth_device dev;
+
+	strcpy(dev.name, "sb_eth");
+	memcpy(dev.enetaddr, sb_eth_addr, 6);
+	dev.init = sb_eth_init;
+	dev.send = sb_eth_send;
+	dev.recv_batch = sb_eth_recv_batch;
+	dev.free_pkt = sb_eth_free_pkt;
+	dev.halt = sb_eth_halt;
+	sb_eth.dev = &dev;
+
+	return eth_register(&dev);
+}
+
+/*
+ * Parse the --eth option, which selects what is on the other end:
+ *
+ * loop:<dir>[:<rtt_us>[:<drop>[:<mbps>]]] - the emulated host serves files
+ *	from <dir> over TFTP, every packet it sends arrives <rtt_us>
+ *	microseconds after the packet which caused it, every <drop>-th TFTP
+ *	DATA packet is lost and DATA packets are sent at <mbps> Mbit/s
+ * raw:<ifname> - a packet socket bound to a host interface
+ * tap:<ifname> - a host TAP interface
+ * pcap:<file> - the session recorded in <file>
+ */
+static int sandbox_cmdline_cb_eth(struct sandbox_state *state,
+				  const char *arg)
+{
+	enum sb_eth_backend backend;
+	const char *p;
+	char *end;
+	int len;
+
+	for (backend = SB_ETH_LOOP; backend <= SB_ETH_PCAP; backend++) {
+		len = strlen(sb_eth_backend_name[backend]);
+		if (!strncmp(arg, sb_eth_backend_name[backend], len) &&
+		    arg[len] == ':')
+			break;
+	}
+	if (backend > SB_ETH_PCAP)
+		return 1;
+#ifndef CONFIG_ETH_SANDBOX_RAW
+	if (backend == SB_ETH_RAW || backend == SB_ETH_TAP)
+		return 1;
+#endif
+	sb_eth.backend = backend;
+	arg += len + 1;
+
+	p = backend == SB_ETH_LOOP ? strchr(arg, ':') : NULL;
+	len = p ? p - arg : strlen(arg);
+	if (!len || len >= sizeof(sb_eth.name))
+		return 1;
+	memcpy(sb_eth.name, arg, len);
+	sb_eth.name[len] = '\0';
+
+	if (p) {
+		sb_eth.delay_us = simple_strtoul(p + 1, &end, 10);
+		if (*end == ':')
+			sb_eth.drop = simple_strtoul(end + 1, &end, 10);
+		if (*end == ':')
+			sb_eth.rate = simple_strtoul(end + 1, &end, 10);
+		if (*end)
+			return 1;
+	}
+
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(eth, 1,
+		    "sandbox Ethernet peer: "
+		    "loop:<dir>[:<rtt_us>[:<drop>[:<mbps>]]], "
+		    "raw:<ifname>, tap:<ifname> or pcap:<file>");
+
+static int sandbox_cmdline_cb_eth_record(struct sandbox_state *state,
+					 const char *arg)
+{
+	if (strlen(arg) >= sizeof(sb_eth.record_name))
+		return 1;
+	strcpy(sb_eth.record_name, arg);
+
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(eth_record, 1,
+		    "Record sandbox Ethernet traffic to a pcap file");
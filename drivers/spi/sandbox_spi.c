@@ -14,6 +14,7 @@
 #include <os.h>
 
 #include <asm/errno.h>
+#include <asm/getopt.h>
 #include <asm/spi.h>
 #include <asm/state.h>
 
@@ -25,8 +26,17 @@ struct sandbox_spi_slave {
 	struct spi_slave slave;
 	const struct sandbox_spi_emu_ops *ops;
 	void *priv;
+	uint max_hz;
+	uint64_t busy_until;	/* end of the last transfer, in ns */
 };
 
+/* Transfer modes the bus supports (SPI_OPM_...), by default all of them */
+static u8 sandbox_spi_op_mode_rx = SPI_OPM_RX_EXTN;
+static u8 sandbox_spi_op_mode_tx = SPI_OPM_TX_QPP;
+
+/* Make each transfer take as long as it would on the bus */
+static int sandbox_spi_timing;
+
 #define to_sandbox_spi_slave(s) container_of(s, struct sandbox_spi_slave, slave)
 
 const char *sandbox_spi_parse_spec(const char *arg, unsigned long *bus,
@@ -94,6 +104,9 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs,
 		debug("sandbox_spi: Out of memory\n");
 		return NULL;
 	}
+	sss->slave.op_mode_rx = sandbox_spi_op_mode_rx;
+	sss->slave.op_mode_tx = sandbox_spi_op_mode_tx;
+	sss->max_hz = max_hz;
 
 	spec = state->spi[bus][cs].spec;
 	sss->ops = state->spi[bus][cs].ops;
@@ -138,6 +151,28 @@ void spi_release_bus(struct spi_slave *slave)
 	}
 }
 
+/* Wait until a transfer of @bitlen bits would have finished on the bus */
+static void sandbox_spi_bus_time(struct sandbox_spi_slave *sss, uint bitlen,
+				 unsigned long flags)
+{
+	uint64_t now = os_get_nsec();
+	uint cycles = bitlen;
+
+	if (flags & SPI_XFER_QUAD)
+		cycles /= 4;
+	else if (flags & SPI_XFER_DUAL)
+		cycles /= 2;
+
+	if (sss->busy_until < now)
+		sss->busy_until = now;
+	sss->busy_until += (uint64_t)cycles * 1000000000 / sss->max_hz;
+
+	/* Sleeping has overhead, so let short transfers add up first */
+	now = os_get_nsec();
+	if (sss->busy_until > now + 1000000)
+		os_usleep((sss->busy_until - now) / 1000);
+}
+
 int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		void *din, unsigned long flags)
 {
@@ -183,7 +218,9 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 		debug(" %u:%02x", i, tx[i]);
 	debug("\n");
 
-	ret = sss->ops->xfer(sss->priv, tx, rx, bytes);
+	ret = sss->ops->xfer(sss->priv, tx, rx, bytes, flags);
+	if (sandbox_spi_timing && sss->max_hz)
+		sandbox_spi_bus_time(sss, bitlen, flags);
 
 	debug("sandbox_spi: xfer: got back %i (that's %s)\n rx:",
 	      ret, ret ? "bad" : "good");
@@ -215,3 +252,27 @@ struct spi_slave *spi_setup_slave_fdt(const void *blob, int slave_node,
 {
 	return NULL;
 }
+
+static int sandbox_cmdline_cb_spi_op_mode(struct sandbox_state *state,
+					  const char *arg)
+{
+	char *endp;
+
+	sandbox_spi_op_mode_rx = simple_strtoul(arg, &endp, 16);
+	if (*endp == ':')
+		sandbox_spi_op_mode_tx = simple_strtoul(endp + 1, &endp, 16);
+
+	return *endp ? 1 : 0;
+}
+SANDBOX_CMDLINE_OPT(spi_op_mode, 1,
+		    "SPI bus transfer modes: <rx>[:<tx>], SPI_OPM_... in hex");
+
+static int sandbox_cmdline_cb_spi_timing(struct sandbox_state *state,
+					 const char *arg)
+{
+	sandbox_spi_timing = 1;
+
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(spi_timing, 0,
+		    "Make SPI transfers take as long as on the bus");
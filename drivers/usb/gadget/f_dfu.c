@@ -206,7 +206,7 @@ static void handle_getstatus(struct usb_request *req)
 
 	if (f_dfu->poll_timeout)
 		if (!(f_dfu->blk_seq_num %
-		      (dfu_get_buf_size() / DFU_USB_BUFSIZ)))
+		      (dfu_get_buf_part_size() / DFU_USB_BUFSIZ)))
 			dfu_set_poll_timeout(dstat, f_dfu->poll_timeout);
 
 	/* send status response */
@@ -435,6 +435,8 @@ static int state_dfu_dnload_idle(struct f_dfu *f_dfu,
 		break;
 	case USB_REQ_DFU_ABORT:
 		f_dfu->dfu_state = DFU_STATE_dfuIDLE;
+		/* the download is not finished, so drop it */
+		dfu_abort();
 		value = RET_ZLP;
 		break;
 	case USB_REQ_DFU_GETSTATUS:
@@ -564,6 +566,7 @@ static int state_dfu_error(struct f_dfu *f_dfu,
 	case USB_REQ_DFU_CLRSTATUS:
 		f_dfu->dfu_state = DFU_STATE_dfuIDLE;
 		f_dfu->dfu_status = DFU_STATUS_OK;
+		dfu_abort();
 		/* no zlp? */
 		value = RET_ZLP;
 		break;
@@ -784,6 +787,8 @@ static void dfu_disable(struct usb_function *f)
 	debug("%s: reset config\n", __func__);
 
 	f_dfu->config = 0;
+	/* a bus reset or disconnect ends any download */
+	dfu_abort();
 }
 
 static int dfu_bind_config(struct usb_configuration *c)
@@ -19,6 +19,9 @@
 #include <linux/compiler.h>
 #include <version.h>
 #include <g_dnl.h>
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+#include <fb_mmc.h>
+#endif
 
 #define FASTBOOT_VERSION		"0.4"
 
@@ -51,6 +54,11 @@ static inline struct f_fastboot *func_to_fastboot(struct usb_function *f)
 static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+/* The download is written to this partition as it arrives */
+static char stream_part[32];
+static const char *stream_err;
+#endif
 
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
@@ -326,6 +334,30 @@ static int strcmp_l1(const char *s1, const char *s2)
 	return strncmp(s1, s2, strlen(s1));
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+static bool stream_download(void)
+{
+	return getenv("fastboot_stream") != NULL;
+}
+#else
+static inline bool stream_download(void)
+{
+	return false;
+}
+#endif
+
+/*
+ * A streamed download is not held in memory, so only the 32-bit size
+ * field of the protocol limits it. The host splits larger images.
+ */
+static unsigned int max_download_size(void)
+{
+	if (stream_download())
+		return 0xfffff000;
+
+	return CONFIG_USB_FASTBOOT_BUF_SIZE;
+}
+
 static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 {
 	char *cmd = req->buf;
@@ -346,10 +378,11 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		strncat(response, FASTBOOT_VERSION, chars_left);
 	} else if (!strcmp_l1("bootloader-version", cmd)) {
 		strncat(response, U_BOOT_VERSION, chars_left);
-	} else if (!strcmp_l1("downloadsize", cmd)) {
+	} else if (!strcmp_l1("downloadsize", cmd) ||
+		   !strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
-		sprintf(str_num, "%08x", CONFIG_USB_FASTBOOT_BUF_SIZE);
+		sprintf(str_num, "%08x", max_download_size());
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
 		s = getenv("serial#");
@@ -373,6 +406,20 @@ static unsigned int rx_bytes_expected(void)
 	return rx_remain;
 }
 
+static void store_download(const unsigned char *buffer, unsigned int size)
+{
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	if (stream_part[0]) {
+		/* after an error the rest of the image is dropped */
+		if (!stream_err)
+			stream_err = fb_mmc_flash_data(buffer, size);
+		return;
+	}
+#endif
+	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
+	       buffer, size);
+}
+
 #define BYTES_PER_DOT	0x20000
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
@@ -389,8 +436,7 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
-	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
-	       buffer, transfer_size);
+	store_download(buffer, transfer_size);
 
 	download_bytes += transfer_size;
 
@@ -405,6 +451,18 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		req->length = EP_BUFFER_SIZE;
 
 		sprintf(response, "OKAY");
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+		if (stream_part[0]) {
+			if (!stream_err)
+				stream_err = fb_mmc_flash_finish();
+			if (stream_err) {
+				/* flash reports the error again */
+				snprintf(response, RESPONSE_LEN, "FAIL%s",
+					 stream_err);
+				stream_part[0] = '\0';
+			}
+		}
+#endif
 		fastboot_tx_write_str(response);
 
 		printf("\ndownloading of %d bytes finished\n", download_bytes);
@@ -434,12 +492,33 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 
 	printf("Starting download of %d bytes\n", download_size);
 
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	stream_part[0] = '\0';
+	stream_err = NULL;
+#endif
+
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_USB_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > max_download_size()) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
 	} else {
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+		if (stream_download()) {
+			strncpy(stream_part, getenv("fastboot_stream"),
+				sizeof(stream_part) - 1);
+			stream_err = fb_mmc_flash_start(stream_part);
+			if (stream_err) {
+				download_size = 0;
+				snprintf(response, RESPONSE_LEN, "FAIL%s",
+					 stream_err);
+				stream_part[0] = '\0';
+				stream_err = NULL;
+				fastboot_tx_write_str(response);
+				return;
+			}
+		}
+#endif
 		sprintf(response, "DATA%08x", download_size);
 		req->complete = rx_handler_dl_image;
 		req->length = rx_bytes_expected();
@@ -465,10 +544,54 @@ static void do_bootm_on_complete(struct usb_ep *ep, struct usb_request *req)
 
 static void cb_boot(struct usb_ep *ep, struct usb_request *req)
 {
+	/* downloads go to the stream partition, not to load_addr */
+	if (stream_download()) {
+		fastboot_tx_write_str("FAILnot possible in stream mode");
+		return;
+	}
+
 	fastboot_func->in_req->complete = do_bootm_on_complete;
 	fastboot_tx_write_str("OKAY");
 }
 
+#ifdef CONFIG_FASTBOOT_FLASH
+static void cb_flash(struct usb_ep *ep, struct usb_request *req)
+{
+	char *cmd = req->buf;
+	char response[RESPONSE_LEN];
+	const char *err = "no flash device defined";
+
+	strsep(&cmd, ":");
+	if (!cmd) {
+		fastboot_tx_write_str("FAILmissing partition name");
+		return;
+	}
+
+#ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
+	if (stream_err || stream_part[0] || stream_download()) {
+		/* written while it was downloaded, if at all */
+		err = stream_err;
+		if (!err && !stream_part[0])
+			err = "no image was streamed";
+		else if (!err && strcmp(cmd, stream_part))
+			err = "image was streamed to another partition";
+		stream_part[0] = '\0';
+		stream_err = NULL;
+	} else {
+		err = fb_mmc_flash_write(cmd,
+					 (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
+					 download_bytes);
+	}
+#endif
+
+	if (err)
+		snprintf(response, RESPONSE_LEN, "FAIL%s", err);
+	else
+		strcpy(response, "OKAY");
+	fastboot_tx_write_str(response);
+}
+#endif
+
 struct cmd_dispatch_info {
 	char *cmd;
 	void (*cb)(struct usb_ep *ep, struct usb_request *req);
@@ -488,6 +611,12 @@ static const struct cmd_dispatch_info cmd_dispatch_info[] = {
 		.cmd = "boot",
 		.cb = cb_boot,
 	},
+#ifdef CONFIG_FASTBOOT_FLASH
+	{
+		.cmd = "flash:",
+		.cb = cb_flash,
+	},
+#endif
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
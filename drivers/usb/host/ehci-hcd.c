@@ -1051,6 +1051,15 @@ done:
 	return 0;
 }
 
+/*
+ * Any length goes, as long as there is enough free heap space left for
+ * the qTDs
+ */
+size_t usb_max_xfer_size(struct usb_device *dev)
+{
+	return ~(size_t)0;
+}
+
 int
 submit_bulk_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 		int length)
@@ -0,0 +1,519 @@
+/*
+ * Simulate a USB host controller with a mass storage device, for sandbox
+ *
+ * Set up with --usb_storage <file>[:<blocksize>]. The device sits on the
+ * root port of the controller and uses the bulk-only transport with SCSI
+ * commands. Its blocks are those of the host file, 512 bytes unless told
+ * otherwise, so a sparse file simulates a disk of any size: beyond 2TiB
+ * the host has to use READ CAPACITY(16), READ(16) and WRITE(16).
+ * Optionally:
+ *
+ * --usb_timing <us>[:<ns>]	Each transfer on the bus takes that many us
+ *				to start and each byte that many ns
+ * --usb_max_xfer <bytes>	The controller takes bulk transfers of at
+ *				most that many bytes, K and M suffixes
+ *				allowed, and fails larger ones
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <exports.h>
+#include <os.h>
+#include <scsi.h>
+#include <usb.h>
+#include <asm/errno.h>
+#include <asm/getopt.h>
+#include <asm/state.h>
+#include <asm/unaligned.h>
+
+/* IDs of the file-backed storage gadget of Linux */
+#define USBSIM_VENDOR_ID	0x0525
+#define USBSIM_PRODUCT_ID	0xa4a5
+
+#define USBSIM_EP_IN		1
+#define USBSIM_EP_OUT		2
+#define USBSIM_MAX_PACKET	512
+
+/* Smallest wait worth sleeping for, in ns */
+#define USBSIM_MIN_SLEEP	1000000
+
+/* Bulk-only transport wrappers */
+#define USBSIM_CBW_SIG		0x43425355
+#define USBSIM_CBW_SIZE		31
+#define USBSIM_CSW_SIG		0x53425355
+#define USBSIM_CSW_SIZE		13
+
+#define USBSIM_STATUS_GOOD	0
+#define USBSIM_STATUS_FAILED	1
+
+/* Class requests of the bulk-only transport */
+#define USBSIM_GET_MAX_LUN	0xfe
+#define USBSIM_RESET		0xff
+
+/* Sense keys and additional sense codes */
+#define USBSIM_NO_SENSE		0x00, 0x00
+#define USBSIM_MEDIUM_ERROR	0x03, 0x11
+#define USBSIM_BAD_OPCODE	0x05, 0x20
+#define USBSIM_BAD_LBA		0x05, 0x21
+#define USBSIM_BAD_FIELD	0x05, 0x24
+
+enum usbsim_phase {
+	USBSIM_CMD,		/* waiting for a CBW */
+	USBSIM_DATA_IN,		/* sending data to the host */
+	USBSIM_DATA_OUT,	/* taking data from the host */
+	USBSIM_STATUS,		/* the CSW is next */
+};
+
+static struct usbsim {
+	int fd;
+	ulong blksz;
+	u64 blocks;
+
+	/* State of the bulk-only transport */
+	enum usbsim_phase phase;
+	u32 tag;
+	u32 residue;		/* bytes the host asked for but did not get */
+	u8 status;
+	u32 data_len;		/* bytes left in the data phase */
+	int stall;		/* fail the data phase with a STALL */
+	int from_file;		/* the data phase reads or writes the file */
+	u8 resp[36];		/* data of the other commands */
+	u32 resp_pos;
+	u8 sense_key;
+	u8 asc;
+
+	/* Timing and controller limits */
+	ulong t_xfer_us;
+	ulong t_byte_ns;
+	ulong max_xfer;
+	uint64_t busy_until;
+} usbsim;
+
+static const char *usbsim_spec;
+
+static const u8 usbsim_dev_desc[] = {
+	18, USB_DT_DEVICE,
+	0x00, 0x02,			/* USB 2.0 */
+	0, 0, 0,			/* class in the interface */
+	64,				/* ep0 max packet */
+	USBSIM_VENDOR_ID & 0xff, USBSIM_VENDOR_ID >> 8,
+	USBSIM_PRODUCT_ID & 0xff, USBSIM_PRODUCT_ID >> 8,
+	0x00, 0x01,			/* bcdDevice */
+	1, 2, 3,			/* strings */
+	1,				/* configurations */
+};
+
+static const u8 usbsim_config_desc[] = {
+	9, USB_DT_CONFIG, 32, 0, 1, 1, 0, 0x80, 50,
+	9, USB_DT_INTERFACE, 0, 0, 2, USB_CLASS_MASS_STORAGE, US_SC_SCSI,
+		US_PR_BULK, 0,
+	7, USB_DT_ENDPOINT, USB_DIR_IN | USBSIM_EP_IN, USB_ENDPOINT_XFER_BULK,
+		USBSIM_MAX_PACKET & 0xff, USBSIM_MAX_PACKET >> 8, 0,
+	7, USB_DT_ENDPOINT, USBSIM_EP_OUT, USB_ENDPOINT_XFER_BULK,
+		USBSIM_MAX_PACKET & 0xff, USBSIM_MAX_PACKET >> 8, 0,
+};
+
+static const char * const usbsim_strings[] = {
+	NULL, "U-Boot", "Sandbox USB storage", "0123456789ab",
+};
+
+/* Keep the bus busy for a transfer of @len bytes */
+static void usbsim_busy(int len)
+{
+	uint64_t ns = usbsim.t_xfer_us * 1000ULL +
+		      (uint64_t)len * usbsim.t_byte_ns;
+	uint64_t now;
+
+	if (!ns)
+		return;
+
+	now = os_get_nsec();
+	if (usbsim.busy_until < now)
+		usbsim.busy_until = now;
+	usbsim.busy_until += ns;
+
+	/* Sleeping has overhead, so let short waits add up first */
+	if (usbsim.busy_until > now + USBSIM_MIN_SLEEP)
+		os_usleep((usbsim.busy_until - now) / 1000);
+}
+
+static int usbsim_string(u8 *buf, int index)
+{
+	const char *s;
+	int i;
+
+	if (!index) {
+		buf[0] = 4;
+		buf[1] = USB_DT_STRING;
+		buf[2] = 0x09;		/* US English */
+		buf[3] = 0x04;
+		return 4;
+	}
+	if (index >= ARRAY_SIZE(usbsim_strings))
+		return -1;
+
+	s = usbsim_strings[index];
+	for (i = 0; s[i]; i++) {
+		buf[2 + i * 2] = s[i];
+		buf[3 + i * 2] = 0;
+	}
+	buf[0] = 2 + i * 2;
+	buf[1] = USB_DT_STRING;
+
+	return buf[0];
+}
+
+static int usbsim_control(void *buffer, int length, struct devrequest *setup)
+{
+	u16 value = le16_to_cpu(setup->value);
+	u8 buf[64];
+	const void *data = buf;
+	int len = 0;
+
+	switch (setup->request) {
+	case USB_REQ_GET_DESCRIPTOR:
+		switch (value >> 8) {
+		case USB_DT_DEVICE:
+			data = usbsim_dev_desc;
+			len = sizeof(usbsim_dev_desc);
+			break;
+		case USB_DT_CONFIG:
+			data = usbsim_config_desc;
+			len = sizeof(usbsim_config_desc);
+			break;
+		case USB_DT_STRING:
+			len = usbsim_string(buf, value & 0xff);
+			break;
+		default:
+			len = -1;
+		}
+		break;
+	case USB_REQ_SET_ADDRESS:
+	case USB_REQ_SET_CONFIGURATION:
+	case USB_REQ_SET_INTERFACE:
+	case USB_REQ_CLEAR_FEATURE:
+		break;
+	case USBSIM_GET_MAX_LUN:
+		buf[0] = 0;
+		len = 1;
+		break;
+	case USBSIM_RESET:
+		usbsim.phase = USBSIM_CMD;
+		break;
+	default:
+		len = -1;
+	}
+	if (len < 0)
+		return -1;
+
+	len = min(len, length);
+	if (setup->requesttype & USB_DIR_IN)
+		memcpy(buffer, data, len);
+	else
+		len = 0;
+
+	return len;
+}
+
+static void usbsim_sense(u8 key, u8 asc)
+{
+	usbsim.sense_key = key;
+	usbsim.asc = asc;
+}
+
+/* Check a READ or WRITE of @count blocks at @lba and set up the data */
+static int usbsim_rw(u64 lba, u32 count, u32 len)
+{
+	loff_t pos = lba * usbsim.blksz;
+
+	if (lba > usbsim.blocks || count > usbsim.blocks - lba) {
+		usbsim_sense(USBSIM_BAD_LBA);
+		return -1;
+	}
+	if ((u64)count * usbsim.blksz != len) {
+		usbsim_sense(USBSIM_BAD_FIELD);
+		return -1;
+	}
+	usbsim.from_file = 1;
+	if (os_lseek(usbsim.fd, pos, OS_SEEK_SET) != pos) {
+		usbsim_sense(USBSIM_MEDIUM_ERROR);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Run a SCSI command, setting up its data phase */
+static int usbsim_scsi(const u8 *cdb, u32 len)
+{
+	u8 *resp = usbsim.resp;
+	u64 last = usbsim.blocks - 1;
+
+	usbsim.from_file = 0;
+	usbsim.resp_pos = 0;
+	memset(resp, '\0', sizeof(usbsim.resp));
+
+	switch (cdb[0]) {
+	case SCSI_TST_U_RDY:
+		return 0;
+	case SCSI_INQUIRY:
+		resp[1] = 0x80;		/* removable */
+		resp[2] = 0x05;		/* SPC-3 */
+		resp[3] = 0x02;
+		resp[4] = sizeof(usbsim.resp) - 5;
+		memcpy(resp + 8, "Sandbox ", 8);
+		memcpy(resp + 16, "USB storage     ", 16);
+		memcpy(resp + 32, "1.00", 4);
+		return sizeof(usbsim.resp);
+	case SCSI_REQ_SENSE:
+		resp[0] = 0x70;
+		resp[2] = usbsim.sense_key;
+		resp[7] = 10;
+		resp[12] = usbsim.asc;
+		usbsim_sense(USBSIM_NO_SENSE);
+		return 18;
+	case SCSI_RD_CAPAC:
+		put_unaligned_be32(last > 0xffffffff ? 0xffffffff : last,
+				   resp);
+		put_unaligned_be32(usbsim.blksz, resp + 4);
+		return 8;
+	case SCSI_RD_CAPAC16:
+		if ((cdb[1] & 0x1f) != SCSI_SAI_RD_CAPAC16)
+			break;
+		put_unaligned_be64(last, resp);
+		put_unaligned_be32(usbsim.blksz, resp + 8);
+		return 32;
+	case SCSI_READ10:
+	case SCSI_WRITE10:
+		if (usbsim_rw(get_unaligned_be32(cdb + 2),
+			      get_unaligned_be16(cdb + 7), len))
+			return -1;
+		return len;
+	case SCSI_READ16:
+	case SCSI_WRITE16:
+		if (usbsim_rw(get_unaligned_be64(cdb + 2),
+			      get_unaligned_be32(cdb + 10), len))
+			return -1;
+		return len;
+	}
+
+	usbsim_sense(USBSIM_BAD_OPCODE);
+	return -1;
+}
+
+static int usbsim_cbw(const u8 *cbw, int length)
+{
+	u32 len;
+	int ret;
+
+	if (length != USBSIM_CBW_SIZE ||
+	    get_unaligned_le32(cbw) != USBSIM_CBW_SIG)
+		return -1;
+
+	usbsim.tag = get_unaligned_le32(cbw + 4);
+	len = get_unaligned_le32(cbw + 8);
+	ret = usbsim_scsi(cbw + 15, len);
+
+	usbsim.status = ret < 0 ? USBSIM_STATUS_FAILED : USBSIM_STATUS_GOOD;
+	usbsim.stall = ret < 0;
+	usbsim.data_len = ret < 0 ? 0 : min((u32)ret, len);
+	usbsim.residue = len - usbsim.data_len;
+	if (!len)
+		usbsim.phase = USBSIM_STATUS;
+	else if (cbw[12] & USB_DIR_IN)
+		usbsim.phase = USBSIM_DATA_IN;
+	else
+		usbsim.phase = USBSIM_DATA_OUT;
+
+	return 0;
+}
+
+static int usbsim_data(void *buffer, int length, int in)
+{
+	int len = min((u32)length, usbsim.data_len);
+	ssize_t ret = len;
+
+	if (usbsim.stall || (usbsim.phase == USBSIM_DATA_IN) != in) {
+		usbsim.phase = USBSIM_STATUS;
+		return -1;
+	}
+
+	if (!usbsim.from_file)
+		memcpy(buffer, usbsim.resp + usbsim.resp_pos, len);
+	else if (in)
+		ret = os_read(usbsim.fd, buffer, len);
+	else
+		ret = os_write(usbsim.fd, buffer, len);
+	usbsim.resp_pos += len;
+	usbsim.data_len -= len;
+	if (ret != len) {
+		usbsim_sense(USBSIM_MEDIUM_ERROR);
+		usbsim.status = USBSIM_STATUS_FAILED;
+		usbsim.stall = 1;
+	}
+	if (!usbsim.data_len || len < length)
+		usbsim.phase = USBSIM_STATUS;
+
+	return len;
+}
+
+static int usbsim_csw(u8 *csw, int length)
+{
+	if (length < USBSIM_CSW_SIZE)
+		return -1;
+
+	put_unaligned_le32(USBSIM_CSW_SIG, csw);
+	put_unaligned_le32(usbsim.tag, csw + 4);
+	put_unaligned_le32(usbsim.residue + usbsim.data_len, csw + 8);
+	csw[12] = usbsim.status;
+	usbsim.phase = USBSIM_CMD;
+
+	return USBSIM_CSW_SIZE;
+}
+
+static int usbsim_bulk(unsigned long pipe, void *buffer, int length)
+{
+	int in = usb_pipein(pipe);
+
+	if (usb_pipeendpoint(pipe) != (in ? USBSIM_EP_IN : USBSIM_EP_OUT))
+		return -1;
+
+	switch (usbsim.phase) {
+	case USBSIM_CMD:
+		if (in || usbsim_cbw(buffer, length))
+			return -1;
+		return length;
+	case USBSIM_DATA_IN:
+	case USBSIM_DATA_OUT:
+		return usbsim_data(buffer, length, in);
+	case USBSIM_STATUS:
+		if (!in)
+			return -1;
+		return usbsim_csw(buffer, length);
+	}
+
+	return -1;
+}
+
+/* Finish a transfer of @len bytes, or a STALL if @len is negative */
+static int usbsim_done(struct usb_device *dev, int len)
+{
+	usbsim_busy(max(len, 0));
+	dev->act_len = max(len, 0);
+	dev->status = len < 0 ? USB_ST_STALLED : 0;
+
+	return 0;
+}
+
+int submit_bulk_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
+		    int length)
+{
+	if (usbsim.max_xfer && length > usbsim.max_xfer) {
+		printf("usbsim: %d byte bulk transfer is too large\n", length);
+		dev->status = USB_ST_BUF_ERR;
+		return -1;
+	}
+
+	return usbsim_done(dev, usbsim_bulk(pipe, buffer, length));
+}
+
+int submit_control_msg(struct usb_device *dev, unsigned long pipe,
+		       void *buffer, int length, struct devrequest *setup)
+{
+	return usbsim_done(dev, usbsim_control(buffer, length, setup));
+}
+
+int submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
+		   int length, int interval)
+{
+	return -1;
+}
+
+size_t usb_max_xfer_size(struct usb_device *dev)
+{
+	return usbsim.max_xfer ? usbsim.max_xfer : ~(size_t)0;
+}
+
+int usb_lowlevel_init(int index, enum usb_init_type init, void **controller)
+{
+	char file[256];
+	const char *sep;
+	loff_t size;
+
+	if (!usbsim_spec)
+		return -ENODEV;
+
+	/* 'usb reset' starts again with the file as it is now */
+	if (usbsim.fd > 0)
+		os_close(usbsim.fd);
+	usbsim.phase = USBSIM_CMD;
+	usbsim_sense(USBSIM_NO_SENSE);
+
+	sep = strchr(usbsim_spec, ':');
+	if (!sep)
+		sep = usbsim_spec + strlen(usbsim_spec);
+	snprintf(file, sizeof(file), "%.*s", (int)(sep - usbsim_spec),
+		 usbsim_spec);
+	usbsim.blksz = *sep ? simple_strtoul(sep + 1, NULL, 0) : 512;
+	if (usbsim.blksz < 512 || usbsim.blksz & (usbsim.blksz - 1)) {
+		printf("usbsim: bad block size in '%s'\n", usbsim_spec);
+		return -EINVAL;
+	}
+
+	usbsim.fd = os_open(file, OS_O_RDWR);
+	if (usbsim.fd < 0) {
+		printf("usbsim: cannot open '%s'\n", file);
+		return -EIO;
+	}
+	size = os_lseek(usbsim.fd, 0, OS_SEEK_END);
+	usbsim.blocks = size > 0 ? size / usbsim.blksz : 0;
+	if (!usbsim.blocks) {
+		printf("usbsim: '%s' holds no block\n", file);
+		os_close(usbsim.fd);
+		usbsim.fd = 0;
+		return -EINVAL;
+	}
+
+	*controller = &usbsim;
+	return 0;
+}
+
+int usb_lowlevel_stop(int index)
+{
+	return 0;
+}
+
+static int sandbox_cmdline_cb_usb_storage(struct sandbox_state *state,
+					  const char *arg)
+{
+	/* The device is set up by usb_lowlevel_init() */
+	usbsim_spec = arg;
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(usb_storage, 1,
+		    "USB mass storage device in a file: <file>[:<blocksize>]");
+
+static int sandbox_cmdline_cb_usb_timing(struct sandbox_state *state,
+					 const char *arg)
+{
+	char *end;
+
+	usbsim.t_xfer_us = simple_strtoul(arg, &end, 10);
+	if (*end == ':')
+		usbsim.t_byte_ns = simple_strtoul(end + 1, &end, 10);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(usb_timing, 1,
+		    "USB transfer times: <us/transfer>[:<ns/byte>]");
+
+static int sandbox_cmdline_cb_usb_max_xfer(struct sandbox_state *state,
+					   const char *arg)
+{
+	char *end;
+
+	usbsim.max_xfer = ustrtoul(arg, &end, 0);
+	return 0;
+}
+SANDBOX_CMDLINE_OPT(usb_max_xfer, 1,
+		    "Largest USB bulk transfer in bytes");
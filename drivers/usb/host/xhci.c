@@ -890,6 +890,20 @@ submit_bulk_msg(struct usb_device *udev, unsigned long pipe, void *buffer,
 	return xhci_bulk_tx(udev, pipe, length, buffer);
 }
 
+/**
+ * Each endpoint has a transfer ring of one segment, whose last TRB links
+ * back to the start. A TRB moves up to 64KiB without crossing a 64KiB
+ * boundary, so a transfer that is not aligned needs one more TRB than
+ * its length suggests: 62 TRBs always fit.
+ *
+ * @param udev	pointer to the USB device
+ * @return the largest bulk transfer in bytes
+ */
+size_t usb_max_xfer_size(struct usb_device *udev)
+{
+	return (TRBS_PER_SEGMENT - 2) * TRB_MAX_BUFF_SIZE;
+}
+
 /**
  * submit the control type of request to the Root hub/Device based on the devnum
  *
@@ -80,32 +80,82 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 
 	if (remainder) {
 		if (fs->dev_desc->block_read) {
-			fs->dev_desc->block_read(fs->dev_desc->dev,
-						 startblock, 1, sec_buf);
+			blk_dread(fs->dev_desc, startblock, 1, sec_buf);
 			temp_ptr = sec_buf;
 			memcpy((temp_ptr + remainder),
 			       (unsigned char *)buf, size);
-			fs->dev_desc->block_write(fs->dev_desc->dev,
-						  startblock, 1, sec_buf);
+			blk_dwrite(fs->dev_desc, startblock, 1, sec_buf);
 		}
 	} else {
 		if (size >> log2blksz != 0) {
-			fs->dev_desc->block_write(fs->dev_desc->dev,
-						  startblock,
-						  size >> log2blksz,
-						  (unsigned long *)buf);
+			blk_dwrite(fs->dev_desc, startblock,
+				   size >> log2blksz, (unsigned long *)buf);
 		} else {
-			fs->dev_desc->block_read(fs->dev_desc->dev,
-						 startblock, 1, sec_buf);
+			blk_dread(fs->dev_desc, startblock, 1, sec_buf);
 			temp_ptr = sec_buf;
 			memcpy(temp_ptr, buf, size);
-			fs->dev_desc->block_write(fs->dev_desc->dev,
-						  startblock, 1,
-						  (unsigned long *)sec_buf);
+			blk_dwrite(fs->dev_desc, startblock, 1,
+				   (unsigned long *)sec_buf);
 		}
 	}
 }
 
+static unsigned char *ext4fs_read_bmap(unsigned char **bmap, uint32_t blkno)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	if (*bmap)
+		return *bmap;
+
+	*bmap = zalloc(fs->blksz);
+	if (!*bmap)
+		return NULL;
+	if (!ext4fs_devread((lbaint_t)blkno * fs->sect_perblk, 0, fs->blksz,
+			    (char *)*bmap)) {
+		free(*bmap);
+		*bmap = NULL;
+	}
+
+	return *bmap;
+}
+
+/*
+ * The bitmaps of a block group are read the first time the group is
+ * changed, so that only the groups a write allocates from or frees to
+ * are touched. The group is marked dirty for ext4fs_update().
+ */
+unsigned char *ext4fs_get_blk_bmap(unsigned int i)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	if (!ext4fs_read_bmap(&fs->blk_bmaps[i], fs->bgd[i].block_id))
+		return NULL;
+	fs->bg_dirty[i] = 1;
+
+	return fs->blk_bmaps[i];
+}
+
+unsigned char *ext4fs_get_inode_bmap(unsigned int i)
+{
+	struct ext_filesystem *fs = get_fs();
+
+	if (!ext4fs_read_bmap(&fs->inode_bmaps[i], fs->bgd[i].inode_id))
+		return NULL;
+	fs->bg_dirty[i] = 1;
+
+	return fs->inode_bmaps[i];
+}
+
+static inline int ext4fs_test_bit(unsigned char *bmap, unsigned int bit)
+{
+	return bmap[bit / 8] & (1 << (bit % 8));
+}
+
+static inline void ext4fs_set_bit(unsigned char *bmap, unsigned int bit)
+{
+	bmap[bit / 8] |= 1 << (bit % 8);
+}
+
 static int _get_new_inode_no(unsigned char *buffer)
 {
 	struct ext_filesystem *fs = get_fs();
@@ -845,36 +895,102 @@ int ext4fs_filename_check(char *filename)
 	return -1;
 }
 
+static int ext4fs_bg_has_super(unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+	unsigned int n, power;
+
+	if (group <= 1 || !(le32_to_cpu(fs->sb->feature_ro_compat) &
+			    EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER))
+		return 1;
+	if (!(group & 1))
+		return 0;
+
+	/* with sparse_super, backups are in the powers of 3, 5 and 7 */
+	for (n = 3; n <= 7; n += 2) {
+		for (power = n; power < group; power *= n)
+			;
+		if (power == group)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void ext4fs_mark_blk(unsigned char *bmap, unsigned int group,
+			    uint32_t blkno)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t bpg = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t first = le32_to_cpu(fs->sb->first_data_block) + group * bpg;
+
+	if (blkno >= first && blkno - first < bpg)
+		ext4fs_set_bit(bmap, blkno - first);
+}
+
+/*
+ * A group flagged EXT4_BG_BLOCK_UNINIT has no block bitmap on the disk
+ * yet. Only its superblock and descriptor backup and its own bitmaps and
+ * inode table are in use, so build the bitmap from those, write it and
+ * clear the flag.
+ */
+static void ext4fs_init_blk_bmap(unsigned int group, unsigned char *bmap)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = &fs->bgd[group];
+	uint32_t bpg = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t first = le32_to_cpu(fs->sb->first_data_block) + group * bpg;
+	uint32_t last = min(le32_to_cpu(fs->sb->total_blocks) - first, bpg);
+	uint32_t itable = le32_to_cpu(bgd->inode_table_id);
+	uint32_t itable_blks = ext4fs_div_roundup(
+			le32_to_cpu(fs->sb->inodes_per_group) * fs->inodesz,
+			fs->blksz);
+	uint32_t i;
+
+	memset(bmap, '\0', fs->blksz);
+	if (ext4fs_bg_has_super(group)) {
+		for (i = 0; i < 1 + fs->no_blk_pergdt +
+		     le16_to_cpu(fs->sb->reserved_gdt_blocks); i++)
+			ext4fs_set_bit(bmap, i);
+	}
+	ext4fs_mark_blk(bmap, group, le32_to_cpu(bgd->block_id));
+	ext4fs_mark_blk(bmap, group, le32_to_cpu(bgd->inode_id));
+	for (i = 0; i < itable_blks; i++)
+		ext4fs_mark_blk(bmap, group, itable + i);
+
+	/* the bits past the end of the group are always set */
+	for (i = last; i < fs->blksz * 8; i++)
+		ext4fs_set_bit(bmap, i);
+
+	put_ext4((uint64_t)le32_to_cpu(bgd->block_id) * fs->blksz, bmap,
+		 fs->blksz);
+	bgd->bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+}
+
 long int ext4fs_get_new_blk_no(void)
 {
 	short i;
 	short status;
 	int remainder;
 	unsigned int bg_idx;
+	unsigned char *bmap;
 	static int prev_bg_bitmap_index = -1;
 	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
 	struct ext_filesystem *fs = get_fs();
 	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
+	if (!journal_buffer)
 		goto fail;
 	struct ext2_block_group *bgd = (struct ext2_block_group *)fs->gdtable;
 
 	if (fs->first_pass_bbmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
 			if (bgd[i].free_blocks) {
-				if (bgd[i].bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					put_ext4(((uint64_t) ((uint64_t)bgd[i].block_id *
-							      (uint64_t)fs->blksz)),
-						 zero_buffer, fs->blksz);
-					bgd[i].bg_flags =
-					    bgd[i].
-					    bg_flags & ~EXT4_BG_BLOCK_UNINIT;
-					memcpy(fs->blk_bmaps[i], zero_buffer,
-					       fs->blksz);
-				}
-				fs->curr_blkno =
-				    _get_new_blk_no(fs->blk_bmaps[i]);
+				bmap = ext4fs_get_blk_bmap(i);
+				if (!bmap)
+					goto fail;
+				if (bgd[i].bg_flags & EXT4_BG_BLOCK_UNINIT)
+					ext4fs_init_blk_bmap(i, bmap);
+				fs->curr_blkno = _get_new_blk_no(bmap);
 				if (fs->curr_blkno == -1)
 					/* if block bitmap is completely fill */
 					continue;
@@ -925,17 +1041,13 @@ restart:
 			goto restart;
 		}
 
-		if (bgd[bg_idx].bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memset(zero_buffer, '\0', fs->blksz);
-			put_ext4(((uint64_t) ((uint64_t)bgd[bg_idx].block_id *
-					(uint64_t)fs->blksz)), zero_buffer, fs->blksz);
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
-			bgd[bg_idx].bg_flags = bgd[bg_idx].bg_flags &
-						~EXT4_BG_BLOCK_UNINIT;
-		}
+		bmap = ext4fs_get_blk_bmap(bg_idx);
+		if (!bmap)
+			goto fail;
+		if (bgd[bg_idx].bg_flags & EXT4_BG_BLOCK_UNINIT)
+			ext4fs_init_blk_bmap(bg_idx, bmap);
 
-		if (ext4fs_set_block_bmap(fs->curr_blkno, fs->blk_bmaps[bg_idx],
-				   bg_idx) != 0) {
+		if (ext4fs_set_block_bmap(fs->curr_blkno, bmap, bg_idx) != 0) {
 			debug("going for restart for the block no %ld %u\n",
 			      fs->curr_blkno, bg_idx);
 			goto restart;
@@ -961,21 +1073,116 @@ restart:
 	}
 success:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return fs->curr_blkno;
 fail:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 }
 
+/**
+ * ext4fs_get_new_blk_run() - Allocate a run of contiguous blocks
+ *
+ * The search starts after the last allocated block and goes on through
+ * the following groups, skipping full groups without reading their
+ * bitmaps. The first free run of @want blocks in a group is taken, or
+ * else the longest free run of that group, so that one bitmap is read at
+ * most per call.
+ *
+ * @want:	number of blocks wanted
+ * @len:	returns the number of blocks allocated, 1 to @want
+ * @return first block allocated, or -1 if the filesystem is full
+ */
+long int ext4fs_get_new_blk_run(unsigned int want, unsigned int *len)
+{
+	static int prev_bg_bitmap_index = -1;
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = fs->bgd;
+	uint32_t bpg = le32_to_cpu(fs->sb->blocks_per_group);
+	uint32_t first_data = le32_to_cpu(fs->sb->first_data_block);
+	unsigned int group, n, bit, end, run, goal = 0;
+	unsigned int best = 0, best_len = 0;
+	unsigned char *bmap = NULL;
+	char *journal_buffer;
+
+	group = 0;
+	if (fs->first_pass_bbmap) {
+		group = (fs->curr_blkno - first_data) / bpg;
+		goal = (fs->curr_blkno - first_data) % bpg + 1;
+	}
+
+	/* the first group is searched again from its start at the end */
+	for (n = 0; n <= fs->no_blkgrp; n++, group++, goal = 0) {
+		if (group >= fs->no_blkgrp)
+			group = 0;
+		if (!bgd[group].free_blocks)
+			continue;
+
+		bmap = ext4fs_get_blk_bmap(group);
+		if (!bmap)
+			return -1;
+		if (bgd[group].bg_flags & EXT4_BG_BLOCK_UNINIT)
+			ext4fs_init_blk_bmap(group, bmap);
+
+		end = min(le32_to_cpu(fs->sb->total_blocks) - first_data -
+			  group * bpg, bpg);
+		best = best_len = 0;
+		for (bit = goal; bit < end && best_len < want; bit += run) {
+			run = 1;
+			if (!(bit % 8) && bmap[bit / 8] == 0xff)
+				run = 8;
+			if (ext4fs_test_bit(bmap, bit))
+				continue;
+			while (bit + run < end && run < want &&
+			       !ext4fs_test_bit(bmap, bit + run))
+				run++;
+			if (run > best_len) {
+				best = bit;
+				best_len = run;
+			}
+		}
+		if (best_len)
+			break;
+	}
+	if (n > fs->no_blkgrp)
+		return -1;
+
+	/* journal backup */
+	if (prev_bg_bitmap_index != group) {
+		journal_buffer = zalloc(fs->blksz);
+		if (!journal_buffer)
+			return -1;
+		if (!ext4fs_devread((lbaint_t)bgd[group].block_id *
+				    fs->sect_perblk, 0, fs->blksz,
+				    journal_buffer) ||
+		    ext4fs_log_journal(journal_buffer, bgd[group].block_id)) {
+			free(journal_buffer);
+			return -1;
+		}
+		free(journal_buffer);
+		prev_bg_bitmap_index = group;
+	}
+
+	for (bit = best; bit < best + best_len; bit++)
+		ext4fs_set_bit(bmap, bit);
+	bgd[group].free_blocks -= best_len;
+	fs->sb->free_blocks -= best_len;
+
+	/* ext4fs_get_new_blk_no() goes on after the run */
+	fs->curr_blkno = first_data + group * bpg + best + best_len - 1;
+	fs->first_pass_bbmap = 1;
+	*len = best_len;
+
+	return fs->curr_blkno - best_len + 1;
+}
+
 int ext4fs_get_new_inode_no(void)
 {
 	short i;
 	short status;
 	unsigned int ibmap_idx;
+	unsigned char *bmap;
 	static int prev_inode_bitmap_index = -1;
 	unsigned int inodes_per_grp = ext4fs_root->sblock.inodes_per_group;
 	struct ext_filesystem *fs = get_fs();
@@ -988,6 +1195,9 @@ int ext4fs_get_new_inode_no(void)
 	if (fs->first_pass_ibmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
 			if (bgd[i].free_inodes) {
+				bmap = ext4fs_get_inode_bmap(i);
+				if (!bmap)
+					goto fail;
 				if (bgd[i].bg_itable_unused !=
 						bgd[i].free_inodes)
 					bgd[i].bg_itable_unused =
@@ -999,11 +1209,9 @@ int ext4fs_get_new_inode_no(void)
 						 zero_buffer, fs->blksz);
 					bgd[i].bg_flags = bgd[i].bg_flags &
 							~EXT4_BG_INODE_UNINIT;
-					memcpy(fs->inode_bmaps[i],
-					       zero_buffer, fs->blksz);
+					memcpy(bmap, zero_buffer, fs->blksz);
 				}
-				fs->curr_inode_no =
-				    _get_new_inode_no(fs->inode_bmaps[i]);
+				fs->curr_inode_no = _get_new_inode_no(bmap);
 				if (fs->curr_inode_no == -1)
 					/* if block bitmap is completely fill */
 					continue;
@@ -1033,6 +1241,11 @@ restart:
 		fs->curr_inode_no++;
 		/* get the blockbitmap index respective to blockno */
 		ibmap_idx = fs->curr_inode_no / inodes_per_grp;
+		if (ibmap_idx >= fs->no_blkgrp)
+			goto fail;
+		bmap = ext4fs_get_inode_bmap(ibmap_idx);
+		if (!bmap)
+			goto fail;
 		if (bgd[ibmap_idx].bg_flags & EXT4_BG_INODE_UNINIT) {
 			memset(zero_buffer, '\0', fs->blksz);
 			put_ext4(((uint64_t) ((uint64_t)bgd[ibmap_idx].inode_id *
@@ -1040,12 +1253,10 @@ restart:
 				 fs->blksz);
 			bgd[ibmap_idx].bg_flags =
 			    bgd[ibmap_idx].bg_flags & ~EXT4_BG_INODE_UNINIT;
-			memcpy(fs->inode_bmaps[ibmap_idx], zero_buffer,
-				fs->blksz);
+			memcpy(bmap, zero_buffer, fs->blksz);
 		}
 
-		if (ext4fs_set_inode_bmap(fs->curr_inode_no,
-					  fs->inode_bmaps[ibmap_idx],
+		if (ext4fs_set_inode_bmap(fs->curr_inode_no, bmap,
 					  ibmap_idx) != 0) {
 			debug("going for restart for the block no %d %u\n",
 			      fs->curr_inode_no, ibmap_idx);
@@ -1371,7 +1582,155 @@ fail:
 	free(ti_gp_buff_start_addr);
 }
 
-void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
+/*
+ * Store @count extents in the inode. When they do not fit in the four
+ * slots of i_block, they are written to leaf blocks and the tree grows
+ * levels of index blocks until the indexes of the top level fit. Returns
+ * 0, or -1 if a tree block could not be allocated.
+ */
+static int ext4fs_put_extent_tree(struct ext2_inode *file_inode,
+				  struct ext4_extent *ext, unsigned int count,
+				  unsigned int *total_no_of_block)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_header *eh;
+	struct ext4_extent_idx *idx;
+	unsigned int per_blk = (fs->blksz - sizeof(*eh)) / sizeof(*ext);
+	unsigned int root_max = (sizeof(file_inode->b.blocks) - sizeof(*eh)) /
+				sizeof(*ext);
+	unsigned int depth = 0, nodes, i, n;
+	void *entries = ext;
+	long int blkno;
+	char *buf;
+	int ret = -1;
+
+	buf = zalloc(fs->blksz);
+	if (!buf) {
+		printf("No memory\n");
+		return -1;
+	}
+
+	/* extents and indexes are both 12 bytes, starting with a block */
+	while (count > root_max) {
+		nodes = ext4fs_div_roundup(count, per_blk);
+		idx = zalloc(nodes * sizeof(*idx));
+		if (!idx) {
+			printf("No memory\n");
+			goto fail;
+		}
+		for (i = 0; i < nodes; i++) {
+			n = min(count - i * per_blk, per_blk);
+			blkno = ext4fs_get_new_blk_no();
+			if (blkno == -1) {
+				printf("no block left to assign\n");
+				free(idx);
+				goto fail;
+			}
+			memset(buf, '\0', fs->blksz);
+			eh = (struct ext4_extent_header *)buf;
+			eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+			eh->eh_entries = cpu_to_le16(n);
+			eh->eh_max = cpu_to_le16(per_blk);
+			eh->eh_depth = cpu_to_le16(depth);
+			memcpy(eh + 1, (char *)entries +
+			       i * per_blk * sizeof(*idx), n * sizeof(*idx));
+			put_ext4((uint64_t)blkno * fs->blksz, buf, fs->blksz);
+
+			memcpy(&idx[i].ei_block, eh + 1, sizeof(idx->ei_block));
+			idx[i].ei_leaf_lo = cpu_to_le32(blkno);
+			(*total_no_of_block)++;
+		}
+		if (depth)
+			free(entries);
+		entries = idx;
+		count = nodes;
+		depth++;
+	}
+
+	eh = (struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	memset(eh, '\0', sizeof(file_inode->b.blocks));
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_entries = cpu_to_le16(count);
+	eh->eh_max = cpu_to_le16(root_max);
+	eh->eh_depth = cpu_to_le16(depth);
+	memcpy(eh + 1, entries, count * sizeof(*idx));
+	file_inode->flags |= cpu_to_le32(EXT4_EXTENTS_FL);
+	ret = 0;
+
+fail:
+	if (depth)
+		free(entries);
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Allocate the blocks of a file as runs of contiguous blocks and map them
+ * with an extent tree. Runs that turn out to be contiguous are merged.
+ */
+static int ext4fs_allocate_extents(struct ext2_inode *file_inode,
+				   unsigned int total_remaining_blocks,
+				   unsigned int *total_no_of_block)
+{
+	struct ext4_extent *ext = NULL, *tmp;
+	unsigned int count = 0, size = 0;
+	unsigned int lblk = 0, want, len;
+	long int start, prev_end;
+	int ret = -1;
+
+	while (lblk < total_remaining_blocks) {
+		want = min(total_remaining_blocks - lblk,
+			   (unsigned int)EXT_INIT_MAX_LEN);
+		start = ext4fs_get_new_blk_run(want, &len);
+		if (start == -1) {
+			printf("no block left to assign\n");
+			goto fail;
+		}
+		debug("EXT %u: %u blocks at %ld\n", lblk, len, start);
+
+		if (count) {
+			tmp = &ext[count - 1];
+			prev_end = le32_to_cpu(tmp->ee_start_lo) +
+				   le16_to_cpu(tmp->ee_len);
+			if (prev_end == start &&
+			    le16_to_cpu(tmp->ee_len) + len <= EXT_INIT_MAX_LEN) {
+				tmp->ee_len = cpu_to_le16(le16_to_cpu(
+							tmp->ee_len) + len);
+				lblk += len;
+				continue;
+			}
+		}
+
+		if (count == size) {
+			size = size ? size * 2 : 16;
+			tmp = realloc(ext, size * sizeof(*ext));
+			if (!tmp) {
+				printf("No memory\n");
+				goto fail;
+			}
+			ext = tmp;
+		}
+		tmp = &ext[count++];
+		tmp->ee_block = cpu_to_le32(lblk);
+		tmp->ee_len = cpu_to_le16(len);
+		tmp->ee_start_hi = cpu_to_le16((uint64_t)start >> 32);
+		tmp->ee_start_lo = cpu_to_le32(start);
+		lblk += len;
+	}
+
+	ret = ext4fs_put_extent_tree(file_inode, ext, count,
+				     total_no_of_block);
+	/* a map kept for a deleted file of this inode may match the tree */
+	ext4fs_free_extent_map();
+
+fail:
+	free(ext);
+
+	return ret;
+}
+
+int ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block)
 {
@@ -1379,12 +1738,18 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	long int direct_blockno;
 	unsigned int no_blks_reqd = 0;
 
+	if (le32_to_cpu(get_fs()->sb->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)
+		return ext4fs_allocate_extents(file_inode,
+					       total_remaining_blocks,
+					       total_no_of_block);
+
 	/* allocation of direct blocks */
 	for (i = 0; total_remaining_blocks && i < INDIRECT_BLOCKS; i++) {
 		direct_blockno = ext4fs_get_new_blk_no();
 		if (direct_blockno == -1) {
 			printf("no block left to assign\n");
-			return;
+			return -1;
 		}
 		file_inode->b.blocks.dir_blocks[i] = direct_blockno;
 		debug("DB %ld: %u\n", direct_blockno, total_remaining_blocks);
@@ -1399,6 +1764,8 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 	alloc_triple_indirect_block(file_inode, &total_remaining_blocks,
 				    &no_blks_reqd);
 	*total_no_of_block += no_blks_reqd;
+
+	return 0;
 }
 
 #endif
@@ -1442,6 +1809,156 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 	}
 }
 
+/* Extent map of the inode most recently read through ext4fs_read_file() */
+static struct ext4fs_extent_map ext4fs_extent_map;
+
+void ext4fs_free_extent_map(void)
+{
+	free(ext4fs_extent_map.ext);
+	memset(&ext4fs_extent_map, '\0', sizeof(ext4fs_extent_map));
+}
+
+static int ext4fs_add_extent(struct ext4fs_extent_map *map, uint32_t lblk,
+			     uint32_t len, uint64_t pblk)
+{
+	struct ext4fs_extent *ext;
+
+	if (map->count) {
+		ext = &map->ext[map->count - 1];
+		if (lblk < ext->lblk + ext->len)
+			return -EINVAL;
+		/* Merge with the previous extent if physically contiguous */
+		if (ext->lblk + ext->len == lblk && ext->pblk && pblk &&
+		    ext->pblk + ext->len == pblk) {
+			ext->len += len;
+			return 0;
+		}
+	}
+
+	if (map->count == map->size) {
+		int size = map->size ? map->size * 2 : 16;
+
+		ext = realloc(map->ext, size * sizeof(*ext));
+		if (!ext)
+			return -ENOMEM;
+		map->ext = ext;
+		map->size = size;
+	}
+
+	ext = &map->ext[map->count++];
+	ext->lblk = lblk;
+	ext->len = len;
+	ext->pblk = pblk;
+
+	return 0;
+}
+
+/*
+ * Walk one node of an extent tree, appending the extents of all leaves
+ * below it to the map in logical block order.
+ */
+static int ext4fs_map_extent_node(struct ext2_data *data,
+				  struct ext4_extent_header *ext_block,
+				  int depth, struct ext4fs_extent_map *map)
+{
+	int log2_blksz = LOG2_BLOCK_SIZE(data) - get_fs()->dev_desc->log2blksz;
+	int blksz = EXT2_BLOCK_SIZE(data);
+	int entries = le16_to_cpu(ext_block->eh_entries);
+	unsigned long long block;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(ext_block->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(ext_block->eh_depth) != depth)
+		return -EINVAL;
+
+	if (depth == 0) {
+		struct ext4_extent *extent = (struct ext4_extent *)
+			(ext_block + 1);
+
+		for (i = 0; i < entries; i++) {
+			uint32_t len = le16_to_cpu(extent[i].ee_len);
+
+			block = le16_to_cpu(extent[i].ee_start_hi);
+			block = (block << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			/* Unwritten extents read back as zeroes */
+			if (len > EXT_INIT_MAX_LEN) {
+				len -= EXT_INIT_MAX_LEN;
+				block = 0;
+			}
+			ret = ext4fs_add_extent(map,
+					le32_to_cpu(extent[i].ee_block),
+					len, block);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = 0; i < entries; i++) {
+		struct ext4_extent_idx *index = (struct ext4_extent_idx *)
+			(ext_block + 1);
+
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
+				    buf)) {
+			ret = -EIO;
+			break;
+		}
+		ret = ext4fs_map_extent_node(data,
+				(struct ext4_extent_header *)buf,
+				depth - 1, map);
+		if (ret)
+			break;
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * ext4fs_get_extent_map() - Get the decoded extent tree of an inode
+ *
+ * The tree is walked once and kept until a different inode is asked for,
+ * or until ext4fs_reinit_global() is called.
+ *
+ * @node: extent-mapped inode
+ * @return extent map, or NULL on error
+ */
+struct ext4fs_extent_map *ext4fs_get_extent_map(struct ext2fs_node *node)
+{
+	struct ext4fs_extent_map *map = &ext4fs_extent_map;
+	struct ext4_extent_header *root;
+
+	if (map->ino && map->ino == node->ino &&
+	    !memcmp(&map->root, &node->inode.b.blocks, sizeof(map->root)))
+		return map;
+
+	ext4fs_free_extent_map();
+	root = (struct ext4_extent_header *)node->inode.b.blocks.dir_blocks;
+	if (le16_to_cpu(root->eh_magic) != EXT4_EXT_MAGIC ||
+	    le16_to_cpu(root->eh_depth) > EXT4_EXT_MAX_DEPTH ||
+	    ext4fs_map_extent_node(node->data, root,
+				   le16_to_cpu(root->eh_depth), map)) {
+		printf("invalid extent block\n");
+		ext4fs_free_extent_map();
+		return NULL;
+	}
+
+	map->ino = node->ino;
+	memcpy(&map->root, &node->inode.b.blocks, sizeof(map->root));
+
+	return map;
+}
+
 static int ext4fs_blockgroup
 	(struct ext2_data *data, int group, struct ext2_block_group *blkgrp)
 {
@@ -1853,6 +2370,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_free_extent_map();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
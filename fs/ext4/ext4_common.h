@@ -48,8 +48,26 @@ static inline void *zalloc(size_t size)
 	return p;
 }
 
+/* Contiguous run of file blocks, as decoded from an inode's extent tree */
+struct ext4fs_extent {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block, 0 if unwritten */
+};
+
+/* All extents of one inode, sorted by logical block */
+struct ext4fs_extent_map {
+	int ino;
+	struct datablocks root;	/* copy of i_block, for validation */
+	struct ext4fs_extent *ext;
+	int count;
+	int size;
+};
+
 int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
+struct ext4fs_extent_map *ext4fs_get_extent_map(struct ext2fs_node *node);
+void ext4fs_free_extent_map(void);
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf);
 int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
@@ -63,14 +81,17 @@ int ext4fs_checksum_update(unsigned int i);
 int ext4fs_get_parent_inode_num(const char *dirname, char *dname, int flags);
 void ext4fs_update_parent_dentry(char *filename, int *p_ino, int file_type);
 long int ext4fs_get_new_blk_no(void);
+long int ext4fs_get_new_blk_run(unsigned int want, unsigned int *len);
 int ext4fs_get_new_inode_no(void);
+unsigned char *ext4fs_get_blk_bmap(unsigned int i);
+unsigned char *ext4fs_get_inode_bmap(unsigned int i);
 void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer,
 					int index);
 int ext4fs_set_block_bmap(long int blockno, unsigned char *buffer, int index);
 int ext4fs_set_inode_bmap(int inode_no, unsigned char *buffer, int index);
 void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index);
 int ext4fs_iget(int inode_no, struct ext2_inode *inode);
-void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
+int ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 				unsigned int total_remaining_blocks,
 				unsigned int *total_no_of_block);
 void put_ext4(uint64_t off, void *buf, uint32_t size);
@@ -29,7 +29,8 @@
 
 static void ext4fs_update(void)
 {
-	short i;
+	unsigned int i, desc_per_blk;
+	unsigned int blk = -1;
 	ext4fs_update_journal();
 	struct ext_filesystem *fs = get_fs();
 
@@ -37,23 +38,29 @@ static void ext4fs_update(void)
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
-	/* update block groups */
+	/* update the bitmaps of the block groups that changed */
 	for (i = 0; i < fs->no_blkgrp; i++) {
+		if (!fs->bg_dirty[i])
+			continue;
 		fs->bgd[i].bg_checksum = ext4fs_checksum_update(i);
-		put_ext4((uint64_t)((uint64_t)fs->bgd[i].block_id * (uint64_t)fs->blksz),
-			 fs->blk_bmaps[i], fs->blksz);
+		if (fs->blk_bmaps[i])
+			put_ext4((uint64_t)fs->bgd[i].block_id * fs->blksz,
+				 fs->blk_bmaps[i], fs->blksz);
+		if (fs->inode_bmaps[i])
+			put_ext4((uint64_t)fs->bgd[i].inode_id * fs->blksz,
+				 fs->inode_bmaps[i], fs->blksz);
 	}
 
-	/* update inode table groups */
+	/* update the blocks of the descriptor table holding those groups */
+	desc_per_blk = fs->blksz / sizeof(struct ext2_block_group);
 	for (i = 0; i < fs->no_blkgrp; i++) {
-		put_ext4((uint64_t) ((uint64_t)fs->bgd[i].inode_id * (uint64_t)fs->blksz),
-			 fs->inode_bmaps[i], fs->blksz);
+		if (!fs->bg_dirty[i] || i / desc_per_blk == blk)
+			continue;
+		blk = i / desc_per_blk;
+		put_ext4((uint64_t)(fs->gdtable_blkno + blk) * fs->blksz,
+			 fs->gdtable + blk * fs->blksz, fs->blksz);
 	}
-
-	/* update the block group descriptor table */
-	put_ext4((uint64_t)((uint64_t)fs->gdtable_blkno * (uint64_t)fs->blksz),
-		 (struct ext2_block_group *)fs->gdtable,
-		 (fs->blksz * fs->no_blk_pergdt));
+	memset(fs->bg_dirty, '\0', fs->no_blkgrp);
 
 	ext4fs_dump_metadata();
 
@@ -98,6 +105,7 @@ static void delete_single_indirect_block(struct ext2_inode *inode)
 {
 	struct ext2_block_group *bgd = NULL;
 	static int prev_bg_bmap_idx = -1;
+	unsigned char *bmap;
 	long int blknr;
 	int remainder;
 	int bg_idx;
@@ -122,7 +130,10 @@ static void delete_single_indirect_block(struct ext2_inode *inode)
 			if (!remainder)
 				bg_idx--;
 		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
+		bmap = ext4fs_get_blk_bmap(bg_idx);
+		if (!bmap)
+			goto fail;
+		ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
 		bgd[bg_idx].free_blocks++;
 		fs->sb->free_blocks++;
 		/* journal backup */
@@ -148,6 +159,7 @@ static void delete_double_indirect_block(struct ext2_inode *inode)
 	int i;
 	short status;
 	static int prev_bg_bmap_idx = -1;
+	unsigned char *bmap;
 	long int blknr;
 	int remainder;
 	int bg_idx;
@@ -185,8 +197,10 @@ static void delete_double_indirect_block(struct ext2_inode *inode)
 				if (!remainder)
 					bg_idx--;
 			}
-			ext4fs_reset_block_bmap(*di_buffer,
-					fs->blk_bmaps[bg_idx], bg_idx);
+			bmap = ext4fs_get_blk_bmap(bg_idx);
+			if (!bmap)
+				goto fail;
+			ext4fs_reset_block_bmap(*di_buffer, bmap, bg_idx);
 			di_buffer++;
 			bgd[bg_idx].free_blocks++;
 			fs->sb->free_blocks++;
@@ -215,7 +229,10 @@ static void delete_double_indirect_block(struct ext2_inode *inode)
 			if (!remainder)
 				bg_idx--;
 		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
+		bmap = ext4fs_get_blk_bmap(bg_idx);
+		if (!bmap)
+			goto fail;
+		ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
 		bgd[bg_idx].free_blocks++;
 		fs->sb->free_blocks++;
 		/* journal backup */
@@ -244,6 +261,7 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 	int i, j;
 	short status;
 	static int prev_bg_bmap_idx = -1;
+	unsigned char *bmap;
 	long int blknr;
 	int remainder;
 	int bg_idx;
@@ -294,8 +312,10 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 						bg_idx--;
 				}
 
-				ext4fs_reset_block_bmap(*tip_buffer,
-							fs->blk_bmaps[bg_idx],
+				bmap = ext4fs_get_blk_bmap(bg_idx);
+				if (!bmap)
+					goto fail;
+				ext4fs_reset_block_bmap(*tip_buffer, bmap,
 							bg_idx);
 
 				tip_buffer++;
@@ -333,8 +353,10 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 				if (!remainder)
 					bg_idx--;
 			}
-			ext4fs_reset_block_bmap(*tigp_buffer,
-						fs->blk_bmaps[bg_idx], bg_idx);
+			bmap = ext4fs_get_blk_bmap(bg_idx);
+			if (!bmap)
+				goto fail;
+			ext4fs_reset_block_bmap(*tigp_buffer, bmap, bg_idx);
 
 			tigp_buffer++;
 			bgd[bg_idx].free_blocks++;
@@ -365,7 +387,10 @@ static void delete_triple_indirect_block(struct ext2_inode *inode)
 			if (!remainder)
 				bg_idx--;
 		}
-		ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx], bg_idx);
+		bmap = ext4fs_get_blk_bmap(bg_idx);
+		if (!bmap)
+			goto fail;
+		ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
 		bgd[bg_idx].free_blocks++;
 		fs->sb->free_blocks++;
 		/* journal backup */
@@ -390,6 +415,72 @@ fail:
 	free(journal_buffer);
 }
 
+/* Free one block, logging its bitmap block in the journal */
+static int ext4fs_free_blk(long int blknr)
+{
+	struct ext_filesystem *fs = get_fs();
+	unsigned int blk_per_grp = ext4fs_root->sblock.blocks_per_group;
+	unsigned char *bmap;
+	char *journal_buffer;
+	int bg_idx;
+	int ret = -EIO;
+
+	bg_idx = blknr / blk_per_grp;
+	if (fs->blksz == 1024 && !(blknr % blk_per_grp))
+		bg_idx--;
+	bmap = ext4fs_get_blk_bmap(bg_idx);
+	if (!bmap)
+		return -EIO;
+	ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
+	fs->bgd[bg_idx].free_blocks++;
+	fs->sb->free_blocks++;
+
+	journal_buffer = zalloc(fs->blksz);
+	if (!journal_buffer)
+		return -ENOMEM;
+	if (ext4fs_devread((lbaint_t)fs->bgd[bg_idx].block_id *
+			   fs->sect_perblk, 0, fs->blksz, journal_buffer))
+		ret = ext4fs_log_journal(journal_buffer,
+					 fs->bgd[bg_idx].block_id);
+	free(journal_buffer);
+
+	return ret;
+}
+
+/* Free the index and leaf blocks below a node of an extent tree */
+static int ext4fs_delete_extent_tree(struct ext4_extent_header *eh)
+{
+	struct ext4_extent_idx *idx = (struct ext4_extent_idx *)(eh + 1);
+	struct ext_filesystem *fs = get_fs();
+	long int blknr;
+	char *buf;
+	int i, ret = 0;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC)
+		return -EINVAL;
+	if (!eh->eh_depth)
+		return 0;
+
+	buf = zalloc(fs->blksz);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; !ret && i < le16_to_cpu(eh->eh_entries); i++) {
+		blknr = le32_to_cpu(idx[i].ei_leaf_lo);
+		debug("EXT4_EXTENTS tree block releasing %ld\n", blknr);
+		if (!ext4fs_devread((lbaint_t)blknr * fs->sect_perblk, 0,
+				    fs->blksz, buf))
+			ret = -EIO;
+		if (!ret)
+			ret = ext4fs_delete_extent_tree(
+					(struct ext4_extent_header *)buf);
+		if (!ret)
+			ret = ext4fs_free_blk(blknr);
+	}
+	free(buf);
+
+	return ret;
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
@@ -404,6 +495,7 @@ static int ext4fs_delete_file(int inodeno)
 	unsigned int no_blocks;
 
 	static int prev_bg_bmap_idx = -1;
+	unsigned char *bmap;
 	unsigned int inodes_per_block;
 	long int blkno;
 	unsigned int blkoff;
@@ -444,8 +536,10 @@ static int ext4fs_delete_file(int inodeno)
 				if (!remainder)
 					bg_idx--;
 			}
-			ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-						bg_idx);
+			bmap = ext4fs_get_blk_bmap(bg_idx);
+			if (!bmap)
+				goto fail;
+			ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
 			debug("EXT4_EXTENTS Block releasing %ld: %d\n",
 			      blknr, bg_idx);
 
@@ -467,6 +561,11 @@ static int ext4fs_delete_file(int inodeno)
 				prev_bg_bmap_idx = bg_idx;
 			}
 		}
+		if (ext4fs_delete_extent_tree((struct ext4_extent_header *)
+					      inode.b.blocks.dir_blocks))
+			goto fail;
+		/* the blocks are free now, so the map must not be reused */
+		ext4fs_free_extent_map();
 		if (node_inode) {
 			free(node_inode);
 			node_inode = NULL;
@@ -489,8 +588,10 @@ static int ext4fs_delete_file(int inodeno)
 				if (!remainder)
 					bg_idx--;
 			}
-			ext4fs_reset_block_bmap(blknr, fs->blk_bmaps[bg_idx],
-						bg_idx);
+			bmap = ext4fs_get_blk_bmap(bg_idx);
+			if (!bmap)
+				goto fail;
+			ext4fs_reset_block_bmap(blknr, bmap, bg_idx);
 			debug("ActualB releasing %ld: %d\n", blknr, bg_idx);
 
 			bgd[bg_idx].free_blocks++;
@@ -548,7 +649,10 @@ static int ext4fs_delete_file(int inodeno)
 
 	/* update the respective inode bitmaps */
 	inodeno++;
-	ext4fs_reset_inode_bmap(inodeno, fs->inode_bmaps[ibmap_idx], ibmap_idx);
+	bmap = ext4fs_get_inode_bmap(ibmap_idx);
+	if (!bmap)
+		goto fail;
+	ext4fs_reset_inode_bmap(inodeno, bmap, ibmap_idx);
 	bgd[ibmap_idx].free_inodes++;
 	fs->sb->free_inodes++;
 	/* journal backup */
@@ -582,7 +686,6 @@ fail:
 
 int ext4fs_init(void)
 {
-	short status;
 	int i;
 	unsigned int real_free_blocks = 0;
 	struct ext_filesystem *fs = get_fs();
@@ -617,43 +720,15 @@ int ext4fs_init(void)
 	}
 	fs->bgd = (struct ext2_block_group *)fs->gdtable;
 
-	/* load all the available bitmap block of the partition */
-	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(char *));
-	if (!fs->blk_bmaps)
-		goto fail;
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		fs->blk_bmaps[i] = zalloc(fs->blksz);
-		if (!fs->blk_bmaps[i])
-			goto fail;
-	}
-
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		status =
-		    ext4fs_devread((lbaint_t)fs->bgd[i].block_id *
-				   fs->sect_perblk, 0,
-				   fs->blksz, (char *)fs->blk_bmaps[i]);
-		if (status == 0)
-			goto fail;
-	}
-
-	/* load all the available inode bitmap of the partition */
+	/*
+	 * the bitmaps are read by ext4fs_get_blk_bmap() and
+	 * ext4fs_get_inode_bmap() when a group is first changed
+	 */
+	fs->blk_bmaps = zalloc(fs->no_blkgrp * sizeof(unsigned char *));
 	fs->inode_bmaps = zalloc(fs->no_blkgrp * sizeof(unsigned char *));
-	if (!fs->inode_bmaps)
+	fs->bg_dirty = zalloc(fs->no_blkgrp);
+	if (!fs->blk_bmaps || !fs->inode_bmaps || !fs->bg_dirty)
 		goto fail;
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		fs->inode_bmaps[i] = zalloc(fs->blksz);
-		if (!fs->inode_bmaps[i])
-			goto fail;
-	}
-
-	for (i = 0; i < fs->no_blkgrp; i++) {
-		status = ext4fs_devread((lbaint_t)fs->bgd[i].inode_id *
-					fs->sect_perblk,
-					0, fs->blksz,
-					(char *)fs->inode_bmaps[i]);
-		if (status == 0)
-			goto fail;
-	}
 
 	/*
 	 * check filesystem consistency with free blocks of file system
@@ -724,6 +799,8 @@ void ext4fs_deinit(void)
 		fs->inode_bmaps = NULL;
 	}
 
+	free(fs->bg_dirty);
+	fs->bg_dirty = NULL;
 
 	free(fs->gdtable);
 	fs->gdtable = NULL;
@@ -817,6 +894,37 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 	return len;
 }
 
+/* Write the data of an extent-mapped file, one put_ext4() per extent */
+static int ext4fs_write_extents(struct ext2_inode *file_inode, int ino,
+				unsigned int len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4fs_extent_map *map;
+	struct ext4fs_extent *ext;
+	struct ext2fs_node node;
+	unsigned int off, blocks;
+	int i;
+
+	node.data = ext4fs_root;
+	node.ino = ino;
+	node.inode_read = 1;
+	memcpy(&node.inode, file_inode, sizeof(node.inode));
+	map = ext4fs_get_extent_map(&node);
+	if (!map)
+		return -1;
+
+	for (i = 0; i < map->count; i++) {
+		ext = &map->ext[i];
+		off = ext->lblk * fs->blksz;
+		if (off >= len)
+			break;
+		blocks = min(ext->len, ext4fs_div_roundup(len - off, fs->blksz));
+		put_ext4(ext->pblk * fs->blksz, buf + off, blocks * fs->blksz);
+	}
+
+	return len;
+}
+
 int ext4fs_write(const char *fname, unsigned char *buffer,
 					unsigned long sizebytes)
 {
@@ -898,8 +1006,9 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	file_inode->size = sizebytes;
 
 	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	if (ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				   &blks_reqd_for_file))
+		goto fail;
 	file_inode->blockcnt = (blks_reqd_for_file * fs->blksz) >>
 		fs->dev_desc->log2blksz;
 
@@ -921,7 +1030,13 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 	if (ext4fs_put_metadata(temp_ptr, itable_blkno))
 		goto fail;
 	/* copy the file content into data blocks */
-	if (ext4fs_write_file(file_inode, 0, sizebytes, (char *)buffer) == -1) {
+	if (le32_to_cpu(file_inode->flags) & EXT4_EXTENTS_FL)
+		ret = ext4fs_write_extents(file_inode, inodeno + 1, sizebytes,
+					   (char *)buffer);
+	else
+		ret = ext4fs_write_file(file_inode, 0, sizebytes,
+					(char *)buffer);
+	if (ret == -1) {
 		printf("Error in copying content\n");
 		goto fail;
 	}
@@ -40,6 +40,84 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/* Largest read passed to ext4fs_devread(), a multiple of any block size */
+#define EXT4_MAX_DEVREAD	(1 << 30)
+
+/*
+ * Read from an extent-mapped inode: the extent tree is decoded once and
+ * every physically contiguous run is fetched with a single device read.
+ */
+static int ext4fs_read_extents(struct ext2fs_node *node, int pos,
+			       unsigned int len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) -
+				fs->dev_desc->log2blksz;
+	int log2_blocksize = LOG2_BLOCK_SIZE(node->data);
+	struct ext4fs_extent_map *map;
+	uint64_t cur = pos, end = (uint64_t)pos + len, off, n;
+	int lo, hi;
+
+	map = ext4fs_get_extent_map(node);
+	if (!map)
+		return -1;
+
+	/* Find the first extent ending after pos */
+	lo = 0;
+	hi = map->count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		struct ext4fs_extent *ext = &map->ext[mid];
+
+		if (((uint64_t)ext->lblk + ext->len) << log2_blocksize <= cur)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < map->count && cur < end; lo++) {
+		struct ext4fs_extent *ext = &map->ext[lo];
+		uint64_t ext_start = (uint64_t)ext->lblk << log2_blocksize;
+		uint64_t ext_end = ext_start +
+				   ((uint64_t)ext->len << log2_blocksize);
+		uint64_t stop = min(ext_end, end);
+
+		/* Hole before this extent */
+		if (ext_start > cur) {
+			uint64_t gap = min(ext_start, end) - cur;
+
+			memset(buf + (cur - pos), 0, gap);
+			cur += gap;
+			if (cur >= end)
+				break;
+		}
+
+		if (!ext->pblk) {
+			memset(buf + (cur - pos), 0, stop - cur);
+			cur = stop;
+		}
+
+		/* ext4fs_devread() takes int offsets, so address the block */
+		while (cur < stop) {
+			off = cur - ext_start;
+			n = min(stop - cur, (uint64_t)EXT4_MAX_DEVREAD);
+			if (!ext4fs_devread((lbaint_t)(ext->pblk +
+					    (off >> log2_blocksize)) <<
+					    log2_fs_blocksize,
+					    off & ((1 << log2_blocksize) - 1),
+					    n, buf + (cur - pos)))
+				return -1;
+			cur += n;
+		}
+	}
+
+	/* Sparse tail */
+	if (cur < end)
+		memset(buf + (cur - pos), 0, end - cur);
+
+	return len;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -67,6 +145,9 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 	if (len > filesize)
 		len = filesize;
 
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL)
+		return ext4fs_read_extents(node, pos, len, buf);
+
 	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
 
 	for (i = pos / blocksize; i < blockcnt; i++) {
@@ -48,8 +48,7 @@ static int disk_read(__u32 block, __u32 nr_blocks, void *buf)
 	if (!cur_dev || !cur_dev->block_read)
 		return -1;
 
-	return cur_dev->block_read(cur_dev->dev,
-			cur_part_info.start + block, nr_blocks, buf);
+	return blk_dread(cur_dev, cur_part_info.start + block, nr_blocks, buf);
 }
 
 int fat_set_blk_dev(block_dev_desc_t *dev_desc, disk_partition_t *info)
@@ -189,10 +188,10 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
+		__u32 getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
@@ -322,6 +321,156 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 __u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
 
+#ifdef CONFIG_FAT_CHAIN_PREFETCH
+/* A run of physically consecutive clusters */
+struct fat_run {
+	__u32 start;
+	__u32 count;
+};
+
+/*
+ * Follow the cluster chain starting at 'clust' for at most 'nclust'
+ * clusters and decode it into a list of runs.
+ * Return the number of runs, or -1 if out of memory. The chain is cut
+ * short at the first invalid FAT entry.
+ */
+static int get_cluster_runs(fsdata *mydata, __u32 clust, __u32 nclust,
+			    struct fat_run **runsp)
+{
+	struct fat_run *runs = NULL, *tmp;
+	int nruns = 0, size = 0;
+	__u32 i;
+
+	for (i = 0; i < nclust; i++) {
+		if (nruns && runs[nruns - 1].start +
+			     runs[nruns - 1].count == clust) {
+			runs[nruns - 1].count++;
+		} else {
+			if (nruns == size) {
+				size = size ? size * 2 : 16;
+				tmp = realloc(runs, size * sizeof(*runs));
+				if (!tmp) {
+					free(runs);
+					return -1;
+				}
+				runs = tmp;
+			}
+			runs[nruns].start = clust;
+			runs[nruns].count = 1;
+			nruns++;
+		}
+
+		if (i + 1 == nclust)
+			break;
+		clust = get_fatent(mydata, clust);
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			debug("Invalid FAT entry\n");
+			break;
+		}
+	}
+
+	*runsp = runs;
+	return nruns;
+}
+
+/*
+ * Prefetch mode of get_contents(): map the whole cluster chain first and
+ * then issue one multi-sector read per run of consecutive clusters.
+ * Clusters that are only partly wanted (at 'pos' and at the end) are
+ * bounced through get_contents_vfatname_block.
+ */
+static long
+get_contents_runs(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
+		  __u8 *buffer, unsigned long filesize)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	__u32 skip = pos / bytesperclust;
+	unsigned long offset = pos % bytesperclust;
+	unsigned long gotsize = 0, left = filesize - pos;
+	struct fat_run *runs;
+	int nruns, i;
+
+	nruns = get_cluster_runs(mydata, START(dentptr),
+				 DIV_ROUND_UP(filesize, bytesperclust), &runs);
+	if (nruns < 0) {
+		printf("Error: allocating memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < nruns && left; i++) {
+		__u32 clust = runs[i].start;
+		__u32 count = runs[i].count;
+		unsigned long actsize;
+
+		if (skip >= count) {
+			skip -= count;
+			continue;
+		}
+		clust += skip;
+		count -= skip;
+		skip = 0;
+
+		/* Unaligned head */
+		if (offset) {
+			actsize = min(left + offset, (unsigned long)bytesperclust);
+			if (get_cluster(mydata, clust,
+					get_contents_vfatname_block,
+					actsize) != 0) {
+				printf("Error reading cluster\n");
+				free(runs);
+				return -1;
+			}
+			actsize -= offset;
+			memcpy(buffer, get_contents_vfatname_block + offset,
+			       actsize);
+			offset = 0;
+			gotsize += actsize;
+			buffer += actsize;
+			left -= actsize;
+			clust++;
+			count--;
+		}
+
+		/* Whole clusters, one read for the run */
+		actsize = min(left / bytesperclust, (unsigned long)count);
+		if (actsize) {
+			debug("run: cluster %u, %lu clusters\n", clust,
+			      actsize);
+			if (get_cluster(mydata, clust, buffer,
+					actsize * bytesperclust) != 0) {
+				printf("Error reading cluster\n");
+				free(runs);
+				return -1;
+			}
+			clust += actsize;
+			count -= actsize;
+			actsize *= bytesperclust;
+			gotsize += actsize;
+			buffer += actsize;
+			left -= actsize;
+		}
+
+		/* Partial tail cluster */
+		if (count && left && left < bytesperclust) {
+			if (get_cluster(mydata, clust,
+					get_contents_vfatname_block,
+					left) != 0) {
+				printf("Error reading cluster\n");
+				free(runs);
+				return -1;
+			}
+			memcpy(buffer, get_contents_vfatname_block, left);
+			gotsize += left;
+			left = 0;
+		}
+	}
+
+	free(runs);
+	return gotsize;
+}
+#endif
+
 static long
 get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	     __u8 *buffer, unsigned long maxsize)
@@ -344,6 +493,12 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 
 	debug("%ld bytes\n", filesize);
 
+#ifdef CONFIG_FAT_CHAIN_PREFETCH
+	if (mydata->prefetch)
+		return get_contents_runs(mydata, dentptr, pos, buffer,
+					 filesize);
+#endif
+
 	actsize = bytesperclust;
 
 	/* go to cluster at pos */
@@ -806,6 +961,41 @@ exit:
 __u8 do_fat_read_at_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
 
+#ifdef CONFIG_FAT_CHAIN_PREFETCH
+#ifndef CONFIG_FAT_CACHE_BLOCKS
+#define CONFIG_FAT_CACHE_BLOCKS	1024
+#endif
+
+/*
+ * Unless disabled with the "fatprefetch" environment variable, cache the
+ * whole FAT (at most CONFIG_FAT_CACHE_BLOCKS sectors of it) in one read
+ * and map cluster chains before reading file data. If the large FAT
+ * buffer cannot be allocated, the caller falls back to the small window.
+ */
+static void fat_setup_prefetch(fsdata *mydata)
+{
+	__u32 blocks = mydata->fatlength;
+
+#ifndef CONFIG_SPL_BUILD
+	if (getenv_yesno("fatprefetch") == 0)
+		return;
+#endif
+
+	mydata->prefetch = 1;
+	if (blocks > CONFIG_FAT_CACHE_BLOCKS)
+		blocks = CONFIG_FAT_CACHE_BLOCKS;
+	/* FAT12 entries must not straddle two buffer windows */
+	blocks = roundup(blocks, FATBUFBLOCKS);
+	if (blocks <= FATBUFBLOCKS)
+		return;
+
+	mydata->fatbufblocks = blocks;
+	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	if (mydata->fatbuf == NULL)
+		debug("Cannot cache %u FAT sectors\n", blocks);
+}
+#endif
+
 long
 do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	       unsigned long maxsize, int dols, int dogetsize)
@@ -866,7 +1056,15 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	}
 
 	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbuf = NULL;
+	mydata->prefetch = 0;
+#ifdef CONFIG_FAT_CHAIN_PREFETCH
+	fat_setup_prefetch(mydata);
+#endif
+	if (mydata->fatbuf == NULL) {
+		mydata->fatbufblocks = FATBUFBLOCKS;
+		mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	}
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
@@ -37,8 +37,7 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 		return -1;
 	}
 
-	return cur_dev->block_write(cur_dev->dev,
-			cur_part_info.start + block, nr_blocks,	buf);
+	return blk_dwrite(cur_dev, cur_part_info.start + block, nr_blocks, buf);
 }
 
 /*
@@ -979,6 +978,8 @@ static int do_fat_write(const char *filename, void *buffer,
 	}
 
 	mydata->fatbufnum = -1;
+	mydata->fatbufblocks = FATBUFBLOCKS;
+	mydata->prefetch = 0;
 	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
@@ -20,6 +20,7 @@
 #include <ext4fs.h>
 #include <fat.h>
 #include <fs.h>
+#include <image.h>
 #include <sandboxfs.h>
 #include <asm/io.h>
 
@@ -266,6 +267,45 @@ int fs_write(const char *filename, ulong addr, int offset, int len)
 	return ret;
 }
 
+#ifdef CONFIG_IMAGE_STREAM
+/* Size of the pieces a streamed image is read in */
+#define FS_STREAM_CHUNK		(1 << 20)
+
+/*
+ * Read a file a piece at a time so that an image can be decompressed while
+ * it loads (see common/image-stream.c). The filesystem is set up once, for
+ * all the pieces.
+ */
+static int fs_read_stream(const char *filename, ulong addr, int pos, int len)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	int done = 0;
+	int chunk, ret;
+	void *buf;
+
+	do {
+		chunk = FS_STREAM_CHUNK;
+		if (len)
+			chunk = min(chunk, len - done);
+		buf = map_sysmem(addr + done, chunk);
+		ret = info->read(filename, buf, pos + done, chunk);
+		unmap_sysmem(buf);
+		if (ret < 0)
+			break;
+		image_stream_write(done, ret);
+		done += ret;
+	} while (ret == chunk && done != len);
+	fs_close();
+
+	if (ret >= 0 && len && done != len) {
+		printf("** Unable to read file %s **\n", filename);
+		ret = -1;
+	}
+
+	return ret < 0 ? ret : done;
+}
+#endif
+
 int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype)
 {
@@ -312,9 +352,17 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	else
 		pos = 0;
 
+	image_stream_start(addr);
 	time = get_timer(0);
-	len_read = fs_read(filename, addr, pos, bytes);
+#ifdef CONFIG_IMAGE_STREAM
+	/* ext4 cannot read at an offset, so load it in one go */
+	if (fs_type != FS_TYPE_EXT && getenv_yesno("bootm_stream") == 1)
+		len_read = fs_read_stream(filename, addr, pos, bytes);
+	else
+#endif
+		len_read = fs_read(filename, addr, pos, bytes);
 	time = get_timer(time);
+	image_stream_end(max(len_read, 0));
 	if (len_read <= 0)
 		return 1;
 
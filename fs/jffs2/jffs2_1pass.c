@@ -92,13 +92,10 @@
  * - implemented fragment sorting to ensure that the newest data is copied
  *   if there are multiple copies of fragments for a certain file offset.
  *
- * The fragment sorting feature must be enabled by CONFIG_SYS_JFFS2_SORT_FRAGMENTS.
- * Sorting is done while adding fragments to the lists, which is more or less a
- * bubble sort. This takes a lot of time, and is most probably not an issue if
- * the boot filesystem is always mounted readonly.
- *
- * You should define it if the boot filesystem is mounted writable, and updates
- * to the boot files are done by copying files to that filesystem.
+ * The fragment sorting feature used to be enabled by
+ * CONFIG_SYS_JFFS2_SORT_FRAGMENTS and was more or less a bubble sort done
+ * while adding fragments to the lists. The lists are now arrays which are
+ * sorted once the scan is done (see below), so the newest data always wins.
  *
  *
  * There's a big issue left: endianess is completely ignored in this code. Duh!
@@ -159,50 +156,63 @@ static struct part_info *current_part;
  *
  */
 
-#define NAND_PAGE_SIZE 512
-#define NAND_PAGE_SHIFT 9
-#define NAND_PAGE_MASK (~(NAND_PAGE_SIZE-1))
-
-#ifndef NAND_CACHE_PAGES
-#define NAND_CACHE_PAGES 16
-#endif
-#define NAND_CACHE_SIZE (NAND_CACHE_PAGES*NAND_PAGE_SIZE)
-
 static u8* nand_cache = NULL;
 static u32 nand_cache_off = (u32)-1;
+static u32 nand_cache_size;
 
+static int read_nand_direct(u32 off, u32 size, u_char *buf)
+{
+	struct mtdids *id = current_part->dev->id;
+	size_t retlen = size;
+	int ret;
+
+	ret = nand_read(&nand_info[id->num], off, &retlen, buf);
+	if ((ret && ret != -EUCLEAN) || retlen != size) {
+		printf("read_nand_direct: error reading nand off %#x size %d bytes\n",
+		       off, size);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The cache holds one erase block: the nodes of a file are mostly written
+ * one after the other, so this reads each block once rather than once for
+ * every node in it.
+ */
 static int read_nand_cached(u32 off, u32 size, u_char *buf)
 {
 	struct mtdids *id = current_part->dev->id;
+	u32 erasesize = nand_info[id->num].erasesize;
 	u32 bytes_read = 0;
-	size_t retlen;
 	int cpy_bytes;
 
 	while (bytes_read < size) {
 		if ((off + bytes_read < nand_cache_off) ||
-		    (off + bytes_read >= nand_cache_off+NAND_CACHE_SIZE)) {
-			nand_cache_off = (off + bytes_read) & NAND_PAGE_MASK;
-			if (!nand_cache) {
+		    (off + bytes_read >= nand_cache_off + nand_cache_size)) {
+			if (nand_cache_size != erasesize) {
 				/* This memory never gets freed but 'cause
 				   it's a bootloader, nobody cares */
-				nand_cache = malloc(NAND_CACHE_SIZE);
+				free(nand_cache);
+				nand_cache_size = 0;
+				nand_cache = malloc(erasesize);
 				if (!nand_cache) {
 					printf("read_nand_cached: can't alloc cache size %d bytes\n",
-					       NAND_CACHE_SIZE);
+					       erasesize);
 					return -1;
 				}
+				nand_cache_size = erasesize;
 			}
 
-			retlen = NAND_CACHE_SIZE;
-			if (nand_read(&nand_info[id->num], nand_cache_off,
-						&retlen, nand_cache) != 0 ||
-					retlen != NAND_CACHE_SIZE) {
-				printf("read_nand_cached: error reading nand off %#x size %d bytes\n",
-						nand_cache_off, NAND_CACHE_SIZE);
+			nand_cache_off = (off + bytes_read) & ~(erasesize - 1);
+			if (read_nand_direct(nand_cache_off, erasesize,
+					     nand_cache) < 0) {
+				nand_cache_off = (u32)-1;
 				return -1;
 			}
 		}
-		cpy_bytes = nand_cache_off + NAND_CACHE_SIZE - (off + bytes_read);
+		cpy_bytes = nand_cache_off + nand_cache_size -
+			    (off + bytes_read);
 		if (cpy_bytes > size - bytes_read)
 			cpy_bytes = size - bytes_read;
 		memcpy(buf + bytes_read,
@@ -259,49 +269,59 @@ static void put_fl_mem_nand(void *buf)
 #include <linux/mtd/onenand.h>
 #include <onenand_uboot.h>
 
-#define ONENAND_PAGE_SIZE 2048
-#define ONENAND_PAGE_SHIFT 11
-#define ONENAND_PAGE_MASK (~(ONENAND_PAGE_SIZE-1))
-
-#ifndef ONENAND_CACHE_PAGES
-#define ONENAND_CACHE_PAGES 4
-#endif
-#define ONENAND_CACHE_SIZE (ONENAND_CACHE_PAGES*ONENAND_PAGE_SIZE)
-
 static u8* onenand_cache;
 static u32 onenand_cache_off = (u32)-1;
+static u32 onenand_cache_size;
+
+static int read_onenand_direct(u32 off, u32 size, u_char *buf)
+{
+	size_t retlen;
+	int ret;
+
+	ret = onenand_read(&onenand_mtd, off, size, &retlen, buf);
+	if ((ret && ret != -EUCLEAN) || retlen != size) {
+		printf("read_onenand_direct: error reading nand off %#x size %d bytes\n",
+		       off, size);
+		return -1;
+	}
+	return 0;
+}
 
+/* Like the NAND one, the cache holds one erase block */
 static int read_onenand_cached(u32 off, u32 size, u_char *buf)
 {
+	u32 erasesize = onenand_mtd.erasesize;
 	u32 bytes_read = 0;
-	size_t retlen;
 	int cpy_bytes;
 
 	while (bytes_read < size) {
 		if ((off + bytes_read < onenand_cache_off) ||
-		    (off + bytes_read >= onenand_cache_off + ONENAND_CACHE_SIZE)) {
-			onenand_cache_off = (off + bytes_read) & ONENAND_PAGE_MASK;
-			if (!onenand_cache) {
+		    (off + bytes_read >=
+		     onenand_cache_off + onenand_cache_size)) {
+			if (onenand_cache_size != erasesize) {
 				/* This memory never gets freed but 'cause
 				   it's a bootloader, nobody cares */
-				onenand_cache = malloc(ONENAND_CACHE_SIZE);
+				free(onenand_cache);
+				onenand_cache_size = 0;
+				onenand_cache = malloc(erasesize);
 				if (!onenand_cache) {
 					printf("read_onenand_cached: can't alloc cache size %d bytes\n",
-					       ONENAND_CACHE_SIZE);
+					       erasesize);
 					return -1;
 				}
+				onenand_cache_size = erasesize;
 			}
 
-			retlen = ONENAND_CACHE_SIZE;
-			if (onenand_read(&onenand_mtd, onenand_cache_off, retlen,
-						&retlen, onenand_cache) != 0 ||
-					retlen != ONENAND_CACHE_SIZE) {
-				printf("read_onenand_cached: error reading nand off %#x size %d bytes\n",
-					onenand_cache_off, ONENAND_CACHE_SIZE);
+			onenand_cache_off = (off + bytes_read) &
+					    ~(erasesize - 1);
+			if (read_onenand_direct(onenand_cache_off, erasesize,
+						onenand_cache) < 0) {
+				onenand_cache_off = (u32)-1;
 				return -1;
 			}
 		}
-		cpy_bytes = onenand_cache_off + ONENAND_CACHE_SIZE - (off + bytes_read);
+		cpy_bytes = onenand_cache_off + onenand_cache_size -
+			    (off + bytes_read);
 		if (cpy_bytes > size - bytes_read)
 			cpy_bytes = size - bytes_read;
 		memcpy(buf + bytes_read,
@@ -470,6 +490,39 @@ static inline void put_fl_mem(void *buf, void *ext_buf)
 	}
 }
 
+/*
+ * Read flash into a buffer without going through the cache, for data that
+ * is only needed once, like the summary at the end of an erase block.
+ */
+static int read_fl_mem(u32 off, u32 size, void *buf)
+{
+	struct mtdids *id = current_part->dev->id;
+
+	switch (id->type) {
+#if defined(CONFIG_JFFS2_NAND) && defined(CONFIG_CMD_NAND)
+	case MTD_DEV_TYPE_NAND:
+		return read_nand_direct(off, size, buf);
+#endif
+#if defined(CONFIG_CMD_ONENAND)
+	case MTD_DEV_TYPE_ONENAND:
+		return read_onenand_direct(off, size, buf);
+#endif
+	default:
+		return get_fl_mem(off, size, buf) ? 0 : -1;
+	}
+}
+
+/* The flash may have been written since the last command */
+static void flush_fl_cache(void)
+{
+#if defined(CONFIG_JFFS2_NAND) && defined(CONFIG_CMD_NAND)
+	nand_cache_off = (u32)-1;
+#endif
+#if defined(CONFIG_CMD_ONENAND)
+	onenand_cache_off = (u32)-1;
+#endif
+}
+
 /* Compression names */
 static char *compr_names[] = {
 	"NONE",
@@ -484,175 +537,232 @@ static char *compr_names[] = {
 #endif
 };
 
-/* Memory management */
-struct mem_block {
-	u32	index;
-	struct mem_block *next;
-	struct b_node nodes[NODE_CHUNK];
-};
+/*
+ * The node index
+ *
+ * The data nodes and the directory entries found by the scan are kept in
+ * arrays, along with what is needed to look them up without reading the
+ * flash again. Once the scan is done the data nodes are sorted by inode
+ * and version and the directory entries by parent inode, name crc, name
+ * length and version, with an array of pointers to them sorted by inode.
+ * All the nodes of an inode or the entries for a name are then next to
+ * each other with the newest last, and are found by binary search.
+ */
+static void *
+grow_list(void *base, u32 count, u32 *size, size_t entry_size)
+{
+	u32 new_size;
 
+	if (count < *size)
+		return base;
 
-static void
-free_nodes(struct b_list *list)
-{
-	while (list->listMemBase != NULL) {
-		struct mem_block *next = list->listMemBase->next;
-		free( list->listMemBase );
-		list->listMemBase = next;
+	new_size = *size ? *size * 2 : NODE_CHUNK;
+	base = realloc(base, new_size * entry_size);
+	if (base == NULL) {
+		putstr("add_node: malloc failed\n");
+		return NULL;
 	}
+	*size = new_size;
+	return base;
 }
 
 static struct b_node *
 add_node(struct b_list *list)
 {
-	u32 index = 0;
-	struct mem_block *memBase;
-	struct b_node *b;
+	struct b_node *nodes;
 
-	memBase = list->listMemBase;
-	if (memBase != NULL)
-		index = memBase->index;
-#if 0
-	putLabeledWord("add_node: index = ", index);
-	putLabeledWord("add_node: memBase = ", list->listMemBase);
-#endif
+	nodes = grow_list(list->nodes, list->listCount, &list->listSize,
+			  sizeof(*nodes));
+	if (nodes == NULL)
+		return NULL;
+	list->nodes = nodes;
+	return &nodes[list->listCount++];
+}
 
-	if (memBase == NULL || index >= NODE_CHUNK) {
-		/* we need more space before we continue */
-		memBase = mmalloc(sizeof(struct mem_block));
-		if (memBase == NULL) {
-			putstr("add_node: malloc failed\n");
-			return NULL;
-		}
-		memBase->next = list->listMemBase;
-		index = 0;
-#if 0
-		putLabeledWord("add_node: alloced a new membase at ", *memBase);
-#endif
+static struct b_dirent *
+add_dirent(struct b_dir_list *list)
+{
+	struct b_dirent *dirents;
 
-	}
-	/* now we have room to add it. */
-	b = &memBase->nodes[index];
-	index ++;
-
-	memBase->index = index;
-	list->listMemBase = memBase;
-	list->listCount++;
-	return b;
+	dirents = grow_list(list->dirents, list->listCount, &list->listSize,
+			    sizeof(*dirents));
+	if (dirents == NULL)
+		return NULL;
+	list->dirents = dirents;
+	return &dirents[list->listCount++];
 }
 
 static struct b_node *
-insert_node(struct b_list *list, u32 offset)
+insert_node(struct b_lists *pL, u32 offset, u32 totlen)
 {
 	struct b_node *new;
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-	struct b_node *b, *prev;
-#endif
 
-	if (!(new = add_node(list))) {
+	if (!(new = add_node(&pL->frag))) {
 		putstr("add_node failed!\r\n");
 		return NULL;
 	}
 	new->offset = offset;
+	new->datacrc = CRC_UNKNOWN;
+	if (pL->max_totlen < totlen)
+		pL->max_totlen = totlen;
 
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-	if (list->listTail != NULL && list->listCompare(new, list->listTail))
-		prev = list->listTail;
-	else if (list->listLast != NULL && list->listCompare(new, list->listLast))
-		prev = list->listLast;
-	else
-		prev = NULL;
+	return new;
+}
 
-	for (b = (prev ? prev->next : list->listHead);
-	     b != NULL && list->listCompare(new, b);
-	     prev = b, b = b->next) {
-		list->listLoops++;
-	}
-	if (b != NULL)
-		list->listLast = prev;
+static struct b_dirent *
+insert_dirent(struct b_lists *pL, u32 offset, u32 totlen)
+{
+	struct b_dirent *new;
 
-	if (b != NULL) {
-		new->next = b;
-		if (prev != NULL)
-			prev->next = new;
-		else
-			list->listHead = new;
-	} else
-#endif
-	{
-		new->next = (struct b_node *) NULL;
-		if (list->listTail != NULL) {
-			list->listTail->next = new;
-			list->listTail = new;
-		} else {
-			list->listTail = list->listHead = new;
-		}
+	if (!(new = add_dirent(&pL->dir))) {
+		putstr("add_node failed!\r\n");
+		return NULL;
 	}
+	new->offset = offset;
+	if (pL->max_totlen < totlen)
+		pL->max_totlen = totlen;
 
 	return new;
 }
 
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-/* Sort data entries with the latest version last, so that if there
+/* Sort data nodes by inode with the latest version last, so that if there
  * is overlapping data the latest version will be used.
  */
-static int compare_inodes(struct b_node *new, struct b_node *old)
+static int compare_nodes(const void *a, const void *b)
 {
-	struct jffs2_raw_inode ojNew;
-	struct jffs2_raw_inode ojOld;
-	struct jffs2_raw_inode *jNew =
-		(struct jffs2_raw_inode *)get_fl_mem(new->offset, sizeof(ojNew), &ojNew);
-	struct jffs2_raw_inode *jOld =
-		(struct jffs2_raw_inode *)get_fl_mem(old->offset, sizeof(ojOld), &ojOld);
-
-	return jNew->version > jOld->version;
+	const struct b_node *new = a, *old = b;
+
+	if (new->ino != old->ino)
+		return new->ino > old->ino ? 1 : -1;
+	if (new->version != old->version)
+		return new->version > old->version ? 1 : -1;
+	return 0;
 }
 
-/* Sort directory entries so all entries in the same directory
- * with the same name are grouped together, with the latest version
- * last. This makes it easy to eliminate all but the latest version
- * by marking the previous version dead by setting the inode to 0.
+/* Sort directory entries so all entries in the same directory with the
+ * same name crc and length are grouped together, with the latest version
+ * last.
  */
-static int compare_dirents(struct b_node *new, struct b_node *old)
+static int compare_dirents(const void *a, const void *b)
 {
-	struct jffs2_raw_dirent ojNew;
-	struct jffs2_raw_dirent ojOld;
-	struct jffs2_raw_dirent *jNew =
-		(struct jffs2_raw_dirent *)get_fl_mem(new->offset, sizeof(ojNew), &ojNew);
-	struct jffs2_raw_dirent *jOld =
-		(struct jffs2_raw_dirent *)get_fl_mem(old->offset, sizeof(ojOld), &ojOld);
-	int cmp;
-
-	/* ascending sort by pino */
-	if (jNew->pino != jOld->pino)
-		return jNew->pino > jOld->pino;
-
-	/* pino is the same, so use ascending sort by nsize, so
-	 * we don't do strncmp unless we really must.
-	 */
-	if (jNew->nsize != jOld->nsize)
-		return jNew->nsize > jOld->nsize;
+	const struct b_dirent *new = a, *old = b;
+
+	if (new->pino != old->pino)
+		return new->pino > old->pino ? 1 : -1;
+	if (new->name_crc != old->name_crc)
+		return new->name_crc > old->name_crc ? 1 : -1;
+	if (new->nsize != old->nsize)
+		return new->nsize > old->nsize ? 1 : -1;
+	if (new->version != old->version)
+		return new->version > old->version ? 1 : -1;
+	return 0;
+}
 
-	/* length is also the same, so use ascending sort by name
-	 */
-	cmp = strncmp((char *)jNew->name, (char *)jOld->name, jNew->nsize);
-	if (cmp != 0)
-		return cmp > 0;
+/* Sort pointers to directory entries by inode, latest version last */
+static int compare_dirent_inos(const void *a, const void *b)
+{
+	const struct b_dirent *new = *(struct b_dirent **)a;
+	const struct b_dirent *old = *(struct b_dirent **)b;
 
-	/* we have duplicate names in this directory, so use ascending
-	 * sort by version
-	 */
-	if (jNew->version > jOld->version) {
-		/* since jNew is newer, we know jOld is not valid, so
-		 * mark it with inode 0 and it will not be used
-		 */
-		jOld->ino = 0;
-		return 1;
+	if (new->ino != old->ino)
+		return new->ino > old->ino ? 1 : -1;
+	if (new->version != old->version)
+		return new->version > old->version ? 1 : -1;
+	return 0;
+}
+
+static int
+sort_lists(struct b_lists *pL)
+{
+	struct b_dir_list *dir = &pL->dir;
+	u32 i;
+
+	qsort(pL->frag.nodes, pL->frag.listCount, sizeof(struct b_node),
+	      compare_nodes);
+	qsort(dir->dirents, dir->listCount, sizeof(struct b_dirent),
+	      compare_dirents);
+
+	dir->by_ino = malloc(dir->listCount * sizeof(struct b_dirent *));
+	if (dir->by_ino == NULL && dir->listCount) {
+		putstr("sort_lists: malloc failed\n");
+		return 0;
 	}
+	for (i = 0; i < dir->listCount; i++)
+		dir->by_ino[i] = &dir->dirents[i];
+	qsort(dir->by_ino, dir->listCount, sizeof(struct b_dirent *),
+	      compare_dirent_inos);
 
-	return 0;
+	return 1;
+}
+
+/* Find the data nodes of an inode */
+static struct b_node *
+find_nodes(struct b_list *list, u32 ino, u32 *count)
+{
+	u32 lo = 0, hi = list->listCount, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (list->nodes[mid].ino < ino)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (hi = lo; hi < list->listCount && list->nodes[hi].ino == ino; hi++)
+		;
+
+	*count = hi - lo;
+	return &list->nodes[lo];
+}
+
+/* Find the entries of a directory, only those with the given name crc if
+ * match_crc is set.
+ */
+static struct b_dirent *
+find_dirents(struct b_dir_list *list, u32 pino, u32 name_crc, int match_crc,
+	     u32 *count)
+{
+	u32 lo = 0, hi = list->listCount, mid;
+	struct b_dirent *d;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		d = &list->dirents[mid];
+		if (d->pino < pino ||
+		    (match_crc && d->pino == pino && d->name_crc < name_crc))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (hi = lo; hi < list->listCount; hi++) {
+		d = &list->dirents[hi];
+		if (d->pino != pino || (match_crc && d->name_crc != name_crc))
+			break;
+	}
+
+	*count = hi - lo;
+	return &list->dirents[lo];
+}
+
+/* Find the latest directory entry for an inode */
+static struct b_dirent *
+find_ino_dirent(struct b_dir_list *list, u32 ino)
+{
+	u32 lo = 0, hi = list->listCount, mid;
+
+	/* find the first entry past the ones for the inode */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (list->by_ino[mid]->ino <= ino)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0 || list->by_ino[lo - 1]->ino != ino)
+		return NULL;
+
+	return list->by_ino[lo - 1];
 }
-#endif
 
 void
 jffs2_free_cache(struct part_info *part)
@@ -661,10 +771,13 @@ jffs2_free_cache(struct part_info *part)
 
 	if (part->jffs2_priv != NULL) {
 		pL = (struct b_lists *)part->jffs2_priv;
-		free_nodes(&pL->frag);
-		free_nodes(&pL->dir);
+		free(pL->frag.nodes);
+		free(pL->dir.dirents);
+		free(pL->dir.by_ino);
+		free(pL->sectors);
 		free(pL->readbuf);
 		free(pL);
+		part->jffs2_priv = NULL;
 	}
 }
 
@@ -679,10 +792,6 @@ jffs_init_1pass_list(struct part_info *part)
 		pL = (struct b_lists *)part->jffs2_priv;
 
 		memset(pL, 0, sizeof(*pL));
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-		pL->dir.listCompare = compare_dirents;
-		pL->frag.listCompare = compare_inodes;
-#endif
 	}
 	return 0;
 }
@@ -692,14 +801,19 @@ static long
 jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 {
 	struct b_node *b;
+	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
-	u32 totalSize = 0;
-	u32 latestVersion = 0;
+	u32 totalSize;
+	u32 count;
+	u32 n;
 	uchar *lDest;
 	uchar *src;
 	int i;
-	u32 counter = 0;
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+
+	b = find_nodes(&pL->frag, inode, &count);
+	if (!count)
+		return 0;
+
 	/* Find file size before loading any data, so fragments that
 	 * start past the end of file can be ignored. A fragment
 	 * that is partially in the file is loaded, so extra data may
@@ -707,159 +821,117 @@ jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 	 * This shouldn't cause trouble when loading kernel images, so
 	 * we will live with it.
 	 */
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
-		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
-			sizeof(struct jffs2_raw_inode), pL->readbuf);
-		if ((inode == jNode->ino)) {
-			/* get actual file length from the newest node */
-			if (jNode->version >= latestVersion) {
-				totalSize = jNode->isize;
-				latestVersion = jNode->version;
-			}
-		}
-		put_fl_mem(jNode, pL->readbuf);
-	}
-#endif
-
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
+	jNode = (struct jffs2_raw_inode *) get_fl_mem(b[count - 1].offset,
+		sizeof(ojNode), &ojNode);
+	if (!jNode)
+		return -1;
+	/* get actual file length from the newest node */
+	totalSize = jNode->isize;
+
+	if (!dest)
+		return totalSize;
+
+	/* the nodes are sorted oldest first, so the newest data wins */
+	for (n = 0; n < count; n++, b++) {
 		jNode = (struct jffs2_raw_inode *) get_node_mem(b->offset,
 								pL->readbuf);
-		if (inode == jNode->ino) {
-#if 0
-			putLabeledWord("\r\n\r\nread_inode: totlen = ", jNode->totlen);
-			putLabeledWord("read_inode: inode = ", jNode->ino);
-			putLabeledWord("read_inode: version = ", jNode->version);
-			putLabeledWord("read_inode: isize = ", jNode->isize);
-			putLabeledWord("read_inode: offset = ", jNode->offset);
-			putLabeledWord("read_inode: csize = ", jNode->csize);
-			putLabeledWord("read_inode: dsize = ", jNode->dsize);
-			putLabeledWord("read_inode: compr = ", jNode->compr);
-			putLabeledWord("read_inode: usercompr = ", jNode->usercompr);
-			putLabeledWord("read_inode: flags = ", jNode->flags);
-#endif
-
-#ifndef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-			/* get actual file length from the newest node */
-			if (jNode->version >= latestVersion) {
-				totalSize = jNode->isize;
-				latestVersion = jNode->version;
-			}
-#endif
+		if (!jNode)
+			return -1;
 
-			if(dest) {
-				src = ((uchar *) jNode) + sizeof(struct jffs2_raw_inode);
-				/* ignore data behind latest known EOF */
-				if (jNode->offset > totalSize) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
-				if (b->datacrc == CRC_UNKNOWN)
-					b->datacrc = data_crc(jNode) ?
-						CRC_OK : CRC_BAD;
-				if (b->datacrc == CRC_BAD) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
+		src = ((uchar *) jNode) + sizeof(struct jffs2_raw_inode);
+		/* ignore data behind latest known EOF */
+		if (jNode->offset > totalSize) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
+		if (b->datacrc == CRC_UNKNOWN)
+			b->datacrc = data_crc(jNode) ? CRC_OK : CRC_BAD;
+		if (b->datacrc == CRC_BAD) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
 
-				lDest = (uchar *) (dest + jNode->offset);
-#if 0
-				putLabeledWord("read_inode: src = ", src);
-				putLabeledWord("read_inode: dest = ", lDest);
-#endif
-				switch (jNode->compr) {
-				case JFFS2_COMPR_NONE:
-					ldr_memcpy(lDest, src, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZERO:
-					for (i = 0; i < jNode->dsize; i++)
-						*(lDest++) = 0;
-					break;
-				case JFFS2_COMPR_RTIME:
-					rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_DYNRUBIN:
-					/* this is slow but it works */
-					dynrubin_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZLIB:
-					zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
+		lDest = (uchar *) (dest + jNode->offset);
+		switch (jNode->compr) {
+		case JFFS2_COMPR_NONE:
+			ldr_memcpy(lDest, src, jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZERO:
+			for (i = 0; i < jNode->dsize; i++)
+				*(lDest++) = 0;
+			break;
+		case JFFS2_COMPR_RTIME:
+			rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
+		case JFFS2_COMPR_DYNRUBIN:
+			/* this is slow but it works */
+			dynrubin_decompress(src, lDest, jNode->csize,
+					    jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZLIB:
+			zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #if defined(CONFIG_JFFS2_LZO)
-				case JFFS2_COMPR_LZO:
-					lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-#endif
-				default:
-					/* unknown */
-					putLabeledWord("UNKNOWN COMPRESSION METHOD = ", jNode->compr);
-					put_fl_mem(jNode, pL->readbuf);
-					return -1;
-					break;
-				}
-			}
-
-#if 0
-			putLabeledWord("read_inode: totalSize = ", totalSize);
+		case JFFS2_COMPR_LZO:
+			lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #endif
+		default:
+			/* unknown */
+			putLabeledWord("UNKNOWN COMPRESSION METHOD = ",
+				       jNode->compr);
+			put_fl_mem(jNode, pL->readbuf);
+			return -1;
 		}
-		counter++;
 		put_fl_mem(jNode, pL->readbuf);
 	}
 
-#if 0
-	putLabeledWord("read_inode: returning = ", totalSize);
-#endif
 	return totalSize;
 }
 
+/* Read the name of a directory entry, which must have room for 256 bytes */
+static int
+read_dirent_name(struct b_lists *pL, struct b_dirent *d, char *name)
+{
+	struct jffs2_raw_dirent *jDir;
+
+	jDir = (struct jffs2_raw_dirent *) get_fl_mem(d->offset,
+		sizeof(*jDir) + d->nsize, pL->readbuf);
+	if (!jDir)
+		return -1;
+	memcpy(name, jDir->name, d->nsize);
+	name[d->nsize] = '\0';
+	put_fl_mem(jDir, pL->readbuf);
+	return 0;
+}
+
 /* find the inode from the slashless name given a parent */
 static u32
 jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 {
-	struct b_node *b;
-	struct jffs2_raw_dirent *jDir;
+	struct b_dirent *d;
+	char tmp[256];
+	u32 count;
 	int len;
-	u32 counter;
-	u32 version = 0;
-	u32 inode = 0;
 
 	/* name is assumed slash free */
 	len = strlen(name);
 
-	counter = 0;
-	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next, counter++) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		if ((pino == jDir->pino) && (len == jDir->nsize) &&
-		    (jDir->ino) &&	/* 0 for unlink */
-		    (!strncmp((char *)jDir->name, name, len))) {	/* a match */
-			if (jDir->version < version) {
-				put_fl_mem(jDir, pL->readbuf);
-				continue;
-			}
-
-			if (jDir->version == version && inode != 0) {
-				/* I'm pretty sure this isn't legal */
-				putstr(" ** ERROR ** ");
-				putnstr(jDir->name, jDir->nsize);
-				putLabeledWord(" has dup version =", version);
-			}
-			inode = jDir->ino;
-			version = jDir->version;
-		}
-#if 0
-		putstr("\r\nfind_inode:p&l ->");
-		putnstr(jDir->name, jDir->nsize);
-		putstr("\r\n");
-		putLabeledWord("pino = ", jDir->pino);
-		putLabeledWord("nsize = ", jDir->nsize);
-		putLabeledWord("b = ", (u32) b);
-		putLabeledWord("counter = ", counter);
-#endif
-		put_fl_mem(jDir, pL->readbuf);
+	/* we need the entry with the name and the highest version, which is
+	 * the last one of those with its crc and length
+	 */
+	d = find_dirents(&pL->dir, pino,
+			 crc32_no_comp(0, (unsigned char *)name, len), 1,
+			 &count);
+	while (count--) {
+		if (d[count].nsize != len)
+			continue;
+		if (read_dirent_name(pL, &d[count], tmp))
+			return 0;
+		if (!strcmp(tmp, name))
+			return d[count].ino;	/* 0 for unlink */
 	}
-	return inode;
+	return 0;
 }
 
 char *mkmodestr(unsigned long mode, char *str)
@@ -943,45 +1015,62 @@ static inline u32 dump_inode(struct b_lists * pL, struct jffs2_raw_dirent *d, st
 	return 0;
 }
 
+/* check whether a directory entry has a newer version, which can only be
+ * one of the entries after it with the same name crc and length
+ */
+static int
+jffs2_1pass_superseded(struct b_lists *pL, struct b_dirent *d, u32 count)
+{
+	char name[256];
+	char tmp[256];
+	u32 n;
+
+	for (n = 1; n < count; n++) {
+		if (d[n].name_crc != d->name_crc || d[n].nsize != d->nsize)
+			break;
+		if (n == 1 && read_dirent_name(pL, d, name))
+			return 0;
+		if (read_dirent_name(pL, &d[n], tmp))
+			return 0;
+		if (!strcmp(tmp, name))
+			return 1;
+	}
+	return 0;
+}
+
 /* list inodes with the given pino */
 static u32
 jffs2_1pass_list_inodes(struct b_lists * pL, u32 pino)
 {
+	struct b_dirent *d;
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
+	struct jffs2_raw_inode *i;
+	u32 count, nodes;
 
-	for (b = pL->dir.listHead; b; b = b->next) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		if ((pino == jDir->pino) && (jDir->ino)) { /* ino=0 -> unlink */
-			u32 i_version = 0;
-			struct jffs2_raw_inode ojNode;
-			struct jffs2_raw_inode *jNode, *i = NULL;
-			struct b_node *b2 = pL->frag.listHead;
-
-			while (b2) {
-				jNode = (struct jffs2_raw_inode *)
-					get_fl_mem(b2->offset, sizeof(ojNode), &ojNode);
-				if (jNode->ino == jDir->ino && jNode->version >= i_version) {
-					i_version = jNode->version;
-					if (i)
-						put_fl_mem(i, NULL);
-
-					if (jDir->type == DT_LNK)
-						i = get_node_mem(b2->offset,
-								 NULL);
-					else
-						i = get_fl_mem(b2->offset,
-							       sizeof(*i),
-							       NULL);
-				}
-				b2 = b2->next;
-			}
+	d = find_dirents(&pL->dir, pino, 0, 0, &count);
+	for (; count; d++, count--) {
+		if (!d->ino)	/* ino=0 -> unlink */
+			continue;
+		if (jffs2_1pass_superseded(pL, d, count))
+			continue;
 
-			dump_inode(pL, jDir, i);
-			put_fl_mem(i, NULL);
+		i = NULL;
+		b = find_nodes(&pL->frag, d->ino, &nodes);
+		if (nodes) {
+			/* the newest node has the current attributes */
+			b += nodes - 1;
+			if (d->type == DT_LNK)
+				i = get_node_mem(b->offset, NULL);
+			else
+				i = get_fl_mem(b->offset, sizeof(*i), NULL);
 		}
+
+		jDir = (struct jffs2_raw_dirent *) get_node_mem(d->offset,
+								pL->readbuf);
+		dump_inode(pL, jDir, i);
 		put_fl_mem(jDir, pL->readbuf);
+		put_fl_mem(i, NULL);
 	}
 	return pino;
 }
@@ -1045,75 +1134,44 @@ jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino)
 static u32
 jffs2_1pass_resolve_inode(struct b_lists * pL, u32 ino)
 {
+	struct b_dirent *d;
 	struct b_node *b;
-	struct b_node *b2;
-	struct jffs2_raw_dirent *jDir;
 	struct jffs2_raw_inode *jNode;
-	u8 jDirFoundType = 0;
-	u32 jDirFoundIno = 0;
-	u32 jDirFoundPino = 0;
 	char tmp[256];
-	u32 version = 0;
+	u32 count;
+	u32 len;
 	u32 pino;
 	unsigned char *src;
 
-	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		if (ino == jDir->ino) {
-			if (jDir->version < version) {
-				put_fl_mem(jDir, pL->readbuf);
-				continue;
-			}
-
-			if (jDir->version == version && jDirFoundType) {
-				/* I'm pretty sure this isn't legal */
-				putstr(" ** ERROR ** ");
-				putnstr(jDir->name, jDir->nsize);
-				putLabeledWord(" has dup version (resolve) = ",
-					version);
-			}
+	/* we need the entry with the highest version */
+	d = find_ino_dirent(&pL->dir, ino);
+	if (!d)
+		return 0;
+	if (d->type != DT_LNK)
+		return d->ino;
 
-			jDirFoundType = jDir->type;
-			jDirFoundIno = jDir->ino;
-			jDirFoundPino = jDir->pino;
-			version = jDir->version;
-		}
-		put_fl_mem(jDir, pL->readbuf);
-	}
-	/* now we found the right entry again. (shoulda returned inode*) */
-	if (jDirFoundType != DT_LNK)
-		return jDirFoundIno;
-
-	/* it's a soft link so we follow it again. */
-	b2 = pL->frag.listHead;
-	while (b2) {
-		jNode = (struct jffs2_raw_inode *) get_node_mem(b2->offset,
-								pL->readbuf);
-		if (jNode->ino == jDirFoundIno) {
-			src = (unsigned char *)jNode + sizeof(struct jffs2_raw_inode);
+	/* it's a soft link so we follow it again, the target is the data of
+	 * its newest node
+	 */
+	b = find_nodes(&pL->frag, ino, &count);
+	if (!count)
+		return 0;
+	jNode = (struct jffs2_raw_inode *) get_node_mem(b[count - 1].offset,
+							pL->readbuf);
+	if (!jNode)
+		return 0;
+	src = (unsigned char *)jNode + sizeof(struct jffs2_raw_inode);
+	len = min_t(u32, jNode->dsize, sizeof(tmp) - 1);
+	strncpy(tmp, (char *)src, len);
+	tmp[len] = '\0';
+	put_fl_mem(jNode, pL->readbuf);
 
-#if 0
-			putLabeledWord("\t\t dsize = ", jNode->dsize);
-			putstr("\t\t target = ");
-			putnstr(src, jNode->dsize);
-			putstr("\r\n");
-#endif
-			strncpy(tmp, (char *)src, jNode->dsize);
-			tmp[jNode->dsize] = '\0';
-			put_fl_mem(jNode, pL->readbuf);
-			break;
-		}
-		b2 = b2->next;
-		put_fl_mem(jNode, pL->readbuf);
-	}
 	/* ok so the name of the new file to find is in tmp */
 	/* if it starts with a slash it is root based else shared dirs */
 	if (tmp[0] == '/')
 		pino = 1;
 	else
-		pino = jDirFoundPino;
+		pino = d->pino;
 
 	return jffs2_1pass_search_inode(pL, tmp, pino);
 }
@@ -1166,13 +1224,40 @@ jffs2_1pass_search_list_inodes(struct b_lists * pL, const char *fname, u32 pino)
 
 }
 
+#define STAMP_SIZE	16
+
+/*
+ * Each erase block is stamped with the crc of the STAMP_SIZE bytes which
+ * end just past its last node, or of its first bytes if it is empty, or of
+ * its last bytes if it has a summary. Writing a node to the block or
+ * flashing another image over the partition changes the stamp.
+ */
+static u32 stamp_offset(struct part_info *part, u32 used)
+{
+	u32 end = used + 4;
+
+	if (end < STAMP_SIZE)
+		end = STAMP_SIZE;
+	if (end > part->sector_size)
+		end = part->sector_size;
+	return end - STAMP_SIZE;
+}
+
+static u32 stamp_sector(struct part_info *part, u32 sector_ofs, u32 used)
+{
+	uchar buf[STAMP_SIZE];
+
+	if (read_fl_mem(part->offset + sector_ofs + stamp_offset(part, used),
+			STAMP_SIZE, buf))
+		return 0;
+	return crc32_no_comp(0, buf, STAMP_SIZE);
+}
+
 unsigned char
 jffs2_1pass_rescan_needed(struct part_info *part)
 {
-	struct b_node *b;
-	struct jffs2_unknown_node onode;
-	struct jffs2_unknown_node *node;
 	struct b_lists *pL = (struct b_lists *)part->jffs2_priv;
+	u32 i;
 
 	if (part->jffs2_priv == 0){
 		DEBUGF ("rescan: First time in use\n");
@@ -1186,16 +1271,17 @@ jffs2_1pass_rescan_needed(struct part_info *part)
 	}
 
 	/* but suppose someone reflashed a partition at the same offset... */
-	b = pL->dir.listHead;
-	while (b) {
-		node = (struct jffs2_unknown_node *) get_fl_mem(b->offset,
-			sizeof(onode), &onode);
-		if (node->nodetype != JFFS2_NODETYPE_DIRENT) {
+	if (pL->nr_sectors != lldiv(part->size, part->sector_size)) {
+		DEBUGF ("rescan: partition size changed\n");
+		return 1;
+	}
+	for (i = 0; i < pL->nr_sectors; i++) {
+		if (stamp_sector(part, i * part->sector_size,
+				 pL->sectors[i].used) != pL->sectors[i].stamp) {
 			DEBUGF ("rescan: fs changed beneath me? (%lx)\n",
-					(unsigned long) b->offset);
+				(unsigned long) i * part->sector_size);
 			return 1;
 		}
-		b = b->next;
 	}
 	return 0;
 }
@@ -1233,7 +1319,6 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 {
 	void *sp;
 	int i, pass;
-	void *ret;
 
 	for (pass = 0; pass < 2; pass++) {
 		sp = summary->sum;
@@ -1246,15 +1331,24 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 				case JFFS2_NODETYPE_INODE: {
 				struct jffs2_sum_inode_flash *spi;
 					if (pass) {
+						struct b_node *b;
+
 						spi = sp;
 
-						ret = insert_node(&pL->frag,
+						b = insert_node(pL,
 							(u32)part->offset +
 							offset +
 							sum_get_unaligned32(
-								&spi->offset));
-						if (ret == NULL)
+								&spi->offset),
+							sum_get_unaligned32(
+								&spi->totlen));
+						if (b == NULL)
 							return -1;
+						b->ino = sum_get_unaligned32(
+								&spi->inode);
+						b->version =
+							sum_get_unaligned32(
+								&spi->version);
 					}
 
 					sp += JFFS2_SUMMARY_INODE_SIZE;
@@ -1265,13 +1359,28 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 					struct jffs2_sum_dirent_flash *spd;
 					spd = sp;
 					if (pass) {
-						ret = insert_node(&pL->dir,
+						struct b_dirent *d;
+
+						d = insert_dirent(pL,
 							(u32) part->offset +
 							offset +
 							sum_get_unaligned32(
-								&spd->offset));
-						if (ret == NULL)
+								&spd->offset),
+							sum_get_unaligned32(
+								&spd->totlen));
+						if (d == NULL)
 							return -1;
+						d->pino = sum_get_unaligned32(
+								&spd->pino);
+						d->version =
+							sum_get_unaligned32(
+								&spd->version);
+						d->ino = sum_get_unaligned32(
+								&spd->ino);
+						d->nsize = spd->nsize;
+						d->type = spd->type;
+						d->name_crc = crc32_no_comp(0,
+							spd->name, spd->nsize);
 					}
 
 					sp += JFFS2_SUMMARY_DIRENT_SIZE(
@@ -1368,10 +1477,10 @@ dump_fragments(struct b_lists *pL)
 	struct b_node *b;
 	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
+	u32 n;
 
 	putstr("\r\n\r\n******The fragment Entries******\r\n");
-	b = pL->frag.listHead;
-	while (b) {
+	for (n = 0, b = pL->frag.nodes; n < pL->frag.listCount; n++, b++) {
 		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
 			sizeof(ojNode), &ojNode);
 		putLabeledWord("\r\n\tbuild_list: FLASH_OFFSET = ", b->offset);
@@ -1387,7 +1496,6 @@ dump_fragments(struct b_lists *pL)
 		putLabeledWord("\tbuild_list: usercompr = ", jNode->usercompr);
 		putLabeledWord("\tbuild_list: flags = ", jNode->flags);
 		putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
-		b = b->next;
 	}
 }
 #endif
@@ -1396,12 +1504,12 @@ dump_fragments(struct b_lists *pL)
 static void
 dump_dirents(struct b_lists *pL)
 {
-	struct b_node *b;
+	struct b_dirent *b;
 	struct jffs2_raw_dirent *jDir;
+	u32 n;
 
 	putstr("\r\n\r\n******The directory Entries******\r\n");
-	b = pL->dir.listHead;
-	while (b) {
+	for (n = 0, b = pL->dir.dirents; n < pL->dir.listCount; n++, b++) {
 		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
 								pL->readbuf);
 		putstr("\r\n");
@@ -1418,7 +1526,6 @@ dump_dirents(struct b_lists *pL)
 		putLabeledWord("\tbuild_list: node_crc = ", jDir->node_crc);
 		putLabeledWord("\tbuild_list: name_crc = ", jDir->name_crc);
 		putLabeledWord("\tbuild_list: offset = ", b->offset);	/* FIXME: ? [RS] */
-		b = b->next;
 		put_fl_mem(jDir, pL->readbuf);
 	}
 }
@@ -1434,18 +1541,110 @@ static inline uint32_t EMPTY_SCAN_SIZE(uint32_t sector_size)
 		return DEFAULT_EMPTY_SCAN_SIZE;
 }
 
+/*
+ * Scan an erase block without a usable summary. Its first bytes tell
+ * whether it is empty, otherwise the whole block is read in one go and
+ * its nodes are added to the lists. Returns -1 if out of memory.
+ */
+static int
+jffs2_1pass_scan_sector(struct part_info *part, struct b_lists *pL,
+			u32 sector_ofs, char *buf, struct b_sector *sector)
+{
+	struct jffs2_unknown_node *node;
+	struct jffs2_raw_dirent *jDir;
+	struct b_node *b;
+	struct b_dirent *d;
+	u32 empty_len = EMPTY_SCAN_SIZE(part->sector_size);
+	u32 ofs;
+
+	sector->used = 0;
+	sector->stamp = 0;
+	if (read_fl_mem((u32)part->offset + sector_ofs, empty_len, buf))
+		return 0;
+
+	/* Scan only 4KiB of 0xFF before declaring it's empty */
+	ofs = 0;
+	while (ofs < empty_len && *(uint32_t *)(&buf[ofs]) == 0xFFFFFFFF)
+		ofs += 4;
+
+	if (ofs == empty_len || (empty_len < part->sector_size &&
+	    read_fl_mem((u32)part->offset + sector_ofs + empty_len,
+			part->sector_size - empty_len, buf + empty_len)))
+		goto stamp;
+
+	while (ofs + sizeof(*node) <= part->sector_size) {
+		node = (struct jffs2_unknown_node *)&buf[ofs];
+
+		if (node->magic != JFFS2_MAGIC_BITMASK || !hdr_crc(node) ||
+		    node->totlen < sizeof(*node) ||
+		    ofs + node->totlen > part->sector_size) {
+			ofs += 4;
+			continue;
+		}
+		/* if its a fragment add it */
+		switch (node->nodetype) {
+		case JFFS2_NODETYPE_INODE:
+			if (node->totlen < sizeof(struct jffs2_raw_inode) ||
+			    !inode_crc((struct jffs2_raw_inode *) node))
+				break;
+
+			b = insert_node(pL, (u32)part->offset + sector_ofs +
+					ofs, node->totlen);
+			if (b == NULL)
+				return -1;
+			b->ino = ((struct jffs2_raw_inode *)node)->ino;
+			b->version = ((struct jffs2_raw_inode *)node)->version;
+			break;
+		case JFFS2_NODETYPE_DIRENT:
+			jDir = (struct jffs2_raw_dirent *)node;
+			if (node->totlen < sizeof(*jDir) + jDir->nsize ||
+			    !dirent_crc(jDir) || !dirent_name_crc(jDir))
+				break;
+			if (! (pL->dir.listCount%100))
+				puts ("\b\b.  ");
+
+			d = insert_dirent(pL, (u32)part->offset + sector_ofs +
+					  ofs, node->totlen);
+			if (d == NULL)
+				return -1;
+			d->pino = jDir->pino;
+			d->version = jDir->version;
+			d->ino = jDir->ino;
+			d->nsize = jDir->nsize;
+			d->type = jDir->type;
+			d->name_crc = jDir->name_crc;
+			break;
+		case JFFS2_NODETYPE_CLEANMARKER:
+			if (node->totlen != sizeof(struct jffs2_unknown_node))
+				printf("OOPS Cleanmarker has bad size "
+					"%d != %zu\n",
+					node->totlen,
+					sizeof(struct jffs2_unknown_node));
+			break;
+		case JFFS2_NODETYPE_PADDING:
+		case JFFS2_NODETYPE_SUMMARY:
+			break;
+		default:
+			printf("Unknown node type: %x len %d offset 0x%x\n",
+				node->nodetype,
+				node->totlen, sector_ofs + ofs);
+		}
+		ofs += ((node->totlen + 3) & ~3);
+		sector->used = ofs;
+	}
+
+stamp:
+	sector->stamp = crc32_no_comp(0, (uchar *)buf +
+			stamp_offset(part, sector->used), STAMP_SIZE);
+	return 0;
+}
+
 static u32
 jffs2_1pass_build_lists(struct part_info * part)
 {
 	struct b_lists *pL;
-	struct jffs2_unknown_node *node;
 	u32 nr_sectors;
 	u32 i;
-	u32 counter4 = 0;
-	u32 counterF = 0;
-	u32 counterN = 0;
-	u32 max_totlen = 0;
-	u32 buf_size = DEFAULT_EMPTY_SCAN_SIZE;
 	char *buf;
 
 	nr_sectors = lldiv(part->size, part->sector_size);
@@ -1457,18 +1656,28 @@ jffs2_1pass_build_lists(struct part_info * part)
 	/* if we are building a list we need to refresh the cache. */
 	jffs_init_1pass_list(part);
 	pL = (struct b_lists *)part->jffs2_priv;
-	buf = malloc(buf_size);
+	if (pL == NULL)
+		return 0;
+
+	/* erase blocks are scanned whole, so read them in one go */
+	buf = malloc(part->sector_size);
+	pL->sectors = malloc(nr_sectors * sizeof(struct b_sector));
+	if (buf == NULL || pL->sectors == NULL) {
+		putstr("Can't get memory for the scan!\n");
+		free(buf);
+		jffs2_free_cache(part);
+		return 0;
+	}
+	pL->nr_sectors = nr_sectors;
 	puts ("Scanning JFFS2 FS:   ");
 
 	/* start at the beginning of the partition */
 	for (i = 0; i < nr_sectors; i++) {
+		struct b_sector *sector = &pL->sectors[i];
 		uint32_t sector_ofs = i * part->sector_size;
-		uint32_t buf_ofs = sector_ofs;
-		uint32_t buf_len;
-		uint32_t ofs, prevofs;
 #ifdef CONFIG_JFFS2_SUMMARY
+		uint32_t tail = part->sector_size - STAMP_SIZE;
 		struct jffs2_sum_marker *sm;
-		void *sumptr = NULL;
 		uint32_t sumlen;
 		int ret;
 #endif
@@ -1476,239 +1685,63 @@ jffs2_1pass_build_lists(struct part_info * part)
 		WATCHDOG_RESET();
 
 #ifdef CONFIG_JFFS2_SUMMARY
-		buf_len = sizeof(*sm);
-
-		/* Read as much as we want into the _end_ of the preallocated
-		 * buffer
+		/* The summary at the end of the block lists all its nodes, so
+		 * there is no need to read the rest of it. The marker is read
+		 * along with the bytes for the stamp.
 		 */
-		get_fl_mem(part->offset + sector_ofs + part->sector_size -
-				buf_len, buf_len, buf + buf_size - buf_len);
-
-		sm = (void *)buf + buf_size - sizeof(*sm);
-		if (sm->magic == JFFS2_SUM_MAGIC) {
-			sumlen = part->sector_size - sm->offset;
-			sumptr = buf + buf_size - sumlen;
-
-			/* Now, make sure the summary itself is available */
-			if (sumlen > buf_size) {
-				/* Need to kmalloc for this. */
-				sumptr = malloc(sumlen);
-				if (!sumptr) {
-					putstr("Can't get memory for summary "
-							"node!\n");
-					free(buf);
-					jffs2_free_cache(part);
-					return 0;
-				}
-				memcpy(sumptr + sumlen - buf_len, buf +
-						buf_size - buf_len, buf_len);
-			}
-			if (buf_len < sumlen) {
-				/* Need to read more so that the entire summary
-				 * node is present
-				 */
-				get_fl_mem(part->offset + sector_ofs +
-						part->sector_size - sumlen,
-						sumlen - buf_len, sumptr);
-			}
+		if (read_fl_mem((u32)part->offset + sector_ofs + tail,
+				STAMP_SIZE, buf + tail))
+			goto scan;
+
+		sm = (void *)buf + part->sector_size - sizeof(*sm);
+		sumlen = part->sector_size - sm->offset;
+		if (sm->magic != JFFS2_SUM_MAGIC ||
+		    sm->offset > tail ||
+		    sumlen < JFFS2_SUMMARY_FRAME_SIZE)
+			goto scan;
+
+		/* Now, make sure the summary itself is available */
+		if (read_fl_mem((u32)part->offset + sector_ofs + sm->offset,
+				sumlen - STAMP_SIZE, buf + sm->offset))
+			goto scan;
+
+		ret = jffs2_sum_scan_sumnode(part, sector_ofs,
+				(void *)buf + sm->offset, sumlen, pL);
+		if (ret < 0) {
+			free(buf);
+			jffs2_free_cache(part);
+			return 0;
 		}
-
-		if (sumptr) {
-			ret = jffs2_sum_scan_sumnode(part, sector_ofs, sumptr,
-					sumlen, pL);
-
-			if (buf_size && sumlen > buf_size)
-				free(sumptr);
-			if (ret < 0) {
-				free(buf);
-				jffs2_free_cache(part);
-				return 0;
-			}
-			if (ret)
-				continue;
-
+		if (ret) {
+			sector->used = part->sector_size;
+			sector->stamp = crc32_no_comp(0, (uchar *)buf + tail,
+						      STAMP_SIZE);
+			continue;
 		}
+scan:
 #endif /* CONFIG_JFFS2_SUMMARY */
 
-		buf_len = EMPTY_SCAN_SIZE(part->sector_size);
-
-		get_fl_mem((u32)part->offset + buf_ofs, buf_len, buf);
-
-		/* We temporarily use 'ofs' as a pointer into the buffer/jeb */
-		ofs = 0;
-
-		/* Scan only 4KiB of 0xFF before declaring it's empty */
-		while (ofs < EMPTY_SCAN_SIZE(part->sector_size) &&
-				*(uint32_t *)(&buf[ofs]) == 0xFFFFFFFF)
-			ofs += 4;
-
-		if (ofs == EMPTY_SCAN_SIZE(part->sector_size))
-			continue;
-
-		ofs += sector_ofs;
-		prevofs = ofs - 1;
-
-	scan_more:
-		while (ofs < sector_ofs + part->sector_size) {
-			if (ofs == prevofs) {
-				printf("offset %08x already seen, skip\n", ofs);
-				ofs += 4;
-				counter4++;
-				continue;
-			}
-			prevofs = ofs;
-			if (sector_ofs + part->sector_size <
-					ofs + sizeof(*node))
-				break;
-			if (buf_ofs + buf_len < ofs + sizeof(*node)) {
-				buf_len = min_t(uint32_t, buf_size, sector_ofs
-						+ part->sector_size - ofs);
-				get_fl_mem((u32)part->offset + ofs, buf_len,
-					   buf);
-				buf_ofs = ofs;
-			}
-
-			node = (struct jffs2_unknown_node *)&buf[ofs-buf_ofs];
-
-			if (*(uint32_t *)(&buf[ofs-buf_ofs]) == 0xffffffff) {
-				uint32_t inbuf_ofs;
-				uint32_t scan_end;
-
-				ofs += 4;
-				scan_end = min_t(uint32_t, EMPTY_SCAN_SIZE(
-							part->sector_size)/8,
-							buf_len);
-			more_empty:
-				inbuf_ofs = ofs - buf_ofs;
-				while (inbuf_ofs < scan_end) {
-					if (*(uint32_t *)(&buf[inbuf_ofs]) !=
-							0xffffffff)
-						goto scan_more;
-
-					inbuf_ofs += 4;
-					ofs += 4;
-				}
-				/* Ran off end. */
-
-				/* See how much more there is to read in this
-				 * eraseblock...
-				 */
-				buf_len = min_t(uint32_t, buf_size,
-						sector_ofs +
-						part->sector_size - ofs);
-				if (!buf_len) {
-					/* No more to read. Break out of main
-					 * loop without marking this range of
-					 * empty space as dirty (because it's
-					 * not)
-					 */
-					break;
-				}
-				scan_end = buf_len;
-				get_fl_mem((u32)part->offset + ofs, buf_len,
-					   buf);
-				buf_ofs = ofs;
-				goto more_empty;
-			}
-			if (node->magic != JFFS2_MAGIC_BITMASK ||
-					!hdr_crc(node)) {
-				ofs += 4;
-				counter4++;
-				continue;
-			}
-			if (ofs + node->totlen >
-					sector_ofs + part->sector_size) {
-				ofs += 4;
-				counter4++;
-				continue;
-			}
-			/* if its a fragment add it */
-			switch (node->nodetype) {
-			case JFFS2_NODETYPE_INODE:
-				if (buf_ofs + buf_len < ofs + sizeof(struct
-							jffs2_raw_inode)) {
-					get_fl_mem((u32)part->offset + ofs,
-						   buf_len, buf);
-					buf_ofs = ofs;
-					node = (void *)buf;
-				}
-				if (!inode_crc((struct jffs2_raw_inode *) node))
-				       break;
-
-				if (insert_node(&pL->frag, (u32) part->offset +
-						ofs) == NULL) {
-					free(buf);
-					jffs2_free_cache(part);
-					return 0;
-				}
-				if (max_totlen < node->totlen)
-					max_totlen = node->totlen;
-				break;
-			case JFFS2_NODETYPE_DIRENT:
-				if (buf_ofs + buf_len < ofs + sizeof(struct
-							jffs2_raw_dirent) +
-							((struct
-							 jffs2_raw_dirent *)
-							node)->nsize) {
-					get_fl_mem((u32)part->offset + ofs,
-						   buf_len, buf);
-					buf_ofs = ofs;
-					node = (void *)buf;
-				}
-
-				if (!dirent_crc((struct jffs2_raw_dirent *)
-							node) ||
-						!dirent_name_crc(
-							(struct
-							 jffs2_raw_dirent *)
-							node))
-					break;
-				if (! (counterN%100))
-					puts ("\b\b.  ");
-				if (insert_node(&pL->dir, (u32) part->offset +
-						ofs) == NULL) {
-					free(buf);
-					jffs2_free_cache(part);
-					return 0;
-				}
-				if (max_totlen < node->totlen)
-					max_totlen = node->totlen;
-				counterN++;
-				break;
-			case JFFS2_NODETYPE_CLEANMARKER:
-				if (node->totlen != sizeof(struct jffs2_unknown_node))
-					printf("OOPS Cleanmarker has bad size "
-						"%d != %zu\n",
-						node->totlen,
-						sizeof(struct jffs2_unknown_node));
-				break;
-			case JFFS2_NODETYPE_PADDING:
-				if (node->totlen < sizeof(struct jffs2_unknown_node))
-					printf("OOPS Padding has bad size "
-						"%d < %zu\n",
-						node->totlen,
-						sizeof(struct jffs2_unknown_node));
-				break;
-			case JFFS2_NODETYPE_SUMMARY:
-				break;
-			default:
-				printf("Unknown node type: %x len %d offset 0x%x\n",
-					node->nodetype,
-					node->totlen, ofs);
-			}
-			ofs += ((node->totlen + 3) & ~3);
-			counterF++;
+		if (jffs2_1pass_scan_sector(part, pL, sector_ofs, buf,
+					    sector) < 0) {
+			free(buf);
+			jffs2_free_cache(part);
+			return 0;
 		}
 	}
 
 	free(buf);
 	putstr("\b\b done.\r\n");		/* close off the dots */
 
+	if (!sort_lists(pL)) {
+		jffs2_free_cache(part);
+		return 0;
+	}
+
 	/* We don't care if malloc failed - then each read operation will
 	 * allocate its own buffer as necessary (NAND) or will read directly
 	 * from flash (NOR).
 	 */
-	pL->readbuf = malloc(max_totlen);
+	pL->readbuf = malloc(pL->max_totlen);
 
 	/* turn the lcd back on. */
 	/* splash(); */
@@ -1716,9 +1749,6 @@ jffs2_1pass_build_lists(struct part_info * part)
 #if 0
 	putLabeledWord("dir entries = ", pL->dir.listCount);
 	putLabeledWord("frag entries = ", pL->frag.listCount);
-	putLabeledWord("+4 increments = ", counter4);
-	putLabeledWord("+file_offset increments = ", counterF);
-
 #endif
 
 #ifdef DEBUG_DIRENTS
@@ -1741,6 +1771,7 @@ jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 	struct b_node *b;
 	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
+	u32 n;
 	int i;
 
 	for (i = 0; i < JFFS2_NUM_COMPR; i++) {
@@ -1749,16 +1780,14 @@ jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 		piL->compr_info[i].decompr_sum = 0;
 	}
 
-	b = pL->frag.listHead;
-	while (b) {
+	for (n = 0, b = pL->frag.nodes; n < pL->frag.listCount; n++, b++) {
 		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
 			sizeof(ojNode), &ojNode);
-		if (jNode->compr < JFFS2_NUM_COMPR) {
+		if (jNode && jNode->compr < JFFS2_NUM_COMPR) {
 			piL->compr_info[jNode->compr].num_frags++;
 			piL->compr_info[jNode->compr].compr_sum += jNode->csize;
 			piL->compr_info[jNode->compr].decompr_sum += jNode->dsize;
 		}
-		b = b->next;
 	}
 	return 0;
 }
@@ -1769,6 +1798,7 @@ jffs2_get_list(struct part_info * part, const char *who)
 {
 	/* copy requested part_info struct pointer to global location */
 	current_part = part;
+	flush_fl_cache();
 
 	if (jffs2_1pass_rescan_needed(part)) {
 		if (!jffs2_1pass_build_lists(part)) {
@@ -4,27 +4,51 @@
 #include <jffs2/jffs2.h>
 
 
+/* a data node, the nodes are sorted by inode and version */
 struct b_node {
 	u32 offset;
-	struct b_node *next;
+	u32 ino;
+	u32 version;
 	enum { CRC_UNKNOWN = 0, CRC_OK, CRC_BAD } datacrc;
 };
 
+/* a directory entry, the entries are sorted by parent, name crc, name
+ * length and version */
+struct b_dirent {
+	u32 offset;
+	u32 pino;
+	u32 name_crc;
+	u32 version;
+	u32 ino;		/* 0 for unlink */
+	u8 nsize;
+	u8 type;
+};
+
 struct b_list {
-	struct b_node *listTail;
-	struct b_node *listHead;
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-	struct b_node *listLast;
-	int (*listCompare)(struct b_node *new, struct b_node *node);
-	u32 listLoops;
-#endif
+	struct b_node *nodes;
 	u32 listCount;
-	struct mem_block *listMemBase;
+	u32 listSize;
+};
+
+struct b_dir_list {
+	struct b_dirent *dirents;
+	struct b_dirent **by_ino;	/* entries sorted by inode, version */
+	u32 listCount;
+	u32 listSize;
+};
+
+/* what the scan found in an erase block, to tell whether it changed */
+struct b_sector {
+	u32 used;		/* end of the last node */
+	u32 stamp;		/* crc of the bytes around that end */
 };
 
 struct b_lists {
-	struct b_list dir;
+	struct b_dir_list dir;
 	struct b_list frag;
+	struct b_sector *sectors;
+	u32 nr_sectors;
+	u32 max_totlen;
 	void *readbuf;
 };
 
@@ -90,7 +114,7 @@ static inline int
 data_crc(struct jffs2_raw_inode *node)
 {
 	if (node->data_crc != crc32_no_comp(0, (unsigned char *)
-					    ((int) &node->node_crc + sizeof (node->node_crc)),
+					    (&node->node_crc + 1),
 					     node->csize)) {
 		return 0;
 	} else {
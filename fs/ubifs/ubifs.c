@@ -25,6 +25,7 @@
 
 #include "ubifs.h"
 #include <u-boot/zlib.h>
+#include <asm/io.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -37,8 +38,13 @@ DECLARE_GLOBAL_DATA_PTR;
 static int gzip_decompress(const unsigned char *in, size_t in_len,
 			   unsigned char *out, size_t *out_len)
 {
-	return zunzip(out, *out_len, (unsigned char *)in,
-		      (unsigned long *)out_len, 0, 0);
+	unsigned long len = in_len;
+	int err;
+
+	err = zunzip(out, *out_len, (unsigned char *)in, &len, 0, 0);
+	*out_len = len;
+
+	return err;
 }
 
 /* Fake description object for the "none" compressor */
@@ -82,6 +88,7 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 		     int *out_len, int compr_type)
 {
 	int err;
+	size_t len;
 	struct ubifs_compressor *compr;
 
 	if (unlikely(compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)) {
@@ -102,7 +109,9 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
 		return 0;
 	}
 
-	err = compr->decompress(in_buf, in_len, out_buf, (size_t *)out_len);
+	len = *out_len;
+	err = compr->decompress(in_buf, in_len, out_buf, &len);
+	*out_len = len;
 	if (err)
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
@@ -519,23 +528,17 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/*
+ * Decompress data node @dn of @block into @addr, zeroing the rest of the
+ * block if the node holds less than a block
+ */
+static int decode_block(struct ubifs_info *c, struct inode *inode,
+			void *addr, unsigned int block,
+			struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -566,13 +569,32 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return decode_block(c, inode, addr, block, dn);
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
-		       struct page *page, int last_block_size)
+		       struct page *page, int last_block_size,
+		       struct ubifs_data_node *dn, void *buff)
 {
 	void *addr;
 	int err = 0, i;
 	unsigned int block, beyond;
-	struct ubifs_data_node *dn;
 	loff_t i_size = inode->i_size;
 
 	dbg_gen("ino %lu, pg %lu, i_size %lld",
@@ -588,10 +610,6 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		goto out;
 	}
 
-	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
-	if (!dn)
-		return -ENOMEM;
-
 	i = 0;
 	while (1) {
 		int ret;
@@ -606,7 +624,6 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 			 * the requested size in the destination buffer.
 			 */
 			if (((block + 1) == beyond) || last_block_size) {
-				void *buff;
 				int dlen;
 
 				/*
@@ -615,22 +632,13 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 				 * destination area to a multiple of
 				 * UBIFS_BLOCK_SIZE.
 				 */
-				buff = malloc(UBIFS_BLOCK_SIZE);
-				if (!buff) {
-					printf("%s: Error, malloc fails!\n",
-					       __func__);
-					err = -ENOMEM;
-					break;
-				}
 
 				/* Read block-size into temp buffer */
 				ret = read_block(inode, buff, block, dn);
 				if (ret) {
 					err = ret;
-					if (err != -ENOENT) {
-						free(buff);
+					if (err != -ENOENT)
 						break;
-					}
 				}
 
 				if (last_block_size)
@@ -640,8 +648,6 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 
 				/* Now copy required size back to dest */
 				memcpy(addr, buff, dlen);
-
-				free(buff);
 			} else {
 				ret = read_block(inode, addr, block, dn);
 				if (ret) {
@@ -660,29 +666,127 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		if (err == -ENOENT) {
 			/* Not found, so it must be a hole */
 			dbg_gen("hole");
-			goto out_free;
+			goto out;
 		}
 		ubifs_err("cannot read page %lu of inode %lu, error %d",
 			  page->index, inode->i_ino, err);
-		goto error;
+		return err;
 	}
 
-out_free:
-	kfree(dn);
 out:
 	return 0;
+}
+
+/*
+ * Put @len bytes of block @block at @addr: decompressed from @dn, or zeroes
+ * for a hole if @dn is NULL. A part block goes through @buff so that
+ * nothing past @addr + @len is written.
+ */
+static int put_block(struct ubifs_info *c, struct inode *inode, void *addr,
+		     unsigned int block, int len,
+		     struct ubifs_data_node *dn, void *buff)
+{
+	int err;
+
+	if (!dn) {
+		memset(addr, 0, len);
+		return 0;
+	}
+	if (len == UBIFS_BLOCK_SIZE)
+		return decode_block(c, inode, addr, block, dn);
+
+	err = decode_block(c, inode, buff, block, dn);
+	if (!err)
+		memcpy(addr, buff, len);
 
-error:
-	kfree(dn);
 	return err;
 }
 
+/**
+ * read_bulk - read the data nodes of a run of blocks in one go.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read
+ * @bu: bulk-read information, with its buffer
+ * @addr: where to put block @block
+ * @block: first block to read
+ * @size: bytes to read from @block on
+ * @buff: a block sized buffer for a part block
+ *
+ * Finds the data nodes from @block on which lie one after another in one
+ * LEB with one TNC walk, reads them with one flash read and decompresses
+ * them in turn straight into @addr, with zeroes for any holes. This
+ * function returns the number of blocks read, which is at least one, or a
+ * negative error code.
+ */
+static int read_bulk(struct ubifs_info *c, struct inode *inode,
+		     struct bu_info *bu, void *addr, unsigned int block,
+		     loff_t size, void *buff)
+{
+	unsigned int count = (size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
+	unsigned int next = block, nblock;
+	void *node;
+	int err, i;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		return err;
+
+	/* No data node nearby, so there is a hole here */
+	if (!bu->cnt) {
+		count = bu->eof ? count : min_t(unsigned int, count,
+						bu->blk_cnt);
+		for (i = 0; i < count; i++, addr += UBIFS_BLOCK_SIZE)
+			put_block(c, inode, addr, block + i,
+				  min_t(loff_t, size - i * UBIFS_BLOCK_SIZE,
+					UBIFS_BLOCK_SIZE), NULL, NULL);
+		return count;
+	}
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		return err;
+
+	node = bu->buf;
+	for (i = 0; i < bu->cnt; i++) {
+		nblock = key_block(c, &bu->zbranch[i].key);
+		if (nblock >= block + count)
+			break;
+
+		/* Zero any hole before this node, then decompress it */
+		for (; next <= nblock; next++, addr += UBIFS_BLOCK_SIZE) {
+			err = put_block(c, inode, addr, next,
+					min_t(loff_t, size - (next - block) *
+					      UBIFS_BLOCK_SIZE,
+					      UBIFS_BLOCK_SIZE),
+					next == nblock ? node : NULL, buff);
+			if (err)
+				return err;
+		}
+		node += ALIGN(bu->zbranch[i].len, 8);
+	}
+
+	/* The next data node lies past the range, so the rest is a hole */
+	if (i < bu->cnt)
+		for (; next < block + count; next++, addr += UBIFS_BLOCK_SIZE)
+			put_block(c, inode, addr, next,
+				  min_t(loff_t, size - (next - block) *
+					UBIFS_BLOCK_SIZE, UBIFS_BLOCK_SIZE),
+				  NULL, NULL);
+
+	return next - block;
+}
+
 int ubifs_load(char *filename, u32 addr, u32 size)
 {
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum;
 	struct inode *inode;
 	struct page page;
+	struct ubifs_data_node *dn = NULL;
+	struct bu_info *bu = NULL;
+	void *buf, *buff = NULL;
 	int err = 0;
 	int i;
 	int count;
@@ -718,23 +822,55 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	printf("Loading file '%s' to addr 0x%08x with size %d (0x%08x)...\n",
 	       filename, addr, size, size);
 
-	page.addr = (void *)addr;
-	page.index = 0;
-	page.inode = inode;
-	for (i = 0; i < count; i++) {
-		/*
-		 * Make sure to not read beyond the requested size
-		 */
-		if (((i + 1) == count) && (size < inode->i_size))
-			last_block_size = size - (i * PAGE_SIZE);
+	/* Bulk-read unless turned off, as with the Linux mount option */
+	c->bulk_read = getenv_yesno("ubifs_bulk_read") != 0;
 
-		err = do_readpage(c, inode, &page, last_block_size);
-		if (err)
-			break;
+	/* The buffers are shared by all blocks */
+	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
+	buff = malloc(UBIFS_BLOCK_SIZE);
+	if (c->bulk_read) {
+		bu = kmalloc(sizeof(struct bu_info), GFP_NOFS);
+		if (bu)
+			bu->buf = kmalloc(c->max_bu_buf_len, GFP_NOFS);
+	}
+	if (!dn || !buff || (c->bulk_read && (!bu || !bu->buf))) {
+		printf("%s: Error, no memory for malloc!\n", __func__);
+		err = -ENOMEM;
+		goto out_free;
+	}
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+	buf = map_sysmem(addr, size);
+	if (c->bulk_read) {
+		for (i = 0; i < count; i += err) {
+			err = read_bulk(c, inode, bu,
+					buf + i * UBIFS_BLOCK_SIZE, i,
+					size - i * UBIFS_BLOCK_SIZE, buff);
+			if (err < 0)
+				break;
+		}
+		if (err > 0)
+			err = 0;
+	} else {
+		page.addr = buf;
+		page.index = 0;
+		page.inode = inode;
+		for (i = 0; i < count; i++) {
+			/*
+			 * Make sure to not read beyond the requested size
+			 */
+			if (((i + 1) == count) && (size < inode->i_size))
+				last_block_size = size - (i * PAGE_SIZE);
+
+			err = do_readpage(c, inode, &page, last_block_size,
+					  dn, buff);
+			if (err)
+				break;
+
+			page.addr += PAGE_SIZE;
+			page.index++;
+		}
 	}
+	unmap_sysmem(buf);
 
 	if (err)
 		printf("Error reading file '%s'\n", filename);
@@ -743,6 +879,12 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 		printf("Done\n");
 	}
 
+out_free:
+	if (bu)
+		kfree(bu->buf);
+	kfree(bu);
+	kfree(dn);
+	free(buff);
 	ubifs_iput(inode);
 
 out:
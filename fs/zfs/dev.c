@@ -55,7 +55,7 @@ int zfs_devread(int sector, int byte_offset, int byte_len, char *buf)
 
 	if (byte_offset != 0) {
 		/* read first part which isn't aligned with start of sector */
-		if (zfs_block_dev_desc->block_read(zfs_block_dev_desc->dev,
+		if (blk_dread(zfs_block_dev_desc,
 			part_info->start + sector, 1,
 			(unsigned long *)sec_buf) != 1) {
 			printf(" ** zfs_devread() read error **\n");
@@ -78,14 +78,14 @@ int zfs_devread(int sector, int byte_offset, int byte_len, char *buf)
 		u8 p[SECTOR_SIZE];
 
 		block_len = SECTOR_SIZE;
-		zfs_block_dev_desc->block_read(zfs_block_dev_desc->dev,
+		blk_dread(zfs_block_dev_desc,
 			part_info->start + sector,
 			1, (unsigned long *)p);
 		memcpy(buf, p, byte_len);
 		return 0;
 	}
 
-	if (zfs_block_dev_desc->block_read(zfs_block_dev_desc->dev,
+	if (blk_dread(zfs_block_dev_desc,
 		part_info->start + sector, block_len / SECTOR_SIZE,
 		(unsigned long *) buf) != block_len / SECTOR_SIZE) {
 		printf(" ** zfs_devread() read error - block\n");
@@ -99,10 +99,9 @@ int zfs_devread(int sector, int byte_offset, int byte_len, char *buf)
 
 	if (byte_len != 0) {
 		/* read rest of data which are not in whole sector */
-		if (zfs_block_dev_desc->
-			block_read(zfs_block_dev_desc->dev,
-					   part_info->start + sector, 1,
-					   (unsigned long *) sec_buf) != 1) {
+		if (blk_dread(zfs_block_dev_desc,
+			      part_info->start + sector, 1,
+			      (unsigned long *) sec_buf) != 1) {
 			printf(" ** zfs_devread() read error - last part\n");
 			return 1;
 		}
@@ -42,6 +42,10 @@
 #define CONFIG_EXT4_WRITE
 #endif
 
+#if defined(CONFIG_FASTBOOT_FLASH) && !defined(CONFIG_IMAGE_SPARSE)
+#define CONFIG_IMAGE_SPARSE
+#endif
+
 /* Rather than repeat this expression each time, add a define for it */
 #if defined(CONFIG_CMD_IDE) || \
 	defined(CONFIG_CMD_SATA) || \
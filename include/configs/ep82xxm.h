@@ -305,7 +305,6 @@
 #define CONFIG_SYS_JFFS2_NUM_BANKS	CONFIG_SYS_MAX_FLASH_BANKS
 #define CONFIG_SYS_JFFS2_FIRST_SECTOR  0
 #define CONFIG_SYS_JFFS2_LAST_SECTOR   62
-#define CONFIG_SYS_JFFS2_SORT_FRAGMENTS
 #define CONFIG_SYS_JFFS_CUSTOM_PART
 #endif
 
@@ -23,6 +23,7 @@
 
 #define CONFIG_BOOTSTAGE
 #define CONFIG_BOOTSTAGE_REPORT
+#define CONFIG_CMD_BOOTSTAGE
 #define CONFIG_DM
 #define CONFIG_CMD_DEMO
 #define CONFIG_CMD_DM
@@ -45,8 +46,13 @@
 #define CONFIG_CMD_FDT
 #define CONFIG_DEFAULT_DEVICE_TREE	sandbox
 #define CONFIG_ANDROID_BOOT_IMAGE
+#define CONFIG_IMAGE_FORMAT_LEGACY
+#define CONFIG_IMAGE_STREAM
+#define CONFIG_FIT_VERIFY_COPY
+#define CONFIG_SYS_BOOTM_LEN		(32 << 20)
 
 #define CONFIG_FS_FAT
+#define CONFIG_FAT_CHAIN_PREFETCH
 #define CONFIG_FS_EXT4
 #define CONFIG_EXT4_WRITE
 #define CONFIG_CMD_FAT
@@ -55,6 +61,8 @@
 #define CONFIG_CMD_PART
 #define CONFIG_DOS_PARTITION
 #define CONFIG_HOST_MAX_DEVICES 4
+#define CONFIG_BLOCK_CACHE
+#define CONFIG_CMD_BLOCK_CACHE
 #define CONFIG_CMD_FS_GENERIC
 
 #define CONFIG_SYS_VSNPRINTF
@@ -67,6 +75,9 @@
 #define CONFIG_PARTITION_UUIDS
 #define CONFIG_EFI_PARTITION
 
+/* Android sparse images, as flashed by fastboot */
+#define CONFIG_IMAGE_SPARSE
+
 /*
  * Size of malloc() pool, although we don't actually use this yet.
  */
@@ -101,6 +112,35 @@
 #define CONFIG_SPI_FLASH_STMICRO
 #define CONFIG_SPI_FLASH_WINBOND
 
+/* MTD device in a host file, for UBI and UBIFS */
+#define CONFIG_SANDBOX_MTDRAM
+#define CONFIG_MTD_DEVICE
+#define CONFIG_MTD_PARTITIONS
+#define CONFIG_CMD_MTDPARTS
+#define CONFIG_RBTREE
+#define CONFIG_CMD_UBI
+#define CONFIG_MTD_UBI_FASTMAP
+#define CONFIG_CMD_UBIFS
+#define MTDIDS_DEFAULT			"nor0=mtdram"
+#define MTDPARTS_DEFAULT		"mtdparts=mtdram:-(ubi)"
+
+/* NAND chip in a host file */
+#define CONFIG_NAND_SANDBOX
+#define CONFIG_CMD_NAND
+#define CONFIG_SYS_NAND_SELF_INIT
+#define CONFIG_SYS_MAX_NAND_DEVICE	1
+#define CONFIG_SYS_NAND_ONFI_DETECTION
+
+/* JFFS2 on the NAND chip */
+#define CONFIG_CMD_JFFS2
+#define CONFIG_JFFS2_NAND
+#define CONFIG_JFFS2_SUMMARY
+
+/* USB mass storage device in a host file */
+#define CONFIG_USB_SANDBOX
+#define CONFIG_CMD_USB
+#define CONFIG_USB_STORAGE
+
 /* Memory things - we don't really want a memory test */
 #define CONFIG_SYS_LOAD_ADDR		0x00000000
 #define CONFIG_SYS_MEMTEST_START	0x00100000
@@ -126,14 +166,32 @@
 /* include default commands */
 #include <config_cmd_default.h>
 
-/* We don't have networking support yet */
-#undef CONFIG_CMD_NET
+/*
+ * Networking goes through an emulated host, a host interface or a pcap
+ * replay, see drivers/net/sandbox.c
+ */
+#define CONFIG_ETH_SANDBOX
+#define CONFIG_ETH_SANDBOX_RAW
+#define CONFIG_SYS_RX_ETH_BUFFER	32
+#define CONFIG_CMD_DHCP
+#define CONFIG_CMD_PING
 #undef CONFIG_CMD_NFS
+#define CONFIG_ETHADDR			02:00:11:22:33:44
+#define CONFIG_IPADDR			192.168.1.2
+#define CONFIG_SERVERIP			192.168.1.1
+#define CONFIG_NETMASK			255.255.255.0
 
 #define CONFIG_CMD_HASH
 #define CONFIG_HASH_VERIFY
 #define CONFIG_SHA1
 #define CONFIG_SHA256
+#define CONFIG_CMD_SHA1SUM
+#define CONFIG_SHA_ARCH
+#define CONFIG_CMD_HASH_BENCH
+
+#define CONFIG_CRC32_SLICE_BY_8
+#define CONFIG_CRC32_ARCH
+#define CONFIG_CMD_CRC32_BENCH
 
 #define CONFIG_TPM_TIS_SANDBOX
 
@@ -186,5 +244,6 @@
 #define CONFIG_TPM_TIS_SANDBOX
 
 #define CONFIG_CMD_LZMADEC
+#define CONFIG_CMD_TIME
 
 #endif
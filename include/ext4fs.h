@@ -30,6 +30,10 @@
 
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_EXT_MAX_DEPTH		5
+/* ee_len above this marks an unwritten (preallocated) extent */
+#define EXT_INIT_MAX_LEN		(1 << 15)
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_INDIRECT_BLOCKS		12
@@ -107,6 +111,9 @@ struct ext_filesystem {
 	int curr_inode_no;
 	uint16_t first_pass_ibmap;
 
+	/* Groups whose bitmaps or descriptor changed, one byte each */
+	unsigned char *bg_dirty;
+
 	/* Journal Related */
 
 	/* Block Device Descriptor */
@@ -28,7 +28,7 @@
 			 sizeof(dir_entry))
 
 #define FATBUFBLOCKS	6
-#define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+#define FATBUFSIZE	(mydata->sect_size * mydata->fatbufblocks)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -174,6 +174,8 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	__u32	fatbufblocks;	/* Size of fatbuf in sectors */
+	int	prefetch;	/* Map cluster chains before reading files */
 } fsdata;
 
 typedef int	(file_detectfs_func)(void);
@@ -0,0 +1,49 @@
+/*
+ * Flashing eMMC partitions from fastboot
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _FB_MMC_H
+#define _FB_MMC_H
+
+/*
+ * Each function returns NULL if OK, or the reason it failed for the FAIL
+ * response to the host
+ */
+
+/**
+ * fb_mmc_flash_start() - Start writing an image to a GPT partition
+ *
+ * The partition is looked up by name on CONFIG_FASTBOOT_FLASH_MMC_DEV.
+ *
+ * @name:	partition name
+ */
+const char *fb_mmc_flash_start(const char *name);
+
+/**
+ * fb_mmc_flash_data() - Write the next piece of the image
+ *
+ * Android sparse images are unsparsed as they are written.
+ *
+ * @data:	the piece
+ * @len:	its size in bytes
+ */
+const char *fb_mmc_flash_data(const void *data, unsigned int len);
+
+/**
+ * fb_mmc_flash_finish() - Write what is left of the image
+ */
+const char *fb_mmc_flash_finish(void);
+
+/**
+ * fb_mmc_flash_write() - Write an image held in memory to a GPT partition
+ *
+ * @name:	partition name
+ * @data:	the image
+ * @len:	its size in bytes
+ */
+const char *fb_mmc_flash_write(const char *name, const void *data,
+			       unsigned int len);
+
+#endif /* _FB_MMC_H */
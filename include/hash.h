@@ -141,5 +141,17 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
  */
 void hash_show(struct hash_algo *algo, ulong addr, ulong len,
 	       uint8_t *output);
+
+/**
+ * hash_bench() - Show how fast each hash algorithm is
+ *
+ * Each algorithm is timed over a buffer of @size bytes, after checking that
+ * any variant of an algorithm, such as "sha256-generic", gives the same
+ * result as the algorithm itself.
+ *
+ * @size:		Size of the buffer to hash, in bytes
+ * @return 0 if ok, -EIO if a variant disagrees, other -ve on error
+ */
+int hash_bench(unsigned int size);
 #endif /* !USE_HOSTCC */
 #endif
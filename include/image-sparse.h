@@ -0,0 +1,102 @@
+/*
+ * Writing Android sparse images to a block device
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _IMAGE_SPARSE_H
+#define _IMAGE_SPARSE_H
+
+#include <part.h>
+
+/**
+ * struct sparse_writer - state of an image being written to a partition
+ *
+ * The image is passed to sparse_writer_write() in pieces of any size, as
+ * it arrives. An image starting with SPARSE_HEADER_MAGIC is unsparsed on
+ * the way: raw chunks are written, fill chunks are written as repeats of
+ * their value and "don't care" chunks are skipped. Any other image is
+ * written as it is.
+ *
+ * Small pieces are collected in @buf so that the device is written in
+ * large runs of blocks. Runs of at least @buf_size bytes are written
+ * straight from the caller's data.
+ *
+ * @dev:	device holding the partition
+ * @start:	first block of the partition
+ * @size:	blocks in the partition
+ * @blk:	block of the partition @buf is written to
+ * @buf:	staging buffer, aligned for DMA
+ * @buf_size:	size of @buf, a multiple of the device block size
+ * @buf_len:	bytes in @buf
+ * @state:	what the next bytes of the image are
+ * @hdr:	header being collected
+ * @hdr_len:	bytes in @hdr
+ * @hdr_want:	bytes needed in @hdr
+ * @left:	bytes left in the current chunk, blocks for a fill chunk
+ * @blk_sz:	sparse block size
+ * @chunk_hdr_sz: size of a chunk header
+ * @chunks_left: chunks not started yet
+ * @written:	blocks written
+ * @filled:	blocks written by fill chunks
+ * @skipped:	blocks skipped by "don't care" chunks
+ * @err:	why the image was rejected
+ */
+struct sparse_writer {
+	block_dev_desc_t *dev;
+	lbaint_t start;
+	lbaint_t size;
+	lbaint_t blk;
+	u8 *buf;
+	ulong buf_size;
+	ulong buf_len;
+
+	int state;
+	u32 hdr[8];
+	unsigned int hdr_len;
+	unsigned int hdr_want;
+	u64 left;
+	u32 blk_sz;
+	unsigned int chunk_hdr_sz;
+	u32 chunks_left;
+
+	lbaint_t written;
+	lbaint_t filled;
+	lbaint_t skipped;
+	const char *err;
+};
+
+/**
+ * sparse_writer_init() - Start writing an image to a partition
+ *
+ * @sw:		writer state
+ * @dev:	device holding the partition
+ * @info:	the partition
+ * @buf:	staging buffer, aligned for DMA
+ * @buf_size:	size of @buf, at least one device block
+ */
+void sparse_writer_init(struct sparse_writer *sw, block_dev_desc_t *dev,
+			disk_partition_t *info, void *buf, ulong buf_size);
+
+/**
+ * sparse_writer_write() - Write the next piece of an image
+ *
+ * @sw:		writer state
+ * @data:	the piece
+ * @len:	its size in bytes
+ * @return 0 if OK, -ve on error, with the reason in sw->err
+ */
+int sparse_writer_write(struct sparse_writer *sw, const void *data,
+			ulong len);
+
+/**
+ * sparse_writer_finish() - Write what is left of an image
+ *
+ * The last block of an image that is not sparse is padded with zeroes.
+ *
+ * @sw:		writer state
+ * @return 0 if OK, -ve on error, with the reason in sw->err
+ */
+int sparse_writer_finish(struct sparse_writer *sw);
+
+#endif /* _IMAGE_SPARSE_H */
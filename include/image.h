@@ -306,6 +306,8 @@ typedef struct bootm_headers {
 
 #ifndef USE_HOSTCC
 	image_info_t	os;		/* os image info */
+	ulong		os_load_end;	/* end of os if already at its load
+					 * address, else 0 */
 	ulong		ep;		/* entry point of OS */
 
 	ulong		rd_start, rd_end;/* ramdisk start/end */
@@ -840,6 +842,61 @@ int fit_check_ramdisk(const void *fit, int os_noffset,
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+#if defined(CONFIG_FIT_VERIFY_COPY) && !defined(USE_HOSTCC)
+/**
+ * fit_image_verify_copy() - Copy an image while hashing it
+ *
+ * Copies or decompresses the image data to @dst, computing on the same pass
+ * all of the digests that the image's hash and signature nodes call for.
+ * These are then used by calculate_hash() and the signature checksum for
+ * the same data, until fit_image_clear_digests() is called. Nothing is
+ * verified here.
+ *
+ * @fit:	FIT holding the image
+ * @noffset:	Offset of the image node
+ * @dst:	Address to write the image data to
+ * @dst_max:	Room at @dst, or 0 to compute the digests only
+ * @out_lenp:	Returns the number of bytes written to @dst, unless
+ *		@dst_max is 0
+ * @return 0 if OK, -ve on error, in which case the image must be copied
+ * and checked as usual
+ */
+int fit_image_verify_copy(const void *fit, int noffset, ulong dst,
+			  ulong dst_max, ulong *out_lenp);
+
+/**
+ * fit_image_get_digest() - Look up a digest found by fit_image_verify_copy()
+ *
+ * @data:	Image data
+ * @size:	Size of the image data
+ * @algo:	Name of the hash algorithm, e.g. "sha1"
+ * @value:	Returns the digest, as calculate_hash() would
+ * @value_len:	Returns the length of the digest, if not NULL
+ * @return 0 if found, -ve if the digest must be calculated
+ */
+int fit_image_get_digest(const void *data, ulong size, const char *algo,
+			 uint8_t *value, int *value_len);
+
+/** fit_image_clear_digests() - Forget the digests of the last image copied */
+void fit_image_clear_digests(void);
+#else
+static inline int fit_image_verify_copy(const void *fit, int noffset,
+					ulong dst, ulong dst_max,
+					ulong *out_lenp)
+{
+	return -1;
+}
+
+static inline int fit_image_get_digest(const void *data, ulong size,
+				       const char *algo, uint8_t *value,
+				       int *value_len)
+{
+	return -1;
+}
+
+static inline void fit_image_clear_digests(void) {}
+#endif /* CONFIG_FIT_VERIFY_COPY */
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
@@ -1045,6 +1102,96 @@ static inline int fit_image_check_target_arch(const void *fdt, int node)
 #endif /* CONFIG_FIT_VERBOSE */
 #endif /* CONFIG_FIT */
 
+#ifndef USE_HOSTCC
+struct image_unpack;
+
+/**
+ * image_unpack_new() - Set up to decompress an image a piece at a time
+ *
+ * @comp:	Compression type (IH_COMP_...)
+ * @dst:	Buffer for the output
+ * @dst_max:	Size of @dst
+ * @return decompressor, or NULL if @comp is not supported or there is no
+ * memory
+ */
+struct image_unpack *image_unpack_new(int comp, void *dst, ulong dst_max);
+
+/**
+ * image_unpack_feed() - Decompress the next piece of data
+ *
+ * The compression header must arrive in one piece. If it is not all in
+ * @buf, nothing is used and the caller should try again with the same data
+ * and more following it.
+ *
+ * @up:		Decompressor
+ * @buf:	Compressed data
+ * @len:	Length of @buf
+ * @return number of bytes used, 0 if more are needed first, -ve on error
+ */
+long image_unpack_feed(struct image_unpack *up, const void *buf, ulong len);
+
+/**
+ * image_unpack_finish() - Finish decompressing and free the decompressor
+ *
+ * @up:		Decompressor
+ * @out_lenp:	Returns the number of bytes written, if not NULL
+ * @return 0 if the compressed stream was complete, -ve otherwise
+ */
+int image_unpack_finish(struct image_unpack *up, ulong *out_lenp);
+#endif
+
+#if defined(CONFIG_IMAGE_STREAM) && !defined(USE_HOSTCC)
+/**
+ * image_stream_start() - Start decompressing an image while it is loaded
+ *
+ * Loaders call this before loading to @addr. Nothing happens unless the
+ * environment variable bootm_stream is set to "yes".
+ *
+ * @addr:	Address the image is being loaded to
+ */
+void image_stream_start(ulong addr);
+
+/**
+ * image_stream_write() - Report a piece of the image as loaded
+ *
+ * Pieces must arrive in order, although repeats are fine. A gap stops
+ * streaming and leaves the image to bootm.
+ *
+ * @offset:	Offset of the piece within the image
+ * @len:	Length of the piece in bytes, already stored in memory
+ */
+void image_stream_write(ulong offset, ulong len);
+
+/**
+ * image_stream_end() - Finish streaming when the load is complete
+ *
+ * @size:	Number of bytes loaded, 0 if the load failed
+ */
+void image_stream_end(ulong size);
+
+/**
+ * image_stream_check() - Check for a kernel decompressed while loading
+ *
+ * @img_addr:	Address of the legacy image
+ * @hdr:	Header of the image, which must match the one streamed
+ * @load_end:	Returns the end of the decompressed kernel, if not NULL
+ * @return 0 if the kernel is at its load address and its data CRC is
+ * good, -1 if bootm must check and decompress it itself
+ */
+int image_stream_check(ulong img_addr, const image_header_t *hdr,
+		       ulong *load_end);
+#else
+static inline void image_stream_start(ulong addr) {}
+static inline void image_stream_write(ulong offset, ulong len) {}
+static inline void image_stream_end(ulong size) {}
+static inline int image_stream_check(ulong img_addr,
+				     const image_header_t *hdr,
+				     ulong *load_end)
+{
+	return -1;
+}
+#endif /* CONFIG_IMAGE_STREAM */
+
 #if defined(CONFIG_ANDROID_BOOT_IMAGE)
 struct andr_img_hdr;
 int android_image_check_header(const struct andr_img_hdr *hdr);
@@ -96,6 +96,8 @@ extern void nand_wait_ready(struct mtd_info *mtd);
 #define NAND_CMD_READSTART	0x30
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
 
 /* Extended commands for AG-AND device */
 /*
@@ -191,6 +193,13 @@ typedef enum {
 /* Device supports subpage reads */
 #define NAND_SUBPAGE_READ       0x00001000
 
+/*
+ * Chip has read cache: READCACHESEQ moves the page just read to the cache
+ * register and reads the next one from the array while the cache register
+ * is read out, READCACHEEND moves the last page without reading another
+ */
+#define NAND_CACHERD		0x00002000
+
 /* Options valid for Samsung large page devices */
 #define NAND_SAMSUNG_LP_OPTIONS \
 	(NAND_NO_PADDING | NAND_CACHEPRG | NAND_COPYBACK)
@@ -200,6 +209,7 @@ typedef enum {
 #define NAND_HAS_CACHEPROG(chip) ((chip->options & NAND_CACHEPRG))
 #define NAND_HAS_COPYBACK(chip) ((chip->options & NAND_COPYBACK))
 #define NAND_HAS_SUBPAGE_READ(chip) ((chip->options & NAND_SUBPAGE_READ))
+#define NAND_HAS_CACHERD(chip) ((chip->options & NAND_CACHERD))
 
 /* Non chip related options */
 /* This option skips the bbt scan during initialization. */
@@ -211,6 +221,12 @@ typedef enum {
 #define NAND_OWN_BUFFERS	0x00020000
 /* Chip may not exist, so silence any errors in scan */
 #define NAND_SCAN_SILENT_NODEV	0x00040000
+/*
+ * The board driver's cmdfunc sends the read cache commands and waits for
+ * them, as nand_command_lp() does. Without this, NAND_CACHERD is ignored
+ * for drivers with their own cmdfunc.
+ */
+#define NAND_CMDFUNC_CACHERD	0x00080000
 
 /* Options set by nand scan */
 /* bbt has already been read */
@@ -240,6 +256,10 @@ struct nand_chip;
 /* ONFI subfeature parameters length */
 #define ONFI_SUBFEATURE_PARAM_LEN	4
 
+/* ONFI optional commands, in opt_cmd */
+#define ONFI_OPT_CMD_PROG_CACHE		(1 << 0)
+#define ONFI_OPT_CMD_READ_CACHE		(1 << 1)
+
 struct nand_onfi_params {
 	/* rev info and features block */
 	/* 'O' 'N' 'F' 'I'  */
@@ -386,6 +406,22 @@ struct nand_ecc_ctrl {
 			int page);
 };
 
+/**
+ * struct nand_read_stats - Pages read from the chip
+ *
+ * @pages:		Pages read from the array
+ * @cache_pages:	Of those, pages read while the page before was read out
+ *			of the cache register
+ * @bytes:		Bytes of data returned
+ * @us:			Time taken in microseconds
+ */
+struct nand_read_stats {
+	ulong pages;
+	ulong cache_pages;
+	uint64_t bytes;
+	ulong us;
+};
+
 /**
  * struct nand_buffers - buffer structure for read/write
  * @ecccalc:	buffer for calculated ECC
@@ -488,6 +524,8 @@ struct nand_buffers {
  *			additional error status checks (determine if errors are
  *			correctable).
  * @write_page:		[REPLACEABLE] High-level page write function
+ * @read_stats:		[OPTIONAL] if not NULL, reads add the pages they
+ *			read and the time they took here
  */
 
 struct nand_chip {
@@ -560,6 +598,8 @@ struct nand_chip {
 
 	struct nand_bbt_descr *badblock_pattern;
 
+	struct nand_read_stats *read_stats;
+
 	void *priv;
 };
 
@@ -39,6 +39,10 @@
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_HC		(1 << 5)
 #define MMC_MODE_DDR_52MHz	(1 << 6)
+/* The host sends CMD12 by itself after multi-block transfers */
+#define MMC_MODE_AUTO_CMD12	(1 << 7)
+/* The host waits for the card to leave busy before each command */
+#define MMC_MODE_BUSY_WAIT	(1 << 8)
 
 #define SD_DATA_4BIT	0x00040000
 
@@ -95,6 +99,7 @@
 #define SD_CMD_APP_SEND_SCR		51
 
 /* SCR definitions in different words */
+#define SD_SCR_CMD23_SUPPORT	0x00000002
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
 
@@ -103,6 +108,10 @@
 #define OCR_VOLTAGE_MASK	0x007FFF80
 #define OCR_ACCESS_MODE		0x60000000
 
+/* CMD38 arguments */
+#define MMC_ERASE_ARG		0x00000000
+#define MMC_TRIM_ARG		0x00000001
+#define MMC_DISCARD_ARG		0x00000003
 #define SECURE_ERASE		0x80000000
 
 #define MMC_STATUS_MASK		(~0x0206BF7F)
@@ -160,8 +169,12 @@
 #define EXT_CSD_CARD_TYPE		196	/* RO */
 #define EXT_CSD_SEC_CNT			212	/* RO, 4 bytes */
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
+#define EXT_CSD_ERASE_TIMEOUT_MULT	223	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_SEC_ERASE_MULT		230	/* RO */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_TRIM_MULT		232	/* RO */
 
 /*
  * EXT_CSD field definitions
@@ -184,6 +197,9 @@
 #define EXT_CSD_DDR_BUS_WIDTH_4	5	/* Card is in 4 bit DDR mode */
 #define EXT_CSD_DDR_BUS_WIDTH_8	6	/* Card is in 8 bit DDR mode */
 
+#define EXT_CSD_SEC_ER_EN	(1 << 0)	/* Secure erase */
+#define EXT_CSD_SEC_GB_CL_EN	(1 << 4)	/* Trim */
+
 #define EXT_CSD_BOOT_ACK_ENABLE			(1 << 6)
 #define EXT_CSD_BOOT_PARTITION_ENABLE		(1 << 3)
 #define EXT_CSD_PARTITION_ACCESS_ENABLE		(1 << 0)
@@ -280,6 +296,21 @@ struct mmc_config {
 	unsigned char part_type;
 };
 
+/*
+ * Data transfers since the device was created, shown by 'mmc info'. The
+ * core counts commands, blocks and time; hosts that have to restart DMA
+ * within a command count the restarts.
+ */
+struct mmc_stats {
+	ulong rd_cmds;		/* read commands */
+	ulong wr_cmds;		/* write commands */
+	u64 rd_blks;		/* blocks read */
+	u64 wr_blks;		/* blocks written */
+	u64 rd_us;		/* time spent reading */
+	u64 wr_us;		/* time spent writing */
+	ulong dma_restarts;	/* DMA restarts by the host */
+};
+
 /* TODO struct mmc should be in mmc_private but it's hard to fix right now */
 struct mmc {
 	struct list_head link;
@@ -304,6 +335,12 @@ struct mmc {
 	uint read_bl_len;
 	uint write_bl_len;
 	uint erase_grp_size;
+	uint erase_types;	/* 1 << BLK_ERASE_... for each type supported */
+	uint erase_timeout;	/* ms to erase one erase group */
+	uint trim_timeout;	/* ms to trim in one erase group */
+	uint sec_erase_mult;	/* secure erase takes this many erase timeouts */
+	uint write_grp_size;	/* blocks best written together */
+	char set_block_count;	/* 1 if CMD23 starts multi-block transfers */
 	u64 capacity;
 	u64 capacity_user;
 	u64 capacity_boot;
@@ -314,6 +351,7 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	uint op_cond_response;	/* the response byte from the last op_cond */
+	struct mmc_stats stats;
 };
 
 int mmc_register(struct mmc *mmc);
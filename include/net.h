@@ -78,6 +78,19 @@ enum eth_state_t {
 	ETH_STATE_ACTIVE
 };
 
+/**
+ * struct eth_rx_desc - a received packet handed up by recv_batch()
+ *
+ * @packet:	Start of the Ethernet frame, in a buffer owned by the driver
+ * @length:	Length of the frame in bytes
+ * @priv:	Driver's own reference to the buffer, for free_pkt()
+ */
+struct eth_rx_desc {
+	uchar *packet;
+	int length;
+	void *priv;
+};
+
 struct eth_device {
 	char name[16];
 	unsigned char enetaddr[6];
@@ -87,6 +100,15 @@ struct eth_device {
 	int  (*init) (struct eth_device *, bd_t *);
 	int  (*send) (struct eth_device *, void *packet, int length);
 	int  (*recv) (struct eth_device *);
+	/*
+	 * Optional batched receive, used instead of recv: fill in up to
+	 * count descriptors and return how many. Each packet is passed to
+	 * NetReceive() and its buffer then given back, in order, with
+	 * free_pkt() (which may be NULL).
+	 */
+	int  (*recv_batch) (struct eth_device *, struct eth_rx_desc *desc,
+			    int count);
+	void (*free_pkt) (struct eth_device *, struct eth_rx_desc *desc);
 	void (*halt) (struct eth_device *);
 #ifdef CONFIG_MCAST_TFTP
 	int (*mcast) (struct eth_device *, const u8 *enetaddr, u8 set);
@@ -588,6 +610,15 @@ static inline ulong NetReadLong(ulong *from)
 	return l;
 }
 
+/* return u32 *in network byteorder* */
+static inline u32 NetReadU32(u32 *from)
+{
+	u32 l;
+
+	memcpy((void *)&l, (void *)from, sizeof(l));
+	return l;
+}
+
 /* write IP *in network byteorder* */
 static inline void NetWriteIP(void *to, IPaddr_t ip)
 {
@@ -606,6 +637,12 @@ static inline void NetCopyLong(ulong *to, ulong *from)
 	memcpy((void *)to, (void *)from, sizeof(ulong));
 }
 
+/* copy u32 */
+static inline void NetCopyU32(u32 *to, u32 *from)
+{
+	memcpy((void *)to, (void *)from, sizeof(u32));
+}
+
 /**
  * is_zero_ether_addr - Determine if give Ethernet address is all zeros.
  * @addr: Pointer to a six-byte array containing the Ethernet address
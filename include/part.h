@@ -37,10 +37,17 @@ typedef struct block_dev_desc {
 				       const void *buffer);
 	unsigned long   (*block_erase)(int dev,
 				       lbaint_t start,
-				       lbaint_t blkcnt);
+				       lbaint_t blkcnt,
+				       int type);
 	void		*priv;		/* driver private struct pointer */
 }block_dev_desc_t;
 
+/* Erase types for block_erase() */
+#define BLK_ERASE		0	/* erase, rounded out to erase groups */
+#define BLK_ERASE_TRIM		1	/* erase exactly the blocks given */
+#define BLK_ERASE_DISCARD	2	/* like trim, old data may be kept */
+#define BLK_ERASE_SECURE	3	/* erase, and purge copies of the data */
+
 #define BLOCK_CNT(size, block_dev_desc) (PAD_COUNT(size, block_dev_desc->blksz))
 #define PAD_TO_BLOCKSIZE(size, block_dev_desc) \
 	(PAD_SIZE(size, block_dev_desc->blksz))
@@ -148,6 +155,94 @@ static inline int get_device_and_partition(const char *ifname,
 { *dev_desc = NULL; return -1; }
 #endif
 
+/* drivers/block/blkcache.c */
+struct block_cache_stats {
+	unsigned hits;		/* reads satisfied from the cache */
+	unsigned misses;	/* cacheable reads that went to the device */
+	unsigned bypass;	/* reads too large to be cached */
+	unsigned entries;	/* entries currently held */
+	unsigned max_blocks_per_entry;
+	unsigned max_entries;
+};
+
+#if defined(CONFIG_BLOCK_CACHE) && !defined(CONFIG_SPL_BUILD)
+/**
+ * blk_dread() - Read blocks from a device through the block cache
+ *
+ * Small reads are looked up in (and added to) the LRU block cache; larger
+ * reads are passed straight to dev_desc->block_read().
+ *
+ * @param dev_desc - block device descriptor
+ * @param start - first block to read
+ * @param blkcnt - number of blocks to read
+ * @param buffer - destination buffer
+ *
+ * @return - number of blocks read, as returned by block_read()
+ */
+unsigned long blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+			lbaint_t blkcnt, void *buffer);
+
+/**
+ * blk_dwrite() - Write blocks to a device, updating the block cache
+ *
+ * The cache is write-through: data always goes to the device, and any
+ * cached copies of the written blocks are refreshed afterwards.
+ *
+ * @param dev_desc - block device descriptor
+ * @param start - first block to write
+ * @param blkcnt - number of blocks to write
+ * @param buffer - source buffer
+ *
+ * @return - number of blocks written, as returned by block_write()
+ */
+unsigned long blk_dwrite(block_dev_desc_t *dev_desc, lbaint_t start,
+			 lbaint_t blkcnt, const void *buffer);
+
+/**
+ * blkcache_invalidate() - Drop all cached blocks of a device
+ *
+ * Must be called whenever a device is (re)initialised or written without
+ * going through blk_dwrite().
+ *
+ * @param if_type - interface type (IF_TYPE_...)
+ * @param dev - device number
+ */
+void blkcache_invalidate(int if_type, int dev);
+
+/**
+ * blkcache_configure() - Change the cache geometry
+ *
+ * Flushes the whole cache and clears the statistics.
+ *
+ * @param blocks - maximum number of blocks held by one entry
+ * @param entries - maximum number of entries
+ */
+void blkcache_configure(unsigned blocks, unsigned entries);
+
+/**
+ * blkcache_stats() - Return the cache statistics
+ *
+ * @param stats - filled in with the current statistics
+ */
+void blkcache_stats(struct block_cache_stats *stats);
+#else
+static inline unsigned long blk_dread(block_dev_desc_t *dev_desc,
+				      lbaint_t start, lbaint_t blkcnt,
+				      void *buffer)
+{
+	return dev_desc->block_read(dev_desc->dev, start, blkcnt, buffer);
+}
+
+static inline unsigned long blk_dwrite(block_dev_desc_t *dev_desc,
+				       lbaint_t start, lbaint_t blkcnt,
+				       const void *buffer)
+{
+	return dev_desc->block_write(dev_desc->dev, start, blkcnt, buffer);
+}
+
+static inline void blkcache_invalidate(int if_type, int dev) {}
+#endif
+
 #ifdef CONFIG_MAC_PARTITION
 /* disk/part_mac.c */
 int get_partition_info_mac (block_dev_desc_t * dev_desc, int part, disk_partition_t *info);
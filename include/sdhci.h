@@ -179,6 +179,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -223,6 +224,31 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+#if defined(CONFIG_MMC_SDHCI_ADMA) && defined(CONFIG_MMC_SDMA)
+#error "CONFIG_MMC_SDHCI_ADMA replaces CONFIG_MMC_SDMA, define only one"
+#endif
+
+/*
+ * ADMA2 descriptor, little endian. The 32-bit form ends after addr_lo.
+ * Each descriptor moves up to 64KiB, a length of 0 meaning 64KiB, from
+ * an address aligned to the descriptor's address size.
+ */
+struct sdhci_adma_desc {
+	__le16 attr;
+	__le16 len;
+	__le32 addr_lo;
+	__le32 addr_hi;
+} __packed;
+
+#define SDHCI_ADMA_VALID	0x01
+#define SDHCI_ADMA_END		0x02
+#define SDHCI_ADMA_INT		0x04
+#define SDHCI_ADMA_TRAN		0x20
+#define SDHCI_ADMA_MAX_LEN	65536
+#define SDHCI_ADMA32_DESC_SIZE	8
+#define SDHCI_ADMA64_DESC_SIZE	12
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32             (*read_l)(struct sdhci_host *host, int reg);
@@ -254,6 +280,11 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	void *adma_table;		/* ADMA2 descriptor table */
+	uint adma_desc_size;		/* bytes per descriptor */
+	uint adma_descs;		/* descriptors in the table */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -0,0 +1,46 @@
+/*
+ * Android sparse image format, as written by img2simg and the fastboot
+ * client
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _SPARSE_FORMAT_H
+#define _SPARSE_FORMAT_H
+
+#include <linux/types.h>
+
+typedef struct sparse_header {
+	__le32	magic;		/* SPARSE_HEADER_MAGIC */
+	__le16	major_version;	/* 1, higher major versions are rejected */
+	__le16	minor_version;	/* 0, higher minor versions are allowed */
+	__le16	file_hdr_sz;	/* 28 bytes in the first revision */
+	__le16	chunk_hdr_sz;	/* 12 bytes in the first revision */
+	__le32	blk_sz;		/* block size in bytes, a multiple of 4 */
+	__le32	total_blks;	/* blocks in the unsparsed image */
+	__le32	total_chunks;	/* chunks in the sparse image */
+	__le32	image_checksum;	/* CRC32 of the unsparsed image */
+} sparse_header_t;
+
+#define SPARSE_HEADER_MAGIC	0xed26ff3a
+#define SPARSE_MAJOR_VERSION	1
+
+#define CHUNK_TYPE_RAW		0xCAC1
+#define CHUNK_TYPE_FILL		0xCAC2
+#define CHUNK_TYPE_DONT_CARE	0xCAC3
+#define CHUNK_TYPE_CRC32	0xCAC4
+
+typedef struct chunk_header {
+	__le16	chunk_type;	/* CHUNK_TYPE_... */
+	__le16	reserved1;
+	__le32	chunk_sz;	/* blocks in the unsparsed image */
+	__le32	total_sz;	/* bytes in the sparse image, with this header */
+} chunk_header_t;
+
+/*
+ * A chunk header is followed by its data: chunk_sz * blk_sz bytes for a
+ * raw chunk, the 4 byte fill value for a fill chunk and the 4 byte CRC32
+ * of the image so far for a CRC32 chunk.
+ */
+
+#endif /* _SPARSE_FORMAT_H */
@@ -31,6 +31,8 @@
 #define SPI_XFER_MMAP_END	0x10	/* Memory Mapped End */
 #define SPI_XFER_ONCE		(SPI_XFER_BEGIN | SPI_XFER_END)
 #define SPI_XFER_U_PAGE		(1 << 5)
+#define SPI_XFER_DUAL		(1 << 6)	/* Bits go on IO0-1 */
+#define SPI_XFER_QUAD		(1 << 7)	/* Bits go on IO0-3 */
 
 /* SPI TX operation modes */
 #define SPI_OPM_TX_QPP		1 << 0
@@ -61,8 +63,11 @@
  *
  * @bus:		ID of the bus that the slave is attached to.
  * @cs:			ID of the chip select connected to the slave.
- * @op_mode_rx:		SPI RX operation mode.
- * @op_mode_tx:		SPI TX operation mode.
+ * @op_mode_rx:		SPI RX operation modes (SPI_OPM_RX_...) the bus
+ *			supports. Drivers setting the dual or quad modes
+ *			should use the line count given to spi_xfer().
+ * @op_mode_tx:		SPI TX operation modes (SPI_OPM_TX_...) the bus
+ *			supports.
  * @wordlen:		Size of SPI word in number of bits
  * @max_write_size:	If non-zero, the maximum number of bytes which can
  *			be written at once, excluding command bytes.
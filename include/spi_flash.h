@@ -66,6 +66,28 @@ struct spi_flash_params {
 
 extern const struct spi_flash_params spi_flash_params_table[];
 
+/* Kinds of erase command, from the smallest; see struct spi_flash */
+enum spi_flash_erase_kind {
+	SF_ERASE_4K,
+	SF_ERASE_32K,
+	SF_ERASE_SECTOR,
+	SF_ERASE_CHIP,
+
+	SF_ERASE_KINDS,
+};
+
+/**
+ * struct spi_flash_erase_stats - Erase commands planned or issued
+ *
+ * @count:	Number of commands of each kind
+ * @us:		Time taken by each kind in microseconds, including waiting
+ *		for the flash to finish
+ */
+struct spi_flash_erase_stats {
+	u32 count[SF_ERASE_KINDS];
+	ulong us[SF_ERASE_KINDS];
+};
+
 /**
  * struct spi_flash - SPI flash structure
  *
@@ -82,6 +104,9 @@ extern const struct spi_flash_params spi_flash_params_table[];
  * @bank_curr:		Current flash bank
  * @poll_cmd:		Poll cmd - for flash erase/program
  * @erase_cmd:		Erase cmd 4K, 32K, 64K
+ * @erase_cmds:		Erase cmd of each kind, 0 if not supported
+ * @erase_sizes:	Size erased by each kind of erase cmd
+ * @erase_stats:	If not NULL, erase ops add the cmds they issue here
  * @read_cmd:		Read cmd - Array Fast, Extn read and quad read.
  * @write_cmd:		Write cmd - page and quad program.
  * @dummy_byte:		Dummy cycles for read operation.
@@ -91,7 +116,7 @@ extern const struct spi_flash_params spi_flash_params_table[];
  * @write:		Flash write ops: Write len bytes from buf into offset
  *			Supported cmds: Page Program
  * @erase:		Flash erase ops: Erase len bytes from offset
- *			Supported cmds: Sector erase 4K, 32K, 64K
+ *			Supported cmds: Sector erase 4K, 32K, 64K, chip erase
  * return 0 - Success, 1 - Failure
  */
 struct spi_flash {
@@ -114,6 +139,9 @@ struct spi_flash {
 	u8 read_cmd;
 	u8 write_cmd;
 	u8 dummy_byte;
+	u8 erase_cmds[SF_ERASE_KINDS];
+	u32 erase_sizes[SF_ERASE_KINDS];
+	struct spi_flash_erase_stats *erase_stats;
 
 	void *memory_map;
 	int (*read)(struct spi_flash *flash, u32 offset, size_t len, void *buf);
@@ -157,6 +185,23 @@ static inline int spi_flash_erase(struct spi_flash *flash, u32 offset,
 	return flash->erase(flash, offset, len);
 }
 
+/**
+ * spi_flash_erase_plan() - Work out the erase commands for a region
+ *
+ * The region is covered with the fewest erase commands the flash supports,
+ * taking the largest that is aligned and fits at each step, and a chip
+ * erase if it covers the whole flash. This is what the erase ops do.
+ *
+ * @flash:	SPI flash
+ * @offset:	Start of the region
+ * @len:	Length of the region
+ * @plan:	Returns the number of commands of each kind (us is zeroed)
+ * @return number of commands, or -EINVAL if the region is not aligned to
+ * the flash's erase size or runs past its end
+ */
+int spi_flash_erase_plan(struct spi_flash *flash, u32 offset, size_t len,
+			 struct spi_flash_erase_stats *plan);
+
 void spi_boot(void) __noreturn;
 void spi_spl_load_image(uint32_t offs, unsigned int size, void *vdst);
 
@@ -25,4 +25,45 @@ uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 void crc32_wd_buf(const unsigned char *input, uint ilen,
 		    unsigned char *output, uint chunk_sz);
 
+#ifndef USE_HOSTCC
+/**
+ * crc32_arch_probe() - Check whether the CPU can accelerate the CRC32
+ *
+ * Provided by the architecture with CONFIG_CRC32_ARCH.
+ *
+ * @return non-zero if crc32_arch_no_comp() will do any work
+ */
+int crc32_arch_probe(void);
+
+/**
+ * crc32_arch_no_comp() - Work out the CRC32 of a buffer using the CPU
+ *
+ * Provided by the architecture with CONFIG_CRC32_ARCH. This may stop short
+ * of the end of the buffer, e.g. on an alignment boundary, or do nothing
+ * at all if the CPU cannot help, leaving the caller to do the rest.
+ *
+ * @crcp:	CRC so far, as for crc32_no_comp(); updated with the bytes done
+ * @buf:	Buffer to check
+ * @len:	Length of @buf in bytes
+ * @return number of bytes from the start of @buf added to *@crcp
+ */
+uint crc32_arch_no_comp(uint32_t *crcp, const unsigned char *buf, uint len);
+
+/**
+ * struct crc32_algo - A way of working out crc32_no_comp()
+ *
+ * @name:	Short name, e.g. "slice8"
+ * @no_comp:	Works out the CRC as crc32_no_comp() does
+ * @probe:	Checks whether this can be used, if not NULL
+ */
+struct crc32_algo {
+	const char *name;
+	uint32_t (*no_comp)(uint32_t crc, const unsigned char *buf, uint len);
+	int (*probe)(void);
+};
+
+/* All CRC32 algorithms built in, ending with an empty entry */
+extern const struct crc32_algo crc32_algos[];
+#endif
+
 #endif /* _UBOOT_CRC_H */
@@ -91,6 +91,36 @@ void sha1_csum(const unsigned char *input, unsigned int ilen,
 void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+/**
+ * \brief	   As sha1_csum_wd(), without the help of the CPU
+ */
+void sha1_csum_wd_generic(const unsigned char *input, unsigned int ilen,
+			  unsigned char *output, unsigned int chunk_sz);
+
+/**
+ * \brief	   Hash whole blocks using the CPU
+ *
+ * Provided by the architecture with CONFIG_SHA_ARCH. This does nothing
+ * if the CPU cannot help, leaving the caller to hash the blocks.
+ *
+ * \param state    SHA-1 state, updated with the blocks done
+ * \param data	   data to hash
+ * \param blocks   number of 64-byte blocks in the data
+ *
+ * \return	   number of blocks from the start of the data hashed
+ */
+unsigned int sha1_arch_process(uint32_t state[5], const unsigned char *data,
+			       unsigned int blocks);
+
+/**
+ * \brief	   Check whether the CPU can accelerate SHA-1
+ *
+ * \return	   non-zero if sha1_arch_process() will do any work
+ */
+int sha1_arch_probe(void);
+#endif
+
 /**
  * \brief	   Output = HMAC-SHA-1( input buffer, hmac key )
  *
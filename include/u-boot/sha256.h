@@ -19,4 +19,29 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+void sha256_csum_wd_generic(const unsigned char *input, unsigned int ilen,
+			    unsigned char *output, unsigned int chunk_sz);
+
+/**
+ * sha256_arch_process() - Hash whole blocks using the CPU
+ *
+ * Provided by the architecture with CONFIG_SHA_ARCH. This does nothing if
+ * the CPU cannot help, leaving the caller to hash the blocks.
+ *
+ * @state:	SHA-256 state, updated with the blocks done
+ * @data:	Data to hash
+ * @blocks:	Number of 64-byte blocks in @data
+ * @return number of blocks from the start of @data that were hashed
+ */
+unsigned int sha256_arch_process(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks);
+
+/**
+ * sha256_arch_probe() - Check whether the CPU can accelerate SHA-256
+ *
+ * @return non-zero if sha256_arch_process() will do any work
+ */
+int sha256_arch_probe(void);
+#endif
 #endif /* _SHA256_H */
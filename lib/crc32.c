@@ -176,7 +176,7 @@ const uint32_t * ZEXPORT get_crc_table()
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
  */
-uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+static uint32_t crc32_no_comp_word(uint32_t crc, const Bytef *buf, uInt len)
 {
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
@@ -218,6 +218,75 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 }
 #undef DO_CRC
 
+#if defined(CONFIG_CRC32_SLICE_BY_8) && !defined(USE_HOSTCC)
+#include "crc32_table8.h"
+
+/*
+ * Slice-by-8: look up eight bytes at a time in eight tables, so that the
+ * lookups do not wait on each other. Costs 8KB of tables.
+ */
+static uint32_t crc32_no_comp_slice8(uint32_t crc, const Bytef *buf,
+				     uInt len)
+{
+	const uint32_t (*t)[256] = crc_table8;
+	uint32_t one, two;
+
+	while (len && ((ulong)buf & 3)) {
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	for (; len >= 8; len -= 8, buf += 8) {
+		one = le32_to_cpu(*(const uint32_t *)buf) ^ crc;
+		two = le32_to_cpu(*(const uint32_t *)(buf + 4));
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^
+		      t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+		      t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^
+		      t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+	}
+	while (len--)
+		crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+#define crc32_no_comp_table	crc32_no_comp_slice8
+#else
+#define crc32_no_comp_table	crc32_no_comp_word
+#endif
+
+#if defined(CONFIG_CRC32_ARCH) && !defined(USE_HOSTCC)
+/* Let the CPU do what it can, and the tables the rest */
+static uint32_t crc32_no_comp_arch(uint32_t crc, const Bytef *buf, uInt len)
+{
+	uInt done;
+
+	done = crc32_arch_no_comp(&crc, buf, len);
+
+	return crc32_no_comp_table(crc, buf + done, len - done);
+}
+#endif
+
+uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
+{
+#if defined(CONFIG_CRC32_ARCH) && !defined(USE_HOSTCC)
+	return crc32_no_comp_arch(crc, buf, len);
+#else
+	return crc32_no_comp_table(crc, buf, len);
+#endif
+}
+
+#if defined(CONFIG_CMD_CRC32_BENCH) && !defined(USE_HOSTCC)
+const struct crc32_algo crc32_algos[] = {
+	{ "word", crc32_no_comp_word },
+#ifdef CONFIG_CRC32_SLICE_BY_8
+	{ "slice8", crc32_no_comp_slice8 },
+#endif
+#ifdef CONFIG_CRC32_ARCH
+	{ "arch", crc32_no_comp_arch, crc32_arch_probe },
+#endif
+	{ },
+};
+#endif
+
 uint32_t ZEXPORT crc32 (uint32_t crc, const Bytef *p, uInt len)
 {
      return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
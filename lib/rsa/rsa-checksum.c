@@ -143,6 +143,12 @@ void sha1_calculate(const struct image_region region[], int region_count,
 	uint32_t i;
 	i = 0;
 
+	/* Image data digested while it was copied to its load address */
+	if (region_count == 1 &&
+	    !fit_image_get_digest(region[0].data, region[0].size, "sha1",
+				  checksum, NULL))
+		return;
+
 	sha1_starts(&ctx);
 	for (i = 0; i < region_count; i++)
 		sha1_update(&ctx, region[i].data, region[i].size);
@@ -156,6 +162,12 @@ void sha256_calculate(const struct image_region region[], int region_count,
 	uint32_t i;
 	i = 0;
 
+	/* Image data digested while it was copied to its load address */
+	if (region_count == 1 &&
+	    !fit_image_get_digest(region[0].data, region[0].size, "sha256",
+				  checksum, NULL))
+		return;
+
 	sha256_starts(&ctx);
 	for (i = 0; i < region_count; i++)
 		sha256_update(&ctx, region[i].data, region[i].size);
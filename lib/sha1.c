@@ -73,27 +73,15 @@ void sha1_starts (sha1_context * ctx)
 	ctx->state[4] = 0xC3D2E1F0;
 }
 
-static void sha1_process(sha1_context *ctx, const unsigned char data[64])
+/*
+ * Hash whole 64-byte blocks, keeping the state in local variables from
+ * one block to the next.
+ */
+static void sha1_process_generic(unsigned long state[5],
+				 const unsigned char *data, unsigned int blocks)
 {
 	unsigned long temp, W[16], A, B, C, D, E;
 
-	GET_UINT32_BE (W[0], data, 0);
-	GET_UINT32_BE (W[1], data, 4);
-	GET_UINT32_BE (W[2], data, 8);
-	GET_UINT32_BE (W[3], data, 12);
-	GET_UINT32_BE (W[4], data, 16);
-	GET_UINT32_BE (W[5], data, 20);
-	GET_UINT32_BE (W[6], data, 24);
-	GET_UINT32_BE (W[7], data, 28);
-	GET_UINT32_BE (W[8], data, 32);
-	GET_UINT32_BE (W[9], data, 36);
-	GET_UINT32_BE (W[10], data, 40);
-	GET_UINT32_BE (W[11], data, 44);
-	GET_UINT32_BE (W[12], data, 48);
-	GET_UINT32_BE (W[13], data, 52);
-	GET_UINT32_BE (W[14], data, 56);
-	GET_UINT32_BE (W[15], data, 60);
-
 #define S(x,n)	((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
 
 #define R(t) (						\
@@ -106,35 +94,53 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 	e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);	\
 }
 
-	A = ctx->state[0];
-	B = ctx->state[1];
-	C = ctx->state[2];
-	D = ctx->state[3];
-	E = ctx->state[4];
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+
+	for (; blocks; blocks--, data += 64) {
+		GET_UINT32_BE (W[0], data, 0);
+		GET_UINT32_BE (W[1], data, 4);
+		GET_UINT32_BE (W[2], data, 8);
+		GET_UINT32_BE (W[3], data, 12);
+		GET_UINT32_BE (W[4], data, 16);
+		GET_UINT32_BE (W[5], data, 20);
+		GET_UINT32_BE (W[6], data, 24);
+		GET_UINT32_BE (W[7], data, 28);
+		GET_UINT32_BE (W[8], data, 32);
+		GET_UINT32_BE (W[9], data, 36);
+		GET_UINT32_BE (W[10], data, 40);
+		GET_UINT32_BE (W[11], data, 44);
+		GET_UINT32_BE (W[12], data, 48);
+		GET_UINT32_BE (W[13], data, 52);
+		GET_UINT32_BE (W[14], data, 56);
+		GET_UINT32_BE (W[15], data, 60);
 
 #define F(x,y,z) (z ^ (x & (y ^ z)))
 #define K 0x5A827999
 
-	P (A, B, C, D, E, W[0]);
-	P (E, A, B, C, D, W[1]);
-	P (D, E, A, B, C, W[2]);
-	P (C, D, E, A, B, W[3]);
-	P (B, C, D, E, A, W[4]);
-	P (A, B, C, D, E, W[5]);
-	P (E, A, B, C, D, W[6]);
-	P (D, E, A, B, C, W[7]);
-	P (C, D, E, A, B, W[8]);
-	P (B, C, D, E, A, W[9]);
-	P (A, B, C, D, E, W[10]);
-	P (E, A, B, C, D, W[11]);
-	P (D, E, A, B, C, W[12]);
-	P (C, D, E, A, B, W[13]);
-	P (B, C, D, E, A, W[14]);
-	P (A, B, C, D, E, W[15]);
-	P (E, A, B, C, D, R (16));
-	P (D, E, A, B, C, R (17));
-	P (C, D, E, A, B, R (18));
-	P (B, C, D, E, A, R (19));
+		P (A, B, C, D, E, W[0]);
+		P (E, A, B, C, D, W[1]);
+		P (D, E, A, B, C, W[2]);
+		P (C, D, E, A, B, W[3]);
+		P (B, C, D, E, A, W[4]);
+		P (A, B, C, D, E, W[5]);
+		P (E, A, B, C, D, W[6]);
+		P (D, E, A, B, C, W[7]);
+		P (C, D, E, A, B, W[8]);
+		P (B, C, D, E, A, W[9]);
+		P (A, B, C, D, E, W[10]);
+		P (E, A, B, C, D, W[11]);
+		P (D, E, A, B, C, W[12]);
+		P (C, D, E, A, B, W[13]);
+		P (B, C, D, E, A, W[14]);
+		P (A, B, C, D, E, W[15]);
+		P (E, A, B, C, D, R (16));
+		P (D, E, A, B, C, R (17));
+		P (C, D, E, A, B, R (18));
+		P (B, C, D, E, A, R (19));
 
 #undef K
 #undef F
@@ -142,26 +148,26 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 #define F(x,y,z) (x ^ y ^ z)
 #define K 0x6ED9EBA1
 
-	P (A, B, C, D, E, R (20));
-	P (E, A, B, C, D, R (21));
-	P (D, E, A, B, C, R (22));
-	P (C, D, E, A, B, R (23));
-	P (B, C, D, E, A, R (24));
-	P (A, B, C, D, E, R (25));
-	P (E, A, B, C, D, R (26));
-	P (D, E, A, B, C, R (27));
-	P (C, D, E, A, B, R (28));
-	P (B, C, D, E, A, R (29));
-	P (A, B, C, D, E, R (30));
-	P (E, A, B, C, D, R (31));
-	P (D, E, A, B, C, R (32));
-	P (C, D, E, A, B, R (33));
-	P (B, C, D, E, A, R (34));
-	P (A, B, C, D, E, R (35));
-	P (E, A, B, C, D, R (36));
-	P (D, E, A, B, C, R (37));
-	P (C, D, E, A, B, R (38));
-	P (B, C, D, E, A, R (39));
+		P (A, B, C, D, E, R (20));
+		P (E, A, B, C, D, R (21));
+		P (D, E, A, B, C, R (22));
+		P (C, D, E, A, B, R (23));
+		P (B, C, D, E, A, R (24));
+		P (A, B, C, D, E, R (25));
+		P (E, A, B, C, D, R (26));
+		P (D, E, A, B, C, R (27));
+		P (C, D, E, A, B, R (28));
+		P (B, C, D, E, A, R (29));
+		P (A, B, C, D, E, R (30));
+		P (E, A, B, C, D, R (31));
+		P (D, E, A, B, C, R (32));
+		P (C, D, E, A, B, R (33));
+		P (B, C, D, E, A, R (34));
+		P (A, B, C, D, E, R (35));
+		P (E, A, B, C, D, R (36));
+		P (D, E, A, B, C, R (37));
+		P (C, D, E, A, B, R (38));
+		P (B, C, D, E, A, R (39));
 
 #undef K
 #undef F
@@ -169,26 +175,26 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 #define F(x,y,z) ((x & y) | (z & (x | y)))
 #define K 0x8F1BBCDC
 
-	P (A, B, C, D, E, R (40));
-	P (E, A, B, C, D, R (41));
-	P (D, E, A, B, C, R (42));
-	P (C, D, E, A, B, R (43));
-	P (B, C, D, E, A, R (44));
-	P (A, B, C, D, E, R (45));
-	P (E, A, B, C, D, R (46));
-	P (D, E, A, B, C, R (47));
-	P (C, D, E, A, B, R (48));
-	P (B, C, D, E, A, R (49));
-	P (A, B, C, D, E, R (50));
-	P (E, A, B, C, D, R (51));
-	P (D, E, A, B, C, R (52));
-	P (C, D, E, A, B, R (53));
-	P (B, C, D, E, A, R (54));
-	P (A, B, C, D, E, R (55));
-	P (E, A, B, C, D, R (56));
-	P (D, E, A, B, C, R (57));
-	P (C, D, E, A, B, R (58));
-	P (B, C, D, E, A, R (59));
+		P (A, B, C, D, E, R (40));
+		P (E, A, B, C, D, R (41));
+		P (D, E, A, B, C, R (42));
+		P (C, D, E, A, B, R (43));
+		P (B, C, D, E, A, R (44));
+		P (A, B, C, D, E, R (45));
+		P (E, A, B, C, D, R (46));
+		P (D, E, A, B, C, R (47));
+		P (C, D, E, A, B, R (48));
+		P (B, C, D, E, A, R (49));
+		P (A, B, C, D, E, R (50));
+		P (E, A, B, C, D, R (51));
+		P (D, E, A, B, C, R (52));
+		P (C, D, E, A, B, R (53));
+		P (B, C, D, E, A, R (54));
+		P (A, B, C, D, E, R (55));
+		P (E, A, B, C, D, R (56));
+		P (D, E, A, B, C, R (57));
+		P (C, D, E, A, B, R (58));
+		P (B, C, D, E, A, R (59));
 
 #undef K
 #undef F
@@ -196,42 +202,62 @@ static void sha1_process(sha1_context *ctx, const unsigned char data[64])
 #define F(x,y,z) (x ^ y ^ z)
 #define K 0xCA62C1D6
 
-	P (A, B, C, D, E, R (60));
-	P (E, A, B, C, D, R (61));
-	P (D, E, A, B, C, R (62));
-	P (C, D, E, A, B, R (63));
-	P (B, C, D, E, A, R (64));
-	P (A, B, C, D, E, R (65));
-	P (E, A, B, C, D, R (66));
-	P (D, E, A, B, C, R (67));
-	P (C, D, E, A, B, R (68));
-	P (B, C, D, E, A, R (69));
-	P (A, B, C, D, E, R (70));
-	P (E, A, B, C, D, R (71));
-	P (D, E, A, B, C, R (72));
-	P (C, D, E, A, B, R (73));
-	P (B, C, D, E, A, R (74));
-	P (A, B, C, D, E, R (75));
-	P (E, A, B, C, D, R (76));
-	P (D, E, A, B, C, R (77));
-	P (C, D, E, A, B, R (78));
-	P (B, C, D, E, A, R (79));
+		P (A, B, C, D, E, R (60));
+		P (E, A, B, C, D, R (61));
+		P (D, E, A, B, C, R (62));
+		P (C, D, E, A, B, R (63));
+		P (B, C, D, E, A, R (64));
+		P (A, B, C, D, E, R (65));
+		P (E, A, B, C, D, R (66));
+		P (D, E, A, B, C, R (67));
+		P (C, D, E, A, B, R (68));
+		P (B, C, D, E, A, R (69));
+		P (A, B, C, D, E, R (70));
+		P (E, A, B, C, D, R (71));
+		P (D, E, A, B, C, R (72));
+		P (C, D, E, A, B, R (73));
+		P (B, C, D, E, A, R (74));
+		P (A, B, C, D, E, R (75));
+		P (E, A, B, C, D, R (76));
+		P (D, E, A, B, C, R (77));
+		P (C, D, E, A, B, R (78));
+		P (B, C, D, E, A, R (79));
 
 #undef K
 #undef F
 
-	ctx->state[0] += A;
-	ctx->state[1] += B;
-	ctx->state[2] += C;
-	ctx->state[3] += D;
-	ctx->state[4] += E;
+		A = state[0] += A;
+		B = state[1] += B;
+		C = state[2] += C;
+		D = state[3] += D;
+		E = state[4] += E;
+	}
 }
 
-/*
- * SHA-1 process buffer
- */
-void sha1_update(sha1_context *ctx, const unsigned char *input,
-		 unsigned int ilen)
+static void sha1_process(unsigned long state[5], const unsigned char *data,
+			 unsigned int blocks)
+{
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+	uint32_t arch_state[5];
+	unsigned int done;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		arch_state[i] = state[i];
+	done = sha1_arch_process(arch_state, data, blocks);
+	for (i = 0; i < 5; i++)
+		state[i] = arch_state[i];
+	data += done * 64;
+	blocks -= done;
+#endif
+	sha1_process_generic(state, data, blocks);
+}
+
+typedef void (*sha1_process_t)(unsigned long state[5],
+			       const unsigned char *data, unsigned int blocks);
+
+static void __sha1_update(sha1_context *ctx, const unsigned char *input,
+			  unsigned int ilen, sha1_process_t process)
 {
 	int fill;
 	unsigned long left;
@@ -250,16 +276,16 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 
 	if (left && ilen >= fill) {
 		memcpy ((void *) (ctx->buffer + left), (void *) input, fill);
-		sha1_process (ctx, ctx->buffer);
+		process(ctx->state, ctx->buffer, 1);
 		input += fill;
 		ilen -= fill;
 		left = 0;
 	}
 
-	while (ilen >= 64) {
-		sha1_process (ctx, input);
-		input += 64;
-		ilen -= 64;
+	if (ilen >= 64) {
+		process(ctx->state, input, ilen / 64);
+		input += ilen & ~0x3F;
+		ilen &= 0x3F;
 	}
 
 	if (ilen > 0) {
@@ -267,6 +293,15 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
 	}
 }
 
+/*
+ * SHA-1 process buffer
+ */
+void sha1_update(sha1_context *ctx, const unsigned char *input,
+		 unsigned int ilen)
+{
+	__sha1_update(ctx, input, ilen, sha1_process);
+}
+
 static const unsigned char sha1_padding[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -274,10 +309,8 @@ static const unsigned char sha1_padding[64] = {
 	   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-/*
- * SHA-1 final digest
- */
-void sha1_finish (sha1_context * ctx, unsigned char output[20])
+static void __sha1_finish(sha1_context *ctx, unsigned char output[20],
+			  sha1_process_t process)
 {
 	unsigned long last, padn;
 	unsigned long high, low;
@@ -293,8 +326,8 @@ void sha1_finish (sha1_context * ctx, unsigned char output[20])
 	last = ctx->total[0] & 0x3F;
 	padn = (last < 56) ? (56 - last) : (120 - last);
 
-	sha1_update (ctx, (unsigned char *) sha1_padding, padn);
-	sha1_update (ctx, msglen, 8);
+	__sha1_update(ctx, (unsigned char *) sha1_padding, padn, process);
+	__sha1_update(ctx, msglen, 8, process);
 
 	PUT_UINT32_BE (ctx->state[0], output, 0);
 	PUT_UINT32_BE (ctx->state[1], output, 4);
@@ -303,6 +336,14 @@ void sha1_finish (sha1_context * ctx, unsigned char output[20])
 	PUT_UINT32_BE (ctx->state[4], output, 16);
 }
 
+/*
+ * SHA-1 final digest
+ */
+void sha1_finish (sha1_context * ctx, unsigned char output[20])
+{
+	__sha1_finish(ctx, output, sha1_process);
+}
+
 /*
  * Output = SHA-1( input buffer )
  */
@@ -316,12 +357,9 @@ void sha1_csum(const unsigned char *input, unsigned int ilen,
 	sha1_finish (&ctx, output);
 }
 
-/*
- * Output = SHA-1( input buffer ). Trigger the watchdog every 'chunk_sz'
- * bytes of input processed.
- */
-void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
-		  unsigned char *output, unsigned int chunk_sz)
+static void __sha1_csum_wd(const unsigned char *input, unsigned int ilen,
+			   unsigned char *output, unsigned int chunk_sz,
+			   sha1_process_t process)
 {
 	sha1_context ctx;
 #if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
@@ -338,17 +376,36 @@ void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		chunk = end - curr;
 		if (chunk > chunk_sz)
 			chunk = chunk_sz;
-		sha1_update (&ctx, curr, chunk);
+		__sha1_update(&ctx, curr, chunk, process);
 		curr += chunk;
 		WATCHDOG_RESET ();
 	}
 #else
-	sha1_update (&ctx, input, ilen);
+	__sha1_update(&ctx, input, ilen, process);
 #endif
 
-	sha1_finish (&ctx, output);
+	__sha1_finish(&ctx, output, process);
+}
+
+/*
+ * Output = SHA-1( input buffer ). Trigger the watchdog every 'chunk_sz'
+ * bytes of input processed.
+ */
+void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
+		  unsigned char *output, unsigned int chunk_sz)
+{
+	__sha1_csum_wd(input, ilen, output, chunk_sz, sha1_process);
 }
 
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+/* As sha1_csum_wd(), without the help of the CPU */
+void sha1_csum_wd_generic(const unsigned char *input, unsigned int ilen,
+			  unsigned char *output, unsigned int chunk_sz)
+{
+	__sha1_csum_wd(input, ilen, output, chunk_sz, sha1_process_generic);
+}
+#endif
+
 /*
  * Output = HMAC-SHA-1( input buffer, hmac key )
  */
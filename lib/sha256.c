@@ -50,29 +50,17 @@ void sha256_starts(sha256_context * ctx)
 	ctx->state[7] = 0x5BE0CD19;
 }
 
-static void sha256_process(sha256_context *ctx, const uint8_t data[64])
+/*
+ * Hash whole 64-byte blocks, keeping the state in local variables from
+ * one block to the next and the message schedule in a 16-word ring.
+ */
+static void sha256_process_generic(uint32_t state[8], const uint8_t *data,
+				   unsigned int blocks)
 {
 	uint32_t temp1, temp2;
-	uint32_t W[64];
+	uint32_t W[16];
 	uint32_t A, B, C, D, E, F, G, H;
 
-	GET_UINT32_BE(W[0], data, 0);
-	GET_UINT32_BE(W[1], data, 4);
-	GET_UINT32_BE(W[2], data, 8);
-	GET_UINT32_BE(W[3], data, 12);
-	GET_UINT32_BE(W[4], data, 16);
-	GET_UINT32_BE(W[5], data, 20);
-	GET_UINT32_BE(W[6], data, 24);
-	GET_UINT32_BE(W[7], data, 28);
-	GET_UINT32_BE(W[8], data, 32);
-	GET_UINT32_BE(W[9], data, 36);
-	GET_UINT32_BE(W[10], data, 40);
-	GET_UINT32_BE(W[11], data, 44);
-	GET_UINT32_BE(W[12], data, 48);
-	GET_UINT32_BE(W[13], data, 52);
-	GET_UINT32_BE(W[14], data, 56);
-	GET_UINT32_BE(W[15], data, 60);
-
 #define SHR(x,n) ((x & 0xFFFFFFFF) >> n)
 #define ROTR(x,n) (SHR(x,n) | (x << (32 - n)))
 
@@ -85,10 +73,10 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 #define F0(x,y,z) ((x & y) | (z & (x | y)))
 #define F1(x,y,z) (z ^ (x & (y ^ z)))
 
-#define R(t)					\
-(						\
-	W[t] = S1(W[t - 2]) + W[t - 7] +	\
-		S0(W[t - 15]) + W[t - 16]	\
+#define R(t)						\
+(							\
+	W[t & 15] += S1(W[(t - 2) & 15]) +		\
+		W[(t - 7) & 15] + S0(W[(t - 15) & 15])	\
 )
 
 #define P(a,b,c,d,e,f,g,h,x,K) {		\
@@ -97,91 +85,127 @@ static void sha256_process(sha256_context *ctx, const uint8_t data[64])
 	d += temp1; h = temp1 + temp2;		\
 }
 
-	A = ctx->state[0];
-	B = ctx->state[1];
-	C = ctx->state[2];
-	D = ctx->state[3];
-	E = ctx->state[4];
-	F = ctx->state[5];
-	G = ctx->state[6];
-	H = ctx->state[7];
-
-	P(A, B, C, D, E, F, G, H, W[0], 0x428A2F98);
-	P(H, A, B, C, D, E, F, G, W[1], 0x71374491);
-	P(G, H, A, B, C, D, E, F, W[2], 0xB5C0FBCF);
-	P(F, G, H, A, B, C, D, E, W[3], 0xE9B5DBA5);
-	P(E, F, G, H, A, B, C, D, W[4], 0x3956C25B);
-	P(D, E, F, G, H, A, B, C, W[5], 0x59F111F1);
-	P(C, D, E, F, G, H, A, B, W[6], 0x923F82A4);
-	P(B, C, D, E, F, G, H, A, W[7], 0xAB1C5ED5);
-	P(A, B, C, D, E, F, G, H, W[8], 0xD807AA98);
-	P(H, A, B, C, D, E, F, G, W[9], 0x12835B01);
-	P(G, H, A, B, C, D, E, F, W[10], 0x243185BE);
-	P(F, G, H, A, B, C, D, E, W[11], 0x550C7DC3);
-	P(E, F, G, H, A, B, C, D, W[12], 0x72BE5D74);
-	P(D, E, F, G, H, A, B, C, W[13], 0x80DEB1FE);
-	P(C, D, E, F, G, H, A, B, W[14], 0x9BDC06A7);
-	P(B, C, D, E, F, G, H, A, W[15], 0xC19BF174);
-	P(A, B, C, D, E, F, G, H, R(16), 0xE49B69C1);
-	P(H, A, B, C, D, E, F, G, R(17), 0xEFBE4786);
-	P(G, H, A, B, C, D, E, F, R(18), 0x0FC19DC6);
-	P(F, G, H, A, B, C, D, E, R(19), 0x240CA1CC);
-	P(E, F, G, H, A, B, C, D, R(20), 0x2DE92C6F);
-	P(D, E, F, G, H, A, B, C, R(21), 0x4A7484AA);
-	P(C, D, E, F, G, H, A, B, R(22), 0x5CB0A9DC);
-	P(B, C, D, E, F, G, H, A, R(23), 0x76F988DA);
-	P(A, B, C, D, E, F, G, H, R(24), 0x983E5152);
-	P(H, A, B, C, D, E, F, G, R(25), 0xA831C66D);
-	P(G, H, A, B, C, D, E, F, R(26), 0xB00327C8);
-	P(F, G, H, A, B, C, D, E, R(27), 0xBF597FC7);
-	P(E, F, G, H, A, B, C, D, R(28), 0xC6E00BF3);
-	P(D, E, F, G, H, A, B, C, R(29), 0xD5A79147);
-	P(C, D, E, F, G, H, A, B, R(30), 0x06CA6351);
-	P(B, C, D, E, F, G, H, A, R(31), 0x14292967);
-	P(A, B, C, D, E, F, G, H, R(32), 0x27B70A85);
-	P(H, A, B, C, D, E, F, G, R(33), 0x2E1B2138);
-	P(G, H, A, B, C, D, E, F, R(34), 0x4D2C6DFC);
-	P(F, G, H, A, B, C, D, E, R(35), 0x53380D13);
-	P(E, F, G, H, A, B, C, D, R(36), 0x650A7354);
-	P(D, E, F, G, H, A, B, C, R(37), 0x766A0ABB);
-	P(C, D, E, F, G, H, A, B, R(38), 0x81C2C92E);
-	P(B, C, D, E, F, G, H, A, R(39), 0x92722C85);
-	P(A, B, C, D, E, F, G, H, R(40), 0xA2BFE8A1);
-	P(H, A, B, C, D, E, F, G, R(41), 0xA81A664B);
-	P(G, H, A, B, C, D, E, F, R(42), 0xC24B8B70);
-	P(F, G, H, A, B, C, D, E, R(43), 0xC76C51A3);
-	P(E, F, G, H, A, B, C, D, R(44), 0xD192E819);
-	P(D, E, F, G, H, A, B, C, R(45), 0xD6990624);
-	P(C, D, E, F, G, H, A, B, R(46), 0xF40E3585);
-	P(B, C, D, E, F, G, H, A, R(47), 0x106AA070);
-	P(A, B, C, D, E, F, G, H, R(48), 0x19A4C116);
-	P(H, A, B, C, D, E, F, G, R(49), 0x1E376C08);
-	P(G, H, A, B, C, D, E, F, R(50), 0x2748774C);
-	P(F, G, H, A, B, C, D, E, R(51), 0x34B0BCB5);
-	P(E, F, G, H, A, B, C, D, R(52), 0x391C0CB3);
-	P(D, E, F, G, H, A, B, C, R(53), 0x4ED8AA4A);
-	P(C, D, E, F, G, H, A, B, R(54), 0x5B9CCA4F);
-	P(B, C, D, E, F, G, H, A, R(55), 0x682E6FF3);
-	P(A, B, C, D, E, F, G, H, R(56), 0x748F82EE);
-	P(H, A, B, C, D, E, F, G, R(57), 0x78A5636F);
-	P(G, H, A, B, C, D, E, F, R(58), 0x84C87814);
-	P(F, G, H, A, B, C, D, E, R(59), 0x8CC70208);
-	P(E, F, G, H, A, B, C, D, R(60), 0x90BEFFFA);
-	P(D, E, F, G, H, A, B, C, R(61), 0xA4506CEB);
-	P(C, D, E, F, G, H, A, B, R(62), 0xBEF9A3F7);
-	P(B, C, D, E, F, G, H, A, R(63), 0xC67178F2);
-
-	ctx->state[0] += A;
-	ctx->state[1] += B;
-	ctx->state[2] += C;
-	ctx->state[3] += D;
-	ctx->state[4] += E;
-	ctx->state[5] += F;
-	ctx->state[6] += G;
-	ctx->state[7] += H;
+	A = state[0];
+	B = state[1];
+	C = state[2];
+	D = state[3];
+	E = state[4];
+	F = state[5];
+	G = state[6];
+	H = state[7];
+
+	for (; blocks; blocks--, data += 64) {
+		GET_UINT32_BE(W[0], data, 0);
+		GET_UINT32_BE(W[1], data, 4);
+		GET_UINT32_BE(W[2], data, 8);
+		GET_UINT32_BE(W[3], data, 12);
+		GET_UINT32_BE(W[4], data, 16);
+		GET_UINT32_BE(W[5], data, 20);
+		GET_UINT32_BE(W[6], data, 24);
+		GET_UINT32_BE(W[7], data, 28);
+		GET_UINT32_BE(W[8], data, 32);
+		GET_UINT32_BE(W[9], data, 36);
+		GET_UINT32_BE(W[10], data, 40);
+		GET_UINT32_BE(W[11], data, 44);
+		GET_UINT32_BE(W[12], data, 48);
+		GET_UINT32_BE(W[13], data, 52);
+		GET_UINT32_BE(W[14], data, 56);
+		GET_UINT32_BE(W[15], data, 60);
+
+		P(A, B, C, D, E, F, G, H, W[0], 0x428A2F98);
+		P(H, A, B, C, D, E, F, G, W[1], 0x71374491);
+		P(G, H, A, B, C, D, E, F, W[2], 0xB5C0FBCF);
+		P(F, G, H, A, B, C, D, E, W[3], 0xE9B5DBA5);
+		P(E, F, G, H, A, B, C, D, W[4], 0x3956C25B);
+		P(D, E, F, G, H, A, B, C, W[5], 0x59F111F1);
+		P(C, D, E, F, G, H, A, B, W[6], 0x923F82A4);
+		P(B, C, D, E, F, G, H, A, W[7], 0xAB1C5ED5);
+		P(A, B, C, D, E, F, G, H, W[8], 0xD807AA98);
+		P(H, A, B, C, D, E, F, G, W[9], 0x12835B01);
+		P(G, H, A, B, C, D, E, F, W[10], 0x243185BE);
+		P(F, G, H, A, B, C, D, E, W[11], 0x550C7DC3);
+		P(E, F, G, H, A, B, C, D, W[12], 0x72BE5D74);
+		P(D, E, F, G, H, A, B, C, W[13], 0x80DEB1FE);
+		P(C, D, E, F, G, H, A, B, W[14], 0x9BDC06A7);
+		P(B, C, D, E, F, G, H, A, W[15], 0xC19BF174);
+		P(A, B, C, D, E, F, G, H, R(16), 0xE49B69C1);
+		P(H, A, B, C, D, E, F, G, R(17), 0xEFBE4786);
+		P(G, H, A, B, C, D, E, F, R(18), 0x0FC19DC6);
+		P(F, G, H, A, B, C, D, E, R(19), 0x240CA1CC);
+		P(E, F, G, H, A, B, C, D, R(20), 0x2DE92C6F);
+		P(D, E, F, G, H, A, B, C, R(21), 0x4A7484AA);
+		P(C, D, E, F, G, H, A, B, R(22), 0x5CB0A9DC);
+		P(B, C, D, E, F, G, H, A, R(23), 0x76F988DA);
+		P(A, B, C, D, E, F, G, H, R(24), 0x983E5152);
+		P(H, A, B, C, D, E, F, G, R(25), 0xA831C66D);
+		P(G, H, A, B, C, D, E, F, R(26), 0xB00327C8);
+		P(F, G, H, A, B, C, D, E, R(27), 0xBF597FC7);
+		P(E, F, G, H, A, B, C, D, R(28), 0xC6E00BF3);
+		P(D, E, F, G, H, A, B, C, R(29), 0xD5A79147);
+		P(C, D, E, F, G, H, A, B, R(30), 0x06CA6351);
+		P(B, C, D, E, F, G, H, A, R(31), 0x14292967);
+		P(A, B, C, D, E, F, G, H, R(32), 0x27B70A85);
+		P(H, A, B, C, D, E, F, G, R(33), 0x2E1B2138);
+		P(G, H, A, B, C, D, E, F, R(34), 0x4D2C6DFC);
+		P(F, G, H, A, B, C, D, E, R(35), 0x53380D13);
+		P(E, F, G, H, A, B, C, D, R(36), 0x650A7354);
+		P(D, E, F, G, H, A, B, C, R(37), 0x766A0ABB);
+		P(C, D, E, F, G, H, A, B, R(38), 0x81C2C92E);
+		P(B, C, D, E, F, G, H, A, R(39), 0x92722C85);
+		P(A, B, C, D, E, F, G, H, R(40), 0xA2BFE8A1);
+		P(H, A, B, C, D, E, F, G, R(41), 0xA81A664B);
+		P(G, H, A, B, C, D, E, F, R(42), 0xC24B8B70);
+		P(F, G, H, A, B, C, D, E, R(43), 0xC76C51A3);
+		P(E, F, G, H, A, B, C, D, R(44), 0xD192E819);
+		P(D, E, F, G, H, A, B, C, R(45), 0xD6990624);
+		P(C, D, E, F, G, H, A, B, R(46), 0xF40E3585);
+		P(B, C, D, E, F, G, H, A, R(47), 0x106AA070);
+		P(A, B, C, D, E, F, G, H, R(48), 0x19A4C116);
+		P(H, A, B, C, D, E, F, G, R(49), 0x1E376C08);
+		P(G, H, A, B, C, D, E, F, R(50), 0x2748774C);
+		P(F, G, H, A, B, C, D, E, R(51), 0x34B0BCB5);
+		P(E, F, G, H, A, B, C, D, R(52), 0x391C0CB3);
+		P(D, E, F, G, H, A, B, C, R(53), 0x4ED8AA4A);
+		P(C, D, E, F, G, H, A, B, R(54), 0x5B9CCA4F);
+		P(B, C, D, E, F, G, H, A, R(55), 0x682E6FF3);
+		P(A, B, C, D, E, F, G, H, R(56), 0x748F82EE);
+		P(H, A, B, C, D, E, F, G, R(57), 0x78A5636F);
+		P(G, H, A, B, C, D, E, F, R(58), 0x84C87814);
+		P(F, G, H, A, B, C, D, E, R(59), 0x8CC70208);
+		P(E, F, G, H, A, B, C, D, R(60), 0x90BEFFFA);
+		P(D, E, F, G, H, A, B, C, R(61), 0xA4506CEB);
+		P(C, D, E, F, G, H, A, B, R(62), 0xBEF9A3F7);
+		P(B, C, D, E, F, G, H, A, R(63), 0xC67178F2);
+
+		A = state[0] += A;
+		B = state[1] += B;
+		C = state[2] += C;
+		D = state[3] += D;
+		E = state[4] += E;
+		F = state[5] += F;
+		G = state[6] += G;
+		H = state[7] += H;
+	}
 }
 
-void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
+static void sha256_process(uint32_t state[8], const uint8_t *data,
+			   unsigned int blocks)
+{
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+	unsigned int done;
+
+	done = sha256_arch_process(state, data, blocks);
+	data += done * 64;
+	blocks -= done;
+#endif
+	sha256_process_generic(state, data, blocks);
+}
+
+typedef void (*sha256_process_t)(uint32_t state[8], const uint8_t *data,
+				 unsigned int blocks);
+
+static void __sha256_update(sha256_context *ctx, const uint8_t *input,
+			    uint32_t length, sha256_process_t process)
 {
 	uint32_t left, fill;
 
@@ -199,22 +223,27 @@ void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
 
 	if (left && length >= fill) {
 		memcpy((void *) (ctx->buffer + left), (void *) input, fill);
-		sha256_process(ctx, ctx->buffer);
+		process(ctx->state, ctx->buffer, 1);
 		length -= fill;
 		input += fill;
 		left = 0;
 	}
 
-	while (length >= 64) {
-		sha256_process(ctx, input);
-		length -= 64;
-		input += 64;
+	if (length >= 64) {
+		process(ctx->state, input, length / 64);
+		input += length & ~0x3F;
+		length &= 0x3F;
 	}
 
 	if (length)
 		memcpy((void *) (ctx->buffer + left), (void *) input, length);
 }
 
+void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length)
+{
+	__sha256_update(ctx, input, length, sha256_process);
+}
+
 static uint8_t sha256_padding[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -222,7 +251,8 @@ static uint8_t sha256_padding[64] = {
 	   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-void sha256_finish(sha256_context * ctx, uint8_t digest[32])
+static void __sha256_finish(sha256_context *ctx, uint8_t digest[32],
+			    sha256_process_t process)
 {
 	uint32_t last, padn;
 	uint32_t high, low;
@@ -238,8 +268,8 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[32])
 	last = ctx->total[0] & 0x3F;
 	padn = (last < 56) ? (56 - last) : (120 - last);
 
-	sha256_update(ctx, sha256_padding, padn);
-	sha256_update(ctx, msglen, 8);
+	__sha256_update(ctx, sha256_padding, padn, process);
+	__sha256_update(ctx, msglen, 8, process);
 
 	PUT_UINT32_BE(ctx->state[0], digest, 0);
 	PUT_UINT32_BE(ctx->state[1], digest, 4);
@@ -251,12 +281,14 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[32])
 	PUT_UINT32_BE(ctx->state[7], digest, 28);
 }
 
-/*
- * Output = SHA-256( input buffer ). Trigger the watchdog every 'chunk_sz'
- * bytes of input processed.
- */
-void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
-		unsigned char *output, unsigned int chunk_sz)
+void sha256_finish(sha256_context * ctx, uint8_t digest[32])
+{
+	__sha256_finish(ctx, digest, sha256_process);
+}
+
+static void __sha256_csum_wd(const unsigned char *input, unsigned int ilen,
+			     unsigned char *output, unsigned int chunk_sz,
+			     sha256_process_t process)
 {
 	sha256_context ctx;
 #if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
@@ -274,13 +306,33 @@ void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		chunk = end - curr;
 		if (chunk > chunk_sz)
 			chunk = chunk_sz;
-		sha256_update(&ctx, curr, chunk);
+		__sha256_update(&ctx, curr, chunk, process);
 		curr += chunk;
 		WATCHDOG_RESET();
 	}
 #else
-	sha256_update(&ctx, input, ilen);
+	__sha256_update(&ctx, input, ilen, process);
 #endif
 
-	sha256_finish(&ctx, output);
+	__sha256_finish(&ctx, output, process);
 }
+
+/*
+ * Output = SHA-256( input buffer ). Trigger the watchdog every 'chunk_sz'
+ * bytes of input processed.
+ */
+void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
+		unsigned char *output, unsigned int chunk_sz)
+{
+	__sha256_csum_wd(input, ilen, output, chunk_sz, sha256_process);
+}
+
+#if defined(CONFIG_SHA_ARCH) && !defined(USE_HOSTCC)
+/* As sha256_csum_wd(), without the help of the CPU */
+void sha256_csum_wd_generic(const unsigned char *input, unsigned int ilen,
+			    unsigned char *output, unsigned int chunk_sz)
+{
+	__sha256_csum_wd(input, ilen, output, chunk_sz,
+			 sha256_process_generic);
+}
+#endif
@@ -419,12 +419,31 @@ int eth_send(void *packet, int length)
 	return eth_current->send(eth_current, packet, length);
 }
 
+/*
+ * Poll the current device. A driver with recv_batch hands up to PKTBUFSRX
+ * packets at once, which are all processed before NetLoop() goes back to
+ * checking for timeouts and ctrl-C. Returns the number of packets then.
+ */
 int eth_rx(void)
 {
-	if (!eth_current)
+	struct eth_device *dev = eth_current;
+	struct eth_rx_desc desc[PKTBUFSRX];
+	int count, i;
+
+	if (!dev)
 		return -1;
 
-	return eth_current->recv(eth_current);
+	if (!dev->recv_batch)
+		return dev->recv(dev);
+
+	count = dev->recv_batch(dev, desc, PKTBUFSRX);
+	for (i = 0; i < count; i++) {
+		NetReceive(desc[i].packet, desc[i].length);
+		if (dev->free_pkt)
+			dev->free_pkt(dev, &desc[i]);
+	}
+
+	return count;
 }
 
 #ifdef CONFIG_API
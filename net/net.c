@@ -473,8 +473,9 @@ restart:
 		show_activity(1);
 #endif
 		/*
-		 *	Check the ethernet for a new packet.  The ethernet
-		 *	receive routine will process it.
+		 *	Check the ethernet for new packets.  The ethernet
+		 *	receive routine will process them, a whole batch at
+		 *	a time if the driver supports it.
 		 */
 		eth_rx();
 
@@ -8,7 +8,9 @@
 
 #include <common.h>
 #include <command.h>
+#include <image.h>
 #include <net.h>
+#include <asm/io.h>
 #include "tftp.h"
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
@@ -130,6 +132,23 @@ static char tftp_filename[MAX_LEN];
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * Number of blocks the server may send before waiting for an ACK
+ * (RFC 7440). A window of 1 is the classic lock-step protocol.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+/* block number at which the current window ends and we must ACK */
+static unsigned short TftpNextAck;
+/* last block we re-acknowledged after a gap, to ACK only once per gap */
+static int TftpLastNack;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -184,7 +203,11 @@ store_block(int block, uchar *src, unsigned len)
 	} else
 #endif /* CONFIG_SYS_DIRECT_FLASH_TFTP */
 	{
-		(void)memcpy((void *)(load_addr + offset), src, len);
+		void *ptr = map_sysmem(load_addr + offset, len);
+
+		memcpy(ptr, src, len);
+		unmap_sysmem(ptr);
+		image_stream_write(offset, len);
 	}
 #ifdef CONFIG_MCAST_TFTP
 	if (Multicast)
@@ -201,6 +224,7 @@ static void new_transfer(void)
 	TftpLastBlock = 0;
 	TftpBlockWrap = 0;
 	TftpBlockWrapOffset = 0;
+	TftpLastNack = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	TftpFinalBlock = 0;
 #endif
@@ -221,8 +245,12 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 	ulong offset = ((int)block - 1) * len + TftpBlockWrapOffset;
 	ulong tosend = len;
 
+	void *ptr;
+
 	tosend = min(NetBootFileXferSize - offset, tosend);
-	(void)memcpy(dst, (void *)(save_addr + offset), tosend);
+	ptr = map_sysmem(save_addr + offset, tosend);
+	memcpy(dst, ptr, tosend);
+	unmap_sysmem(ptr);
 	debug("%s: block=%d, offset=%ld, len=%d, tosend=%ld\n", __func__,
 		block, offset, len, tosend);
 	return tosend;
@@ -232,6 +260,29 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 static void TftpSend(void);
 static void TftpTimeout(void);
 
+/*
+ * Check whether the DATA block just received is the one following the last
+ * block we stored. Multicast transfers fill in blocks in any order.
+ */
+static int is_next_block(void)
+{
+#ifdef CONFIG_MCAST_TFTP
+	if (Multicast)
+		return 1;
+#endif
+	return TftpBlock == ((TftpLastBlock + 1) & (TFTP_SEQUENCE_SIZE - 1));
+}
+
+/* Check whether the block just stored has to be acknowledged */
+static int need_ack(unsigned len)
+{
+#ifdef CONFIG_MCAST_TFTP
+	if (Multicast)
+		return 1;
+#endif
+	return TftpBlock == TftpNextAck || len < TftpBlkSize;
+}
+
 /**********************************************************************/
 
 static void show_block_marker(void)
@@ -307,6 +358,10 @@ static void tftp_complete(void)
 			time_start * 1000, "/s");
 	}
 	puts("\ndone\n");
+#ifdef CONFIG_CMD_TFTPPUT
+	if (!TftpWriting)
+#endif
+		image_stream_end(NetBootFileXferSize);
 	net_set_state(NETLOOP_SUCCESS);
 }
 
@@ -359,6 +414,10 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		/* ask for several blocks per ACK */
+		if (TftpWindowSizeOption > 1 && !TftpWriting)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast) {
@@ -390,6 +449,8 @@ TftpSend(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(TftpBlock);
 		pkt = (uchar *)(s + 2);
+		/* the server sends the next window after this ACK */
+		TftpNextAck = TftpBlock + TftpWindowSize;
 #ifdef CONFIG_CMD_TFTPPUT
 		if (TftpWriting) {
 			int toload = TftpBlkSize;
@@ -528,6 +589,16 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				debug("Blocksize ack: %s, %d\n",
 					(char *)pkt+i+8, TftpBlkSize);
 			}
+			if (strcmp((char *)pkt+i, "windowsize") == 0) {
+				ulong ws = simple_strtoul((char *)pkt+i+11,
+							  NULL, 10);
+
+				/* the server may only lower our request */
+				if (ws >= 1 && ws <= TftpWindowSizeOption)
+					TftpWindowSize = ws;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt+i+11, TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				TftpTsize = simple_strtoul((char *)pkt+i+6,
@@ -558,11 +629,20 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		len -= 2;
 		TftpBlock = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (TftpState == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
+		if (TftpState == STATE_OACK && TftpWindowSize > 1 &&
+		    TftpBlock != 1) {
+			/* Block 1 was lost, ask for the first window again */
+			TftpBlock = 0;
+			if (TftpLastNack != 0) {
+				TftpLastNack = 0;
+				TftpSend();
+			}
+			break;
+		}
+
 		if (TftpState == STATE_SEND_RRQ || TftpState == STATE_OACK ||
 		    TftpState == STATE_RECV_WRQ) {
 			/* first block received */
@@ -592,7 +672,24 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			break;
 		}
 
+		if (!is_next_block()) {
+			/*
+			 * A block went missing inside the window. Drop the
+			 * rest of the window and ACK the last block we have
+			 * once, so that the server resends from there.
+			 */
+			TftpBlock = TftpLastBlock;
+			if (TftpWindowSize > 1 && TftpLastNack != TftpBlock) {
+				TftpLastNack = TftpBlock;
+				TftpSend();
+			}
+			break;
+		}
+
+		update_block_number();
 		TftpLastBlock = TftpBlock;
+		/* Only give up after that many timeouts in a row */
+		TftpTimeoutCount = 0;
 		TftpTimeoutCountMax = TIMEOUT_COUNT;
 		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
@@ -600,7 +697,8 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	the remote for the next one. With a window, only the
+		 *	last block of the window and the final block are acked.
 		 */
 #ifdef CONFIG_MCAST_TFTP
 		/* if I am the MasterClient, actively calculate what my next
@@ -627,7 +725,8 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			}
 		}
 #endif
-		TftpSend();
+		if (need_ack(len))
+			TftpSend();
 
 #ifdef CONFIG_MCAST_TFTP
 		if (Multicast) {
@@ -701,6 +800,12 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtoul(ep, NULL, 10);
+	if (TftpWindowSizeOption < 1)
+		TftpWindowSizeOption = 1;
+
 	if (TftpTimeoutMSecs < 1000) {
 		printf("TFTP timeout (%ld ms) too low, "
 			"set minimum = 1000 ms\n",
@@ -708,8 +813,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -780,6 +885,7 @@ void TftpStart(enum proto_t protocol)
 		printf("Load address: 0x%lx\n", load_addr);
 		puts("Loading: *\b");
 		TftpState = STATE_SEND_RRQ;
+		image_stream_start(load_addr);
 	}
 
 	time_start = get_timer(0);
@@ -804,11 +910,14 @@ void TftpStart(enum proto_t protocol)
 		TftpOurPort = simple_strtol(ep, NULL, 10);
 #endif
 	TftpBlock = 0;
+	TftpNextAck = 1;
+	TftpLastNack = -1;
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -837,8 +946,9 @@ TftpStartServer(void)
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
 	TftpOurPort = WELL_KNOWN_PORT;
 
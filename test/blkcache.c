@@ -0,0 +1,160 @@
+/*
+ * Test of the generic block cache, driven through the sandbox host block
+ * device
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <os.h>
+#include <part.h>
+#include <sandboxblockdev.h>
+
+#define TEST_FILE	"/tmp/u-boot-blkcache-test.img"
+#define TEST_DEV	0
+#define TEST_BLOCKS	64
+#define BLKSZ		512
+
+#define errcheck(statement) if (!(statement)) { \
+	fprintf(stderr, "\tFailed: %s\n", #statement); \
+	ret = 1; \
+	goto out; \
+}
+
+/* Each block of the backing file is filled with its own block number */
+static int create_image(void)
+{
+	char block[BLKSZ];
+	int fd, i;
+
+	fd = os_open(TEST_FILE, OS_O_RDWR | OS_O_CREAT);
+	if (fd < 0)
+		return -1;
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		memset(block, i, BLKSZ);
+		if (os_write(fd, block, BLKSZ) != BLKSZ) {
+			os_close(fd);
+			return -1;
+		}
+	}
+	os_close(fd);
+
+	return 0;
+}
+
+/* Change a block behind the back of the cache */
+static int poke_image(int blk, int val)
+{
+	char block[BLKSZ];
+	int fd, ret = 0;
+
+	fd = os_open(TEST_FILE, OS_O_RDWR);
+	if (fd < 0)
+		return -1;
+	memset(block, val, BLKSZ);
+	if (os_lseek(fd, blk * BLKSZ, OS_SEEK_SET) == -1 ||
+	    os_write(fd, block, BLKSZ) != BLKSZ)
+		ret = -1;
+	os_close(fd);
+
+	return ret;
+}
+
+static int check_block(const char *buf, int val)
+{
+	int i;
+
+	for (i = 0; i < BLKSZ; i++) {
+		if ((unsigned char)buf[i] != (unsigned char)val)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int do_ut_blkcache(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	struct block_cache_stats stats, saved;
+	block_dev_desc_t *dev_desc;
+	char *buf = NULL;
+	int ret = 0, i;
+
+	printf("%s: Testing block cache\n", __func__);
+	blkcache_stats(&saved);
+	blkcache_configure(4, 4);
+
+	errcheck(create_image() == 0);
+	errcheck(host_dev_bind(TEST_DEV, TEST_FILE) == 0);
+	dev_desc = host_get_dev(TEST_DEV);
+	errcheck(dev_desc != NULL);
+	buf = malloc(8 * BLKSZ);
+	errcheck(buf != NULL);
+
+	/* First read misses, sub-ranges of it hit */
+	errcheck(blk_dread(dev_desc, 10, 2, buf) == 2);
+	errcheck(check_block(buf, 10) && check_block(buf + BLKSZ, 11));
+	errcheck(blk_dread(dev_desc, 11, 1, buf) == 1);
+	errcheck(check_block(buf, 11));
+	errcheck(blk_dread(dev_desc, 10, 2, buf) == 2);
+	blkcache_stats(&stats);
+	errcheck(stats.misses == 1 && stats.hits == 2 && stats.entries == 1);
+
+	/* A hit must not reach the device */
+	errcheck(poke_image(10, 0xaa) == 0);
+	errcheck(blk_dread(dev_desc, 10, 1, buf) == 1);
+	errcheck(check_block(buf, 10));
+
+	/* Writes go to the device and update the cached copy */
+	memset(buf, 0xbb, BLKSZ);
+	errcheck(blk_dwrite(dev_desc, 11, 1, buf) == 1);
+	errcheck(blk_dread(dev_desc, 11, 1, buf) == 1);
+	errcheck(check_block(buf, 0xbb));
+	errcheck(dev_desc->block_read(dev_desc->dev, 11, 1, buf) == 1);
+	errcheck(check_block(buf, 0xbb));
+
+	/* Large reads bypass the cache */
+	errcheck(blk_dread(dev_desc, 32, 8, buf) == 8);
+	for (i = 0; i < 8; i++)
+		errcheck(check_block(buf + i * BLKSZ, 32 + i));
+	blkcache_stats(&stats);
+	errcheck(stats.bypass == 1 && stats.entries == 1);
+
+	/* Four more entries push the least recently used one out */
+	for (i = 0; i < 4; i++)
+		errcheck(blk_dread(dev_desc, 20 + i * 4, 4, buf) == 4);
+	blkcache_stats(&stats);
+	errcheck(stats.entries == 4);
+	errcheck(blk_dread(dev_desc, 10, 1, buf) == 1);
+	errcheck(check_block(buf, 0xaa));
+	errcheck(blk_dread(dev_desc, 24, 1, buf) == 1);
+	errcheck(check_block(buf, 24));
+
+	/* Invalidation drops everything cached for the device */
+	errcheck(poke_image(24, 0xcc) == 0);
+	blkcache_invalidate(dev_desc->if_type, dev_desc->dev);
+	blkcache_stats(&stats);
+	errcheck(stats.entries == 0);
+	errcheck(blk_dread(dev_desc, 24, 1, buf) == 1);
+	errcheck(check_block(buf, 0xcc));
+
+	blkcache_stats(&stats);
+	printf("\thits %u misses %u bypassed %u\n", stats.hits, stats.misses,
+	       stats.bypass);
+
+out:
+	free(buf);
+	host_dev_bind(TEST_DEV, NULL);
+	os_unlink(TEST_FILE);
+	blkcache_configure(saved.max_blocks_per_entry, saved.max_entries);
+	printf("%s: %s\n", __func__, ret == 0 ? "ok" : "FAILED");
+
+	return ret;
+}
+
+U_BOOT_CMD(
+	ut_blkcache,	5,	1,	do_ut_blkcache,
+	"Test the block cache using the sandbox host block device", ""
+);
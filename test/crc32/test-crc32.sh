@@ -0,0 +1,66 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Test and benchmark of the CRC32 algorithms using sandbox
+#
+# Runs 'crc32 bench', which checks that each algorithm built in agrees with
+# the others and shows how fast each one is, then checks the crc32 command
+# against gzip on random data at each alignment and a range of lengths.
+#
+# Usage: test-crc32.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+echo "CRC32 test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+./${OUTPUT_DIR}/u-boot -c "crc32 bench" >${tmpdir}/out 2>&1 ||
+	fail "crc32 bench"
+grep -q mismatch ${tmpdir}/out && fail "algorithms disagree"
+sed -n '/^Algorithm/,$p' ${tmpdir}/out
+echo
+
+head -c 70000 /dev/urandom >${tmpdir}/data
+cmds="load hostfs - 1000000 ${tmpdir}/data"
+expect=
+for ofs in 0 1 2 3 4 5 6 7; do
+	for len in 1 7 15 63 64 65 255 4096 65537; do
+		tail -c +$((ofs + 1)) ${tmpdir}/data | head -c ${len} \
+			>${tmpdir}/part
+		crc=$(gzip -c ${tmpdir}/part | tail -c8 | od -An -tx4 -N4 |
+			tr -d ' ')
+		expect="${expect} ${crc}"
+		cmds="${cmds}
+crc32 $(printf "%x %x" $((0x1000000 + ofs)) ${len})"
+	done
+done
+./${OUTPUT_DIR}/u-boot -c "${cmds}" >${tmpdir}/out 2>&1
+got=$(awk '/==>/ { printf " %s", $NF }' ${tmpdir}/out)
+[ "${got}" = "${expect}" ] || fail "crc mismatch:${got} !=${expect}"
+
+cleanup
+echo "Test passed"
@@ -0,0 +1,171 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test of ext4write using the sandbox host block device
+#
+# Writes a small file to a small and to a large ext4 image and checks that
+# the number of device reads, as counted by the block cache, does not grow
+# with the size of the filesystem. Then overwrites the file, which frees
+# its blocks first, and writes a 20MiB file, which spans several block
+# groups with 1KiB blocks. The files are compared with what debugfs reads
+# back and e2fsck must find the filesystem clean. Done for 1KiB and 4KiB
+# blocks.
+#
+# Files get extent trees. The 20MiB file must be written in at most four
+# extents, one per block group it spans. A file written to free space cut
+# into 4KiB holes needs a tree of index and leaf blocks, which must be
+# freed when the file is overwritten. Writing a file as large as the free
+# space there must fail, as it leaves no block for the tree, and leave the
+# filesystem clean. A filesystem without the extent feature still gets
+# block maps.
+#
+# Needs mkfs.ext4, debugfs, dumpe2fs and e2fsck from e2fsprogs.
+#
+# Usage: test-ext4-write.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# make_image <block size> <size> [<features>]
+make_image() {
+	rm -f ${tmpdir}/img
+	truncate -s $2 ${tmpdir}/img || fail "sparse file"
+	mkfs.ext4 -q -F -b $1 -O ^metadata_csum,^64bit,^flex_bg,uninit_bg$3 \
+		${tmpdir}/img || fail "mkfs.ext4"
+}
+
+# write_file <host file> <name>
+write_file() {
+	./${OUTPUT_DIR}/u-boot -c "sb bind 0 ${tmpdir}/img
+load hostfs - 1000000 ${tmpdir}/$1
+blkcache configure 8 32
+ext4write host 0:0 1000000 /$2 \${filesize}
+blkcache show" >${tmpdir}/out 2>&1
+	grep -q "Error" ${tmpdir}/out && fail "ext4write $2"
+	reads=$(awk '/misses:|bypassed:/ { n += $2 } END { print n }' \
+		${tmpdir}/out)
+}
+
+# check_file <host file> <name>
+check_file() {
+	rm -f ${tmpdir}/dump
+	debugfs -R "dump /$2 ${tmpdir}/dump" ${tmpdir}/img >/dev/null 2>&1
+	cmp -s ${tmpdir}/$1 ${tmpdir}/dump || fail "$2 data"
+}
+
+# Print the block map of a file as shown by debugfs
+get_blocks() {
+	debugfs -R "stat /$1" ${tmpdir}/img 2>/dev/null |
+		sed -n '/^EXTENTS:\|^BLOCKS:/,$p'
+}
+
+check_fs() {
+	e2fsck -fn ${tmpdir}/img >${tmpdir}/fsck 2>&1 ||
+		fail "e2fsck: $(grep -v '^Pass\|^e2fsck' ${tmpdir}/fsck |
+			head -3)"
+}
+
+# check_blksz <block size> <small image size> <large image size>
+check_blksz() {
+	make_image $1 $2
+	write_file small small.bin
+	small_reads=${reads}
+
+	make_image $1 $3
+	write_file small small.bin
+	check_file small small.bin
+	check_fs
+	echo "$1-byte blocks: ${small_reads} device reads on $2," \
+		"${reads} on $3"
+	[ ${reads} -le $((small_reads + 8)) ] ||
+		fail "reads grow with the filesystem size"
+
+	write_file other small.bin
+	check_file other small.bin
+	check_fs
+
+	write_file big big.bin
+	check_file big big.bin
+	check_file other small.bin
+	check_fs
+	extents=$(get_blocks big.bin | grep -o '([0-9-]*)' | wc -l)
+	echo "$1-byte blocks: 20MiB file in ${extents} extents"
+	[ ${extents} -le 4 ] || fail "big.bin is not contiguous"
+}
+
+# Write to free space in 4KiB holes, left by punching a filler file
+check_fragmented() {
+	make_image 1024 16M
+	head -c 12000000 /dev/urandom >${tmpdir}/filler
+	(echo "write ${tmpdir}/filler filler"
+	for i in $(seq 0 8 11700); do
+		echo "punch filler $i $((i + 3))"
+	done) | debugfs -w ${tmpdir}/img >/dev/null 2>&1 || fail "debugfs"
+
+	write_file mid mid.bin
+	check_file mid mid.bin
+	check_fs
+	get_blocks mid.bin | grep -q "(ETB1)" || fail "no extent tree"
+
+	write_file other mid.bin
+	check_file other mid.bin
+	check_fs
+	get_blocks mid.bin | grep -q "(ETB" && fail "extent tree not freed"
+
+	# Data for every free block leaves none for the tree
+	free=$(dumpe2fs -h ${tmpdir}/img 2>/dev/null |
+		sed -n 's/^Free blocks: *//p')
+	head -c $((free * 1024)) /dev/urandom >${tmpdir}/full
+	./${OUTPUT_DIR}/u-boot -c "sb bind 0 ${tmpdir}/img
+load hostfs - 1000000 ${tmpdir}/full
+ext4write host 0:0 1000000 /full.bin \${filesize}" >${tmpdir}/out 2>&1
+	grep -q "Error" ${tmpdir}/out || fail "full filesystem written"
+	check_fs
+	echo "fragmented: OK"
+}
+
+check_no_extents() {
+	make_image 1024 64M ,^extent
+	write_file big big.bin
+	check_file big big.bin
+	check_fs
+	get_blocks big.bin | grep -q "^BLOCKS:" || fail "no block map"
+	echo "no extents: OK"
+}
+
+echo "ext4 write test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+head -c 5000 /dev/urandom >${tmpdir}/small
+head -c 9000 /dev/urandom >${tmpdir}/other
+head -c $((20 * 1024 * 1024)) /dev/urandom >${tmpdir}/big
+head -c 3000000 /dev/urandom >${tmpdir}/mid
+
+check_blksz 1024 64M 4G
+check_blksz 4096 256M 64G
+check_fragmented
+check_no_extents
+
+cleanup
+echo "Test passed"
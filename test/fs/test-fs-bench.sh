@@ -0,0 +1,125 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Filesystem read benchmark using the sandbox host block device
+#
+# Creates filesystem images holding a large file laid out both contiguously
+# and fragmented (interleaved with deleted files), loads the file with
+# sandbox U-Boot and reports the load time and the number of device reads
+# as counted by the block cache. The loaded data is checked against the
+# original with crc32.
+#
+# Needs mkfs.ext4 and debugfs from e2fsprogs, mkfs.vfat and mtools.
+#
+# Usage: test-fs-bench.sh [size_in_MB]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+SIZE_MB=${1:-30}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# Fill a directory with 64KiB files to fragment the free space later
+make_fillers() {
+	mkdir -p $1
+	for i in $(seq 0 $2); do
+		head -c 65536 /dev/urandom >$1/f$i
+	done
+}
+
+make_ext4_images() {
+	echo "Create ext4 images"
+	mkdir ${tmpdir}/contig
+	cp ${tmpdir}/big.bin ${tmpdir}/contig/
+	mkfs.ext4 -q -F -b 4096 -d ${tmpdir}/contig ${tmpdir}/ext4-contig.img \
+		$((SIZE_MB * 2 + 16))M || fail "mkfs.ext4"
+
+	# Free every other filler so that big.bin is written in small extents
+	make_fillers ${tmpdir}/frag $((SIZE_MB * 8))
+	mkfs.ext4 -q -F -b 4096 -d ${tmpdir}/frag ${tmpdir}/ext4-frag.img \
+		$((SIZE_MB * 2 + 16))M || fail "mkfs.ext4"
+	(for i in $(seq 1 2 $((SIZE_MB * 8))); do
+		echo "rm f$i"
+	done
+	echo "write ${tmpdir}/big.bin big.bin") |
+		debugfs -w ${tmpdir}/ext4-frag.img >/dev/null 2>&1 ||
+		fail "debugfs"
+}
+
+make_fat_images() {
+	echo "Create FAT images"
+	mkfs.vfat -C -F 32 ${tmpdir}/fat-contig.img \
+		$(((SIZE_MB * 2 + 16) * 1024)) >/dev/null || fail "mkfs.vfat"
+	mcopy -i ${tmpdir}/fat-contig.img ${tmpdir}/big.bin :: ||
+		fail "mcopy"
+
+	# Same trick as for ext4: big.bin ends up in the holes
+	mkfs.vfat -C -F 32 ${tmpdir}/fat-frag.img \
+		$(((SIZE_MB * 2 + 16) * 1024)) >/dev/null || fail "mkfs.vfat"
+	mcopy -i ${tmpdir}/fat-frag.img ${tmpdir}/frag/* :: || fail "mcopy"
+	for i in $(seq 1 2 $((SIZE_MB * 8))); do
+		echo ::f$i
+	done | xargs mdel -i ${tmpdir}/fat-frag.img || fail "mdel"
+	mcopy -i ${tmpdir}/fat-frag.img ${tmpdir}/big.bin :: ||
+		fail "mcopy"
+}
+
+# run_load <fstype> <image> [<label> <setup command>]
+#
+# The load address is offset so that the buffer is cache aligned in the
+# sandbox RAM mapping; FAT falls back to sector-by-sector reads otherwise.
+run_load() {
+	./${OUTPUT_DIR}/u-boot -c "sb bind 0 $2
+$4
+blkcache configure 8 32
+$1load host 0:0 1000038 big.bin
+crc32 1000038 \${filesize}
+blkcache show" >${tmpdir}/out 2>&1
+
+	grep -q "==> ${crc}" ${tmpdir}/out || fail "$1 crc mismatch on $2"
+	reads=$(awk '/misses:|bypassed:/ { n += $2 } END { print n }' \
+		${tmpdir}/out)
+	printf "%-8s %-22s %s, %d device reads\n" $1 \
+		$(basename $2 .img)$3 "$(grep "bytes read" ${tmpdir}/out)" \
+		${reads}
+}
+
+echo "Filesystem read benchmark using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+head -c $((SIZE_MB * 1000000)) /dev/urandom >${tmpdir}/big.bin
+crc=$(gzip -c ${tmpdir}/big.bin | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+
+make_ext4_images
+run_load ext4 ${tmpdir}/ext4-contig.img
+run_load ext4 ${tmpdir}/ext4-frag.img
+
+make_fat_images
+for img in fat-contig fat-frag; do
+	run_load fat ${tmpdir}/${img}.img
+	run_load fat ${tmpdir}/${img}.img "(noprefetch)" \
+		"setenv fatprefetch no"
+done
+
+cleanup
+echo "Test passed"
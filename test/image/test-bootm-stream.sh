@@ -0,0 +1,110 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Benchmark of decompressing a kernel while it loads
+#
+# Builds gzip and LZMA compressed legacy kernel images, loads them over the
+# sandbox Ethernet driver's emulated TFTP server (a 100 Mbit/s link with a
+# 1ms round trip time) and from the host filesystem, and runs bootm up to
+# loading the OS. This is done with bootm_stream set, so that the image is
+# decompressed and verified while it loads, and without, so that bootm does
+# it afterwards. The kernel is checked with crc32 and the time spent
+# loading and in bootm is reported for each.
+#
+# Usage: test-bootm-stream.sh [size_in_MB]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+SIZE_MB=${1:-8}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+# run_boot <load command> <image> <stream> [<sandbox options>]
+run_boot() {
+	./${OUTPUT_DIR}/u-boot $4 -c "
+setenv bootm_stream $3
+setenv tftpwindowsize 16
+time $1 1000000 $2
+time bootm start 1000000
+time bootm loados
+crc32 4000000 ${size_hex}" >${tmpdir}/out 2>&1
+
+	grep -q "==> ${crc}" ${tmpdir}/out ||
+		fail "crc mismatch: $1 $2, bootm_stream $3"
+	if [ "$3" = "yes" ]; then
+		grep -q "unpacked while loading" ${tmpdir}/out ||
+			fail "not streamed: $1 $2"
+	fi
+	load=$(get_time 1)
+	bootm=$(($(get_time 2) + $(get_time 3)))
+	printf "%-14s %-10s stream %-3s load %4d ms, bootm %4d ms, " \
+		"$1" $(basename $2) $3 ${load} ${bootm}
+	printf "total %4d ms\n" $((load + bootm))
+}
+
+echo "Streaming bootm benchmark using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+# Something that compresses like a kernel: copies of U-Boot itself
+while [ $(stat -c %s ${tmpdir}/kernel 2>/dev/null || echo 0) -lt \
+		$((SIZE_MB * 1000000)) ]; do
+	cat ${OUTPUT_DIR}/u-boot >>${tmpdir}/kernel
+done
+truncate -s $((SIZE_MB * 1000000)) ${tmpdir}/kernel
+size_hex=$(printf "%x" $((SIZE_MB * 1000000)))
+crc=$(gzip -c ${tmpdir}/kernel | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+
+gzip -9 -c ${tmpdir}/kernel >${tmpdir}/kernel.gzip
+lzma -c ${tmpdir}/kernel >${tmpdir}/kernel.lzma
+for comp in gzip lzma; do
+	./${OUTPUT_DIR}/tools/mkimage -A sandbox -O linux -T kernel -C ${comp} \
+		-a 4000000 -e 4000000 -d ${tmpdir}/kernel.${comp} \
+		${tmpdir}/${comp}.img >/dev/null || fail "mkimage ${comp}"
+done
+
+for comp in gzip lzma; do
+	for stream in no yes; do
+		run_boot tftp ${comp}.img ${stream} \
+			"--eth loop:${tmpdir}:1000:0:100"
+		run_boot "load hostfs -" ${tmpdir}/${comp}.img ${stream}
+	done
+done
+
+# A corrupt image is left to bootm, which must reject it
+cp ${tmpdir}/gzip.img ${tmpdir}/bad.img
+printf 'x' | dd of=${tmpdir}/bad.img bs=1 seek=1000 conv=notrunc 2>/dev/null
+./${OUTPUT_DIR}/u-boot --eth loop:${tmpdir} -c "
+setenv bootm_stream yes
+tftp 1000000 bad.img
+bootm start 1000000" >${tmpdir}/out 2>&1
+grep -q "Bad Data CRC" ${tmpdir}/out || fail "corrupt image accepted"
+
+cleanup
+echo "Test passed"
@@ -0,0 +1,148 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Test and benchmark of verifying FIT images on the way to their load address
+#
+# Builds a FIT with a gzip compressed kernel and a ramdisk, each with crc32,
+# sha1 and sha256 hashes, and runs bootm up to loading the OS with
+# fit_verify_copy set to "no", so that each hash reads the data in turn and
+# bootm then decompresses the kernel, and to "yes", so that this is all done
+# on one pass. The kernel is checked with crc32, the time spent in bootm is
+# reported for each, and a FIT with a corrupt kernel must be rejected.
+#
+# Needs dtc to be in the path.
+#
+# Usage: test-fit-verify.sh [size_in_MB]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+SIZE_MB=${1:-8}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+# run_boot <fit_verify_copy>
+run_boot() {
+	./${OUTPUT_DIR}/u-boot -c "
+setenv fit_verify_copy $1
+load hostfs - 1000000 ${tmpdir}/test.fit
+time bootm start 1000000
+time bootm loados
+crc32 4000000 ${size_hex}
+bootstage report" >${tmpdir}/out 2>&1
+
+	grep -q "==> ${crc}" ${tmpdir}/out ||
+		fail "crc mismatch: fit_verify_copy $1"
+	if [ "$1" = "yes" ]; then
+		grep -q "loaded while verifying" ${tmpdir}/out ||
+			fail "not loaded while verifying"
+	fi
+	bootm=$(($(get_time 1) + $(get_time 2)))
+	printf "fit_verify_copy %-3s bootm %4d ms" $1 ${bootm}
+	awk '/verify_/ { gsub(",", "", $1); printf ", %s %d us", $2, $1 }' \
+		${tmpdir}/out
+	echo
+}
+
+echo "FIT verify and copy test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+# Something that compresses like a kernel: copies of U-Boot itself
+while [ $(stat -c %s ${tmpdir}/kernel 2>/dev/null || echo 0) -lt \
+		$((SIZE_MB * 1000000)) ]; do
+	cat ${OUTPUT_DIR}/u-boot >>${tmpdir}/kernel
+done
+truncate -s $((SIZE_MB * 1000000)) ${tmpdir}/kernel
+size_hex=$(printf "%x" $((SIZE_MB * 1000000)))
+crc=$(gzip -c ${tmpdir}/kernel | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+gzip -9 -c ${tmpdir}/kernel >${tmpdir}/kernel.gz
+head -c $((SIZE_MB * 500000)) ${tmpdir}/kernel >${tmpdir}/ramdisk
+
+hashes='
+			hash@1 {
+				algo = "crc32";
+			};
+			hash@2 {
+				algo = "sha1";
+			};
+			hash@3 {
+				algo = "sha256";
+			};'
+
+cat >${tmpdir}/test.its <<EOF
+/dts-v1/;
+
+/ {
+	description = "FIT verify test";
+	#address-cells = <1>;
+
+	images {
+		kernel@1 {
+			data = /incbin/("${tmpdir}/kernel.gz");
+			type = "kernel";
+			arch = "sandbox";
+			os = "linux";
+			compression = "gzip";
+			load = <0x4000000>;
+			entry = <0x4000000>;${hashes}
+		};
+		ramdisk@1 {
+			data = /incbin/("${tmpdir}/ramdisk");
+			type = "ramdisk";
+			arch = "sandbox";
+			os = "linux";
+			compression = "none";${hashes}
+		};
+	};
+	configurations {
+		default = "conf@1";
+		conf@1 {
+			kernel = "kernel@1";
+			ramdisk = "ramdisk@1";
+		};
+	};
+};
+EOF
+./${OUTPUT_DIR}/tools/mkimage -f ${tmpdir}/test.its ${tmpdir}/test.fit \
+	>/dev/null || fail "mkimage"
+
+for copy in no yes; do
+	run_boot ${copy}
+done
+
+# A corrupt kernel must still be rejected
+printf 'x' | dd of=${tmpdir}/test.fit bs=1 seek=100000 conv=notrunc \
+	2>/dev/null
+./${OUTPUT_DIR}/u-boot -c "
+load hostfs - 1000000 ${tmpdir}/test.fit
+bootm start 1000000" >${tmpdir}/out 2>&1
+grep -q "Bad hash value" ${tmpdir}/out || fail "corrupt image accepted"
+
+cleanup
+echo "Test passed"
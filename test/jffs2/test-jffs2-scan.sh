@@ -0,0 +1,153 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of the JFFS2 scan
+#
+# Makes a JFFS2 image holding random data, the sandbox U-Boot binary, a
+# directory of small files and a symbolic link, once without erase block
+# summaries and once with them, and writes each to a simulated NAND chip
+# with typical timings. Each file must load correctly, the scan must be
+# faster with summaries, and a second command must use the cached scan
+# unless the partition has been written with another image in between.
+#
+# Needs mkfs.jffs2 and sumtool from mtd-utils.
+#
+# Usage: test-jffs2-scan.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+# 128MiB chip with 2KiB pages and 128KiB blocks, 32MiB partition
+GEOM=128M:2K:64:128K
+ERASE_SIZE=0x20000
+PART_SIZE=0x2000000
+
+# 25us page read, 250us program, 2ms erase and a 40MB/s bus
+TIMING=25:250:2000:25
+
+# Small files in the directory
+FILES=200
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_jffs2 <commands>
+run_jffs2() {
+	./${OUTPUT_DIR}/u-boot --nand ${GEOM}:${tmpdir}/nand.bin \
+		--nand_timing ${TIMING} -c "
+setenv mtdids nand0=nand0
+setenv mtdparts mtdparts=nand0:$(printf "%#x" $((PART_SIZE)))(jffs2)
+$1" >${tmpdir}/out 2>&1
+}
+
+# Write an image to the partition
+# write_image <image>
+write_image() {
+	echo "
+load hostfs - 1000000 $1
+nand erase 0 $(printf "%x" $((PART_SIZE)))
+nand write 1000000 0 \${filesize}"
+}
+
+crc_of() {
+	gzip -c $1 | tail -c8 | od -An -tx4 -N4 | tr -d ' '
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+# Scan, then load every file, the last two with the cached scan
+load_all="
+time fsinfo
+fsload 3000000 rand
+crc32 3000000 \${filesize}
+fsload 3000000 boot/u-boot
+crc32 3000000 \${filesize}
+fsload 3000000 link
+crc32 3000000 \${filesize}
+fsls etc
+time fsload 3000000 etc/f$((FILES / 2))
+crc32 3000000 \${filesize}"
+
+# check_load <name>
+check_load() {
+	grep -q "==> ${crc_rand}" ${tmpdir}/out || fail "$1: random data"
+	[ $(grep -c "==> ${crc_uboot}" ${tmpdir}/out) = 2 ] ||
+		fail "$1: u-boot or link"
+	grep -q "==> ${crc_small}" ${tmpdir}/out || fail "$1: small file"
+	[ $(tr -d '\r' <${tmpdir}/out | grep -c " f[0-9]*$") = ${FILES} ] ||
+		fail "$1: directory"
+	[ $(grep -c "^Scanning JFFS2" ${tmpdir}/out) = 1 ] ||
+		fail "$1: scan not cached"
+}
+
+echo "JFFS2 scan test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+mkdir -p ${tmpdir}/root/boot ${tmpdir}/root/etc ${tmpdir}/other
+head -c 2000000 /dev/urandom >${tmpdir}/root/rand
+cp ${OUTPUT_DIR}/u-boot ${tmpdir}/root/boot/u-boot
+ln -s boot/u-boot ${tmpdir}/root/link
+for i in $(seq 1 ${FILES}); do
+	echo "file $i" >${tmpdir}/root/etc/f$i
+done
+head -c 300000 /dev/urandom >${tmpdir}/other/rand
+crc_rand=$(crc_of ${tmpdir}/root/rand)
+crc_uboot=$(crc_of ${tmpdir}/root/boot/u-boot)
+crc_small=$(crc_of ${tmpdir}/root/etc/f$((FILES / 2)))
+crc_other=$(crc_of ${tmpdir}/other/rand)
+
+mkfs.jffs2 -r ${tmpdir}/root -e ${ERASE_SIZE} -n -p \
+	-o ${tmpdir}/plain.img || fail "mkfs.jffs2"
+sumtool -i ${tmpdir}/plain.img -o ${tmpdir}/sum.img -e ${ERASE_SIZE} -n -p ||
+	fail "sumtool"
+mkfs.jffs2 -r ${tmpdir}/other -e ${ERASE_SIZE} -n -p \
+	-o ${tmpdir}/other.img || fail "mkfs.jffs2"
+
+run_jffs2 "$(write_image ${tmpdir}/plain.img)
+${load_all}"
+check_load "no summary"
+plain_ms=$(get_time 1)
+cached_ms=$(get_time 2)
+
+run_jffs2 "$(write_image ${tmpdir}/sum.img)
+${load_all}"
+check_load "summary"
+sum_ms=$(get_time 1)
+
+echo "Scan: ${plain_ms} ms without summaries, ${sum_ms} ms with them;" \
+	"cached load: ${cached_ms} ms"
+[ ${sum_ms} -lt ${plain_ms} ] || fail "summaries are not faster"
+[ ${cached_ms} -lt ${sum_ms} ] || fail "cached load is not faster"
+
+# The cached scan must not survive another image
+run_jffs2 "fsload 3000000 rand
+$(write_image ${tmpdir}/other.img)
+fsload 3000000 rand
+crc32 3000000 \${filesize}"
+grep -q "==> ${crc_other}" ${tmpdir}/out || fail "new image"
+
+cleanup
+echo "Test passed"
@@ -0,0 +1,132 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of NAND reads using the read cache commands
+#
+# Writes random data to a simulated large page chip with typical timings,
+# then reads it back with the read cache commands and without them. Each
+# way must read the data back, the page counts 'nand read' reports must
+# match the chip's own, and the read cache must make the read faster. With
+# a bit flipped in every page the data must still be corrected page by page,
+# and two flipped bits in a page in the middle of a read must fail it. A
+# small page chip has no read cache.
+#
+# Usage: test-nand-cache-read.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+# 2MiB on a 128MiB chip with 2KiB pages and 128KiB blocks
+SIZE=0x200000
+GEOM=128M:2K:64:128K
+PAGES=$((SIZE / 2048))
+
+# 25us page read, 250us program, 2ms erase and a 40MB/s bus
+TIMING=25:250:2000:25
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_nand <geometry> <extra_args> <commands>
+run_nand() {
+	./${OUTPUT_DIR}/u-boot --nand $1:${tmpdir}/nand.bin \
+		--nand_timing ${TIMING} $2 -c "$3" >${tmpdir}/out 2>&1
+}
+
+# Scan for bad blocks first so that only the read is counted
+read_all="
+nand bad
+nandsim stats reset
+nand read 2000000 0 $(printf "%x" $((SIZE)))
+crc32 2000000 $(printf "%x" $((SIZE)))
+nandsim stats"
+
+# Print the pages, the pages by read cache (2) or the ms (3) of the
+# line printed by 'nand read'
+nand_pages() {
+	awk -v n=$1 '/ by read cache\) in / {
+		sub("\\(", ""); split("1 3 8", f); print $f[n] }' ${tmpdir}/out
+}
+
+# Print the number after a label in the last 'nandsim stats' output
+sim_count() {
+	sed -n "s/^$1: *\([0-9]*\).*/\1/p" ${tmpdir}/out | tail -1
+}
+
+# check_read <name> <pages by read cache>
+check_read() {
+	grep -q "==> ${crc}" ${tmpdir}/out || fail "$1: read"
+	[ "$(nand_pages 1)" = "${PAGES}" ] || fail "$1: page count"
+	[ "$(nand_pages 2)" = "$2" ] || fail "$1: read cache page count"
+	[ "$(sim_count "page reads")" = "${PAGES}" ] ||
+		fail "$1: chip page count"
+	[ "$(sim_count "cache reads")" = "$2" ] ||
+		fail "$1: chip read cache page count"
+}
+
+echo "NAND read cache test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((SIZE)) /dev/urandom >${tmpdir}/in
+crc=$(gzip -c ${tmpdir}/in | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+
+run_nand ${GEOM} "" "
+load hostfs - 1000000 ${tmpdir}/in
+nand erase 0 $(printf "%x" $((SIZE)))
+nand write 1000000 0 $(printf "%x" $((SIZE)))"
+grep -q "bytes written: OK" ${tmpdir}/out || fail "write"
+
+# Only the first page needs a plain read
+run_nand ${GEOM} "" "${read_all}"
+check_read "read cache" $((PAGES - 1))
+cache_ms=$(nand_pages 3)
+
+run_nand ${GEOM} "--nand_no_cache_read" "${read_all}"
+check_read "no read cache" 0
+plain_ms=$(nand_pages 3)
+
+echo "Read ${PAGES} pages: ${cache_ms} ms with read cache," \
+	"${plain_ms} ms without"
+[ ${cache_ms} -lt ${plain_ms} ] || fail "read cache is not faster"
+
+run_nand ${GEOM} "--nand_bitflips 1" "${read_all}"
+check_read "bit flips" $((PAGES - 1))
+[ "$(sim_count "bit flips")" = "${PAGES}" ] || fail "no bit flips"
+
+# Two bits in the first ECC step of page 5, read by read cache
+run_nand ${GEOM} "" "nandsim flip 5 0 0
+nandsim flip 5 1 0
+${read_all}"
+grep -q "failed -74" ${tmpdir}/out ||
+	fail "uncorrectable read cache page succeeded"
+
+rm -f ${tmpdir}/nand.bin
+run_nand 32M:512:16:16K "" "
+load hostfs - 1000000 ${tmpdir}/in
+nand erase 0 $(printf "%x" $((SIZE)))
+nand write 1000000 0 $(printf "%x" $((SIZE)))
+${read_all}"
+grep -q "==> ${crc}" ${tmpdir}/out || fail "small page: read"
+[ "$(nand_pages 2)" = "0" ] || fail "small page: read cache used"
+
+cleanup
+echo "Test passed"
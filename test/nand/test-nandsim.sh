@@ -0,0 +1,142 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test of the sandbox NAND simulator
+#
+# For a small page, a large page and a 4KiB page chip with an OOB size that
+# needs its own ECC layout, writes random data over a factory bad block and
+# checks that it reads back, that the bad block was skipped in the file and
+# that the data reads back with a bit flipped in every page. Two flipped
+# bits in one ECC step must fail the read, and a block which goes bad must
+# fail to erase. Then reports the read and write throughput of a large page
+# chip with typical timings.
+#
+# Usage: test-nandsim.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+# Bytes written to each chip
+SIZE=0x100000
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_nand <geometry> <extra_args> <commands>
+run_nand() {
+	./${OUTPUT_DIR}/u-boot --nand $1:${tmpdir}/nand.bin $2 -c "$3" \
+		>${tmpdir}/out 2>&1
+}
+
+# Copy the page data out of the chip file, leaving out block 2
+# extract <page_size> <oob_size> <erase_size>
+extract() {
+	local pages=$((SIZE / $1 + $3 / $1))
+	local skip_from=$((2 * $3 / $1))
+	local skip_to=$((3 * $3 / $1))
+	local page
+
+	: >${tmpdir}/data
+	for page in $(seq 0 $((pages - 1))); do
+		if [ ${page} -ge ${skip_from} -a ${page} -lt ${skip_to} ]; then
+			continue
+		fi
+		dd if=${tmpdir}/nand.bin bs=$(($1 + $2)) skip=${page} \
+			count=1 2>/dev/null | head -c $1 >>${tmpdir}/data
+	done
+}
+
+# check_geometry <size> <page_size> <oob_size> <erase_size>
+check_geometry() {
+	local geom=$1:$2:$3:$4
+	local write="
+load hostfs - 1000000 ${tmpdir}/in
+nand erase 0 $(printf "%x" $((SIZE + $4)))
+nand write 1000000 0 $(printf "%x" $((SIZE)))"
+	local read="
+nand read 2000000 0 $(printf "%x" $((SIZE)))
+crc32 2000000 $(printf "%x" $((SIZE)))"
+
+	rm -f ${tmpdir}/nand.bin
+	run_nand ${geom} "--nand_badblocks 2" "${write}
+nand bad"
+	grep -q "bytes written: OK" ${tmpdir}/out || fail "${geom}: write"
+	grep -q "^  $(printf "%08x" $((2 * $4)))" ${tmpdir}/out ||
+		fail "${geom}: no bad block"
+	extract $2 $3 $4
+	cmp -s ${tmpdir}/in ${tmpdir}/data || fail "${geom}: chip contents"
+
+	run_nand ${geom} "" "${read}"
+	grep -q "==> ${crc}" ${tmpdir}/out || fail "${geom}: read"
+
+	run_nand ${geom} "--nand_bitflips 1" "${read}
+nandsim stats"
+	grep -q "==> ${crc}" ${tmpdir}/out || fail "${geom}: bit flips"
+	grep -q "^bit flips: *[1-9]" ${tmpdir}/out ||
+		fail "${geom}: no bit flips"
+
+	# Two bits in the first ECC step of the first page
+	run_nand ${geom} "" "nandsim flip 0 0 0
+nandsim flip 0 1 0
+${read}"
+	grep -q "failed -74" ${tmpdir}/out ||
+		fail "${geom}: uncorrectable read succeeded"
+
+	run_nand ${geom} "" "nandsim bad 4
+nand erase $(printf "%x" $((4 * $4))) $(printf "%x" $4)"
+	grep -q "Erase failure: -5" ${tmpdir}/out ||
+		fail "${geom}: bad block erased"
+
+	echo "${geom}: OK"
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+echo "NAND simulator test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((SIZE)) /dev/urandom >${tmpdir}/in
+crc=$(gzip -c ${tmpdir}/in | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+
+check_geometry 32M 512 16 16384
+check_geometry 64M 2048 64 131072
+check_geometry 128M 4096 224 262144
+
+# 25us page read, 250us program, 2ms erase and a 40MB/s bus
+rm -f ${tmpdir}/nand.bin
+run_nand 128M:2K:64:128K "--nand_timing 25:250:2000:25" "
+load hostfs - 1000000 ${tmpdir}/in
+nand erase 0 $(printf "%x" $((SIZE)))
+nand read 2000000 0 1
+time nand write 1000000 0 $(printf "%x" $((SIZE)))
+time nand read 2000000 0 $(printf "%x" $((SIZE)))
+crc32 2000000 $(printf "%x" $((SIZE)))"
+grep -q "==> ${crc}" ${tmpdir}/out || fail "timed read"
+echo "Write $((SIZE)) bytes in $(get_time 1) ms," \
+	"read in $(get_time 2) ms"
+
+cleanup
+echo "Test passed"
@@ -0,0 +1,113 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# TFTP test and benchmark using the sandbox Ethernet driver
+#
+# The sandbox Ethernet driver emulates a TFTP server which serves files
+# from a host directory over a link with a configurable round trip time and
+# packet loss (see drivers/net/sandbox.c). This loads a file with different
+# TFTP window sizes, checks it with crc32 and reports the throughput. It
+# also records a session to a pcap file and checks that replaying it gives
+# the same file.
+#
+# Usage: test-tftp.sh [size_in_MB]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+SIZE_MB=${1:-4}
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_tftp <file> <rtt_us> <drop> <windowsize> [<blocksize>]
+run_tftp() {
+	./${OUTPUT_DIR}/u-boot --eth loop:${tmpdir}:$2:$3 -c "
+setenv tftptimeout 1000
+setenv tftpblocksize ${5:-1468}
+setenv tftpwindowsize $4
+tftp 1000000 $1
+crc32 1000000 \${filesize}" >${tmpdir}/out 2>&1
+
+	crc=$(gzip -c ${tmpdir}/$1 | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+	grep -q "==> ${crc}" ${tmpdir}/out ||
+		fail "crc mismatch: $1, rtt $2us, drop $3, window $4"
+	printf "%-10s rtt %5sus drop 1/%-3s window %-3s %10s, %s timeouts\n" \
+		$1 $2 $3 $4 "$(grep -o '[0-9.]* [KM]iB/s' ${tmpdir}/out)" \
+		$(grep -o "T " ${tmpdir}/out | wc -l)
+}
+
+# run_replay <file> <rtt_us> <drop> <windowsize>
+run_replay() {
+	local cmds="
+setenv tftptimeout 1000
+setenv tftpwindowsize $4
+tftp 1000000 $1
+crc32 1000000 \${filesize}
+sb eth"
+
+	./${OUTPUT_DIR}/u-boot --eth loop:${tmpdir}:$2:$3 \
+		--eth_record ${tmpdir}/session.pcap -c "${cmds}" \
+		>${tmpdir}/out 2>&1
+	./${OUTPUT_DIR}/u-boot --eth pcap:${tmpdir}/session.pcap \
+		-c "${cmds}" >${tmpdir}/replay 2>&1
+
+	crc=$(gzip -c ${tmpdir}/$1 | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+	grep -q "==> ${crc}" ${tmpdir}/replay ||
+		fail "crc mismatch in replay: $1, drop $3, window $4"
+	grep -q "replay complete, 0 packets" ${tmpdir}/replay ||
+		fail "replay out of step: $1, drop $3, window $4"
+	printf "%-10s replay of window %-3s %10s, rx %s ns per packet\n" \
+		$1 $4 "$(grep -o '[0-9.]* [KM]iB/s' ${tmpdir}/replay)" \
+		$(awk '$1 == "rx" { print $5 }' ${tmpdir}/replay)
+}
+
+echo "TFTP test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+head -c $((SIZE_MB * 1000000)) /dev/urandom >${tmpdir}/big.bin
+# Ends with a short block, and one ending with an empty block
+head -c 100000 /dev/urandom >${tmpdir}/small.bin
+head -c $((1468 * 64)) /dev/urandom >${tmpdir}/even.bin
+# Two wraps of the 16-bit block number with 32-byte blocks
+head -c $((32 * 65536 * 2)) /dev/urandom >${tmpdir}/wrap.bin
+
+# Throughput against the round trip time
+for window in 1 4 16 64; do
+	run_tftp big.bin 1000 0 ${window}
+done
+
+# Lost blocks in the middle and at the end of a window; a lost last block
+# costs a timeout
+for window in 1 4 16; do
+	run_tftp small.bin 100 13 ${window}
+	run_tftp even.bin 100 16 ${window}
+done
+
+# Block numbers wrap after 65535 blocks
+run_tftp wrap.bin 0 0 16 32
+
+# Replay of recorded sessions, with and without loss
+run_replay big.bin 1000 0 16
+run_replay small.bin 100 13 16
+
+cleanup
+echo "Test passed"
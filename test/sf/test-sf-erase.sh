@@ -0,0 +1,98 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of the SPI flash erase planner
+#
+# Uses the sandbox SPI flash emulator with a W25Q128, which has 4KiB, 32KiB
+# and 64KiB erase commands plus chip erase, and erase times scaled to a
+# percentage of the datasheet's typical times. Erases a region that is not
+# 64KiB aligned with one 'sf erase', checks the plan and that exactly that
+# region was erased, then erases the same region again 4KiB at a time, as
+# it used to be, and reports the time each way. Finally the whole flash must
+# be erased with one chip erase.
+#
+# Usage: test-sf-erase.sh [erase_time_percent]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+PERCENT=${1:-10}
+
+# Region to erase: 4KiB before a 32KiB boundary to just under 1MiB later
+OFFSET=0x7000
+LEN=0xf9000
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_sf <commands>
+run_sf() {
+	./${OUTPUT_DIR}/u-boot --spi_sf 0:0:W25Q128:${tmpdir}/flash.bin \
+		--spi_sf_erase_time ${PERCENT} -c "sf probe 0:0; $1" \
+		>${tmpdir}/out 2>&1
+}
+
+# Total time in ms reported by the erases in the output
+erase_ms() {
+	awk '/ erase in / { ms += $(NF - 4) } END { print ms + 0 }' \
+		${tmpdir}/out
+}
+
+echo "SPI flash erase planner test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((16 << 20)) /dev/urandom >${tmpdir}/orig.bin
+cp ${tmpdir}/orig.bin ${tmpdir}/expect.bin
+tr '\0' '\377' </dev/zero | head -c $((LEN)) |
+	dd of=${tmpdir}/expect.bin bs=4096 seek=$((OFFSET / 4096)) \
+		conv=notrunc 2>/dev/null
+
+cp ${tmpdir}/orig.bin ${tmpdir}/flash.bin
+run_sf "sf erase ${OFFSET} ${LEN}"
+grep -q "plan: 1 x 4 KiB, 1 x 32 KiB, 15 x 64 KiB" ${tmpdir}/out ||
+	fail "wrong erase plan"
+cmp -s ${tmpdir}/flash.bin ${tmpdir}/expect.bin || fail "planned erase"
+planned=$(erase_ms)
+
+cmds=
+for off in $(seq $((OFFSET)) 4096 $((OFFSET + LEN - 1))); do
+	cmds="${cmds}sf erase $(printf "%x" ${off}) 1000; "
+done
+cp ${tmpdir}/orig.bin ${tmpdir}/flash.bin
+run_sf "${cmds}"
+cmp -s ${tmpdir}/flash.bin ${tmpdir}/expect.bin || fail "4KiB erase"
+small=$(erase_ms)
+
+echo "Erase $((LEN)) bytes at ${PERCENT}% of typical times:" \
+	"planned ${planned} ms, 4KiB at a time ${small} ms"
+
+# An unaligned region must be refused
+run_sf "sf erase 7800 1000"
+grep -q "Erased: ERROR" ${tmpdir}/out || fail "unaligned erase accepted"
+
+cp ${tmpdir}/orig.bin ${tmpdir}/flash.bin
+run_sf "sf erase 0 1000000"
+grep -q "plan: 1 x chip" ${tmpdir}/out || fail "no chip erase"
+tr '\0' '\377' </dev/zero | head -c $((16 << 20)) | \
+	cmp -s - ${tmpdir}/flash.bin || fail "chip erase"
+
+cleanup
+echo "Test passed"
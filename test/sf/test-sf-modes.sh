@@ -0,0 +1,102 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of SPI flash dual and quad transfer modes
+#
+# Uses the sandbox SPI bus with a choice of transfer modes (--spi_op_mode),
+# taking as long as the bus would at 50MHz (--spi_timing), and the SPI flash
+# emulator, which refuses commands on the wrong number of lines, and quad
+# commands unless the quad enable bit is set. For each set of bus modes the
+# flash core must pick the fastest read and page program commands that the
+# bus and flash share: the data read must be right and reading must take as
+# long as that many lines need. Reports the read and write throughput.
+#
+# Usage: test-sf-modes.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+HZ=50000000
+SIZE=$((1 << 20))
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+# run_modes <flash> <rx>:<tx> <expected read lines> <description>
+run_modes() {
+	size_hex=$(printf "%x" ${SIZE})
+	./${OUTPUT_DIR}/u-boot --spi_sf 0:0:$1:${tmpdir}/flash.bin \
+		--spi_timing --spi_op_mode $2 -c "
+sf probe 0:0 ${HZ}
+time sf read 1000000 0 ${size_hex}
+crc32 1000000 ${size_hex}
+sf erase 0 ${size_hex}
+time sf write 1000000 0 ${size_hex}
+sf read 2000000 0 ${size_hex}
+cmp.b 1000000 2000000 ${size_hex}" >${tmpdir}/out 2>&1
+
+	grep -q "==> ${crc}" ${tmpdir}/out || fail "$4: read data"
+	grep -q "were the same" ${tmpdir}/out || fail "$4: written data"
+	if grep -q "sandbox_sf:" ${tmpdir}/out; then
+		fail "$4: $(grep -m1 sandbox_sf: ${tmpdir}/out)"
+	fi
+
+	# The bus time is a minimum; allow for the emulation on top
+	bus_ms=$((SIZE * 8 * 1000 / $3 / HZ))
+	read_ms=$(get_time 1)
+	write_ms=$(get_time 2)
+	[ ${read_ms} -ge $((bus_ms * 95 / 100)) ] &&
+		[ ${read_ms} -lt $((bus_ms * 3 / 2)) ] ||
+		fail "$4: read took ${read_ms} ms, expected ${bus_ms} ms"
+	printf "%-26s read %2d lines %6d KiB/s, write %6d KiB/s\n" "$4" $3 \
+		$((SIZE * 1000 / 1024 / read_ms)) \
+		$((SIZE * 1000 / 1024 / write_ms))
+}
+
+echo "SPI flash transfer mode test using sandbox at ${HZ} Hz"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((16 << 20)) /dev/urandom >${tmpdir}/flash.bin
+crc=$(head -c ${SIZE} ${tmpdir}/flash.bin | gzip -c | tail -c8 |
+	od -An -tx4 -N4 | tr -d ' ')
+
+# SPI_OPM_RX_...: 2 dual output, 4 dual I/O, 8 quad output, 10 quad I/O
+run_modes W25Q128 0:0 1 "W25Q128 single"
+run_modes W25Q128 2:0 2 "W25Q128 dual output"
+run_modes W25Q128 4:0 2 "W25Q128 dual I/O"
+run_modes W25Q128 8:1 4 "W25Q128 quad output, QPP"
+run_modes W25Q128 10:1 4 "W25Q128 quad I/O, QPP"
+run_modes W25Q128 1f:0 4 "W25Q128 all reads, no QPP"
+
+# The M25P16 has single line commands only, whatever the bus offers
+head -c $((2 << 20)) /dev/urandom >${tmpdir}/flash.bin
+crc=$(head -c ${SIZE} ${tmpdir}/flash.bin | gzip -c | tail -c8 |
+	od -An -tx4 -N4 | tr -d ' ')
+run_modes M25P16 1f:1 1 "M25P16 all modes"
+
+cleanup
+echo "Test passed"
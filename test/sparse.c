@@ -0,0 +1,300 @@
+/*
+ * Test of writing Android sparse images, through the sandbox host block
+ * device
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <os.h>
+#include <part.h>
+#include <sandboxblockdev.h>
+#include <sparse_format.h>
+
+#define TEST_FILE	"/tmp/u-boot-sparse-test.img"
+#define TEST_DEV	0
+#define TEST_BLOCKS	256
+#define BLKSZ		512
+
+/* The partition, and what is outside it */
+#define PART_START	16
+#define PART_SIZE	128
+#define OUTSIDE		0x5a
+
+/* Sparse blocks of 4KiB */
+#define SPARSE_BLKSZ	4096
+#define DEV_BLOCKS	(SPARSE_BLKSZ / BLKSZ)
+
+#define FILL_VALUE	0x11223344
+
+/* Where the data of the first chunk, a raw one, starts in the image */
+#define RAW_OFFSET	(sizeof(sparse_header_t) + sizeof(chunk_header_t))
+
+#define errcheck(statement) if (!(statement)) { \
+	fprintf(stderr, "\tFailed: %s\n", #statement); \
+	ret = 1; \
+	goto out; \
+}
+
+/* Every block of the backing file starts as OUTSIDE */
+static int create_image(void)
+{
+	char block[BLKSZ];
+	int fd, i;
+
+	fd = os_open(TEST_FILE, OS_O_RDWR | OS_O_CREAT);
+	if (fd < 0)
+		return -1;
+	memset(block, OUTSIDE, BLKSZ);
+	for (i = 0; i < TEST_BLOCKS; i++) {
+		if (os_write(fd, block, BLKSZ) != BLKSZ) {
+			os_close(fd);
+			return -1;
+		}
+	}
+	os_close(fd);
+
+	return 0;
+}
+
+/* Start again, without anything the block cache kept */
+static int reset_image(block_dev_desc_t *dev_desc)
+{
+	blkcache_invalidate(dev_desc->if_type, dev_desc->dev);
+
+	return create_image();
+}
+
+static u8 raw_byte(int sparse_blk, int i)
+{
+	return sparse_blk * 37 + i * 7;
+}
+
+static u8 *add_chunk(u8 *p, int type, int blocks, int first)
+{
+	chunk_header_t *chunk = (chunk_header_t *)p;
+	int data = 0;
+	int i;
+
+	p += sizeof(*chunk);
+	switch (type) {
+	case CHUNK_TYPE_RAW:
+		data = blocks * SPARSE_BLKSZ;
+		for (i = 0; i < data; i++)
+			p[i] = raw_byte(first + i / SPARSE_BLKSZ, i);
+		break;
+	case CHUNK_TYPE_FILL:
+		data = 4;
+		*(u32 *)p = cpu_to_le32(FILL_VALUE);
+		break;
+	case CHUNK_TYPE_CRC32:
+		data = 4;
+		break;
+	}
+	chunk->chunk_type = cpu_to_le16(type);
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = cpu_to_le32(blocks);
+	chunk->total_sz = cpu_to_le32(sizeof(*chunk) + data);
+
+	return p + data;
+}
+
+/*
+ * Sparse blocks 0-1 raw, 2-4 not cared about, 5-8 filled and 9 raw, with
+ * a CRC32 chunk before the last one. Returns the size of the image.
+ */
+static int make_sparse(u8 *img, int total_blks)
+{
+	sparse_header_t *hdr = (sparse_header_t *)img;
+	u8 *p = img + sizeof(*hdr);
+
+	hdr->magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	hdr->major_version = cpu_to_le16(SPARSE_MAJOR_VERSION);
+	hdr->minor_version = 0;
+	hdr->file_hdr_sz = cpu_to_le16(sizeof(sparse_header_t));
+	hdr->chunk_hdr_sz = cpu_to_le16(sizeof(chunk_header_t));
+	hdr->blk_sz = cpu_to_le32(SPARSE_BLKSZ);
+	hdr->total_blks = cpu_to_le32(total_blks);
+	hdr->total_chunks = cpu_to_le32(5);
+	hdr->image_checksum = 0;
+
+	p = add_chunk(p, CHUNK_TYPE_RAW, 2, 0);
+	p = add_chunk(p, CHUNK_TYPE_DONT_CARE, 3, 2);
+	p = add_chunk(p, CHUNK_TYPE_FILL, 4, 5);
+	p = add_chunk(p, CHUNK_TYPE_CRC32, 0, 9);
+	p = add_chunk(p, CHUNK_TYPE_RAW, 1, 9);
+
+	return p - img;
+}
+
+/* Check a device block written from sparse block @sparse_blk */
+static int check_block(const u8 *buf, int sparse_blk, int dev_blk)
+{
+	u32 fill = cpu_to_le32(FILL_VALUE);
+	int i, off;
+
+	for (i = 0; i < BLKSZ; i++) {
+		off = (dev_blk % DEV_BLOCKS) * BLKSZ + i;
+		if (sparse_blk < 2 || sparse_blk == 9) {
+			if (buf[i] != raw_byte(sparse_blk, off))
+				return 0;
+		} else if (sparse_blk < 5) {
+			if (buf[i] != OUTSIDE)
+				return 0;
+		} else if (buf[i] != ((u8 *)&fill)[i % 4]) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int check_outside(const u8 *buf)
+{
+	int i;
+
+	for (i = 0; i < BLKSZ; i++) {
+		if (buf[i] != OUTSIDE)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int check_device(block_dev_desc_t *dev_desc, u8 *buf)
+{
+	int blk;
+
+	if (blk_dread(dev_desc, 0, TEST_BLOCKS, buf) != TEST_BLOCKS)
+		return 0;
+	for (blk = 0; blk < TEST_BLOCKS; blk++, buf += BLKSZ) {
+		int part_blk = blk - PART_START;
+
+		if (part_blk >= 0 && part_blk < 10 * DEV_BLOCKS) {
+			if (!check_block(buf, part_blk / DEV_BLOCKS, part_blk))
+				return 0;
+		} else if (!check_outside(buf)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Write an image in pieces of @piece bytes */
+static int write_image(struct sparse_writer *sw, block_dev_desc_t *dev_desc,
+		       const u8 *img, int size, int piece, void *buf,
+		       ulong buf_size)
+{
+	disk_partition_t info;
+	int ret, n;
+
+	info.start = PART_START;
+	info.size = PART_SIZE;
+	sparse_writer_init(sw, dev_desc, &info, buf, buf_size);
+	for (; size; img += n, size -= n) {
+		n = min(size, piece);
+		ret = sparse_writer_write(sw, img, n);
+		if (ret)
+			return ret;
+	}
+
+	return sparse_writer_finish(sw);
+}
+
+static int do_ut_sparse(cmd_tbl_t *cmdtp, int flag, int argc,
+			char * const argv[])
+{
+	struct sparse_writer sw;
+	block_dev_desc_t *dev_desc;
+	u8 *img = NULL, *buf = NULL, *stage = NULL;
+	int ret = 0, size, shift;
+
+	printf("%s: Testing sparse images\n", __func__);
+	img = memalign(ARCH_DMA_MINALIGN,
+		       (PART_SIZE + 1) * BLKSZ + ARCH_DMA_MINALIGN);
+	buf = malloc(TEST_BLOCKS * BLKSZ);
+	stage = malloc(16 * SPARSE_BLKSZ);
+	errcheck(img && buf && stage);
+	errcheck(create_image() == 0);
+	errcheck(host_dev_bind(TEST_DEV, TEST_FILE) == 0);
+	dev_desc = host_get_dev(TEST_DEV);
+	errcheck(dev_desc != NULL);
+
+	/* Small pieces, collected in a staging buffer of a few blocks */
+	size = make_sparse(img, 10);
+	errcheck(write_image(&sw, dev_desc, img, size, 1000, stage,
+			     4 * BLKSZ) == 0);
+	errcheck(check_device(dev_desc, buf));
+	errcheck(sw.written == 7 * DEV_BLOCKS);
+	errcheck(sw.filled == 4 * DEV_BLOCKS);
+	errcheck(sw.skipped == 3 * DEV_BLOCKS);
+
+	/* The whole image at once, unaligned raw chunks staged */
+	errcheck(reset_image(dev_desc) == 0);
+	errcheck(write_image(&sw, dev_desc, img, size, size, stage,
+			     SPARSE_BLKSZ) == 0);
+	errcheck(check_device(dev_desc, buf));
+
+	/* Again with the first raw chunk aligned, so written in place */
+	shift = ARCH_DMA_MINALIGN - RAW_OFFSET % ARCH_DMA_MINALIGN;
+	memmove(img + shift, img, size);
+	errcheck(reset_image(dev_desc) == 0);
+	errcheck(write_image(&sw, dev_desc, img + shift, size, size, stage,
+			     SPARSE_BLKSZ) == 0);
+	errcheck(check_device(dev_desc, buf));
+	memmove(img, img + shift, size);
+
+	/* A byte at a time */
+	errcheck(reset_image(dev_desc) == 0);
+	errcheck(write_image(&sw, dev_desc, img, size, 1, stage,
+			     SPARSE_BLKSZ) == 0);
+	errcheck(check_device(dev_desc, buf));
+
+	/* Bad images */
+	errcheck(write_image(&sw, dev_desc, img, size - 1, 1000, stage,
+			     SPARSE_BLKSZ) != 0);
+	errcheck(!strcmp(sw.err, "image is truncated"));
+	make_sparse(img, PART_SIZE / DEV_BLOCKS + 1);
+	errcheck(write_image(&sw, dev_desc, img, size, 1000, stage,
+			     SPARSE_BLKSZ) != 0);
+	errcheck(!strcmp(sw.err, "image too large for partition"));
+	make_sparse(img, 10);
+	((chunk_header_t *)(img + sizeof(sparse_header_t)))->chunk_type = 0;
+	errcheck(write_image(&sw, dev_desc, img, size, 1000, stage,
+			     SPARSE_BLKSZ) != 0);
+	errcheck(!strcmp(sw.err, "unknown chunk type"));
+
+	/* Other images are written as they are, padded to a block */
+	errcheck(reset_image(dev_desc) == 0);
+	memset(img, 0xa5, 1000);
+	errcheck(write_image(&sw, dev_desc, img, 1000, 300, stage,
+			     SPARSE_BLKSZ) == 0);
+	errcheck(sw.written == 2);
+	errcheck(blk_dread(dev_desc, PART_START, 3, buf) == 3);
+	errcheck(buf[999] == 0xa5 && buf[1000] == 0 && buf[1023] == 0);
+	errcheck(check_outside(buf + 2 * BLKSZ));
+	memset(img, 0xa5, PART_SIZE * BLKSZ + 1);
+	errcheck(write_image(&sw, dev_desc, img, PART_SIZE * BLKSZ + 1,
+			     PART_SIZE * BLKSZ + 1, stage, SPARSE_BLKSZ) != 0);
+	errcheck(!strcmp(sw.err, "image too large for partition"));
+
+out:
+	free(img);
+	free(buf);
+	free(stage);
+	host_dev_bind(TEST_DEV, NULL);
+	os_unlink(TEST_FILE);
+	printf("%s: %s\n", __func__, ret == 0 ? "ok" : "FAILED");
+
+	return ret;
+}
+
+U_BOOT_CMD(
+	ut_sparse,	5,	1,	do_ut_sparse,
+	"Test writing Android sparse images using the sandbox host block device",
+	""
+);
@@ -0,0 +1,128 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of attaching UBI from a fastmap
+#
+# Uses the sandbox MTD device with a read time per page. Formats the device
+# with two volumes of random data and detaches it, which writes a fastmap,
+# then attaches from the fastmap and by scanning the device in turn, checks
+# the volumes each way and reports the time taken to attach. A fastmap with
+# a bad super block must be ignored, and a write made after attaching from
+# a fastmap must make the next attach scan the device.
+#
+# Usage: test-ubi-fastmap.sh [read_us_per_page]
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+READ_US=${1:-25}
+
+# 64MiB of 128KiB eraseblocks
+MTDRAM=64M:128K
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_ubi <flash_file> <commands>
+run_ubi() {
+	./${OUTPUT_DIR}/u-boot --mtdram ${MTDRAM}:$1 \
+		--mtdram_read_us ${READ_US} -c "
+mtdparts default
+time ubi part ubi
+$2" >${tmpdir}/out 2>&1
+}
+
+# Print the time taken by 'ubi part' in ms
+attach_ms() {
+	awk '/^time:/ { sub("\\.", "", $2); print $2 + 0; exit }' \
+		${tmpdir}/out
+}
+
+# Read both volumes back and check them
+check_volumes() {
+	grep -q "==> ${crc1}" ${tmpdir}/out || fail "$1: vol1 mismatch"
+	grep -q "==> ${crc2}" ${tmpdir}/out || fail "$1: vol2 mismatch"
+}
+
+read_volumes="
+ubi read 1000000 vol1 300000
+crc32 1000000 300000
+ubi read 2000000 vol2 180000
+crc32 2000000 180000"
+
+# Offset of the fastmap super block magic in a flash file
+find_magic() {
+	grep -obUaP '\x7b\x11\xd6\x9f' $1 | head -1 | cut -d: -f1
+}
+
+echo "UBI fastmap test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((0x300000)) /dev/urandom >${tmpdir}/vol1
+head -c $((0x180000)) /dev/urandom >${tmpdir}/vol2
+crc1=$(gzip -c ${tmpdir}/vol1 | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+crc2=$(gzip -c ${tmpdir}/vol2 | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+
+run_ubi ${tmpdir}/flash.bin "
+ubi create vol1 400000
+ubi create vol2 200000 s
+load hostfs - 1000000 ${tmpdir}/vol1
+ubi write 1000000 vol1 300000
+load hostfs - 2000000 ${tmpdir}/vol2
+ubi write 2000000 vol2 180000
+ubi detach"
+grep -q "fastmap written" ${tmpdir}/out || fail "no fastmap written"
+
+run_ubi ${tmpdir}/flash.bin "${read_volumes}"
+grep -q "attaching by fastmap" ${tmpdir}/out || fail "fastmap not used"
+check_volumes "fastmap"
+fastmap=$(attach_ms)
+
+# Spoil the super block magic so that the device is scanned
+cp ${tmpdir}/flash.bin ${tmpdir}/scan.bin
+printf '\0' | dd of=${tmpdir}/scan.bin bs=1 \
+	seek=$(find_magic ${tmpdir}/scan.bin) conv=notrunc 2>/dev/null
+run_ubi ${tmpdir}/scan.bin "${read_volumes}"
+grep -q "bad fastmap, attaching by scanning" ${tmpdir}/out ||
+	fail "bad fastmap used"
+check_volumes "scan"
+scan=$(attach_ms)
+
+echo "Attach $((64 << 20)) bytes at ${READ_US} us per page:" \
+	"fastmap ${fastmap} ms, scan ${scan} ms"
+
+# A write makes the fastmap out of date and it must not be used again
+head -c $((0x1000)) /dev/urandom >${tmpdir}/new
+crc2=$(gzip -c ${tmpdir}/new | tail -c8 | od -An -tx4 -N4 | tr -d ' ')
+run_ubi ${tmpdir}/flash.bin "
+load hostfs - 2000000 ${tmpdir}/new
+ubi write 2000000 vol2 1000"
+grep -q "attaching by fastmap" ${tmpdir}/out || fail "fastmap not used"
+run_ubi ${tmpdir}/flash.bin "
+ubi read 1000000 vol1 300000
+crc32 1000000 300000
+ubi read 2000000 vol2 1000
+crc32 2000000 1000"
+grep -q "no fastmap found" ${tmpdir}/out || fail "stale fastmap used"
+check_volumes "after write"
+
+cleanup
+echo "Test passed"
@@ -0,0 +1,148 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of UBIFS bulk read
+#
+# Makes a UBIFS image holding random data, the compressible sandbox U-Boot
+# binary and a file with a hole, writes it to a UBI volume on a simulated
+# NAND chip with typical timings and loads each file with 'ubifsload', with
+# bulk read and without it. Each file must load correctly either way, as
+# must the start of a file cut off in the middle of a block, and bulk read
+# must load the random data faster. So must the start of the file with the
+# hole, cut off in the last block of the hole.
+#
+# Needs mkfs.ubifs from mtd-utils.
+#
+# Usage: test-ubifs-bulk-read.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+# 128MiB chip with 2KiB pages and 128KiB blocks, 16MiB volume
+GEOM=128M:2K:64:128K
+VOL_SIZE=0x1000000
+
+# 25us page read, 250us program, 2ms erase and a 40MB/s bus
+TIMING=25:250:2000:25
+
+# Bytes loaded from the start of the random file
+PART=12345
+
+# Bytes loaded from the start of the file with the hole, ending in the last
+# block of the hole
+HOLE_PART=$((0x4f800))
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_ubi <extra_args> <commands>
+run_ubi() {
+	./${OUTPUT_DIR}/u-boot --nand ${GEOM}:${tmpdir}/nand.bin $1 -c "
+setenv mtdids nand0=nand0
+setenv mtdparts mtdparts=nand0:-(ubi)
+ubi part ubi
+$2" >${tmpdir}/out 2>&1
+}
+
+crc_of() {
+	gzip -c $1 | tail -c8 | od -An -tx4 -N4 | tr -d ' '
+}
+
+# Print the number after a label in the 'ubi part' output
+ubi_info() {
+	sed -n "s|^UBI: $1: *\([0-9]*\).*|\1|p" ${tmpdir}/out | head -1
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+# Load every file and the start of the random one
+load_all="
+ubifsmount ubi:vol
+time ubifsload 3000000 rand
+crc32 3000000 \${filesize}
+ubifsload 3000000 u-boot
+crc32 3000000 \${filesize}
+ubifsload 3000000 hole
+crc32 3000000 \${filesize}
+ubifsload 3000000 rand $(printf "%x" ${PART})
+crc32 3000000 \${filesize}
+ubifsload 3000000 hole $(printf "%x" ${HOLE_PART})
+crc32 3000000 \${filesize}"
+
+# check_load <name>
+check_load() {
+	grep -q "==> ${crc_rand}" ${tmpdir}/out || fail "$1: random data"
+	grep -q "==> ${crc_uboot}" ${tmpdir}/out || fail "$1: u-boot"
+	grep -q "==> ${crc_hole}" ${tmpdir}/out || fail "$1: hole"
+	grep -q "==> ${crc_part}" ${tmpdir}/out || fail "$1: part block"
+	grep -q "==> ${crc_hole_part}" ${tmpdir}/out || fail "$1: part hole"
+}
+
+echo "UBIFS bulk read test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+mkdir ${tmpdir}/root
+head -c $((0x100000)) /dev/urandom >${tmpdir}/root/rand
+cp ${OUTPUT_DIR}/u-boot ${tmpdir}/root/u-boot
+head -c $((0x10000)) /dev/urandom >${tmpdir}/root/hole
+head -c $((0x40000)) /dev/zero >>${tmpdir}/root/hole
+head -c 8000 /dev/urandom >>${tmpdir}/root/hole
+head -c ${PART} ${tmpdir}/root/rand >${tmpdir}/part
+head -c ${HOLE_PART} ${tmpdir}/root/hole >${tmpdir}/hole_part
+crc_rand=$(crc_of ${tmpdir}/root/rand)
+crc_uboot=$(crc_of ${tmpdir}/root/u-boot)
+crc_hole=$(crc_of ${tmpdir}/root/hole)
+crc_part=$(crc_of ${tmpdir}/part)
+crc_hole_part=$(crc_of ${tmpdir}/hole_part)
+
+run_ubi "" "ubi create vol $(printf "%x" $((VOL_SIZE)))"
+min_io=$(ubi_info "smallest flash I/O unit")
+leb_size=$(ubi_info "logical eraseblock size")
+[ -n "${min_io}" -a -n "${leb_size}" ] || fail "ubi part"
+
+mkfs.ubifs -r ${tmpdir}/root -m ${min_io} -e ${leb_size} \
+	-c $((VOL_SIZE / leb_size)) -x zlib -o ${tmpdir}/ubifs.img ||
+	fail "mkfs.ubifs"
+run_ubi "" "
+load hostfs - 1000000 ${tmpdir}/ubifs.img
+ubi write 1000000 vol \${filesize}"
+grep -q "bytes written to volume vol" ${tmpdir}/out || fail "ubi write"
+
+run_ubi "--nand_timing ${TIMING}" "${load_all}"
+check_load "bulk read"
+bulk_ms=$(get_time 1)
+
+run_ubi "--nand_timing ${TIMING}" "setenv ubifs_bulk_read no
+${load_all}"
+check_load "no bulk read"
+plain_ms=$(get_time 1)
+
+echo "Load $((0x100000)) bytes: ${bulk_ms} ms with bulk read," \
+	"${plain_ms} ms without"
+[ ${bulk_ms} -lt ${plain_ms} ] || fail "bulk read is not faster"
+
+cleanup
+echo "Test passed"
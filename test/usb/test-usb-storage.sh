@@ -0,0 +1,120 @@
+# SPDX-License-Identifier:	GPL-2.0+
+#
+# Test and benchmark of USB mass storage reads and writes
+#
+# Reads and writes a simulated USB stick with typical USB 2.0 timings,
+# once with the 10KiB transfers the storage driver used to be limited to
+# on all but EHCI, once with the limit of the xHCI driver and once with no
+# host controller limit. The data must be right each time and larger
+# transfers must be faster. Then checks that a 3TiB disk is read and
+# written beyond 2TiB, where READ(16) and WRITE(16) are needed.
+#
+# Usage: test-usb-storage.sh
+
+OUTPUT_DIR=${OUTPUT_DIR:-sandbox}
+
+# 125us per transfer, one microframe, and about 40MB/s on the bus
+TIMING=125:25
+
+# Size of the stick in MiB
+SIZE=16
+
+fail() {
+	echo "Test failed: $1"
+	cleanup
+	exit 1
+}
+
+cleanup() {
+	if [ -n "${tmpdir}" ]; then
+		rm -rf ${tmpdir}
+	fi
+}
+
+build_uboot() {
+	echo "Build sandbox"
+	OPTS="O=${OUTPUT_DIR}"
+	NUM_CPUS=$(grep -c processor /proc/cpuinfo)
+	make ${OPTS} sandbox_config
+	make ${OPTS} -s -j${NUM_CPUS}
+}
+
+# run_usb <image> <options> <commands>
+run_usb() {
+	./${OUTPUT_DIR}/u-boot --usb_storage $1 $2 -c "usb start
+$3" >${tmpdir}/out 2>&1
+}
+
+crc_of() {
+	gzip -c $1 | tail -c8 | od -An -tx4 -N4 | tr -d ' '
+}
+
+# Print the time reported by the Nth 'time' command in the output, in ms
+get_time() {
+	awk -v n=$1 '/^time:/ && ++i == n {
+		sub("\\.", "", $2); print $2 + 0 }' ${tmpdir}/out
+}
+
+blocks=$(printf "%x" $((SIZE * 2048)))
+bytes=$(printf "%x" $((SIZE * 1024 * 1024)))
+
+# Read the stick, then write other data to it
+# check_rw <name> <options> <blocks per transfer>
+check_rw() {
+	cp ${tmpdir}/old ${tmpdir}/stick
+	run_usb ${tmpdir}/stick "--usb_timing ${TIMING} $2" "
+time usb read 1000000 0 ${blocks}
+crc32 1000000 ${bytes}
+load hostfs - 1000000 ${tmpdir}/new
+time usb write 1000000 0 ${blocks}
+usb storage"
+	grep -q "==> ${crc_old}" ${tmpdir}/out || fail "$1: read"
+	cmp -s ${tmpdir}/stick ${tmpdir}/new || fail "$1: write"
+	grep -q "Transfers of up to $3 blocks" ${tmpdir}/out ||
+		fail "$1: transfer size"
+	grep -q "too large" ${tmpdir}/out && fail "$1: controller limit"
+	echo "$1: read $(get_time 1) ms, write $(get_time 2) ms"
+	eval $1_ms=$(($(get_time 1) + $(get_time 2)))
+}
+
+echo "USB storage test using sandbox"
+echo
+tmpdir="$(mktemp -d)"
+if [ ! -x ${OUTPUT_DIR}/u-boot ]; then
+	build_uboot
+fi
+
+head -c $((SIZE * 1024 * 1024)) /dev/urandom >${tmpdir}/old
+head -c $((SIZE * 1024 * 1024)) /dev/urandom >${tmpdir}/new
+crc_old=$(crc_of ${tmpdir}/old)
+
+check_rw small "--usb_max_xfer 10K" 20
+check_rw xhci "--usb_max_xfer 3968K" 7936
+check_rw nolimit "" $((SIZE * 2048))
+
+[ ${xhci_ms} -lt ${small_ms} ] || fail "xHCI limit is not faster"
+[ ${nolimit_ms} -lt ${small_ms} ] || fail "no limit is not faster"
+
+# 3TiB disk: a write across block 2^32 and one far beyond it
+truncate -s 3T ${tmpdir}/disk || fail "sparse file"
+run_usb ${tmpdir}/disk "" "
+mw.b 1000000 5a 2000
+usb write 1000000 fffffffc 10
+usb write 1000000 140000000 8
+usb read 2000000 fffffffc 10
+cmp.b 1000000 2000000 2000
+usb read 2000000 140000000 8
+cmp.b 1000000 2000000 1000
+usb storage"
+grep -q "(6442450944 x 512)" ${tmpdir}/out || fail "3TiB capacity"
+[ $(grep -c "blocks write: OK" ${tmpdir}/out) = 2 ] || fail "3TiB write"
+[ $(grep -c "blocks read: OK" ${tmpdir}/out) = 2 ] || fail "3TiB read"
+[ $(grep -c "were the same" ${tmpdir}/out) = 2 ] || fail "3TiB data"
+grep -q "Total of 0 byte" ${tmpdir}/out && fail "3TiB data"
+for blk in $((0xffffffff)) $((0x140000007)); do
+	[ "$(od -An -tx1 -j $((blk * 512 + 511)) -N 1 ${tmpdir}/disk)" = \
+		" 5a" ] || fail "3TiB file"
+done
+
+cleanup
+echo "Test passed"